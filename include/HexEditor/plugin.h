@@ -29,23 +29,58 @@ typedef struct _HexEditor HexEditor;
 
 typedef struct _HexEditorPlugin HexEditorPlugin;
 
+/* what the annotations of the plug-ins are */
+typedef enum _HexEditorPluginAnnotation
+{
+	HEPA_FINDING = 0,
+	HEPA_FIELD
+} HexEditorPluginAnnotation;
+
 typedef struct _HexEditorPluginHelper
 {
 	HexEditor * hexeditor;
 	int (*error)(HexEditor * hexeditor, char const * message, int ret);
+	/* random access to the file currently open */
+	ssize_t (*read)(HexEditor * hexeditor, off_t offset, void * buffer,
+			size_t size);
+	/* as much of it as is known yet, when read as it comes */
+	off_t (*get_size)(HexEditor * hexeditor);
+	/* highlight a range of the file currently open, or forget them */
+	int (*annotate)(HexEditor * hexeditor, HexEditorPluginAnnotation type,
+			off_t offset, off_t size, char const * label);
+	void (*annotate_clear)(HexEditor * hexeditor,
+			HexEditorPluginAnnotation type);
 } HexEditorPluginHelper;
 
 typedef const struct _HexEditorPluginDefinition
 {
+	/* HEXEDITOR_PLUGIN_VERSION, as built against */
+	unsigned int version;
 	char const * name;
 	char const * icon;
 	char const * description;
+	/* the instances may live in different threads, one file each */
 	HexEditorPlugin * (*init)(HexEditorPluginHelper * helper);
 	void (*destroy)(HexEditorPlugin * plugin);
+	/* only called when displayed, never in batch mode */
 	GtkWidget * (*get_widget)(HexEditorPlugin * plugin);
 	/* file operations */
+	/* the ranges modified externally may be read again */
 	void (*read)(HexEditorPlugin * plugin, off_t offset,
 			char const * buffer, size_t size);
+	/* analysis cache (optional) */
+	int (*save)(HexEditorPlugin * plugin, void ** buffer, size_t * size);
+	int (*restore)(HexEditorPlugin * plugin, void const * buffer,
+			size_t size);
+	/* the format detected, returns 0 if supported (optional) */
+	int (*format)(HexEditorPlugin * plugin, char const * name);
+	/* the range is a hole, only zeros are not read (optional) */
+	void (*hole)(HexEditorPlugin * plugin, off_t offset, off_t size);
 } HexEditorPluginDefinition;
 
+
+/* constants */
+/* changed along with the definition and the helper */
+# define HEXEDITOR_PLUGIN_VERSION	1
+
 #endif /* DESKTOP_HEXEDITOR_PLUGIN_H */
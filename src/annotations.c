@@ -0,0 +1,636 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <System.h>
+#include "annotations.h"
+
+
+/* HexEditorAnnotations */
+/* private */
+/* types */
+typedef struct _HexEditorAnnotationsItem
+{
+	off_t offset;
+	off_t end;
+	/* the furthest end within the subtree */
+	off_t max;
+	uint32_t color;
+	unsigned char type;
+	/* within the labels, 0 if none */
+	size_t label;
+} HexEditorAnnotationsItem;
+
+struct _HexEditorAnnotations
+{
+	HexEditorAnnotationsItem * items;
+	size_t items_cnt;
+	size_t items_alloc;
+	/* the labels, one after the other */
+	char * labels;
+	size_t labels_cnt;
+	size_t labels_alloc;
+	/* the bytes still in use, the labels removed are left behind */
+	size_t labels_live;
+
+	/* the items sorted are the nodes of an implicit interval tree: the
+	 * leaves have even indices and the root is at 2^levels - 1 */
+	int indexed;
+	int levels;
+};
+
+/* as saved */
+typedef struct _HexEditorAnnotationsHeader
+{
+	uint64_t count;
+	uint64_t size;
+} HexEditorAnnotationsHeader;
+
+
+/* constants */
+#define HEXEDITORANNOTATIONS_STACK	128
+
+
+/* prototypes */
+static void _hexeditorannotations_compact(HexEditorAnnotations * annotations);
+static int _hexeditorannotations_compare(void const * a, void const * b);
+static void _hexeditorannotations_get(HexEditorAnnotations * annotations,
+		HexEditorAnnotationsItem const * item,
+		HexEditorAnnotation * annotation);
+static void _hexeditorannotations_index(HexEditorAnnotations * annotations);
+static void _hexeditorannotations_unlabel(HexEditorAnnotations * annotations,
+		HexEditorAnnotationsItem const * item);
+static size_t _hexeditorannotations_varint_get(char const * buf, size_t size,
+		uint64_t * value);
+static size_t _hexeditorannotations_varint_set(char * buf, uint64_t value);
+
+
+/* public */
+/* functions */
+/* hexeditorannotations_new */
+HexEditorAnnotations * hexeditorannotations_new(void)
+{
+	HexEditorAnnotations * annotations;
+
+	if((annotations = object_new(sizeof(*annotations))) == NULL)
+		return NULL;
+	annotations->items = NULL;
+	annotations->items_cnt = 0;
+	annotations->items_alloc = 0;
+	annotations->labels = NULL;
+	annotations->labels_cnt = 0;
+	annotations->labels_alloc = 0;
+	annotations->labels_live = 0;
+	annotations->indexed = 1;
+	annotations->levels = -1;
+	return annotations;
+}
+
+
+/* hexeditorannotations_new_from_buffer */
+HexEditorAnnotations * hexeditorannotations_new_from_buffer(void const * buf,
+		size_t size)
+{
+	HexEditorAnnotations * annotations;
+	HexEditorAnnotationsHeader header;
+	HexEditorAnnotation annotation;
+	char const * p = buf;
+	char * label = NULL;
+	size_t label_size = 0;
+	char * q;
+	uint64_t offset = 0;
+	uint64_t value;
+	size_t pos;
+	size_t n;
+	uint64_t i;
+
+	if(size < sizeof(header))
+	{
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	memcpy(&header, buf, sizeof(header));
+	if(header.size != size - sizeof(header))
+	{
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	if((annotations = hexeditorannotations_new()) == NULL)
+		return NULL;
+	p += sizeof(header);
+	size -= sizeof(header);
+	for(i = 0, pos = 0; i < header.count; i++)
+	{
+		/* offset (relative to the previous one), size, type, color and
+		 * label */
+		if((n = _hexeditorannotations_varint_get(&p[pos], size - pos,
+						&value)) == 0)
+			break;
+		offset += value;
+		annotation.offset = offset;
+		pos += n;
+		if((n = _hexeditorannotations_varint_get(&p[pos], size - pos,
+						&value)) == 0)
+			break;
+		annotation.size = value;
+		pos += n;
+		if(size - pos < 4 || (unsigned char)p[pos] > HEAT_LAST)
+			break;
+		annotation.type = (unsigned char)p[pos];
+		annotation.color = ((uint32_t)(unsigned char)p[pos + 1] << 16)
+			| ((uint32_t)(unsigned char)p[pos + 2] << 8)
+			| (unsigned char)p[pos + 3];
+		pos += 4;
+		if((n = _hexeditorannotations_varint_get(&p[pos], size - pos,
+						&value)) == 0
+				|| size - pos - n < value)
+			break;
+		pos += n;
+		/* as long as the labels added */
+		if(value >= label_size)
+		{
+			if((q = realloc(label, value + 1)) == NULL)
+			{
+				error_set_code(1, "%s", strerror(errno));
+				free(label);
+				hexeditorannotations_delete(annotations);
+				return NULL;
+			}
+			label = q;
+			label_size = value + 1;
+		}
+		memcpy(label, &p[pos], value);
+		label[value] = '\0';
+		annotation.label = (value > 0) ? label : NULL;
+		pos += value;
+		if(hexeditorannotations_add(annotations, &annotation) != 0)
+		{
+			free(label);
+			hexeditorannotations_delete(annotations);
+			return NULL;
+		}
+	}
+	free(label);
+	if(i != header.count || pos != size)
+	{
+		hexeditorannotations_delete(annotations);
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	return annotations;
+}
+
+
+/* hexeditorannotations_delete */
+void hexeditorannotations_delete(HexEditorAnnotations * annotations)
+{
+	free(annotations->labels);
+	free(annotations->items);
+	object_delete(annotations);
+}
+
+
+/* accessors */
+/* hexeditorannotations_get_buffer */
+int hexeditorannotations_get_buffer(HexEditorAnnotations * annotations,
+		void ** buf, size_t * size)
+{
+	HexEditorAnnotationsHeader header;
+	HexEditorAnnotationsItem * item;
+	char * p;
+	char const * label;
+	size_t len;
+	size_t pos = 0;
+	off_t offset = 0;
+	size_t i;
+
+	_hexeditorannotations_index(annotations);
+	/* at most two varints of 64 bits and a label per annotation */
+	len = sizeof(header) + annotations->items_cnt * (10 * 3 + 4)
+		+ annotations->labels_cnt;
+	if((p = malloc(len)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	for(i = 0; i < annotations->items_cnt; i++)
+	{
+		item = &annotations->items[i];
+		pos += _hexeditorannotations_varint_set(
+				&p[sizeof(header) + pos],
+				item->offset - offset);
+		offset = item->offset;
+		pos += _hexeditorannotations_varint_set(
+				&p[sizeof(header) + pos],
+				item->end - item->offset);
+		p[sizeof(header) + pos++] = item->type;
+		p[sizeof(header) + pos++] = (item->color >> 16) & 0xff;
+		p[sizeof(header) + pos++] = (item->color >> 8) & 0xff;
+		p[sizeof(header) + pos++] = item->color & 0xff;
+		/* the labels may not be allocated at all */
+		label = (item->label != 0)
+			? &annotations->labels[item->label] : NULL;
+		len = (label != NULL) ? strlen(label) : 0;
+		pos += _hexeditorannotations_varint_set(
+				&p[sizeof(header) + pos], len);
+		if(len > 0)
+			memcpy(&p[sizeof(header) + pos], label, len);
+		pos += len;
+	}
+	header.count = annotations->items_cnt;
+	header.size = pos;
+	memcpy(p, &header, sizeof(header));
+	*buf = p;
+	*size = sizeof(header) + pos;
+	return 0;
+}
+
+
+/* hexeditorannotations_get_count */
+size_t hexeditorannotations_get_count(HexEditorAnnotations * annotations)
+{
+	return annotations->items_cnt;
+}
+
+
+/* hexeditorannotations_get_next */
+int hexeditorannotations_get_next(HexEditorAnnotations * annotations,
+		HexEditorAnnotationType type, off_t offset,
+		HexEditorAnnotation * annotation)
+{
+	size_t low = 0;
+	size_t high;
+	size_t middle;
+
+	_hexeditorannotations_index(annotations);
+	/* the first annotation starting after offset */
+	for(high = annotations->items_cnt; low < high;)
+	{
+		middle = low + (high - low) / 2;
+		if(annotations->items[middle].offset <= offset)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	for(; low < annotations->items_cnt; low++)
+		if(annotations->items[low].type == type)
+		{
+			_hexeditorannotations_get(annotations,
+					&annotations->items[low], annotation);
+			return 0;
+		}
+	return -1;
+}
+
+
+/* useful */
+/* hexeditorannotations_add */
+int hexeditorannotations_add(HexEditorAnnotations * annotations,
+		HexEditorAnnotation const * annotation)
+{
+	HexEditorAnnotationsItem * item;
+	size_t len;
+	size_t alloc;
+	void * p;
+
+	if(annotation->offset < 0 || annotation->size <= 0
+			|| annotation->type > HEAT_LAST)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	if(annotations->items_cnt == annotations->items_alloc)
+	{
+		alloc = (annotations->items_alloc > 0)
+			? annotations->items_alloc * 2 : 64;
+		if((p = realloc(annotations->items, sizeof(*item) * alloc))
+				== NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+		annotations->items = p;
+		annotations->items_alloc = alloc;
+	}
+	item = &annotations->items[annotations->items_cnt];
+	item->offset = annotation->offset;
+	item->end = annotation->offset + annotation->size;
+	item->max = item->end;
+	item->color = annotation->color & 0xffffff;
+	item->type = annotation->type;
+	item->label = 0;
+	if(annotation->label != NULL && (len = strlen(annotation->label)) > 0)
+	{
+		/* the first byte is left empty for the annotations without */
+		if(annotations->labels_cnt + len + 2
+				> annotations->labels_alloc)
+		{
+			for(alloc = (annotations->labels_alloc > 0)
+					? annotations->labels_alloc : 1024;
+					annotations->labels_cnt + len + 2
+					> alloc; alloc *= 2);
+			if((p = realloc(annotations->labels, alloc)) == NULL)
+				return -error_set_code(1, "%s",
+						strerror(errno));
+			annotations->labels = p;
+			annotations->labels_alloc = alloc;
+		}
+		if(annotations->labels_cnt == 0)
+			annotations->labels[annotations->labels_cnt++] = '\0';
+		item->label = annotations->labels_cnt;
+		memcpy(&annotations->labels[item->label], annotation->label,
+				len + 1);
+		annotations->labels_cnt += len + 1;
+		annotations->labels_live += len + 1;
+	}
+	annotations->items_cnt++;
+	/* indexed again when queried */
+	annotations->indexed = 0;
+	return 0;
+}
+
+
+/* hexeditorannotations_clear */
+void hexeditorannotations_clear(HexEditorAnnotations * annotations,
+		HexEditorAnnotationType type)
+{
+	size_t i;
+	size_t j;
+
+	for(i = 0, j = 0; i < annotations->items_cnt; i++)
+		if(annotations->items[i].type != type)
+			annotations->items[j++] = annotations->items[i];
+		else
+			_hexeditorannotations_unlabel(annotations,
+					&annotations->items[i]);
+	if(j == annotations->items_cnt)
+		return;
+	annotations->items_cnt = j;
+	annotations->indexed = 0;
+	_hexeditorannotations_compact(annotations);
+}
+
+
+/* hexeditorannotations_query */
+size_t hexeditorannotations_query(HexEditorAnnotations * annotations,
+		off_t offset, off_t size, HexEditorAnnotationsCallback callback,
+		void * data)
+{
+	HexEditorAnnotationsItem const * items;
+	const off_t end = offset + size;
+	const size_t cnt = annotations->items_cnt;
+	struct
+	{
+		int level;
+		size_t index;
+		/* the left subtree was visited */
+		int left;
+	} stack[HEXEDITORANNOTATIONS_STACK], node;
+	size_t stack_cnt = 0;
+	HexEditorAnnotation annotation;
+	size_t ret = 0;
+	size_t i;
+	size_t j;
+
+	if(size <= 0 || cnt == 0)
+		return 0;
+	_hexeditorannotations_index(annotations);
+	items = annotations->items;
+	stack[stack_cnt].level = annotations->levels;
+	stack[stack_cnt].index = ((size_t)1 << annotations->levels) - 1;
+	stack[stack_cnt++].left = 0;
+	while(stack_cnt > 0)
+	{
+		node = stack[--stack_cnt];
+		if(node.level <= 3)
+		{
+			/* the small subtrees are simply walked through */
+			i = node.index >> node.level << node.level;
+			if((j = i + ((size_t)1 << (node.level + 1)) - 1) > cnt)
+				j = cnt;
+			for(; i < j && items[i].offset < end; i++)
+				if(offset < items[i].end)
+				{
+					_hexeditorannotations_get(annotations,
+							&items[i], &annotation);
+					callback(data, &annotation);
+					ret++;
+				}
+		}
+		else if(node.left == 0)
+		{
+			/* back to this node after its left subtree */
+			node.left = 1;
+			stack[stack_cnt++] = node;
+			i = node.index - ((size_t)1 << (node.level - 1));
+			/* unless nothing there reaches the range */
+			if(i >= cnt || items[i].max > offset)
+			{
+				stack[stack_cnt].level = node.level - 1;
+				stack[stack_cnt].index = i;
+				stack[stack_cnt++].left = 0;
+			}
+		}
+		else if(node.index < cnt && items[node.index].offset < end)
+		{
+			/* this node, then its right subtree */
+			if(offset < items[node.index].end)
+			{
+				_hexeditorannotations_get(annotations,
+						&items[node.index],
+						&annotation);
+				callback(data, &annotation);
+				ret++;
+			}
+			stack[stack_cnt].level = node.level - 1;
+			stack[stack_cnt].index = node.index
+				+ ((size_t)1 << (node.level - 1));
+			stack[stack_cnt++].left = 0;
+		}
+	}
+	return ret;
+}
+
+
+/* hexeditorannotations_remove */
+size_t hexeditorannotations_remove(HexEditorAnnotations * annotations,
+		off_t offset, off_t size)
+{
+	const off_t end = offset + ((size > 0) ? size : 1);
+	size_t i;
+	size_t j;
+
+	for(i = 0, j = 0; i < annotations->items_cnt; i++)
+		if(annotations->items[i].offset >= end
+				|| annotations->items[i].end <= offset)
+			annotations->items[j++] = annotations->items[i];
+		else
+			_hexeditorannotations_unlabel(annotations,
+					&annotations->items[i]);
+	if((i = annotations->items_cnt - j) == 0)
+		return 0;
+	annotations->items_cnt = j;
+	annotations->indexed = 0;
+	_hexeditorannotations_compact(annotations);
+	return i;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorannotations_compact */
+static void _hexeditorannotations_compact(HexEditorAnnotations * annotations)
+{
+	char * labels;
+	char const * label;
+	size_t len;
+	size_t cnt = 1;
+	size_t i;
+
+	if(annotations->items_cnt == 0 || annotations->labels_live == 0)
+	{
+		annotations->labels_cnt = 0;
+		annotations->labels_live = 0;
+		return;
+	}
+	/* only once the labels removed outweigh the others */
+	if(annotations->labels_cnt - 1 - annotations->labels_live
+			<= annotations->labels_live)
+		return;
+	/* kept as they are if short of memory */
+	if((labels = malloc(annotations->labels_live + 1)) == NULL)
+		return;
+	labels[0] = '\0';
+	for(i = 0; i < annotations->items_cnt; i++)
+	{
+		if(annotations->items[i].label == 0)
+			continue;
+		label = &annotations->labels[annotations->items[i].label];
+		len = strlen(label) + 1;
+		memcpy(&labels[cnt], label, len);
+		annotations->items[i].label = cnt;
+		cnt += len;
+	}
+	free(annotations->labels);
+	annotations->labels = labels;
+	annotations->labels_cnt = cnt;
+	annotations->labels_alloc = annotations->labels_live + 1;
+}
+
+
+/* hexeditorannotations_compare */
+static int _hexeditorannotations_compare(void const * a, void const * b)
+{
+	HexEditorAnnotationsItem const * ia = a;
+	HexEditorAnnotationsItem const * ib = b;
+
+	if(ia->offset != ib->offset)
+		return (ia->offset < ib->offset) ? -1 : 1;
+	if(ia->end != ib->end)
+		return (ia->end < ib->end) ? -1 : 1;
+	return 0;
+}
+
+
+/* hexeditorannotations_get */
+static void _hexeditorannotations_get(HexEditorAnnotations * annotations,
+		HexEditorAnnotationsItem const * item,
+		HexEditorAnnotation * annotation)
+{
+	annotation->offset = item->offset;
+	annotation->size = item->end - item->offset;
+	annotation->type = item->type;
+	annotation->color = item->color;
+	annotation->label = (item->label != 0)
+		? &annotations->labels[item->label] : NULL;
+}
+
+
+/* hexeditorannotations_index */
+static void _hexeditorannotations_index(HexEditorAnnotations * annotations)
+{
+	HexEditorAnnotationsItem * items = annotations->items;
+	const size_t cnt = annotations->items_cnt;
+	size_t i;
+	size_t last_i = 0;
+	off_t last = 0;
+	size_t x;
+	off_t max;
+	int level;
+
+	if(annotations->indexed)
+		return;
+	qsort(items, cnt, sizeof(*items), _hexeditorannotations_compare);
+	/* the leaves */
+	for(i = 0; i < cnt; i += 2)
+	{
+		last_i = i;
+		items[i].max = last = items[i].end;
+	}
+	/* and every level above, with the rightmost subtree incomplete */
+	for(level = 1; ((size_t)1 << level) <= cnt; level++)
+	{
+		x = (size_t)1 << (level - 1);
+		for(i = (x << 1) - 1; i < cnt; i += x << 2)
+		{
+			max = (i + x < cnt) ? items[i + x].max : last;
+			if(items[i - x].max > max)
+				max = items[i - x].max;
+			items[i].max = (items[i].end > max)
+				? items[i].end : max;
+		}
+		last_i = ((last_i >> level) & 1) ? last_i - x : last_i + x;
+		if(last_i < cnt && items[last_i].max > last)
+			last = items[last_i].max;
+	}
+	annotations->levels = level - 1;
+	annotations->indexed = 1;
+}
+
+
+/* hexeditorannotations_unlabel */
+static void _hexeditorannotations_unlabel(HexEditorAnnotations * annotations,
+		HexEditorAnnotationsItem const * item)
+{
+	if(item->label != 0)
+		annotations->labels_live -= strlen(
+				&annotations->labels[item->label]) + 1;
+}
+
+
+/* hexeditorannotations_varint_get */
+static size_t _hexeditorannotations_varint_get(char const * buf, size_t size,
+		uint64_t * value)
+{
+	size_t i;
+	unsigned char c;
+
+	*value = 0;
+	for(i = 0; i < size && i < 10; i++)
+	{
+		c = buf[i];
+		*value |= (uint64_t)(c & 0x7f) << (i * 7);
+		if((c & 0x80) == 0)
+			return i + 1;
+	}
+	return 0;
+}
+
+
+/* hexeditorannotations_varint_set */
+static size_t _hexeditorannotations_varint_set(char * buf, uint64_t value)
+{
+	size_t i;
+
+	for(i = 0; value >= 0x80; i++, value >>= 7)
+		buf[i] = (value & 0x7f) | 0x80;
+	buf[i++] = value;
+	return i;
+}
@@ -0,0 +1,84 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_ANNOTATIONS_H
+# define HEXEDITOR_ANNOTATIONS_H
+
+# include <sys/types.h>
+# include <stdint.h>
+
+
+/* HexEditorAnnotations */
+/* public */
+/* types */
+typedef struct _HexEditorAnnotations HexEditorAnnotations;
+
+/* where the annotations come from */
+typedef enum _HexEditorAnnotationType
+{
+	HEAT_USER = 0,
+	HEAT_SEARCH,
+	HEAT_TEMPLATE,
+	HEAT_PLUGIN
+} HexEditorAnnotationType;
+# define HEAT_LAST	HEAT_PLUGIN
+# define HEAT_COUNT	(HEAT_LAST + 1)
+
+typedef struct _HexEditorAnnotation
+{
+	off_t offset;
+	off_t size;
+	HexEditorAnnotationType type;
+	/* as 0xRRGGBB */
+	uint32_t color;
+	/* may be NULL */
+	char const * label;
+} HexEditorAnnotation;
+
+typedef void (*HexEditorAnnotationsCallback)(void * data,
+		HexEditorAnnotation const * annotation);
+
+
+/* functions */
+HexEditorAnnotations * hexeditorannotations_new(void);
+HexEditorAnnotations * hexeditorannotations_new_from_buffer(void const * buf,
+		size_t size);
+void hexeditorannotations_delete(HexEditorAnnotations * annotations);
+
+/* accessors */
+int hexeditorannotations_get_buffer(HexEditorAnnotations * annotations,
+		void ** buf, size_t * size);
+size_t hexeditorannotations_get_count(HexEditorAnnotations * annotations);
+/* the first annotation of this type starting after offset */
+int hexeditorannotations_get_next(HexEditorAnnotations * annotations,
+		HexEditorAnnotationType type, off_t offset,
+		HexEditorAnnotation * annotation);
+
+/* useful */
+int hexeditorannotations_add(HexEditorAnnotations * annotations,
+		HexEditorAnnotation const * annotation);
+void hexeditorannotations_clear(HexEditorAnnotations * annotations,
+		HexEditorAnnotationType type);
+/* calls back for every annotation overlapping the range */
+size_t hexeditorannotations_query(HexEditorAnnotations * annotations,
+		off_t offset, off_t size, HexEditorAnnotationsCallback callback,
+		void * data);
+/* returns how many annotations overlapping the range were removed */
+size_t hexeditorannotations_remove(HexEditorAnnotations * annotations,
+		off_t offset, off_t size);
+
+#endif /* !HEXEDITOR_ANNOTATIONS_H */
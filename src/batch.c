@@ -0,0 +1,743 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <libintl.h>
+#include <glib.h>
+#include <System.h>
+#include "HexEditor/plugin.h"
+#include "hexeditor.h"
+#include "magic.h"
+#include "batch.h"
+#define _(string) gettext(string)
+
+
+/* HexEditorBatch */
+/* private */
+/* types */
+typedef struct _HexEditorBatchPlugin
+{
+	String * name;
+	Plugin * plugin;
+	HexEditorPluginDefinition * definition;
+} HexEditorBatchPlugin;
+
+/* the files left to a worker, the others take the last ones once done */
+typedef struct _HexEditorBatchQueue
+{
+	HexEditorBatch * batch;
+	GThread * thread;
+	GMutex mutex;
+	size_t head;
+	size_t tail;
+} HexEditorBatchQueue;
+
+typedef struct _HexEditorBatchAnnotation
+{
+	HexEditorPluginAnnotation type;
+	off_t offset;
+	off_t size;
+	char * label;
+} HexEditorBatchAnnotation;
+
+typedef struct _HexEditorBatchFile HexEditorBatchFile;
+
+/* what a plug-in found in the current file */
+typedef struct _HexEditorBatchResult
+{
+	HexEditorPluginHelper helper;
+	HexEditorBatchFile * file;
+	HexEditorPlugin * plugin;
+	GArray * annotations;
+	char * error;
+} HexEditorBatchResult;
+
+struct _HexEditorBatchFile
+{
+	char const * filename;
+	int fd;
+	off_t size;
+	HexEditorMagic * magic;
+	HexEditorBatchResult * results;
+	char * error;
+};
+
+struct _HexEditorBatch
+{
+	HexEditorBatchFormat format;
+	FILE * fp;
+
+	HexEditorBatchPlugin * plugins;
+	size_t plugins_cnt;
+	char ** files;
+	size_t files_cnt;
+
+	/* the workers, one file at a time each */
+	HexEditorBatchQueue * queues;
+	unsigned int queues_cnt;
+
+	/* the records written */
+	GMutex mutex;
+	int failed;
+};
+
+
+/* prototypes */
+static void _hexeditorbatch_analyse(HexEditorBatch * batch,
+		char const * filename, char * buf,
+		HexEditorBatchResult * results);
+static int _hexeditorbatch_next(HexEditorBatchQueue * queue, size_t * index);
+static void _hexeditorbatch_record(HexEditorBatch * batch,
+		HexEditorBatchFile * file);
+
+/* helper */
+static int _hexeditorbatch_helper_annotate(HexEditor * hexeditor,
+		HexEditorPluginAnnotation type, off_t offset, off_t size,
+		char const * label);
+static void _hexeditorbatch_helper_annotate_clear(HexEditor * hexeditor,
+		HexEditorPluginAnnotation type);
+static int _hexeditorbatch_helper_error(HexEditor * hexeditor,
+		char const * message, int ret);
+static off_t _hexeditorbatch_helper_get_size(HexEditor * hexeditor);
+static ssize_t _hexeditorbatch_helper_read(HexEditor * hexeditor,
+		off_t offset, void * buffer, size_t size);
+
+/* callbacks */
+static gpointer _hexeditorbatch_on_worker(gpointer data);
+
+
+/* public */
+/* functions */
+/* hexeditorbatch_new */
+HexEditorBatch * hexeditorbatch_new(HexEditorBatchFormat format, FILE * fp)
+{
+	HexEditorBatch * batch;
+
+	if(format > HEBF_LAST || fp == NULL)
+	{
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	if((batch = object_new(sizeof(*batch))) == NULL)
+		return NULL;
+	batch->format = format;
+	batch->fp = fp;
+	batch->plugins = NULL;
+	batch->plugins_cnt = 0;
+	batch->files = NULL;
+	batch->files_cnt = 0;
+	batch->queues = NULL;
+	batch->queues_cnt = 0;
+	g_mutex_init(&batch->mutex);
+	batch->failed = 0;
+	return batch;
+}
+
+
+/* hexeditorbatch_delete */
+void hexeditorbatch_delete(HexEditorBatch * batch)
+{
+	size_t i;
+
+	for(i = 0; i < batch->plugins_cnt; i++)
+	{
+		plugin_delete(batch->plugins[i].plugin);
+		string_delete(batch->plugins[i].name);
+	}
+	free(batch->plugins);
+	for(i = 0; i < batch->files_cnt; i++)
+		free(batch->files[i]);
+	free(batch->files);
+	g_mutex_clear(&batch->mutex);
+	object_delete(batch);
+}
+
+
+/* useful */
+/* hexeditorbatch_add */
+int hexeditorbatch_add(HexEditorBatch * batch, char const * filename)
+{
+	char ** p;
+
+	if((p = realloc(batch->files, sizeof(*p) * (batch->files_cnt + 1)))
+			== NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	batch->files = p;
+	if((p[batch->files_cnt] = strdup(filename)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	batch->files_cnt++;
+	return 0;
+}
+
+
+/* hexeditorbatch_load */
+int hexeditorbatch_load(HexEditorBatch * batch, char const * plugin)
+{
+	HexEditorBatchPlugin * p;
+	size_t i;
+
+	for(i = 0; i < batch->plugins_cnt; i++)
+		if(strcmp(batch->plugins[i].name, plugin) == 0)
+			return 0;
+	if((p = realloc(batch->plugins, sizeof(*p) * (batch->plugins_cnt
+						+ 1))) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	batch->plugins = p;
+	p = &batch->plugins[batch->plugins_cnt];
+	/* as by hexeditor_load(), except that the widgets are not needed */
+	if((p->plugin = hexeditor_plugin_load(plugin, &p->definition))
+			== NULL)
+		return -1;
+	if((p->name = string_new(plugin)) == NULL)
+	{
+		plugin_delete(p->plugin);
+		return -1;
+	}
+	batch->plugins_cnt++;
+	return 0;
+}
+
+
+/* hexeditorbatch_run */
+int hexeditorbatch_run(HexEditorBatch * batch, unsigned int jobs)
+{
+	GError * error = NULL;
+	unsigned int i;
+	size_t j;
+
+	if(batch->queues != NULL)
+		return -error_set_code(1, "%s", strerror(EBUSY));
+	if(batch->files_cnt == 0)
+		return 0;
+	/* the files are expected to be read as much as analysed */
+	if(jobs == 0)
+		jobs = g_get_num_processors();
+	if(jobs > batch->files_cnt)
+		jobs = batch->files_cnt;
+	if((batch->queues = malloc(sizeof(*batch->queues) * jobs)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	batch->queues_cnt = jobs;
+	batch->failed = 0;
+	if(batch->format == HEBF_CSV)
+	{
+		fputs("file,size,format,error", batch->fp);
+		for(j = 0; j < batch->plugins_cnt; j++)
+			fprintf(batch->fp, ",%s", batch->plugins[j].name);
+		fputc('\n', batch->fp);
+	}
+	/* neighbouring files are kept together as long as possible */
+	for(i = 0; i < jobs; i++)
+	{
+		batch->queues[i].batch = batch;
+		batch->queues[i].thread = NULL;
+		g_mutex_init(&batch->queues[i].mutex);
+		batch->queues[i].head = batch->files_cnt * i / jobs;
+		batch->queues[i].tail = batch->files_cnt * (i + 1) / jobs;
+	}
+	/* the files of a worker missing are taken by the others */
+	for(i = 0; i < jobs; i++)
+		if((batch->queues[i].thread = g_thread_try_new(NULL,
+						_hexeditorbatch_on_worker,
+						&batch->queues[i], &error))
+				== NULL)
+			break;
+	if(i == 0)
+		error_set_code(1, "%s", error->message);
+	if(error != NULL)
+		g_error_free(error);
+	for(jobs = i, i = 0; i < jobs; i++)
+		g_thread_join(batch->queues[i].thread);
+	for(i = 0; i < batch->queues_cnt; i++)
+		g_mutex_clear(&batch->queues[i].mutex);
+	free(batch->queues);
+	batch->queues = NULL;
+	batch->queues_cnt = 0;
+	fflush(batch->fp);
+	return (jobs == 0) ? -1 : batch->failed;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorbatch_analyse */
+static void _analyse_init(HexEditorBatch * batch, HexEditorBatchFile * file);
+static void _analyse_destroy(HexEditorBatch * batch,
+		HexEditorBatchFile * file);
+
+static void _hexeditorbatch_analyse(HexEditorBatch * batch,
+		char const * filename, char * buf,
+		HexEditorBatchResult * results)
+{
+	HexEditorBatchFile file;
+	HexEditorBatchPlugin * p;
+	HexEditorBatchResult * r;
+	struct stat st;
+	ssize_t res = 0;
+	size_t i;
+
+	file.filename = filename;
+	file.fd = -1;
+	file.size = 0;
+	file.magic = NULL;
+	file.results = results;
+	file.error = NULL;
+	if(buf == NULL || results == NULL)
+		res = -ENOMEM;
+	else if((file.fd = open(filename, O_RDONLY)) < 0
+			|| fstat(file.fd, &st) != 0)
+		res = -errno;
+	else if(S_ISDIR(st.st_mode))
+		res = -EISDIR;
+	if(res < 0)
+	{
+		/* the plug-ins do not run */
+		file.results = NULL;
+		file.error = strdup(strerror(-res));
+		_hexeditorbatch_record(batch, &file);
+		free(file.error);
+		if(file.fd >= 0)
+			close(file.fd);
+		return;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	_analyse_init(batch, &file);
+	/* large reads, to keep the disks busy */
+	while((res = read(file.fd, buf, HEXEDITORBATCH_READ_SIZE)) != 0)
+	{
+		if(res < 0 && errno == EINTR)
+			continue;
+		if(res < 0)
+		{
+			file.error = strdup(strerror(errno));
+			break;
+		}
+		/* what the file is, before the plug-ins look at it */
+		if(file.size == 0)
+			file.magic = hexeditormagic_detect(buf, res);
+		for(i = 0; file.size == 0 && file.magic != NULL
+				&& i < batch->plugins_cnt; i++)
+		{
+			p = &batch->plugins[i];
+			r = &results[i];
+			if(r->plugin != NULL && p->definition->format != NULL)
+				p->definition->format(r->plugin,
+						file.magic->name);
+		}
+		for(i = 0; i < batch->plugins_cnt; i++)
+			if(results[i].plugin != NULL
+					&& batch->plugins[i].definition->read
+					!= NULL)
+				batch->plugins[i].definition->read(
+						results[i].plugin, file.size,
+						buf, res);
+		file.size += res;
+	}
+	for(i = 0; i < batch->plugins_cnt; i++)
+		if(results[i].plugin != NULL
+				&& batch->plugins[i].definition->read != NULL)
+			batch->plugins[i].definition->read(results[i].plugin,
+					file.size, NULL, 0);
+	_hexeditorbatch_record(batch, &file);
+	_analyse_destroy(batch, &file);
+	free(file.error);
+#ifdef POSIX_FADV_DONTNEED
+	/* the next files are more likely to be cached */
+	posix_fadvise(file.fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+	close(file.fd);
+}
+
+static void _analyse_init(HexEditorBatch * batch, HexEditorBatchFile * file)
+{
+	HexEditorBatchResult * r;
+	size_t i;
+
+	for(i = 0; i < batch->plugins_cnt; i++)
+	{
+		r = &file->results[i];
+		/* the plug-ins only hand it back */
+		r->helper.hexeditor = (HexEditor *)r;
+		r->helper.error = _hexeditorbatch_helper_error;
+		r->helper.read = _hexeditorbatch_helper_read;
+		r->helper.get_size = _hexeditorbatch_helper_get_size;
+		r->helper.annotate = _hexeditorbatch_helper_annotate;
+		r->helper.annotate_clear
+			= _hexeditorbatch_helper_annotate_clear;
+		r->file = file;
+		r->annotations = g_array_new(FALSE, FALSE,
+				sizeof(HexEditorBatchAnnotation));
+		r->error = NULL;
+		/* the error of the process may be that of another worker */
+		if((r->plugin = batch->plugins[i].definition->init(&r->helper))
+				== NULL)
+			_hexeditorbatch_helper_error(r->helper.hexeditor,
+					_("Could not initialize the plug-in"),
+					1);
+	}
+}
+
+static void _analyse_destroy(HexEditorBatch * batch,
+		HexEditorBatchFile * file)
+{
+	HexEditorBatchResult * r;
+	size_t i;
+
+	for(i = 0; i < batch->plugins_cnt; i++)
+	{
+		r = &file->results[i];
+		if(r->plugin != NULL)
+			batch->plugins[i].definition->destroy(r->plugin);
+		_hexeditorbatch_helper_annotate_clear(r->helper.hexeditor,
+				HEPA_FINDING);
+		_hexeditorbatch_helper_annotate_clear(r->helper.hexeditor,
+				HEPA_FIELD);
+		g_array_free(r->annotations, TRUE);
+		free(r->error);
+	}
+}
+
+
+/* hexeditorbatch_next */
+static int _hexeditorbatch_next(HexEditorBatchQueue * queue, size_t * index)
+{
+	HexEditorBatch * batch = queue->batch;
+	HexEditorBatchQueue * victim;
+	unsigned int i;
+	size_t cnt;
+
+	g_mutex_lock(&queue->mutex);
+	if(queue->head < queue->tail)
+	{
+		*index = queue->head++;
+		g_mutex_unlock(&queue->mutex);
+		return 0;
+	}
+	g_mutex_unlock(&queue->mutex);
+	/* steal half of the files left to the next worker with any */
+	for(i = 1; i < batch->queues_cnt; i++)
+	{
+		victim = &batch->queues[(queue - batch->queues + i)
+			% batch->queues_cnt];
+		g_mutex_lock(&victim->mutex);
+		if((cnt = victim->tail - victim->head) == 0)
+		{
+			g_mutex_unlock(&victim->mutex);
+			continue;
+		}
+		cnt = (cnt + 1) / 2;
+		victim->tail -= cnt;
+		*index = victim->tail;
+		g_mutex_unlock(&victim->mutex);
+		g_mutex_lock(&queue->mutex);
+		queue->head = *index + 1;
+		queue->tail = *index + cnt;
+		g_mutex_unlock(&queue->mutex);
+		return 0;
+	}
+	return -1;
+}
+
+
+/* hexeditorbatch_record */
+static void _record_csv(HexEditorBatch * batch, HexEditorBatchFile * file,
+		GString * record);
+static void _record_csv_string(GString * record, char const * string);
+static void _record_json(HexEditorBatch * batch, HexEditorBatchFile * file,
+		GString * record);
+static void _record_json_string(GString * record, char const * string);
+
+static void _hexeditorbatch_record(HexEditorBatch * batch,
+		HexEditorBatchFile * file)
+{
+	GString * record;
+	int failed = (file->error != NULL) ? 1 : 0;
+	size_t i;
+
+	/* the plug-ins may have failed alone */
+	for(i = 0; file->results != NULL && i < batch->plugins_cnt; i++)
+		if(file->results[i].error != NULL)
+			failed = 1;
+	record = g_string_sized_new(256);
+	if(batch->format == HEBF_CSV)
+		_record_csv(batch, file, record);
+	else
+		_record_json(batch, file, record);
+	g_string_append_c(record, '\n');
+	/* the records are written whole */
+	g_mutex_lock(&batch->mutex);
+	fwrite(record->str, sizeof(*record->str), record->len, batch->fp);
+	batch->failed += failed;
+	g_mutex_unlock(&batch->mutex);
+	g_string_free(record, TRUE);
+}
+
+static void _record_csv(HexEditorBatch * batch, HexEditorBatchFile * file,
+		GString * record)
+{
+	HexEditorBatchResult * r;
+	HexEditorBatchAnnotation * a;
+	GString * cell;
+	size_t i;
+	guint j;
+
+	_record_csv_string(record, file->filename);
+	g_string_append_printf(record, ",%lld,", (long long)file->size);
+	if(file->magic != NULL)
+		_record_csv_string(record, file->magic->name);
+	g_string_append_c(record, ',');
+	if(file->error != NULL)
+		_record_csv_string(record, file->error);
+	if(file->results == NULL)
+	{
+		/* the plug-ins did not run */
+		for(i = 0; i < batch->plugins_cnt; i++)
+			g_string_append_c(record, ',');
+		return;
+	}
+	/* the annotations, as "label@offset+size" separated by spaces */
+	cell = g_string_new(NULL);
+	for(i = 0; i < batch->plugins_cnt; i++)
+	{
+		r = &file->results[i];
+		g_string_truncate(cell, 0);
+		for(j = 0; j < r->annotations->len; j++)
+		{
+			a = &g_array_index(r->annotations,
+					HexEditorBatchAnnotation, j);
+			g_string_append_printf(cell, "%s%s@%lld+%lld",
+					(j > 0) ? " " : "",
+					(a->label != NULL) ? a->label : "",
+					(long long)a->offset,
+					(long long)a->size);
+		}
+		if(r->error != NULL)
+			g_string_append_printf(cell, "%serror: %s",
+					(cell->len > 0) ? " " : "", r->error);
+		g_string_append_c(record, ',');
+		_record_csv_string(record, cell->str);
+	}
+	g_string_free(cell, TRUE);
+}
+
+static void _record_csv_string(GString * record, char const * string)
+{
+	/* as in RFC 4180 */
+	g_string_append_c(record, '"');
+	for(; *string != '\0'; string++)
+	{
+		if(*string == '"')
+			g_string_append_c(record, '"');
+		g_string_append_c(record, *string);
+	}
+	g_string_append_c(record, '"');
+}
+
+static void _record_json(HexEditorBatch * batch, HexEditorBatchFile * file,
+		GString * record)
+{
+	HexEditorBatchResult * r;
+	HexEditorBatchAnnotation * a;
+	size_t i;
+	guint j;
+
+	g_string_append(record, "{\"file\":");
+	_record_json_string(record, file->filename);
+	g_string_append_printf(record, ",\"size\":%lld,\"format\":",
+			(long long)file->size);
+	if(file->magic != NULL)
+		_record_json_string(record, file->magic->name);
+	else
+		g_string_append(record, "null");
+	if(file->error != NULL)
+	{
+		g_string_append(record, ",\"error\":");
+		_record_json_string(record, file->error);
+	}
+	if(file->results == NULL)
+	{
+		/* the plug-ins did not run */
+		g_string_append_c(record, '}');
+		return;
+	}
+	g_string_append(record, ",\"plugins\":{");
+	for(i = 0; i < batch->plugins_cnt; i++)
+	{
+		r = &file->results[i];
+		if(i > 0)
+			g_string_append_c(record, ',');
+		_record_json_string(record, batch->plugins[i].name);
+		g_string_append(record, ":{\"annotations\":[");
+		for(j = 0; j < r->annotations->len; j++)
+		{
+			a = &g_array_index(r->annotations,
+					HexEditorBatchAnnotation, j);
+			g_string_append_printf(record, "%s{\"type\":\"%s\","
+					"\"offset\":%lld,\"size\":%lld,"
+					"\"label\":", (j > 0) ? "," : "",
+					(a->type == HEPA_FIELD) ? "field"
+					: "finding", (long long)a->offset,
+					(long long)a->size);
+			if(a->label != NULL)
+				_record_json_string(record, a->label);
+			else
+				g_string_append(record, "null");
+			g_string_append_c(record, '}');
+		}
+		g_string_append_c(record, ']');
+		if(r->error != NULL)
+		{
+			g_string_append(record, ",\"error\":");
+			_record_json_string(record, r->error);
+		}
+		g_string_append_c(record, '}');
+	}
+	g_string_append(record, "}}");
+}
+
+static void _record_json_string(GString * record, char const * string)
+{
+	unsigned char c;
+
+	g_string_append_c(record, '"');
+	for(; (c = *string) != '\0'; string++)
+		if(c == '"' || c == '\\')
+			g_string_append_printf(record, "\\%c", c);
+		else if(c < 0x20 || c == 0x7f)
+			g_string_append_printf(record, "\\u%04x", c);
+		else
+			g_string_append_c(record, c);
+	g_string_append_c(record, '"');
+}
+
+
+/* helper */
+/* hexeditorbatch_helper_annotate */
+static int _hexeditorbatch_helper_annotate(HexEditor * hexeditor,
+		HexEditorPluginAnnotation type, off_t offset, off_t size,
+		char const * label)
+{
+	HexEditorBatchResult * result = (HexEditorBatchResult *)hexeditor;
+	HexEditorBatchAnnotation a;
+
+	if(offset < 0 || size <= 0)
+		return -_hexeditorbatch_helper_error(hexeditor,
+				strerror(EINVAL), 1);
+	a.type = type;
+	a.offset = offset;
+	a.size = size;
+	if(label == NULL)
+		a.label = NULL;
+	else if((a.label = strdup(label)) == NULL)
+		return -_hexeditorbatch_helper_error(hexeditor,
+				strerror(errno), 1);
+	g_array_append_val(result->annotations, a);
+	return 0;
+}
+
+
+/* hexeditorbatch_helper_annotate_clear */
+static void _hexeditorbatch_helper_annotate_clear(HexEditor * hexeditor,
+		HexEditorPluginAnnotation type)
+{
+	HexEditorBatchResult * result = (HexEditorBatchResult *)hexeditor;
+	HexEditorBatchAnnotation * a;
+	guint i;
+	guint j;
+
+	for(i = 0, j = 0; i < result->annotations->len; i++)
+	{
+		a = &g_array_index(result->annotations,
+				HexEditorBatchAnnotation, i);
+		if(a->type == type)
+			free(a->label);
+		else
+			g_array_index(result->annotations,
+					HexEditorBatchAnnotation, j++) = *a;
+	}
+	g_array_set_size(result->annotations, j);
+}
+
+
+/* hexeditorbatch_helper_error */
+static int _hexeditorbatch_helper_error(HexEditor * hexeditor,
+		char const * message, int ret)
+{
+	HexEditorBatchResult * result = (HexEditorBatchResult *)hexeditor;
+
+	/* only the first error is reported */
+	if(result->error == NULL && message != NULL)
+		result->error = strdup(message);
+	return ret;
+}
+
+
+/* hexeditorbatch_helper_get_size */
+static off_t _hexeditorbatch_helper_get_size(HexEditor * hexeditor)
+{
+	HexEditorBatchResult * result = (HexEditorBatchResult *)hexeditor;
+	struct stat st;
+
+	/* the whole file, even while still being read */
+	if(fstat(result->file->fd, &st) != 0)
+		return -_hexeditorbatch_helper_error(hexeditor,
+				strerror(errno), 1);
+	return st.st_size;
+}
+
+
+/* hexeditorbatch_helper_read */
+static ssize_t _hexeditorbatch_helper_read(HexEditor * hexeditor,
+		off_t offset, void * buffer, size_t size)
+{
+	HexEditorBatchResult * result = (HexEditorBatchResult *)hexeditor;
+	ssize_t res;
+
+	if((res = pread(result->file->fd, buffer, size, offset)) < 0)
+		_hexeditorbatch_helper_error(hexeditor, strerror(errno), -1);
+	return res;
+}
+
+
+/* callbacks */
+/* hexeditorbatch_on_worker */
+static gpointer _hexeditorbatch_on_worker(gpointer data)
+{
+	HexEditorBatchQueue * queue = data;
+	HexEditorBatch * batch = queue->batch;
+	char * buf;
+	HexEditorBatchResult * results;
+	size_t i;
+
+	/* the files are still reported when out of memory */
+	buf = malloc(HEXEDITORBATCH_READ_SIZE);
+	results = malloc(sizeof(*results) * (batch->plugins_cnt + 1));
+	while(_hexeditorbatch_next(queue, &i) == 0)
+		_hexeditorbatch_analyse(batch, batch->files[i], buf, results);
+	free(results);
+	free(buf);
+	return NULL;
+}
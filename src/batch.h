@@ -0,0 +1,56 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_BATCH_H
+# define HEXEDITOR_BATCH_H
+
+# include <stdio.h>
+
+
+/* HexEditorBatch */
+/* public */
+/* types */
+typedef struct _HexEditorBatch HexEditorBatch;
+
+typedef enum _HexEditorBatchFormat
+{
+	HEBF_JSON = 0,
+	HEBF_CSV
+} HexEditorBatchFormat;
+# define HEBF_LAST	HEBF_CSV
+# define HEBF_COUNT	(HEBF_LAST + 1)
+
+
+/* constants */
+# define HEXEDITORBATCH_READ_SIZE	(1024 * 1024)
+
+
+/* functions */
+/* one record per file is written to fp, in the order they are done */
+HexEditorBatch * hexeditorbatch_new(HexEditorBatchFormat format, FILE * fp);
+void hexeditorbatch_delete(HexEditorBatch * batch);
+
+/* useful */
+int hexeditorbatch_add(HexEditorBatch * batch, char const * filename);
+int hexeditorbatch_load(HexEditorBatch * batch, char const * plugin);
+
+/* with as many workers as processors if jobs is 0; returns the number of
+ * files that could not be analysed, even by a single plug-in, or -1 on
+ * errors */
+int hexeditorbatch_run(HexEditorBatch * batch, unsigned int jobs);
+
+#endif /* !HEXEDITOR_BATCH_H */
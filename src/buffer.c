@@ -0,0 +1,483 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <System.h>
+#include "buffer.h"
+
+#ifndef POSIX_FADV_NORMAL
+# define POSIX_FADV_WILLNEED	0
+# define POSIX_FADV_DONTNEED	0
+#endif
+
+
+/* HexEditorBuffer */
+/* private */
+/* types */
+typedef struct _HexEditorBufferPage HexEditorBufferPage;
+
+struct _HexEditorBufferPage
+{
+	off_t index;
+	size_t size;
+	char * data;
+
+	/* least recently used first */
+	HexEditorBufferPage * prev;
+	HexEditorBufferPage * next;
+	/* hash chain */
+	HexEditorBufferPage * hnext;
+};
+
+struct _HexEditorBuffer
+{
+	int fd;
+	HexEditorBufferReader reader;
+	void * reader_data;
+	off_t size;
+	unsigned int generation;
+
+	/* pages */
+	HexEditorBufferPage * pages;
+	size_t pages_cnt;
+	char * data;
+	HexEditorBufferPage * lru_head;
+	HexEditorBufferPage * lru_tail;
+	HexEditorBufferPage ** buckets;
+	size_t buckets_cnt;
+
+	/* readahead */
+	off_t ra_last;
+	int ra_direction;
+	unsigned int ra_streak;
+};
+
+
+/* prototypes */
+static HexEditorBufferPage * _hexeditorbuffer_get_page(
+		HexEditorBuffer * buffer, off_t index);
+static HexEditorBufferPage * _hexeditorbuffer_lookup(HexEditorBuffer * buffer,
+		off_t index);
+static HexEditorBufferPage * _hexeditorbuffer_recycle(HexEditorBuffer * buffer,
+		off_t index);
+static void _hexeditorbuffer_touch(HexEditorBuffer * buffer,
+		HexEditorBufferPage * page);
+static void _hexeditorbuffer_unlink(HexEditorBuffer * buffer,
+		HexEditorBufferPage * page);
+static void _hexeditorbuffer_discard(HexEditorBuffer * buffer, off_t index);
+static void _hexeditorbuffer_readahead(HexEditorBuffer * buffer, off_t index);
+
+
+/* public */
+/* functions */
+/* hexeditorbuffer_new */
+HexEditorBuffer * hexeditorbuffer_new(int fd, off_t size, size_t pages)
+{
+	HexEditorBuffer * buffer;
+	size_t i;
+
+	if(pages == 0)
+		pages = HEXEDITORBUFFER_PAGES;
+	if((buffer = object_new(sizeof(*buffer))) == NULL)
+		return NULL;
+	buffer->fd = fd;
+	buffer->reader = NULL;
+	buffer->reader_data = NULL;
+	buffer->size = size;
+	buffer->pages_cnt = pages;
+	for(buffer->buckets_cnt = 1; buffer->buckets_cnt < pages * 2;
+			buffer->buckets_cnt <<= 1);
+	buffer->pages = malloc(sizeof(*buffer->pages) * pages);
+	buffer->data = malloc(HEXEDITORBUFFER_PAGE_SIZE * pages);
+	buffer->buckets = calloc(buffer->buckets_cnt,
+			sizeof(*buffer->buckets));
+	if(buffer->pages == NULL || buffer->data == NULL
+			|| buffer->buckets == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		hexeditorbuffer_delete(buffer);
+		return NULL;
+	}
+	/* every page starts unused, at the tail of the LRU list */
+	for(i = 0; i < pages; i++)
+	{
+		buffer->pages[i].index = -1;
+		buffer->pages[i].size = 0;
+		buffer->pages[i].data = &buffer->data[
+			HEXEDITORBUFFER_PAGE_SIZE * i];
+		buffer->pages[i].prev = (i > 0) ? &buffer->pages[i - 1] : NULL;
+		buffer->pages[i].next = (i + 1 < pages)
+			? &buffer->pages[i + 1] : NULL;
+		buffer->pages[i].hnext = NULL;
+	}
+	buffer->lru_head = &buffer->pages[0];
+	buffer->lru_tail = &buffer->pages[pages - 1];
+	buffer->ra_last = -1;
+	buffer->ra_direction = 0;
+	buffer->ra_streak = 0;
+	buffer->generation = 0;
+	return buffer;
+}
+
+
+/* hexeditorbuffer_new_reader */
+HexEditorBuffer * hexeditorbuffer_new_reader(HexEditorBufferReader reader,
+		void * data, off_t size, size_t pages)
+{
+	HexEditorBuffer * buffer;
+
+	if((buffer = hexeditorbuffer_new(-1, size, pages)) == NULL)
+		return NULL;
+	buffer->reader = reader;
+	buffer->reader_data = data;
+	return buffer;
+}
+
+
+/* hexeditorbuffer_delete */
+void hexeditorbuffer_delete(HexEditorBuffer * buffer)
+{
+	free(buffer->buckets);
+	free(buffer->data);
+	free(buffer->pages);
+	object_delete(buffer);
+}
+
+
+/* accessors */
+/* hexeditorbuffer_get_generation */
+unsigned int hexeditorbuffer_get_generation(HexEditorBuffer * buffer)
+{
+	return buffer->generation;
+}
+
+
+/* hexeditorbuffer_get_size */
+off_t hexeditorbuffer_get_size(HexEditorBuffer * buffer)
+{
+	return buffer->size;
+}
+
+
+/* hexeditorbuffer_set_size */
+void hexeditorbuffer_set_size(HexEditorBuffer * buffer, off_t size)
+{
+	/* forget the pages past the former or the new end of the file */
+	_hexeditorbuffer_discard(buffer, ((size < buffer->size) ? size
+				: buffer->size) / HEXEDITORBUFFER_PAGE_SIZE);
+	buffer->size = size;
+}
+
+
+/* useful */
+/* hexeditorbuffer_flush */
+void hexeditorbuffer_flush(HexEditorBuffer * buffer)
+{
+	_hexeditorbuffer_discard(buffer, 0);
+}
+
+
+/* hexeditorbuffer_fill */
+int hexeditorbuffer_fill(HexEditorBuffer * buffer, off_t offset,
+		char const * buf, size_t size)
+{
+	off_t index = offset / HEXEDITORBUFFER_PAGE_SIZE;
+	HexEditorBufferPage * page;
+
+	if(offset < 0 || (offset % HEXEDITORBUFFER_PAGE_SIZE) != 0
+			|| size > HEXEDITORBUFFER_PAGE_SIZE)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	if((page = _hexeditorbuffer_lookup(buffer, index)) == NULL)
+		page = _hexeditorbuffer_recycle(buffer, index);
+	memcpy(page->data, buf, size);
+	page->size = size;
+	_hexeditorbuffer_touch(buffer, page);
+	return 0;
+}
+
+
+/* hexeditorbuffer_is_cached */
+int hexeditorbuffer_is_cached(HexEditorBuffer * buffer, off_t offset)
+{
+	return (_hexeditorbuffer_lookup(buffer,
+				offset / HEXEDITORBUFFER_PAGE_SIZE) != NULL)
+		? 1 : 0;
+}
+
+
+/* hexeditorbuffer_read */
+ssize_t hexeditorbuffer_read(HexEditorBuffer * buffer, off_t offset,
+		void * buf, size_t size)
+{
+	char * p = buf;
+	size_t ret = 0;
+	HexEditorBufferPage * page;
+	size_t pos;
+	size_t cnt;
+
+	if(offset < 0)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	while(ret < size && offset < buffer->size)
+	{
+		if((page = _hexeditorbuffer_get_page(buffer,
+						offset / HEXEDITORBUFFER_PAGE_SIZE))
+				== NULL)
+			return (ret > 0) ? (ssize_t)ret : -1;
+		pos = offset % HEXEDITORBUFFER_PAGE_SIZE;
+		if(pos >= page->size)
+			/* the file was truncated */
+			break;
+		cnt = page->size - pos;
+		if(cnt > size - ret)
+			cnt = size - ret;
+		memcpy(&p[ret], &page->data[pos], cnt);
+		ret += cnt;
+		offset += cnt;
+	}
+	return ret;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorbuffer_discard */
+static void _hexeditorbuffer_discard(HexEditorBuffer * buffer, off_t index)
+{
+	size_t i;
+	HexEditorBufferPage * page;
+
+	/* what is still being read may be outdated already */
+	buffer->generation++;
+	for(i = 0; i < buffer->pages_cnt; i++)
+	{
+		page = &buffer->pages[i];
+		if(page->index < index)
+			continue;
+		_hexeditorbuffer_unlink(buffer, page);
+		/* recycle them first */
+		if(page == buffer->lru_tail)
+			continue;
+		if(page->prev != NULL)
+			page->prev->next = page->next;
+		else
+			buffer->lru_head = page->next;
+		page->next->prev = page->prev;
+		page->prev = buffer->lru_tail;
+		page->next = NULL;
+		buffer->lru_tail->next = page;
+		buffer->lru_tail = page;
+	}
+}
+
+
+/* hexeditorbuffer_get_page */
+static ssize_t _get_page_read(HexEditorBuffer * buffer,
+		HexEditorBufferPage * page);
+
+static HexEditorBufferPage * _hexeditorbuffer_get_page(
+		HexEditorBuffer * buffer, off_t index)
+{
+	HexEditorBufferPage * page;
+
+	_hexeditorbuffer_readahead(buffer, index);
+	if((page = _hexeditorbuffer_lookup(buffer, index)) == NULL)
+	{
+		page = _hexeditorbuffer_recycle(buffer, index);
+		if(_get_page_read(buffer, page) < 0)
+		{
+			_hexeditorbuffer_unlink(buffer, page);
+			return NULL;
+		}
+	}
+	_hexeditorbuffer_touch(buffer, page);
+	return page;
+}
+
+static ssize_t _get_page_read(HexEditorBuffer * buffer,
+		HexEditorBufferPage * page)
+{
+	off_t offset = page->index * HEXEDITORBUFFER_PAGE_SIZE;
+	ssize_t res;
+
+	for(page->size = 0; page->size < HEXEDITORBUFFER_PAGE_SIZE;
+			page->size += res)
+	{
+		res = (buffer->reader != NULL)
+			? buffer->reader(buffer->reader_data,
+					&page->data[page->size],
+					HEXEDITORBUFFER_PAGE_SIZE - page->size,
+					offset + page->size)
+			: pread(buffer->fd, &page->data[page->size],
+					HEXEDITORBUFFER_PAGE_SIZE - page->size,
+					offset + page->size);
+		/* the reader sets the error itself */
+		if(res < 0 && buffer->reader != NULL)
+			return -1;
+		else if(res < 0 && errno == EINTR)
+			res = 0;
+		else if(res < 0)
+			return -error_set_code(1, "%s", strerror(errno));
+		else if(res == 0)
+			break;
+	}
+	return page->size;
+}
+
+
+/* hexeditorbuffer_lookup */
+static HexEditorBufferPage * _hexeditorbuffer_lookup(HexEditorBuffer * buffer,
+		off_t index)
+{
+	HexEditorBufferPage * page;
+
+	for(page = buffer->buckets[index & (buffer->buckets_cnt - 1)];
+			page != NULL; page = page->hnext)
+		if(page->index == index)
+			return page;
+	return NULL;
+}
+
+
+/* hexeditorbuffer_recycle */
+static HexEditorBufferPage * _hexeditorbuffer_recycle(HexEditorBuffer * buffer,
+		off_t index)
+{
+	size_t bucket = index & (buffer->buckets_cnt - 1);
+	HexEditorBufferPage * page;
+
+	/* recycle the least recently used page */
+	page = buffer->lru_tail;
+	_hexeditorbuffer_unlink(buffer, page);
+	page->index = index;
+	page->size = 0;
+	page->hnext = buffer->buckets[bucket];
+	buffer->buckets[bucket] = page;
+	return page;
+}
+
+
+/* hexeditorbuffer_touch */
+static void _hexeditorbuffer_touch(HexEditorBuffer * buffer,
+		HexEditorBufferPage * page)
+{
+	if(page == buffer->lru_head)
+		return;
+	/* move the page to the head of the LRU list */
+	page->prev->next = page->next;
+	if(page->next != NULL)
+		page->next->prev = page->prev;
+	else
+		buffer->lru_tail = page->prev;
+	page->prev = NULL;
+	page->next = buffer->lru_head;
+	buffer->lru_head->prev = page;
+	buffer->lru_head = page;
+}
+
+
+/* hexeditorbuffer_unlink */
+static void _hexeditorbuffer_unlink(HexEditorBuffer * buffer,
+		HexEditorBufferPage * page)
+{
+	HexEditorBufferPage ** p;
+
+	if(page->index < 0)
+		return;
+	for(p = &buffer->buckets[page->index & (buffer->buckets_cnt - 1)];
+			*p != NULL; p = &(*p)->hnext)
+		if(*p == page)
+		{
+			*p = page->hnext;
+			break;
+		}
+	page->index = -1;
+	page->hnext = NULL;
+}
+
+
+/* hexeditorbuffer_readahead */
+static void _readahead_advise(HexEditorBuffer * buffer, off_t first,
+		off_t last, int advice);
+
+static void _hexeditorbuffer_readahead(HexEditorBuffer * buffer, off_t index)
+{
+	int direction;
+	off_t distance;
+	off_t window;
+
+	if(index == buffer->ra_last)
+		return;
+	/* detect sequential accesses, and in which direction */
+	direction = (index > buffer->ra_last) ? 1 : -1;
+	distance = (index - buffer->ra_last) * direction;
+	if(buffer->ra_last >= 0 && direction == buffer->ra_direction
+			&& distance <= 2)
+	{
+		/* the faster the pages go by, the larger the window */
+		if((1 << buffer->ra_streak) < HEXEDITORBUFFER_READAHEAD)
+			buffer->ra_streak++;
+	}
+	else
+		buffer->ra_streak = 0;
+	buffer->ra_direction = direction;
+	buffer->ra_last = index;
+	if(buffer->ra_streak == 0)
+		return;
+	window = 1 << buffer->ra_streak;
+	/* have the kernel fetch the pages ahead asynchronously */
+	if(direction > 0)
+		_readahead_advise(buffer, index + 1, index + window,
+				POSIX_FADV_WILLNEED);
+	else
+		_readahead_advise(buffer, index - window, index - 1,
+				POSIX_FADV_WILLNEED);
+	/* drop the pages left far behind, as many as are read ahead so that
+	 * none are skipped however fast the view goes */
+	distance = buffer->pages_cnt + HEXEDITORBUFFER_READAHEAD;
+	_readahead_advise(buffer, index - (distance + window) * direction,
+			index - distance * direction, POSIX_FADV_DONTNEED);
+}
+
+static void _readahead_advise(HexEditorBuffer * buffer, off_t first,
+		off_t last, int advice)
+{
+	off_t tmp;
+
+	if(first > last)
+	{
+		tmp = first;
+		first = last;
+		last = tmp;
+	}
+	if(first < 0)
+		first = 0;
+	/* only files are known to the kernel */
+	if(buffer->fd < 0 || first > last
+			|| first * HEXEDITORBUFFER_PAGE_SIZE >= buffer->size)
+		return;
+#ifdef POSIX_FADV_NORMAL
+	/* this is only a hint, errors are not relevant */
+	posix_fadvise(buffer->fd, first * HEXEDITORBUFFER_PAGE_SIZE,
+			(last - first + 1) * HEXEDITORBUFFER_PAGE_SIZE, advice);
+#else
+	(void) advice;
+#endif
+}
@@ -0,0 +1,61 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_BUFFER_H
+# define HEXEDITOR_BUFFER_H
+
+# include <sys/types.h>
+
+
+/* HexEditorBuffer */
+/* public */
+/* types */
+typedef struct _HexEditorBuffer HexEditorBuffer;
+
+/* reads from something else than a file descriptor */
+typedef ssize_t (*HexEditorBufferReader)(void * data, void * buf, size_t size,
+		off_t offset);
+
+
+/* constants */
+# define HEXEDITORBUFFER_PAGE_SIZE	65536
+# define HEXEDITORBUFFER_PAGES		64
+# define HEXEDITORBUFFER_READAHEAD	32
+
+
+/* functions */
+HexEditorBuffer * hexeditorbuffer_new(int fd, off_t size, size_t pages);
+HexEditorBuffer * hexeditorbuffer_new_reader(HexEditorBufferReader reader,
+		void * data, off_t size, size_t pages);
+void hexeditorbuffer_delete(HexEditorBuffer * buffer);
+
+/* accessors */
+/* changes whenever pages are discarded, as the file was modified */
+unsigned int hexeditorbuffer_get_generation(HexEditorBuffer * buffer);
+off_t hexeditorbuffer_get_size(HexEditorBuffer * buffer);
+
+void hexeditorbuffer_set_size(HexEditorBuffer * buffer, off_t size);
+
+/* useful */
+void hexeditorbuffer_flush(HexEditorBuffer * buffer);
+int hexeditorbuffer_fill(HexEditorBuffer * buffer, off_t offset,
+		char const * buf, size_t size);
+int hexeditorbuffer_is_cached(HexEditorBuffer * buffer, off_t offset);
+ssize_t hexeditorbuffer_read(HexEditorBuffer * buffer, off_t offset,
+		void * buf, size_t size);
+
+#endif /* !HEXEDITOR_BUFFER_H */
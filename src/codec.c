@@ -0,0 +1,889 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <sys/stat.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <libintl.h>
+#include <zlib.h>
+#include <lzma.h>
+#include <glib.h>
+#include <System.h>
+#include "codec.h"
+#define _(string) gettext(string)
+
+
+/* HexEditorCodec */
+/* private */
+/* types */
+/* where the decompression can resume */
+typedef struct _HexEditorCodecPoint
+{
+	uint64_t in;
+	uint64_t out;
+	/* gzip: the last 32 KiB decompressed, kept in the index file */
+	uint64_t window;
+	uint32_t window_size;
+	/* gzip: bits left in the previous byte; xz: type of check */
+	uint32_t bits;
+} HexEditorCodecPoint;
+
+typedef struct _HexEditorCodecHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t type;
+	uint64_t key;
+	uint64_t size;
+	/* the checkpoints follow the windows */
+	uint64_t points;
+	uint64_t count;
+} HexEditorCodecHeader;
+
+typedef enum _HexEditorCodecState
+{
+	HECS_STREAM = 0,
+	HECS_BLOCK_HEADER,
+	HECS_BLOCK,
+	HECS_INDEX,
+	HECS_FOOTER,
+	HECS_END
+} HexEditorCodecState;
+
+struct _HexEditorCodec
+{
+	/* read from the main loop and from the workers */
+	GMutex mutex;
+
+	int fd;
+	HexEditorCodecType type;
+	off_t isize;
+	uint64_t key;
+	String * filename;
+
+	/* checkpoints, in memory */
+	HexEditorCodecPoint * points;
+	size_t points_cnt;
+	off_t frontier;
+	off_t size;
+	int saved;
+
+	/* windows, on disk */
+	String * index;
+	int index_fd;
+	off_t index_size;
+
+	/* current position */
+	int active;
+	HexEditorCodecState state;
+	off_t in;
+	off_t out;
+	unsigned char * input;
+	unsigned char const * next;
+	size_t avail;
+	unsigned char * scratch;
+	z_stream z;
+	int z_raw;
+	lzma_stream x;
+	lzma_block x_block;
+	uint32_t x_check;
+	lzma_index * x_index;
+};
+
+
+/* constants */
+#define HEXEDITORCODEC_MAGIC		"HEXEDCI"
+#define HEXEDITORCODEC_VERSION		1
+#define HEXEDITORCODEC_INPUT		65536
+#define HEXEDITORCODEC_WINDOW		32768
+
+
+/* prototypes */
+static int _hexeditorcodec_checkpoint(HexEditorCodec * codec,
+		uint32_t bits);
+static ssize_t _hexeditorcodec_decode(HexEditorCodec * codec,
+		unsigned char * buf, size_t size);
+static int _hexeditorcodec_fill(HexEditorCodec * codec, size_t size);
+static int _hexeditorcodec_load(HexEditorCodec * codec);
+static HexEditorCodecPoint * _hexeditorcodec_lookup(HexEditorCodec * codec,
+		off_t offset);
+static int _hexeditorcodec_restore(HexEditorCodec * codec,
+		HexEditorCodecPoint * point);
+
+static ssize_t _hexeditorcodec_gzip(HexEditorCodec * codec,
+		unsigned char * buf, size_t size);
+static ssize_t _hexeditorcodec_xz(HexEditorCodec * codec,
+		unsigned char * buf, size_t size);
+
+
+/* public */
+/* functions */
+/* hexeditorcodec_detect */
+HexEditorCodecType hexeditorcodec_detect(int fd)
+{
+	static const unsigned char gzip[] = { 0x1f, 0x8b, 0x08 };
+	static const unsigned char xz[] = { 0xfd, '7', 'z', 'X', 'Z', 0x00 };
+	unsigned char buf[6];
+	ssize_t res;
+
+	while((res = pread(fd, buf, sizeof(buf), 0)) < 0 && errno == EINTR);
+	if(res >= (ssize_t)sizeof(gzip) && memcmp(buf, gzip, sizeof(gzip)) == 0)
+		return HECT_GZIP;
+	if(res >= (ssize_t)sizeof(xz) && memcmp(buf, xz, sizeof(xz)) == 0)
+		return HECT_XZ;
+	return HECT_NONE;
+}
+
+
+/* hexeditorcodec_new */
+static int _new_index(HexEditorCodec * codec);
+
+HexEditorCodec * hexeditorcodec_new(int fd, HexEditorCodecType type,
+		char const * filename, uint64_t key)
+{
+	HexEditorCodec * codec;
+	struct stat st;
+	lzma_stream x = LZMA_STREAM_INIT;
+
+	if(type != HECT_GZIP && type != HECT_XZ)
+	{
+		error_set_code(1, "%s", strerror(ENOTSUP));
+		return NULL;
+	}
+	if(fstat(fd, &st) != 0)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		return NULL;
+	}
+	if((codec = object_new(sizeof(*codec))) == NULL)
+		return NULL;
+	g_mutex_init(&codec->mutex);
+	codec->fd = fd;
+	codec->type = type;
+	codec->isize = st.st_size;
+	codec->key = key;
+	codec->filename = (filename != NULL) ? string_new(filename) : NULL;
+	codec->points = NULL;
+	codec->points_cnt = 0;
+	codec->frontier = 0;
+	codec->size = -1;
+	codec->saved = 0;
+	codec->index = NULL;
+	codec->index_fd = -1;
+	codec->index_size = 0;
+	codec->active = 0;
+	codec->state = HECS_END;
+	codec->in = 0;
+	codec->out = 0;
+	codec->input = malloc(HEXEDITORCODEC_INPUT);
+	codec->next = codec->input;
+	codec->avail = 0;
+	codec->scratch = malloc(HEXEDITORCODEC_INPUT);
+	memset(&codec->z, 0, sizeof(codec->z));
+	codec->z_raw = 0;
+	codec->x = x;
+	codec->x_check = LZMA_CHECK_NONE;
+	codec->x_index = NULL;
+	if((filename != NULL && codec->filename == NULL)
+			|| codec->input == NULL || codec->scratch == NULL)
+	{
+		if(codec->input == NULL || codec->scratch == NULL)
+			error_set_code(1, "%s", strerror(errno));
+		hexeditorcodec_delete(codec);
+		return NULL;
+	}
+	/* an index saved previously spares the first pass */
+	if((codec->filename == NULL || _hexeditorcodec_load(codec) != 0)
+			&& _new_index(codec) != 0)
+	{
+		hexeditorcodec_delete(codec);
+		return NULL;
+	}
+	return codec;
+}
+
+static int _new_index(HexEditorCodec * codec)
+{
+	HexEditorCodecHeader header;
+	char const * tmpdir;
+
+	/* the windows are stored on disk as soon as they are known */
+	if(codec->filename != NULL)
+		codec->index = string_new_append(codec->filename, ".XXXXXX",
+				NULL);
+	if(codec->index == NULL || (codec->index_fd = mkstemp(codec->index))
+			< 0)
+	{
+		if(codec->index != NULL)
+			string_delete(codec->index);
+		if((tmpdir = getenv("TMPDIR")) == NULL)
+			tmpdir = P_tmpdir;
+		if((codec->index = string_new_append(tmpdir,
+						"/hexeditor.XXXXXX", NULL))
+				== NULL)
+			return -1;
+		if((codec->index_fd = mkstemp(codec->index)) < 0)
+			return -error_set_code(1, "%s: %s", codec->index,
+					strerror(errno));
+		/* this one will not be saved */
+		unlink(codec->index);
+		string_delete(codec->index);
+		codec->index = NULL;
+	}
+	memset(&header, 0, sizeof(header));
+	codec->index_size = sizeof(header);
+	if((codec->points = malloc(sizeof(*codec->points))) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	/* the beginning of the file */
+	memset(codec->points, 0, sizeof(*codec->points));
+	codec->points_cnt = 1;
+	return 0;
+}
+
+
+/* hexeditorcodec_delete */
+void hexeditorcodec_delete(HexEditorCodec * codec)
+{
+	if(codec->x_index != NULL)
+		lzma_index_end(codec->x_index, NULL);
+	lzma_end(&codec->x);
+	if(codec->active && codec->type == HECT_GZIP)
+		inflateEnd(&codec->z);
+	if(codec->index_fd >= 0)
+		close(codec->index_fd);
+	if(codec->index != NULL)
+	{
+		/* incomplete */
+		if(!codec->saved)
+			unlink(codec->index);
+		string_delete(codec->index);
+	}
+	free(codec->scratch);
+	free(codec->input);
+	free(codec->points);
+	if(codec->filename != NULL)
+		string_delete(codec->filename);
+	g_mutex_clear(&codec->mutex);
+	object_delete(codec);
+}
+
+
+/* accessors */
+/* hexeditorcodec_is_complete */
+int hexeditorcodec_is_complete(HexEditorCodec * codec)
+{
+	int ret;
+
+	g_mutex_lock(&codec->mutex);
+	ret = (codec->size >= 0) ? 1 : 0;
+	g_mutex_unlock(&codec->mutex);
+	return ret;
+}
+
+
+/* hexeditorcodec_get_progress */
+double hexeditorcodec_get_progress(HexEditorCodec * codec)
+{
+	double ret;
+	HexEditorCodecPoint const * point;
+
+	g_mutex_lock(&codec->mutex);
+	if(codec->size >= 0 || codec->isize == 0)
+		ret = 1.0;
+	/* how much of the compressed file is known */
+	else if(codec->active && codec->out >= codec->frontier)
+		ret = (double)(codec->in - codec->avail) / codec->isize;
+	else
+	{
+		point = &codec->points[codec->points_cnt - 1];
+		ret = (double)point->in / codec->isize;
+	}
+	g_mutex_unlock(&codec->mutex);
+	return ret;
+}
+
+
+/* hexeditorcodec_get_size */
+off_t hexeditorcodec_get_size(HexEditorCodec * codec)
+{
+	off_t ret;
+
+	/* grows until the end of the stream */
+	g_mutex_lock(&codec->mutex);
+	ret = (codec->size >= 0) ? codec->size : codec->frontier;
+	g_mutex_unlock(&codec->mutex);
+	return ret;
+}
+
+
+/* useful */
+/* hexeditorcodec_read */
+static ssize_t _read_decode(HexEditorCodec * codec, void * buf, size_t size,
+		off_t offset);
+
+ssize_t hexeditorcodec_read(HexEditorCodec * codec, void * buf, size_t size,
+		off_t offset)
+{
+	ssize_t ret;
+
+	/* there is only one position to decompress from */
+	g_mutex_lock(&codec->mutex);
+	ret = _read_decode(codec, buf, size, offset);
+	g_mutex_unlock(&codec->mutex);
+	return ret;
+}
+
+static ssize_t _read_decode(HexEditorCodec * codec, void * buf, size_t size,
+		off_t offset)
+{
+	unsigned char * p = buf;
+	HexEditorCodecPoint * point;
+	size_t pos;
+	ssize_t res;
+
+	if(codec->size >= 0 && offset >= codec->size)
+		return 0;
+	/* resume from the nearest checkpoint, unless already closer */
+	point = _hexeditorcodec_lookup(codec, offset);
+	if(!codec->active || codec->out > offset
+			|| (off_t)point->out > codec->out)
+		if(_hexeditorcodec_restore(codec, point) != 0)
+			return -1;
+	while(codec->out < offset)
+	{
+		pos = (offset - codec->out < HEXEDITORCODEC_INPUT)
+			? offset - codec->out : HEXEDITORCODEC_INPUT;
+		if((res = _hexeditorcodec_decode(codec, codec->scratch, pos))
+				<= 0)
+			return res;
+	}
+	for(pos = 0; pos < size; pos += res)
+		if((res = _hexeditorcodec_decode(codec, &p[pos], size - pos))
+				< 0)
+			return (pos > 0) ? (ssize_t)pos : -1;
+		else if(res == 0)
+			break;
+	return pos;
+}
+
+
+/* hexeditorcodec_save */
+static int _save_index(HexEditorCodec * codec);
+
+int hexeditorcodec_save(HexEditorCodec * codec)
+{
+	int ret;
+
+	g_mutex_lock(&codec->mutex);
+	ret = _save_index(codec);
+	g_mutex_unlock(&codec->mutex);
+	return ret;
+}
+
+static int _save_index(HexEditorCodec * codec)
+{
+	HexEditorCodecHeader header;
+	size_t size;
+
+	if(codec->saved || codec->index == NULL || codec->size < 0)
+		return 0;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, HEXEDITORCODEC_MAGIC, sizeof(header.magic));
+	header.version = HEXEDITORCODEC_VERSION;
+	header.type = codec->type;
+	header.key = codec->key;
+	header.size = codec->size;
+	header.points = codec->index_size;
+	header.count = codec->points_cnt;
+	size = sizeof(*codec->points) * codec->points_cnt;
+	/* the header goes last, once everything else is there */
+	if(pwrite(codec->index_fd, codec->points, size, codec->index_size)
+			!= (ssize_t)size
+			|| pwrite(codec->index_fd, &header, sizeof(header), 0)
+			!= sizeof(header))
+		return -error_set_code(1, "%s: %s", codec->index,
+				strerror(errno));
+	if(rename(codec->index, codec->filename) != 0)
+		return -error_set_code(1, "%s: %s", codec->filename,
+				strerror(errno));
+	string_delete(codec->index);
+	codec->index = NULL;
+	codec->saved = 1;
+	return 0;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorcodec_checkpoint */
+static int _hexeditorcodec_checkpoint(HexEditorCodec * codec,
+		uint32_t bits)
+{
+	HexEditorCodecPoint * p;
+	unsigned char window[HEXEDITORCODEC_WINDOW];
+	uInt size = 0;
+
+	/* only once per span, and only for what was never seen */
+	p = &codec->points[codec->points_cnt - 1];
+	if(codec->saved || codec->out < (off_t)(p->out + HEXEDITORCODEC_SPAN))
+		return 0;
+	if(codec->type == HECT_GZIP)
+	{
+		size = sizeof(window);
+		if(inflateGetDictionary(&codec->z, window, &size) != Z_OK)
+			return -error_set_code(1, "%s", _("Could not obtain the"
+						" decompression window"));
+		if(pwrite(codec->index_fd, window, size, codec->index_size)
+				!= (ssize_t)size)
+			return -error_set_code(1, "%s", strerror(errno));
+	}
+	if((p = realloc(codec->points, sizeof(*p) * (codec->points_cnt + 1)))
+			== NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	codec->points = p;
+	p = &codec->points[codec->points_cnt++];
+	p->in = codec->in - codec->avail;
+	p->out = codec->out;
+	p->window = codec->index_size;
+	p->window_size = size;
+	p->bits = bits;
+	codec->index_size += size;
+	return 0;
+}
+
+
+/* hexeditorcodec_decode */
+static ssize_t _hexeditorcodec_decode(HexEditorCodec * codec,
+		unsigned char * buf, size_t size)
+{
+	ssize_t res;
+
+	res = (codec->type == HECT_GZIP) ? _hexeditorcodec_gzip(codec, buf,
+			size) : _hexeditorcodec_xz(codec, buf, size);
+	if(res > 0)
+		codec->out += res;
+	if(codec->out > codec->frontier)
+		codec->frontier = codec->out;
+	/* the end of the stream gives its size */
+	if(codec->state == HECS_END && codec->size < 0)
+		codec->size = codec->out;
+	return res;
+}
+
+
+/* hexeditorcodec_fill */
+static int _hexeditorcodec_fill(HexEditorCodec * codec, size_t size)
+{
+	ssize_t res;
+
+	/* makes sure that size bytes are available, unless at the end */
+	while(codec->avail < size)
+	{
+		if(codec->next != codec->input)
+		{
+			memmove(codec->input, codec->next, codec->avail);
+			codec->next = codec->input;
+		}
+		if((res = pread(codec->fd, &codec->input[codec->avail],
+						HEXEDITORCODEC_INPUT
+						- codec->avail, codec->in)) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			return -error_set_code(1, "%s", strerror(errno));
+		}
+		if(res == 0)
+			break;
+		codec->avail += res;
+		codec->in += res;
+	}
+	return 0;
+}
+
+
+/* hexeditorcodec_load */
+static int _hexeditorcodec_load(HexEditorCodec * codec)
+{
+	HexEditorCodecHeader header;
+	int fd;
+	size_t size;
+
+	if((fd = open(codec->filename, O_RDONLY)) < 0)
+		return -error_set_code(1, "%s: %s", codec->filename,
+				strerror(errno));
+	if(pread(fd, &header, sizeof(header), 0) != sizeof(header)
+			|| memcmp(header.magic, HEXEDITORCODEC_MAGIC,
+				sizeof(header.magic)) != 0
+			|| header.version != HEXEDITORCODEC_VERSION
+			|| header.type != codec->type
+			|| header.key != codec->key
+			|| header.count == 0
+			|| header.count > SIZE_MAX / sizeof(*codec->points))
+	{
+		close(fd);
+		return -error_set_code(1, "%s: %s", codec->filename,
+				strerror(EINVAL));
+	}
+	size = sizeof(*codec->points) * header.count;
+	if((codec->points = malloc(size)) == NULL)
+	{
+		close(fd);
+		return -error_set_code(1, "%s", strerror(errno));
+	}
+	if(pread(fd, codec->points, size, header.points) != (ssize_t)size)
+	{
+		free(codec->points);
+		codec->points = NULL;
+		close(fd);
+		return -error_set_code(1, "%s: %s", codec->filename,
+				strerror(EINVAL));
+	}
+	codec->points_cnt = header.count;
+	codec->index_fd = fd;
+	codec->index_size = header.points;
+	codec->frontier = header.size;
+	codec->size = header.size;
+	codec->saved = 1;
+	return 0;
+}
+
+
+/* hexeditorcodec_lookup */
+static HexEditorCodecPoint * _hexeditorcodec_lookup(HexEditorCodec * codec,
+		off_t offset)
+{
+	size_t low = 0;
+	size_t high = codec->points_cnt;
+	size_t mid;
+
+	/* the last checkpoint at or before offset */
+	while(high - low > 1)
+	{
+		mid = low + (high - low) / 2;
+		if((off_t)codec->points[mid].out <= offset)
+			low = mid;
+		else
+			high = mid;
+	}
+	return &codec->points[low];
+}
+
+
+/* hexeditorcodec_restore */
+static int _restore_gzip(HexEditorCodec * codec, HexEditorCodecPoint * point);
+
+static int _hexeditorcodec_restore(HexEditorCodec * codec,
+		HexEditorCodecPoint * point)
+{
+	codec->in = point->in;
+	codec->out = point->out;
+	codec->next = codec->input;
+	codec->avail = 0;
+	if(codec->x_index != NULL)
+	{
+		lzma_index_end(codec->x_index, NULL);
+		codec->x_index = NULL;
+	}
+	if(codec->type == HECT_GZIP)
+		return _restore_gzip(codec, point);
+	/* xz resumes at the header of a block */
+	codec->state = (point->in == 0) ? HECS_STREAM : HECS_BLOCK_HEADER;
+	codec->x_check = point->bits;
+	codec->active = 1;
+	return 0;
+}
+
+static int _restore_gzip(HexEditorCodec * codec, HexEditorCodecPoint * point)
+{
+	unsigned char window[HEXEDITORCODEC_WINDOW];
+	int res;
+
+	if(codec->active)
+		inflateEnd(&codec->z);
+	codec->active = 0;
+	memset(&codec->z, 0, sizeof(codec->z));
+	/* raw deflate data, except at the very beginning */
+	codec->z_raw = (point->in != 0) ? 1 : 0;
+	if(inflateInit2(&codec->z, codec->z_raw ? -15 : 15 + 16) != Z_OK)
+		return -error_set_code(1, "%s", (codec->z.msg != NULL)
+				? codec->z.msg : strerror(ENOMEM));
+	codec->active = 1;
+	codec->state = HECS_BLOCK;
+	if(point->bits > 0)
+	{
+		codec->in--;
+		if(_hexeditorcodec_fill(codec, 1) != 0)
+			return -1;
+		if(codec->avail == 0)
+			return -error_set_code(1, "%s", strerror(EIO));
+		res = *(codec->next++) >> (8 - point->bits);
+		codec->avail--;
+		inflatePrime(&codec->z, point->bits, res);
+	}
+	if(point->window_size == 0)
+		return 0;
+	if(point->window_size > sizeof(window)
+			|| pread(codec->index_fd, window, point->window_size,
+				point->window) != (ssize_t)point->window_size)
+		return -error_set_code(1, "%s", strerror(EIO));
+	inflateSetDictionary(&codec->z, window, point->window_size);
+	return 0;
+}
+
+
+/* hexeditorcodec_gzip */
+static int _gzip_member(HexEditorCodec * codec);
+
+static ssize_t _hexeditorcodec_gzip(HexEditorCodec * codec,
+		unsigned char * buf, size_t size)
+{
+	z_stream * z = &codec->z;
+	int res;
+
+	z->next_out = buf;
+	z->avail_out = size;
+	while(z->avail_out == size && codec->state != HECS_END)
+	{
+		if(_hexeditorcodec_fill(codec, 1) != 0)
+			return -1;
+		if(codec->avail == 0)
+		{
+			/* truncated: show what could be decompressed */
+			codec->state = HECS_END;
+			break;
+		}
+		z->next_in = (unsigned char *)codec->next;
+		z->avail_in = codec->avail;
+		/* stops at the end of every deflate block */
+		res = inflate(z, Z_BLOCK);
+		codec->out += size - z->avail_out;
+		codec->next = z->next_in;
+		codec->avail = z->avail_in;
+		if(res == Z_STREAM_END)
+		{
+			if(_gzip_member(codec) != 0)
+				res = Z_DATA_ERROR;
+		}
+		else if(res == Z_OK && (z->data_type & 128)
+				&& !(z->data_type & 64)
+				&& _hexeditorcodec_checkpoint(codec,
+					z->data_type & 7) != 0)
+			res = Z_MEM_ERROR;
+		codec->out -= size - z->avail_out;
+		if(res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR)
+			return -error_set_code(1, "%s", (z->msg != NULL)
+					? z->msg
+					: _("Corrupt compressed data"));
+	}
+	return size - z->avail_out;
+}
+
+static int _gzip_member(HexEditorCodec * codec)
+{
+	z_stream * z = &codec->z;
+
+	/* the trailer is not consumed when decompressing raw data */
+	if(codec->z_raw)
+	{
+		if(_hexeditorcodec_fill(codec, 8) != 0)
+			return -1;
+		if(codec->avail < 8)
+		{
+			codec->state = HECS_END;
+			return 0;
+		}
+		codec->next += 8;
+		codec->avail -= 8;
+	}
+	/* the members of a gzip file may be concatenated */
+	if(_hexeditorcodec_fill(codec, 2) != 0)
+		return -1;
+	if(codec->avail < 2 || codec->next[0] != 0x1f
+			|| codec->next[1] != 0x8b)
+	{
+		codec->state = HECS_END;
+		return 0;
+	}
+	codec->z_raw = 0;
+	return (inflateReset2(z, 15 + 16) == Z_OK) ? 0 : -1;
+}
+
+
+/* hexeditorcodec_xz */
+static int _xz_block(HexEditorCodec * codec);
+static int _xz_footer(HexEditorCodec * codec);
+static int _xz_stream(HexEditorCodec * codec);
+
+static ssize_t _hexeditorcodec_xz(HexEditorCodec * codec,
+		unsigned char * buf, size_t size)
+{
+	lzma_stream * x = &codec->x;
+	lzma_ret res;
+
+	x->next_out = buf;
+	x->avail_out = size;
+	while(x->avail_out == size && codec->state != HECS_END)
+	{
+		if(codec->state == HECS_STREAM)
+		{
+			if(_xz_stream(codec) != 0)
+				return -1;
+			continue;
+		}
+		else if(codec->state == HECS_BLOCK_HEADER)
+		{
+			if(_xz_block(codec) != 0)
+				return -1;
+			continue;
+		}
+		else if(codec->state == HECS_FOOTER)
+		{
+			if(_xz_footer(codec) != 0)
+				return -1;
+			continue;
+		}
+		if(_hexeditorcodec_fill(codec, 1) != 0)
+			return -1;
+		if(codec->avail == 0)
+		{
+			codec->state = HECS_END;
+			break;
+		}
+		x->next_in = codec->next;
+		x->avail_in = codec->avail;
+		res = lzma_code(x, LZMA_RUN);
+		codec->next = x->next_in;
+		codec->avail = x->avail_in;
+		if(res == LZMA_STREAM_END)
+			codec->state = (codec->state == HECS_INDEX)
+				? HECS_FOOTER : HECS_BLOCK_HEADER;
+		else if(res != LZMA_OK)
+			return -error_set_code(1, "%s",
+					_("Corrupt compressed data"));
+	}
+	return size - x->avail_out;
+}
+
+static int _xz_block(HexEditorCodec * codec)
+{
+	lzma_block * block = &codec->x_block;
+	lzma_filter filters[LZMA_FILTERS_MAX + 1];
+	lzma_ret res;
+	size_t i;
+
+	if(_hexeditorcodec_fill(codec, 1) != 0)
+		return -1;
+	if(codec->avail == 0)
+	{
+		codec->state = HECS_END;
+		return 0;
+	}
+	/* the index follows the last block */
+	if(codec->next[0] == 0x00)
+	{
+		if(lzma_index_decoder(&codec->x, &codec->x_index, UINT64_MAX)
+				!= LZMA_OK)
+			return -error_set_code(1, "%s", strerror(ENOMEM));
+		codec->state = HECS_INDEX;
+		return 0;
+	}
+	if(_hexeditorcodec_checkpoint(codec, codec->x_check) != 0)
+		return -1;
+	memset(block, 0, sizeof(*block));
+	block->version = 1;
+	block->check = codec->x_check;
+	block->filters = filters;
+	block->header_size = lzma_block_header_size_decode(codec->next[0]);
+	if(_hexeditorcodec_fill(codec, block->header_size) != 0)
+		return -1;
+	if(codec->avail < block->header_size
+			|| lzma_block_header_decode(block, NULL, codec->next)
+			!= LZMA_OK)
+		return -error_set_code(1, "%s",
+				_("Corrupt compressed data"));
+	res = lzma_block_decoder(&codec->x, block);
+	/* the decoder keeps the block but not the filters */
+	block->filters = NULL;
+	for(i = 0; filters[i].id != LZMA_VLI_UNKNOWN; i++)
+		free(filters[i].options);
+	if(res != LZMA_OK)
+		return -error_set_code(1, "%s",
+				_("Unsupported compressed data"));
+	codec->next += block->header_size;
+	codec->avail -= block->header_size;
+	codec->state = HECS_BLOCK;
+	return 0;
+}
+
+static int _xz_footer(HexEditorCodec * codec)
+{
+	if(codec->x_index != NULL)
+	{
+		lzma_index_end(codec->x_index, NULL);
+		codec->x_index = NULL;
+	}
+	if(_hexeditorcodec_fill(codec, LZMA_STREAM_HEADER_SIZE) != 0)
+		return -1;
+	if(codec->avail < LZMA_STREAM_HEADER_SIZE)
+		return -error_set_code(1, "%s",
+				_("Truncated compressed data"));
+	codec->next += LZMA_STREAM_HEADER_SIZE;
+	codec->avail -= LZMA_STREAM_HEADER_SIZE;
+	/* streams may be concatenated, with padding in between */
+	for(;;)
+	{
+		if(_hexeditorcodec_fill(codec, 4) != 0)
+			return -1;
+		if(codec->avail < 4 || memcmp(codec->next, "\0\0\0\0", 4) != 0)
+			break;
+		codec->next += 4;
+		codec->avail -= 4;
+	}
+	codec->state = (codec->avail >= 4) ? HECS_STREAM : HECS_END;
+	return 0;
+}
+
+static int _xz_stream(HexEditorCodec * codec)
+{
+	lzma_stream_flags flags;
+
+	if(_hexeditorcodec_fill(codec, LZMA_STREAM_HEADER_SIZE) != 0)
+		return -1;
+	if(codec->avail < LZMA_STREAM_HEADER_SIZE
+			|| lzma_stream_header_decode(&flags, codec->next)
+			!= LZMA_OK)
+	{
+		/* garbage after a complete stream is ignored */
+		if(codec->in - (off_t)codec->avail > 0)
+		{
+			codec->state = HECS_END;
+			return 0;
+		}
+		return -error_set_code(1, "%s",
+				_("Corrupt compressed data"));
+	}
+	codec->next += LZMA_STREAM_HEADER_SIZE;
+	codec->avail -= LZMA_STREAM_HEADER_SIZE;
+	codec->x_check = flags.check;
+	codec->state = HECS_BLOCK_HEADER;
+	return 0;
+}
@@ -0,0 +1,61 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_CODEC_H
+# define HEXEDITOR_CODEC_H
+
+# include <sys/types.h>
+# include <stdint.h>
+
+
+/* HexEditorCodec */
+/* public */
+/* types */
+typedef struct _HexEditorCodec HexEditorCodec;
+
+typedef enum _HexEditorCodecType
+{
+	HECT_NONE = 0,
+	HECT_GZIP,
+	HECT_XZ
+} HexEditorCodecType;
+
+
+/* constants */
+/* decompressed between two checkpoints */
+# define HEXEDITORCODEC_SPAN		(1024 * 1024)
+
+
+/* functions */
+HexEditorCodecType hexeditorcodec_detect(int fd);
+
+HexEditorCodec * hexeditorcodec_new(int fd, HexEditorCodecType type,
+		char const * filename, uint64_t key);
+void hexeditorcodec_delete(HexEditorCodec * codec);
+
+/* accessors */
+int hexeditorcodec_is_complete(HexEditorCodec * codec);
+double hexeditorcodec_get_progress(HexEditorCodec * codec);
+off_t hexeditorcodec_get_size(HexEditorCodec * codec);
+
+/* useful */
+/* safe to call from the search and transform workers, one at a time */
+ssize_t hexeditorcodec_read(HexEditorCodec * codec, void * buf, size_t size,
+		off_t offset);
+int hexeditorcodec_save(HexEditorCodec * codec);
+
+#endif /* !HEXEDITOR_CODEC_H */
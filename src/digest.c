@@ -0,0 +1,411 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <System.h>
+#include "digest.h"
+
+
+/* HexEditorDigest */
+/* private */
+/* types */
+struct _HexEditorDigest
+{
+	/* one hash per block, the last one may be partial */
+	uint64_t * hashes;
+	size_t hashes_cnt;
+	off_t size;
+	int complete;
+
+	/* the block being appended */
+	char * pending;
+	size_t pending_size;
+};
+
+/* as saved */
+typedef struct _HexEditorDigestHeader
+{
+	uint64_t block;
+	uint64_t size;
+} HexEditorDigestHeader;
+
+
+/* constants */
+#define HEXEDITORDIGEST_PRIME1	0x9e3779b185ebca87ULL
+#define HEXEDITORDIGEST_PRIME2	0xc2b2ae3d27d4eb4fULL
+
+
+/* prototypes */
+static int _hexeditordigest_compare(HexEditorDigest * digest, off_t offset,
+		size_t size, uint64_t hash);
+static uint64_t _hexeditordigest_hash_zero(size_t size);
+static int _hexeditordigest_set(HexEditorDigest * digest, size_t index,
+		uint64_t hash);
+
+
+/* public */
+/* functions */
+/* hexeditordigest_new */
+HexEditorDigest * hexeditordigest_new(void)
+{
+	HexEditorDigest * digest;
+
+	if((digest = object_new(sizeof(*digest))) == NULL)
+		return NULL;
+	digest->hashes = NULL;
+	digest->hashes_cnt = 0;
+	digest->size = 0;
+	digest->complete = 0;
+	digest->pending = NULL;
+	digest->pending_size = 0;
+	return digest;
+}
+
+
+/* hexeditordigest_new_from_buffer */
+HexEditorDigest * hexeditordigest_new_from_buffer(void const * buf,
+		size_t size)
+{
+	HexEditorDigest * digest;
+	HexEditorDigestHeader header;
+	size_t cnt;
+
+	if(size < sizeof(header))
+	{
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	memcpy(&header, buf, sizeof(header));
+	cnt = (header.size + HEXEDITORDIGEST_BLOCK_SIZE - 1)
+		/ HEXEDITORDIGEST_BLOCK_SIZE;
+	if(header.block != HEXEDITORDIGEST_BLOCK_SIZE
+			|| (size - sizeof(header)) / sizeof(uint64_t) != cnt)
+	{
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	if((digest = hexeditordigest_new()) == NULL)
+		return NULL;
+	if(cnt > 0 && (digest->hashes = malloc(sizeof(*digest->hashes) * cnt))
+			== NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		hexeditordigest_delete(digest);
+		return NULL;
+	}
+	memcpy(digest->hashes, (char const *)buf + sizeof(header),
+			sizeof(*digest->hashes) * cnt);
+	digest->hashes_cnt = cnt;
+	digest->size = header.size;
+	digest->complete = 1;
+	return digest;
+}
+
+
+/* hexeditordigest_delete */
+void hexeditordigest_delete(HexEditorDigest * digest)
+{
+	free(digest->pending);
+	free(digest->hashes);
+	object_delete(digest);
+}
+
+
+/* accessors */
+/* hexeditordigest_get_buffer */
+int hexeditordigest_get_buffer(HexEditorDigest * digest, void ** buf,
+		size_t * size)
+{
+	HexEditorDigestHeader header;
+	char * p;
+
+	if(!digest->complete)
+		return -error_set_code(1, "%s", strerror(EAGAIN));
+	header.block = HEXEDITORDIGEST_BLOCK_SIZE;
+	header.size = digest->size;
+	*size = sizeof(header) + sizeof(*digest->hashes) * digest->hashes_cnt;
+	if((p = malloc(*size)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	memcpy(p, &header, sizeof(header));
+	if(digest->hashes_cnt > 0)
+		memcpy(&p[sizeof(header)], digest->hashes,
+				sizeof(*digest->hashes) * digest->hashes_cnt);
+	*buf = p;
+	return 0;
+}
+
+
+/* hexeditordigest_get_size */
+off_t hexeditordigest_get_size(HexEditorDigest * digest)
+{
+	return digest->size;
+}
+
+
+/* hexeditordigest_is_complete */
+int hexeditordigest_is_complete(HexEditorDigest * digest)
+{
+	return digest->complete;
+}
+
+
+/* useful */
+/* hexeditordigest_append */
+int hexeditordigest_append(HexEditorDigest * digest, char const * buf,
+		size_t size)
+{
+	size_t cnt;
+
+	if(digest->complete)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	if(digest->pending == NULL && (digest->pending = malloc(
+					HEXEDITORDIGEST_BLOCK_SIZE)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	for(; size > 0; buf += cnt, size -= cnt)
+	{
+		cnt = HEXEDITORDIGEST_BLOCK_SIZE - digest->pending_size;
+		if(cnt > size)
+			cnt = size;
+		memcpy(&digest->pending[digest->pending_size], buf, cnt);
+		digest->pending_size += cnt;
+		digest->size += cnt;
+		if(digest->pending_size < HEXEDITORDIGEST_BLOCK_SIZE)
+			break;
+		if(_hexeditordigest_set(digest, digest->hashes_cnt,
+					hexeditordigest_hash(digest->pending,
+						digest->pending_size)) != 0)
+			return -1;
+		digest->pending_size = 0;
+	}
+	return 0;
+}
+
+
+/* hexeditordigest_append_zero */
+int hexeditordigest_append_zero(HexEditorDigest * digest, off_t size)
+{
+	size_t cnt;
+
+	if(digest->complete)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	if(digest->pending == NULL && (digest->pending = malloc(
+					HEXEDITORDIGEST_BLOCK_SIZE)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	/* complete the block pending first */
+	if(digest->pending_size > 0)
+	{
+		cnt = HEXEDITORDIGEST_BLOCK_SIZE - digest->pending_size;
+		if((off_t)cnt > size)
+			cnt = size;
+		memset(&digest->pending[digest->pending_size], 0, cnt);
+		digest->pending_size += cnt;
+		digest->size += cnt;
+		size -= cnt;
+		if(digest->pending_size < HEXEDITORDIGEST_BLOCK_SIZE)
+			return 0;
+		if(_hexeditordigest_set(digest, digest->hashes_cnt,
+					hexeditordigest_hash(digest->pending,
+						digest->pending_size)) != 0)
+			return -1;
+		digest->pending_size = 0;
+	}
+	/* the whole blocks of zeros are not hashed again */
+	for(; size >= HEXEDITORDIGEST_BLOCK_SIZE;
+			size -= HEXEDITORDIGEST_BLOCK_SIZE)
+	{
+		if(_hexeditordigest_set(digest, digest->hashes_cnt,
+					_hexeditordigest_hash_zero(
+						HEXEDITORDIGEST_BLOCK_SIZE))
+				!= 0)
+			return -1;
+		digest->size += HEXEDITORDIGEST_BLOCK_SIZE;
+	}
+	memset(digest->pending, 0, size);
+	digest->pending_size = size;
+	digest->size += size;
+	return 0;
+}
+
+
+/* hexeditordigest_compare */
+int hexeditordigest_compare(HexEditorDigest * digest, off_t offset,
+		char const * buf, size_t size)
+{
+	if(size > HEXEDITORDIGEST_BLOCK_SIZE)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	return _hexeditordigest_compare(digest, offset, size,
+			hexeditordigest_hash(buf, size));
+}
+
+
+/* hexeditordigest_compare_zero */
+int hexeditordigest_compare_zero(HexEditorDigest * digest, off_t offset,
+		size_t size)
+{
+	if(size > HEXEDITORDIGEST_BLOCK_SIZE)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	return _hexeditordigest_compare(digest, offset, size,
+			_hexeditordigest_hash_zero(size));
+}
+
+
+/* hexeditordigest_complete */
+void hexeditordigest_complete(HexEditorDigest * digest)
+{
+	if(digest->complete)
+		return;
+	if(digest->pending_size > 0 && _hexeditordigest_set(digest,
+				digest->hashes_cnt, hexeditordigest_hash(
+					digest->pending,
+					digest->pending_size)) != 0)
+		return;
+	free(digest->pending);
+	digest->pending = NULL;
+	digest->pending_size = 0;
+	digest->complete = 1;
+}
+
+
+/* hexeditordigest_reset */
+void hexeditordigest_reset(HexEditorDigest * digest)
+{
+	free(digest->pending);
+	digest->pending = NULL;
+	digest->pending_size = 0;
+	digest->hashes_cnt = 0;
+	digest->size = 0;
+	digest->complete = 0;
+}
+
+
+/* hexeditordigest_truncate */
+void hexeditordigest_truncate(HexEditorDigest * digest, off_t size)
+{
+	if(!digest->complete || size >= digest->size)
+		return;
+	digest->hashes_cnt = (size + HEXEDITORDIGEST_BLOCK_SIZE - 1)
+		/ HEXEDITORDIGEST_BLOCK_SIZE;
+	/* the last block has to be compared again */
+	if(size % HEXEDITORDIGEST_BLOCK_SIZE != 0)
+		digest->hashes[digest->hashes_cnt - 1] = 0;
+	digest->size = size;
+}
+
+
+/* hexeditordigest_hash */
+uint64_t hexeditordigest_hash(char const * buf, size_t size)
+{
+	uint64_t h = HEXEDITORDIGEST_PRIME1 ^ size;
+	uint64_t w;
+	size_t i;
+
+	/* one word at a time */
+	for(i = 0; i + sizeof(w) <= size; i += sizeof(w))
+	{
+		memcpy(&w, &buf[i], sizeof(w));
+		h ^= w * HEXEDITORDIGEST_PRIME2;
+		h = ((h << 31) | (h >> 33)) * HEXEDITORDIGEST_PRIME1;
+	}
+	for(; i < size; i++)
+	{
+		h ^= (unsigned char)buf[i] * HEXEDITORDIGEST_PRIME1;
+		h = ((h << 23) | (h >> 41)) * HEXEDITORDIGEST_PRIME2;
+	}
+	h ^= h >> 33;
+	h *= HEXEDITORDIGEST_PRIME2;
+	h ^= h >> 29;
+	return h;
+}
+
+
+/* private */
+/* functions */
+/* hexeditordigest_compare */
+static int _hexeditordigest_compare(HexEditorDigest * digest, off_t offset,
+		size_t size, uint64_t hash)
+{
+	size_t index = offset / HEXEDITORDIGEST_BLOCK_SIZE;
+	int ret;
+
+	/* the blocks have to be compared in a complete digest */
+	if(!digest->complete || offset % HEXEDITORDIGEST_BLOCK_SIZE != 0
+			|| size > HEXEDITORDIGEST_BLOCK_SIZE)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	/* the length of the last block matters as well */
+	ret = (index >= digest->hashes_cnt || digest->hashes[index] != hash
+			|| (off_t)(offset + size) > digest->size
+			|| (size < HEXEDITORDIGEST_BLOCK_SIZE
+				&& (off_t)(offset + size) != digest->size))
+		? 1 : 0;
+	if(ret == 0)
+		return 0;
+	if(_hexeditordigest_set(digest, index, hash) != 0)
+		return -1;
+	if((off_t)(offset + size) > digest->size
+			|| size < HEXEDITORDIGEST_BLOCK_SIZE)
+		digest->size = offset + size;
+	return ret;
+}
+
+
+/* hexeditordigest_hash_zero */
+static uint64_t _hexeditordigest_hash_zero(size_t size)
+{
+	static uint64_t hash;
+	static int hashed = 0;
+	char * buf;
+	uint64_t ret;
+
+	/* only whole blocks are remembered */
+	if(size == HEXEDITORDIGEST_BLOCK_SIZE && hashed)
+		return hash;
+	if((buf = calloc(1, (size > 0) ? size : 1)) == NULL)
+		/* never matches, the block is then read again */
+		return 0;
+	ret = hexeditordigest_hash(buf, size);
+	free(buf);
+	if(size == HEXEDITORDIGEST_BLOCK_SIZE)
+	{
+		hash = ret;
+		hashed = 1;
+	}
+	return ret;
+}
+
+
+/* hexeditordigest_set */
+static int _hexeditordigest_set(HexEditorDigest * digest, size_t index,
+		uint64_t hash)
+{
+	uint64_t * p;
+
+	if(index >= digest->hashes_cnt)
+	{
+		if((p = realloc(digest->hashes, sizeof(*p) * (index + 1)))
+				== NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+		digest->hashes = p;
+		/* the blocks skipped can only be different */
+		for(; digest->hashes_cnt < index; digest->hashes_cnt++)
+			digest->hashes[digest->hashes_cnt] = 0;
+		digest->hashes_cnt = index + 1;
+	}
+	digest->hashes[index] = hash;
+	return 0;
+}
@@ -0,0 +1,61 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_DIGEST_H
+# define HEXEDITOR_DIGEST_H
+
+# include <sys/types.h>
+# include <stdint.h>
+
+
+/* HexEditorDigest */
+/* public */
+/* types */
+typedef struct _HexEditorDigest HexEditorDigest;
+
+
+/* constants */
+# define HEXEDITORDIGEST_BLOCK_SIZE	(1024 * 1024)
+
+
+/* functions */
+HexEditorDigest * hexeditordigest_new(void);
+HexEditorDigest * hexeditordigest_new_from_buffer(void const * buf,
+		size_t size);
+void hexeditordigest_delete(HexEditorDigest * digest);
+
+/* accessors */
+int hexeditordigest_get_buffer(HexEditorDigest * digest, void ** buf,
+		size_t * size);
+int hexeditordigest_is_complete(HexEditorDigest * digest);
+off_t hexeditordigest_get_size(HexEditorDigest * digest);
+
+/* useful */
+int hexeditordigest_append(HexEditorDigest * digest, char const * buf,
+		size_t size);
+int hexeditordigest_append_zero(HexEditorDigest * digest, off_t size);
+int hexeditordigest_compare(HexEditorDigest * digest, off_t offset,
+		char const * buf, size_t size);
+int hexeditordigest_compare_zero(HexEditorDigest * digest, off_t offset,
+		size_t size);
+void hexeditordigest_complete(HexEditorDigest * digest);
+void hexeditordigest_reset(HexEditorDigest * digest);
+void hexeditordigest_truncate(HexEditorDigest * digest, off_t size);
+
+uint64_t hexeditordigest_hash(char const * buf, size_t size);
+
+#endif /* !HEXEDITOR_DIGEST_H */
@@ -0,0 +1,677 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE /* for copy_file_range() */
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <System.h>
+#include "export.h"
+
+
+/* HexEditorExport */
+/* private */
+/* constants */
+#define HEXEDITOREXPORT_LINE_MAX	57
+#define HEXEDITOREXPORT_TEXT_MAX	256
+#define HEXEDITOREXPORT_BUFFER_SIZE	(256 * 1024)
+
+/* the bytes per line of every format */
+static const size_t _hexeditorexport_lines[HEEF_COUNT] =
+{
+	0, 12, 12, HEXEDITOREXPORT_LINE_MAX, 16, 16, 16
+};
+
+
+/* types */
+struct _HexEditorExport
+{
+	HexEditorExportFormat format;
+	int fd;
+	HexEditorBufferReader reader;
+	void * reader_data;
+	/* the range exported, and how much of it already */
+	off_t offset;
+	off_t size;
+	off_t position;
+	int out;
+	int started;
+	/* copy_file_range() is still worth trying */
+	int copy;
+
+	/* the chunk being encoded */
+	unsigned char * in;
+	/* the bytes of a partial line, until the next chunk */
+	unsigned char line[HEXEDITOREXPORT_LINE_MAX];
+	size_t line_cnt;
+	/* the text not written yet */
+	char * buf;
+	size_t buf_cnt;
+	/* Intel HEX: the upper 16 bits of the addresses */
+	uint32_t segment;
+};
+
+
+/* variables */
+static pthread_once_t _hexeditorexport_once = PTHREAD_ONCE_INIT;
+/* two characters at once, for every byte or group of 6 bits */
+static char _hexeditorexport_hex[256][2];
+static char _hexeditorexport_hex_upper[256][2];
+static char _hexeditorexport_base64[4096][2];
+
+
+/* prototypes */
+static void _hexeditorexport_init(void);
+
+static int _hexeditorexport_encode(HexEditorExport * export,
+		unsigned char const * buf, size_t size);
+static int _hexeditorexport_flush(HexEditorExport * export);
+static int _hexeditorexport_footer(HexEditorExport * export);
+static int _hexeditorexport_header(HexEditorExport * export);
+static int _hexeditorexport_line(HexEditorExport * export, off_t offset,
+		unsigned char const * buf, size_t size);
+static int _hexeditorexport_step_raw(HexEditorExport * export);
+static int _hexeditorexport_write(HexEditorExport * export, char const * buf,
+		size_t size);
+
+
+/* public */
+/* functions */
+/* hexeditorexport_new */
+static HexEditorExport * _new_export(HexEditorExportFormat format,
+		off_t offset, off_t size, int out);
+
+HexEditorExport * hexeditorexport_new(HexEditorExportFormat format, int fd,
+		off_t offset, off_t size, int out)
+{
+	HexEditorExport * export;
+
+	if((export = _new_export(format, offset, size, out)) == NULL)
+		return NULL;
+	export->fd = fd;
+	export->copy = 1;
+#ifdef POSIX_FADV_SEQUENTIAL
+	/* this is only a hint, errors are not relevant */
+	posix_fadvise(fd, offset, size, POSIX_FADV_SEQUENTIAL);
+#endif
+	return export;
+}
+
+static HexEditorExport * _new_export(HexEditorExportFormat format,
+		off_t offset, off_t size, int out)
+{
+	HexEditorExport * export;
+
+	if(format > HEEF_LAST || offset < 0 || size < 0)
+	{
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	/* the addresses of these formats are limited to 32 bits */
+	if((format == HEEF_IHEX || format == HEEF_SREC)
+			&& (uint64_t)offset + size > 0x100000000ULL)
+	{
+		error_set_code(1, "%s", strerror(EOVERFLOW));
+		return NULL;
+	}
+	pthread_once(&_hexeditorexport_once, _hexeditorexport_init);
+	if((export = object_new(sizeof(*export))) == NULL)
+		return NULL;
+	export->format = format;
+	export->fd = -1;
+	export->reader = NULL;
+	export->reader_data = NULL;
+	export->offset = offset;
+	export->size = size;
+	export->position = 0;
+	export->out = out;
+	export->started = 0;
+	export->copy = 0;
+	export->line_cnt = 0;
+	export->buf_cnt = 0;
+	export->segment = 0;
+	export->in = malloc(HEXEDITOREXPORT_CHUNK_SIZE);
+	export->buf = malloc(HEXEDITOREXPORT_BUFFER_SIZE);
+	if(export->in == NULL || export->buf == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		hexeditorexport_delete(export);
+		return NULL;
+	}
+	return export;
+}
+
+
+/* hexeditorexport_new_reader */
+HexEditorExport * hexeditorexport_new_reader(HexEditorExportFormat format,
+		HexEditorBufferReader reader, void * data, off_t offset,
+		off_t size, int out)
+{
+	HexEditorExport * export;
+
+	if((export = _new_export(format, offset, size, out)) == NULL)
+		return NULL;
+	export->reader = reader;
+	export->reader_data = data;
+	return export;
+}
+
+
+/* hexeditorexport_delete */
+void hexeditorexport_delete(HexEditorExport * export)
+{
+	free(export->buf);
+	free(export->in);
+	object_delete(export);
+}
+
+
+/* accessors */
+/* hexeditorexport_get_position */
+off_t hexeditorexport_get_position(HexEditorExport * export)
+{
+	return export->position;
+}
+
+
+/* hexeditorexport_get_size */
+off_t hexeditorexport_get_size(HexEditorExport * export)
+{
+	return export->size;
+}
+
+
+/* useful */
+/* hexeditorexport_step */
+int hexeditorexport_step(HexEditorExport * export)
+{
+	off_t offset = export->offset + export->position;
+	size_t size;
+	ssize_t len;
+
+	if(!export->started)
+	{
+		export->started = 1;
+		if(_hexeditorexport_header(export) != 0)
+			return -1;
+	}
+	if(export->position == export->size)
+		return (_hexeditorexport_footer(export) == 0) ? 0 : -1;
+	if(export->format == HEEF_RAW && export->fd >= 0)
+		return _hexeditorexport_step_raw(export);
+	size = (export->size - export->position < HEXEDITOREXPORT_CHUNK_SIZE)
+		? export->size - export->position : HEXEDITOREXPORT_CHUNK_SIZE;
+	if(export->reader != NULL)
+		len = export->reader(export->reader_data, export->in, size,
+				offset);
+	else
+		while((len = pread(export->fd, export->in, size, offset)) < 0
+				&& errno == EINTR);
+	if(len < 0)
+		return -error_set_code(1, "%s", strerror(errno));
+	if(len == 0)
+	{
+		/* the file ends before the range */
+		export->size = export->position;
+		return 1;
+	}
+	if(export->format == HEEF_RAW)
+	{
+		if(_hexeditorexport_write(export, (char const *)export->in, len)
+				!= 0)
+			return -1;
+	}
+	else if(_hexeditorexport_encode(export, export->in, len) != 0)
+		return -1;
+	export->position += len;
+	return 1;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorexport_init */
+static void _hexeditorexport_init(void)
+{
+	char const hex[] = "0123456789abcdef";
+	char const upper[] = "0123456789ABCDEF";
+	char const base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t i;
+
+	for(i = 0; i < 256; i++)
+	{
+		_hexeditorexport_hex[i][0] = hex[i >> 4];
+		_hexeditorexport_hex[i][1] = hex[i & 0xf];
+		_hexeditorexport_hex_upper[i][0] = upper[i >> 4];
+		_hexeditorexport_hex_upper[i][1] = upper[i & 0xf];
+	}
+	for(i = 0; i < 4096; i++)
+	{
+		_hexeditorexport_base64[i][0] = base64[i >> 6];
+		_hexeditorexport_base64[i][1] = base64[i & 0x3f];
+	}
+}
+
+
+/* hexeditorexport_encode */
+static int _hexeditorexport_encode(HexEditorExport * export,
+		unsigned char const * buf, size_t size)
+{
+	size_t line = _hexeditorexport_lines[export->format];
+	off_t offset = export->offset + export->position - export->line_cnt;
+	size_t i;
+
+	/* complete the line left over from the previous chunk */
+	if(export->line_cnt > 0)
+	{
+		i = line - export->line_cnt;
+		i = (i < size) ? i : size;
+		memcpy(&export->line[export->line_cnt], buf, i);
+		export->line_cnt += i;
+		buf += i;
+		size -= i;
+		if(export->line_cnt < line)
+			return 0;
+		if(_hexeditorexport_line(export, offset, export->line, line)
+				!= 0)
+			return -1;
+		export->line_cnt = 0;
+		offset += line;
+	}
+	for(; size >= line; buf += line, size -= line, offset += line)
+		if(_hexeditorexport_line(export, offset, buf, line) != 0)
+			return -1;
+	memcpy(export->line, buf, size);
+	export->line_cnt = size;
+	return 0;
+}
+
+
+/* hexeditorexport_flush */
+static int _hexeditorexport_flush(HexEditorExport * export)
+{
+	size_t i;
+	ssize_t len;
+
+	for(i = 0; i < export->buf_cnt; i += len)
+		if((len = write(export->out, &export->buf[i],
+						export->buf_cnt - i)) < 0)
+		{
+			if(errno == EINTR)
+				len = 0;
+			else
+				return -error_set_code(1, "%s",
+						strerror(errno));
+		}
+	export->buf_cnt = 0;
+	return 0;
+}
+
+
+/* hexeditorexport_footer */
+static int _hexeditorexport_footer(HexEditorExport * export)
+{
+	char buf[64];
+	off_t offset = export->offset + export->position - export->line_cnt;
+
+	if(export->line_cnt > 0 && _hexeditorexport_line(export, offset,
+				export->line, export->line_cnt) != 0)
+		return -1;
+	export->line_cnt = 0;
+	switch(export->format)
+	{
+		case HEEF_C:
+			snprintf(buf, sizeof(buf), "\n};\nunsigned int data_len"
+					" = %llu;\n",
+					(unsigned long long)export->size);
+			break;
+		case HEEF_PYTHON:
+			snprintf(buf, sizeof(buf), "\n])\n");
+			break;
+		case HEEF_IHEX:
+			snprintf(buf, sizeof(buf), ":00000001FF\n");
+			break;
+		case HEEF_SREC:
+			snprintf(buf, sizeof(buf), "S70500000000FA\n");
+			break;
+		default:
+			buf[0] = '\0';
+			break;
+	}
+	if(_hexeditorexport_write(export, buf, strlen(buf)) != 0)
+		return -1;
+	return _hexeditorexport_flush(export);
+}
+
+
+/* hexeditorexport_header */
+static int _hexeditorexport_header(HexEditorExport * export)
+{
+	char const * header;
+
+	switch(export->format)
+	{
+		case HEEF_C:
+			header = "unsigned char data[] = {\n";
+			break;
+		case HEEF_PYTHON:
+			header = "data = bytes([\n";
+			break;
+		case HEEF_SREC:
+			header = "S0030000FC\n";
+			break;
+		default:
+			return 0;
+	}
+	return _hexeditorexport_write(export, header, strlen(header));
+}
+
+
+/* hexeditorexport_line */
+static size_t _line_array(char * p, int first, unsigned char const * buf,
+		size_t size, char const * indent);
+static size_t _line_base64(char * p, unsigned char const * buf, size_t size);
+static size_t _line_ihex(HexEditorExport * export, char * p, uint32_t address,
+		unsigned char const * buf, size_t size);
+static size_t _line_number(char * p, uint64_t value, size_t digits,
+		char const table[256][2]);
+static size_t _line_srec(char * p, uint32_t address,
+		unsigned char const * buf, size_t size);
+static size_t _line_xxd(char * p, off_t offset, unsigned char const * buf,
+		size_t size);
+
+static int _hexeditorexport_line(HexEditorExport * export, off_t offset,
+		unsigned char const * buf, size_t size)
+{
+	char * p;
+
+	if(export->buf_cnt + HEXEDITOREXPORT_TEXT_MAX
+			> HEXEDITOREXPORT_BUFFER_SIZE
+			&& _hexeditorexport_flush(export) != 0)
+		return -1;
+	p = &export->buf[export->buf_cnt];
+	switch(export->format)
+	{
+		case HEEF_C:
+			export->buf_cnt += _line_array(p,
+					offset == export->offset, buf, size,
+					"  ");
+			break;
+		case HEEF_PYTHON:
+			export->buf_cnt += _line_array(p,
+					offset == export->offset, buf, size,
+					"    ");
+			break;
+		case HEEF_BASE64:
+			export->buf_cnt += _line_base64(p, buf, size);
+			break;
+		case HEEF_IHEX:
+			export->buf_cnt += _line_ihex(export, p, offset, buf,
+					size);
+			break;
+		case HEEF_SREC:
+			export->buf_cnt += _line_srec(p, offset, buf, size);
+			break;
+		case HEEF_XXD:
+			export->buf_cnt += _line_xxd(p, offset, buf, size);
+			break;
+		default:
+			break;
+	}
+	return 0;
+}
+
+static size_t _line_array(char * p, int first, unsigned char const * buf,
+		size_t size, char const * indent)
+{
+	char * q = p;
+	size_t i;
+
+	/* separates from the previous line, as the last one ends the array */
+	if(!first)
+	{
+		*(q++) = ',';
+		*(q++) = '\n';
+	}
+	for(i = 0; i < size; i++)
+	{
+		if(i == 0)
+		{
+			memcpy(q, indent, strlen(indent));
+			q += strlen(indent);
+		}
+		else
+		{
+			*(q++) = ',';
+			*(q++) = ' ';
+		}
+		*(q++) = '0';
+		*(q++) = 'x';
+		memcpy(q, _hexeditorexport_hex[buf[i]], 2);
+		q += 2;
+	}
+	return q - p;
+}
+
+static size_t _line_base64(char * p, unsigned char const * buf, size_t size)
+{
+	char * q = p;
+	uint32_t v;
+
+	/* 3 bytes at once, as two lookups of 12 bits */
+	for(; size >= 3; buf += 3, size -= 3)
+	{
+		v = (buf[0] << 16) | (buf[1] << 8) | buf[2];
+		memcpy(q, _hexeditorexport_base64[v >> 12], 2);
+		memcpy(q + 2, _hexeditorexport_base64[v & 0xfff], 2);
+		q += 4;
+	}
+	/* the last line may need padding */
+	if(size > 0)
+	{
+		v = (buf[0] << 16) | ((size > 1) ? (buf[1] << 8) : 0);
+		memcpy(q, _hexeditorexport_base64[v >> 12], 2);
+		memcpy(q + 2, _hexeditorexport_base64[v & 0xfff], 2);
+		q[3] = '=';
+		if(size == 1)
+			q[2] = '=';
+		q += 4;
+	}
+	*(q++) = '\n';
+	return q - p;
+}
+
+static size_t _line_ihex(HexEditorExport * export, char * p, uint32_t address,
+		unsigned char const * buf, size_t size)
+{
+	char * q = p;
+	size_t i;
+	size_t cnt;
+	unsigned char sum;
+
+	for(; size > 0; address += cnt, buf += cnt, size -= cnt)
+	{
+		/* the records may not cross a segment */
+		if((address >> 16) != export->segment)
+		{
+			export->segment = address >> 16;
+			sum = 2 + 4 + (export->segment >> 8)
+				+ (export->segment & 0xff);
+			memcpy(q, ":02000004", 9);
+			q += 9 + _line_number(q + 9, export->segment, 4,
+					_hexeditorexport_hex_upper);
+			q += _line_number(q, (-sum) & 0xff, 2,
+					_hexeditorexport_hex_upper);
+			*(q++) = '\n';
+		}
+		cnt = 0x10000 - (address & 0xffff);
+		cnt = (cnt < size) ? cnt : size;
+		sum = cnt + (address >> 8) + address;
+		*(q++) = ':';
+		q += _line_number(q, cnt, 2, _hexeditorexport_hex_upper);
+		q += _line_number(q, address & 0xffff, 4,
+				_hexeditorexport_hex_upper);
+		*(q++) = '0';
+		*(q++) = '0';
+		for(i = 0; i < cnt; i++)
+		{
+			sum += buf[i];
+			memcpy(q, _hexeditorexport_hex_upper[buf[i]], 2);
+			q += 2;
+		}
+		memcpy(q, _hexeditorexport_hex_upper[(-sum) & 0xff], 2);
+		q += 2;
+		*(q++) = '\n';
+	}
+	return q - p;
+}
+
+static size_t _line_number(char * p, uint64_t value, size_t digits,
+		char const table[256][2])
+{
+	size_t i;
+
+	/* the most significant digit first */
+	for(i = digits; i > 0; i--, value >>= 4)
+		p[i - 1] = table[value & 0xf][1];
+	return digits;
+}
+
+static size_t _line_srec(char * p, uint32_t address,
+		unsigned char const * buf, size_t size)
+{
+	char * q = p;
+	size_t i;
+	unsigned char sum;
+
+	/* the address, then the checksum */
+	sum = (size + 5) + (address >> 24) + (address >> 16) + (address >> 8)
+		+ address;
+	*(q++) = 'S';
+	*(q++) = '3';
+	q += _line_number(q, size + 5, 2, _hexeditorexport_hex_upper);
+	q += _line_number(q, address, 8, _hexeditorexport_hex_upper);
+	for(i = 0; i < size; i++)
+	{
+		sum += buf[i];
+		memcpy(q, _hexeditorexport_hex_upper[buf[i]], 2);
+		q += 2;
+	}
+	memcpy(q, _hexeditorexport_hex_upper[(~sum) & 0xff], 2);
+	q += 2;
+	*(q++) = '\n';
+	return q - p;
+}
+
+static size_t _line_xxd(char * p, off_t offset, unsigned char const * buf,
+		size_t size)
+{
+	char * q = p;
+	size_t i;
+
+	/* as output by xxd(1), padded up to the characters */
+	for(i = 8; i < 16 && (offset >> (i * 4)) != 0; i++);
+	q += _line_number(q, offset, i, _hexeditorexport_hex);
+	*(q++) = ':';
+	for(i = 0; i < 16; i++)
+	{
+		if((i & 1) == 0)
+			*(q++) = ' ';
+		if(i < size)
+			memcpy(q, _hexeditorexport_hex[buf[i]], 2);
+		else
+			memset(q, ' ', 2);
+		q += 2;
+	}
+	*(q++) = ' ';
+	*(q++) = ' ';
+	for(i = 0; i < size; i++)
+		*(q++) = (buf[i] >= 0x20 && buf[i] < 0x7f) ? buf[i] : '.';
+	*(q++) = '\n';
+	return q - p;
+}
+
+
+/* hexeditorexport_step_raw */
+static int _hexeditorexport_step_raw(HexEditorExport * export)
+{
+	off_t offset = export->offset + export->position;
+	size_t size;
+	ssize_t len;
+
+	size = (export->size - export->position < HEXEDITOREXPORT_CHUNK_SIZE)
+		? export->size - export->position : HEXEDITOREXPORT_CHUNK_SIZE;
+#ifdef __linux__
+	/* let the kernel copy the data, without reading it here */
+	if(export->copy)
+	{
+		if((len = copy_file_range(export->fd, &offset, export->out,
+						NULL, size, 0)) >= 0)
+		{
+			if(len == 0)
+				/* the file ends before the range */
+				export->size = export->position;
+			export->position += len;
+			return 1;
+		}
+		if(errno != EXDEV && errno != EINVAL && errno != ENOSYS
+				&& errno != EOPNOTSUPP && errno != EBADF)
+			return -error_set_code(1, "%s", strerror(errno));
+		/* not supported here, fall back to reading */
+		export->copy = 0;
+	}
+#endif
+	while((len = pread(export->fd, export->in, size, offset)) < 0
+			&& errno == EINTR);
+	if(len < 0)
+		return -error_set_code(1, "%s", strerror(errno));
+	if(len == 0)
+		export->size = export->position;
+	else if(_hexeditorexport_write(export, (char const *)export->in, len)
+			!= 0)
+		return -1;
+	export->position += len;
+	return 1;
+}
+
+
+/* hexeditorexport_write */
+static int _hexeditorexport_write(HexEditorExport * export, char const * buf,
+		size_t size)
+{
+	size_t i;
+
+	for(; size > 0; buf += i, size -= i)
+	{
+		if(export->buf_cnt == HEXEDITOREXPORT_BUFFER_SIZE
+				&& _hexeditorexport_flush(export) != 0)
+			return -1;
+		i = HEXEDITOREXPORT_BUFFER_SIZE - export->buf_cnt;
+		i = (i < size) ? i : size;
+		memcpy(&export->buf[export->buf_cnt], buf, i);
+		export->buf_cnt += i;
+	}
+	return 0;
+}
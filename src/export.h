@@ -0,0 +1,64 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_EXPORT_H
+# define HEXEDITOR_EXPORT_H
+
+# include <sys/types.h>
+# include "buffer.h"
+
+
+/* HexEditorExport */
+/* public */
+/* types */
+typedef struct _HexEditorExport HexEditorExport;
+
+typedef enum _HexEditorExportFormat
+{
+	HEEF_RAW = 0,
+	HEEF_C,
+	HEEF_PYTHON,
+	HEEF_BASE64,
+	HEEF_IHEX,
+	HEEF_SREC,
+	HEEF_XXD
+} HexEditorExportFormat;
+# define HEEF_LAST	HEEF_XXD
+# define HEEF_COUNT	(HEEF_LAST + 1)
+
+
+/* constants */
+/* read at once, the memory used does not depend on the size exported */
+# define HEXEDITOREXPORT_CHUNK_SIZE	(1024 * 1024)
+
+
+/* functions */
+HexEditorExport * hexeditorexport_new(HexEditorExportFormat format, int fd,
+		off_t offset, off_t size, int out);
+HexEditorExport * hexeditorexport_new_reader(HexEditorExportFormat format,
+		HexEditorBufferReader reader, void * data, off_t offset,
+		off_t size, int out);
+void hexeditorexport_delete(HexEditorExport * export);
+
+/* accessors */
+off_t hexeditorexport_get_position(HexEditorExport * export);
+off_t hexeditorexport_get_size(HexEditorExport * export);
+
+/* useful */
+int hexeditorexport_step(HexEditorExport * export);
+
+#endif /* !HEXEDITOR_EXPORT_H */
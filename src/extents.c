@@ -0,0 +1,693 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE /* for SEEK_DATA and SEEK_HOLE */
+#endif
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+#include <System.h>
+#include "extents.h"
+
+
+/* HexEditorExtents */
+/* private */
+/* types */
+typedef struct _HexEditorExtent
+{
+	off_t offset;
+	off_t size;
+	HexEditorExtentsType type;
+	/* the first row displaying it */
+	off_t row;
+} HexEditorExtent;
+
+struct _HexEditorExtents
+{
+	HexEditorExtent * extents;
+	size_t extents_cnt;
+	size_t extents_alloc;
+	size_t holes;
+	off_t size;
+	off_t granularity;
+	off_t row_size;
+	/* the rows are numbered again from this extent on */
+	size_t dirty;
+
+	/* detection of the runs */
+	off_t scan_offset;
+	unsigned char * scan_last;
+	unsigned char * scan_part;
+	size_t scan_part_cnt;
+	int scan_last_valid;
+	off_t run_offset;
+	off_t run_rows;
+};
+
+
+/* prototypes */
+static int _hexeditorextents_append(HexEditorExtents * extents, off_t offset,
+		off_t size, HexEditorExtentsType type);
+static size_t _hexeditorextents_equal(unsigned char const * a,
+		unsigned char const * b, size_t size);
+static HexEditorExtent * _hexeditorextents_find(HexEditorExtents * extents,
+		off_t offset);
+static size_t _hexeditorextents_find_row(HexEditorExtents * extents,
+		off_t row);
+static int _hexeditorextents_insert(HexEditorExtents * extents, off_t offset,
+		off_t size, HexEditorExtentsType type);
+static void _hexeditorextents_number(HexEditorExtents * extents);
+static int _hexeditorextents_reserve(HexEditorExtents * extents, size_t cnt);
+static off_t _hexeditorextents_rows(HexEditorExtents * extents,
+		HexEditorExtent * extent);
+static int _hexeditorextents_scan_end(HexEditorExtents * extents);
+static int _hexeditorextents_scan_rows(HexEditorExtents * extents,
+		off_t offset, unsigned char const * buf, size_t rows);
+
+
+/* public */
+/* functions */
+/* hexeditorextents_new */
+static int _new_enumerate(HexEditorExtents * extents, int fd);
+
+HexEditorExtents * hexeditorextents_new(int fd, off_t size, off_t granularity,
+		off_t row_size)
+{
+	HexEditorExtents * extents;
+	off_t pos = -1;
+
+	if((extents = object_new(sizeof(*extents))) == NULL)
+		return NULL;
+	extents->extents = NULL;
+	extents->extents_cnt = 0;
+	extents->extents_alloc = 0;
+	extents->holes = 0;
+	extents->size = size;
+	extents->granularity = granularity;
+	extents->row_size = row_size;
+	extents->dirty = 0;
+	extents->scan_offset = 0;
+	extents->scan_last = malloc(row_size * 2);
+	extents->scan_part = extents->scan_last + row_size;
+	extents->scan_part_cnt = 0;
+	extents->scan_last_valid = 0;
+	extents->run_offset = 0;
+	extents->run_rows = 0;
+	if(extents->scan_last == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		hexeditorextents_delete(extents);
+		return NULL;
+	}
+	/* without a file descriptor, there are no holes */
+	if(fd < 0)
+	{
+		if(_hexeditorextents_append(extents, 0, size, HEET_DATA) != 0)
+		{
+			hexeditorextents_delete(extents);
+			return NULL;
+		}
+		return extents;
+	}
+	/* the position of the file is shared with the scan */
+	if((pos = lseek(fd, 0, SEEK_CUR)) < 0
+			|| _new_enumerate(extents, fd) != 0
+			|| lseek(fd, pos, SEEK_SET) != pos)
+	{
+		if(pos >= 0)
+			lseek(fd, pos, SEEK_SET);
+		hexeditorextents_delete(extents);
+		return NULL;
+	}
+	return extents;
+}
+
+static int _new_enumerate(HexEditorExtents * extents, int fd)
+{
+	const off_t size = extents->size;
+	const off_t g = extents->granularity;
+	off_t offset;
+	off_t data;
+	off_t hole;
+	off_t from;
+	off_t to;
+
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	for(offset = 0; offset < size; offset = hole)
+	{
+		if((data = lseek(fd, offset, SEEK_DATA)) < 0 && errno == ENXIO)
+			/* only a hole until the end */
+			data = size;
+		else if(data < 0)
+			return -error_set_code(1, "%s", strerror(errno));
+		data = (data < size) ? data : size;
+		if(data > offset)
+		{
+			/* only the aligned part of the hole is collapsed */
+			from = ((offset + g - 1) / g) * g;
+			to = (data == size) ? size : (data / g) * g;
+			if(from < to)
+			{
+				if(_hexeditorextents_append(extents, offset,
+							from - offset,
+							HEET_DATA) != 0
+						|| _hexeditorextents_append(
+							extents, from,
+							to - from, HEET_HOLE)
+						!= 0)
+					return -1;
+				offset = to;
+			}
+			if(_hexeditorextents_append(extents, offset,
+						data - offset, HEET_DATA) != 0)
+				return -1;
+		}
+		if(data == size)
+			break;
+		if((hole = lseek(fd, data, SEEK_HOLE)) < 0)
+			return -error_set_code(1, "%s", strerror(errno));
+		hole = (hole < size) ? hole : size;
+		if(_hexeditorextents_append(extents, data, hole - data,
+					HEET_DATA) != 0)
+			return -1;
+	}
+	return 0;
+#else
+	return -error_set_code(1, "%s", strerror(ENOTSUP));
+#endif
+}
+
+
+/* hexeditorextents_delete */
+void hexeditorextents_delete(HexEditorExtents * extents)
+{
+	free(extents->scan_last);
+	free(extents->extents);
+	object_delete(extents);
+}
+
+
+/* accessors */
+/* hexeditorextents_get_end */
+off_t hexeditorextents_get_end(HexEditorExtents * extents, off_t offset,
+		int * hole)
+{
+	HexEditorExtent * e;
+
+	if((e = _hexeditorextents_find(extents, offset)) == NULL)
+	{
+		/* past the end, as enumerated */
+		*hole = 0;
+		return offset;
+	}
+	if((*hole = (e->type == HEET_HOLE) ? 1 : 0) == 0)
+		/* the runs are data as well */
+		for(; e + 1 < &extents->extents[extents->extents_cnt]
+				&& e[1].type != HEET_HOLE; e++);
+	return e->offset + e->size;
+}
+
+
+/* hexeditorextents_get_holes */
+size_t hexeditorextents_get_holes(HexEditorExtents * extents)
+{
+	return extents->holes;
+}
+
+
+/* hexeditorextents_get_rows */
+off_t hexeditorextents_get_rows(HexEditorExtents * extents)
+{
+	HexEditorExtent * e;
+
+	if(extents->extents_cnt == 0)
+		return 0;
+	_hexeditorextents_number(extents);
+	e = &extents->extents[extents->extents_cnt - 1];
+	return e->row + _hexeditorextents_rows(extents, e);
+}
+
+
+/* hexeditorextents_set_size */
+void hexeditorextents_set_size(HexEditorExtents * extents, off_t size)
+{
+	HexEditorExtent * e;
+	off_t end;
+
+	/* truncated */
+	while(extents->extents_cnt > 0 && (e = &extents->extents[
+				extents->extents_cnt - 1])->offset >= size)
+	{
+		if(e->type == HEET_HOLE)
+			extents->holes--;
+		extents->extents_cnt--;
+	}
+	if(extents->extents_cnt > 0)
+	{
+		e = &extents->extents[extents->extents_cnt - 1];
+		if((end = e->offset + e->size) > size)
+			e->size = size - e->offset;
+		else if(end < size)
+			/* grown, as data */
+			_hexeditorextents_append(extents, end, size - end,
+					HEET_DATA);
+	}
+	else
+		_hexeditorextents_append(extents, 0, size, HEET_DATA);
+	extents->size = size;
+	if(extents->dirty >= extents->extents_cnt)
+		extents->dirty = (extents->extents_cnt > 0)
+			? extents->extents_cnt - 1 : 0;
+}
+
+
+/* useful */
+/* hexeditorextents_add_hole */
+int hexeditorextents_add_hole(HexEditorExtents * extents, off_t offset,
+		off_t size)
+{
+	const off_t g = extents->granularity;
+	off_t from;
+	off_t to;
+
+	/* only the aligned part of the hole is collapsed */
+	from = ((offset + g - 1) / g) * g;
+	to = (offset + size >= extents->size) ? extents->size
+		: ((offset + size) / g) * g;
+	if(from >= to)
+		return 0;
+	return _hexeditorextents_insert(extents, from, to - from, HEET_HOLE);
+}
+
+
+/* hexeditorextents_copy_runs */
+int hexeditorextents_copy_runs(HexEditorExtents * extents,
+		HexEditorExtents * from)
+{
+	size_t i;
+	HexEditorExtent * e;
+
+	if(extents->row_size != from->row_size)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	for(i = 0; i < from->extents_cnt; i++)
+		if((e = &from->extents[i])->type == HEET_RUN
+				&& _hexeditorextents_insert(extents,
+					e->offset, e->size, HEET_RUN) != 0)
+			return -1;
+	/* the scan goes on */
+	extents->scan_offset = from->scan_offset;
+	memcpy(extents->scan_last, from->scan_last, from->row_size * 2);
+	extents->scan_part_cnt = from->scan_part_cnt;
+	extents->scan_last_valid = from->scan_last_valid;
+	extents->run_offset = from->run_offset;
+	extents->run_rows = from->run_rows;
+	return 0;
+}
+
+
+/* hexeditorextents_expand */
+int hexeditorextents_expand(HexEditorExtents * extents, off_t row)
+{
+	size_t i;
+
+	if(row < 0 || row >= hexeditorextents_get_rows(extents))
+		return -1;
+	i = _hexeditorextents_find_row(extents, row);
+	if(extents->extents[i].type != HEET_RUN)
+		return -1;
+	/* every row is displayed again */
+	extents->extents[i].type = HEET_DATA;
+	extents->dirty = (extents->dirty < i) ? extents->dirty : i;
+	return 0;
+}
+
+
+/* hexeditorextents_offset_to_row */
+off_t hexeditorextents_offset_to_row(HexEditorExtents * extents,
+		off_t offset)
+{
+	HexEditorExtent * e;
+
+	if((e = _hexeditorextents_find(extents, offset)) == NULL)
+		return hexeditorextents_get_rows(extents);
+	_hexeditorextents_number(extents);
+	if(e->type != HEET_DATA)
+		return e->row;
+	return e->row + (offset - e->offset) / extents->row_size;
+}
+
+
+/* hexeditorextents_row_to_offset */
+off_t hexeditorextents_row_to_offset(HexEditorExtents * extents, off_t row,
+		off_t * rows, off_t * collapsed, HexEditorExtentsType * type)
+{
+	HexEditorExtent * e;
+
+	if(row < 0 || row >= hexeditorextents_get_rows(extents))
+		return -1;
+	e = &extents->extents[_hexeditorextents_find_row(extents, row)];
+	*type = e->type;
+	if(e->type != HEET_DATA)
+	{
+		/* a single row for the whole extent */
+		*rows = 1;
+		*collapsed = e->size;
+		return e->offset;
+	}
+	*rows = _hexeditorextents_rows(extents, e) - (row - e->row);
+	*collapsed = 0;
+	return e->offset + (row - e->row) * extents->row_size;
+}
+
+
+/* hexeditorextents_scan */
+int hexeditorextents_scan(HexEditorExtents * extents, off_t offset,
+		void const * buf, size_t size)
+{
+	const size_t r = extents->row_size;
+	unsigned char const * p = buf;
+	int ret = 0;
+	size_t n;
+
+	/* the runs span neither holes nor the end of the scan */
+	if(buf == NULL || offset != extents->scan_offset)
+	{
+		ret = _hexeditorextents_scan_end(extents);
+		extents->scan_part_cnt = 0;
+		extents->scan_last_valid = 0;
+	}
+	if(buf == NULL)
+		return ret;
+	extents->scan_offset = offset + size;
+	/* the rows are aligned */
+	if(extents->scan_part_cnt == 0 && (n = offset % r) != 0)
+	{
+		n = (r - n < size) ? r - n : size;
+		p += n;
+		size -= n;
+		offset += n;
+	}
+	/* complete the partial row */
+	if(extents->scan_part_cnt > 0)
+	{
+		n = r - extents->scan_part_cnt;
+		n = (n < size) ? n : size;
+		memcpy(&extents->scan_part[extents->scan_part_cnt], p, n);
+		p += n;
+		size -= n;
+		offset += n;
+		if((extents->scan_part_cnt += n) < r)
+			return ret;
+		extents->scan_part_cnt = 0;
+		ret += _hexeditorextents_scan_rows(extents, offset - r,
+				extents->scan_part, 1);
+	}
+	if((n = size / r) > 0)
+		ret += _hexeditorextents_scan_rows(extents, offset, p, n);
+	/* keep the partial row */
+	extents->scan_part_cnt = size - n * r;
+	memcpy(extents->scan_part, &p[n * r], extents->scan_part_cnt);
+	return ret;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorextents_append */
+static int _hexeditorextents_append(HexEditorExtents * extents, off_t offset,
+		off_t size, HexEditorExtentsType type)
+{
+	HexEditorExtent * p;
+
+	if(size <= 0)
+		return 0;
+	/* contiguous data is merged */
+	if(extents->extents_cnt > 0 && type == HEET_DATA
+			&& extents->extents[extents->extents_cnt - 1].type
+			== HEET_DATA)
+	{
+		extents->extents[extents->extents_cnt - 1].size += size;
+		return 0;
+	}
+	if(_hexeditorextents_reserve(extents, 1) != 0)
+		return -1;
+	p = &extents->extents[extents->extents_cnt++];
+	p->offset = offset;
+	p->size = size;
+	p->type = type;
+	p->row = 0;
+	if(type == HEET_HOLE)
+		extents->holes++;
+	return 0;
+}
+
+
+/* hexeditorextents_equal */
+static size_t _hexeditorextents_equal(unsigned char const * a,
+		unsigned char const * b, size_t size)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	__m128i x;
+	__m128i y;
+
+	/* sixteen bytes at a time */
+	for(; i + sizeof(x) <= size; i += sizeof(x))
+	{
+		x = _mm_loadu_si128((__m128i const *)&a[i]);
+		y = _mm_loadu_si128((__m128i const *)&b[i]);
+		if(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff)
+			break;
+	}
+#else
+	uint64_t x;
+	uint64_t y;
+
+	/* a word at a time */
+	for(; i + sizeof(x) <= size; i += sizeof(x))
+	{
+		memcpy(&x, &a[i], sizeof(x));
+		memcpy(&y, &b[i], sizeof(y));
+		if(x != y)
+			break;
+	}
+#endif
+	/* the first difference */
+	for(; i < size && a[i] == b[i]; i++);
+	return i;
+}
+
+
+/* hexeditorextents_find */
+static HexEditorExtent * _hexeditorextents_find(HexEditorExtents * extents,
+		off_t offset)
+{
+	size_t low = 0;
+	size_t high = extents->extents_cnt;
+	size_t mid;
+
+	while(low < high)
+	{
+		mid = low + (high - low) / 2;
+		if(offset < extents->extents[mid].offset)
+			high = mid;
+		else if(offset >= extents->extents[mid].offset
+				+ extents->extents[mid].size)
+			low = mid + 1;
+		else
+			return &extents->extents[mid];
+	}
+	return NULL;
+}
+
+
+/* hexeditorextents_find_row */
+static size_t _hexeditorextents_find_row(HexEditorExtents * extents,
+		off_t row)
+{
+	size_t low = 0;
+	size_t high = extents->extents_cnt;
+	size_t mid;
+
+	_hexeditorextents_number(extents);
+	/* the last extent starting at this row or before */
+	while(high - low > 1)
+	{
+		mid = low + (high - low) / 2;
+		if(extents->extents[mid].row <= row)
+			low = mid;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+
+/* hexeditorextents_insert */
+static int _hexeditorextents_insert(HexEditorExtents * extents, off_t offset,
+		off_t size, HexEditorExtentsType type)
+{
+	HexEditorExtent * e;
+	HexEditorExtent data;
+	size_t i;
+	size_t cnt;
+
+	/* only carved out of data */
+	if((e = _hexeditorextents_find(extents, offset)) == NULL
+			|| e->type != HEET_DATA
+			|| offset + size > e->offset + e->size)
+		return 0;
+	data = *e;
+	i = e - extents->extents;
+	cnt = ((data.offset < offset) ? 1 : 0)
+		+ ((offset + size < data.offset + data.size) ? 1 : 0);
+	if(_hexeditorextents_reserve(extents, cnt) != 0)
+		return -1;
+	memmove(&extents->extents[i + 1 + cnt], &extents->extents[i + 1],
+			sizeof(*e) * (extents->extents_cnt - i - 1));
+	extents->extents_cnt += cnt;
+	extents->dirty = (extents->dirty < i) ? extents->dirty : i;
+	e = &extents->extents[i];
+	if(data.offset < offset)
+	{
+		e->size = offset - data.offset;
+		e++;
+	}
+	e->offset = offset;
+	e->size = size;
+	e->type = type;
+	if(offset + size < data.offset + data.size)
+	{
+		e++;
+		e->offset = offset + size;
+		e->size = data.offset + data.size - offset - size;
+		e->type = HEET_DATA;
+	}
+	if(type == HEET_HOLE)
+		extents->holes++;
+	return 0;
+}
+
+
+/* hexeditorextents_number */
+static void _hexeditorextents_number(HexEditorExtents * extents)
+{
+	HexEditorExtent * e;
+	size_t i;
+
+	for(i = extents->dirty; i < extents->extents_cnt; i++)
+	{
+		e = &extents->extents[i];
+		e->row = (i == 0) ? 0 : e[-1].row
+			+ _hexeditorextents_rows(extents, &e[-1]);
+	}
+	extents->dirty = extents->extents_cnt;
+}
+
+
+/* hexeditorextents_reserve */
+static int _hexeditorextents_reserve(HexEditorExtents * extents, size_t cnt)
+{
+	HexEditorExtent * p;
+	size_t alloc;
+
+	if(extents->extents_cnt + cnt <= extents->extents_alloc)
+		return 0;
+	/* there may be as many runs as rows */
+	for(alloc = (extents->extents_alloc > 0) ? extents->extents_alloc
+			: 0x100; alloc < extents->extents_cnt + cnt;
+			alloc *= 2);
+	if((p = realloc(extents->extents, sizeof(*p) * alloc)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	extents->extents = p;
+	extents->extents_alloc = alloc;
+	return 0;
+}
+
+
+/* hexeditorextents_rows */
+static off_t _hexeditorextents_rows(HexEditorExtents * extents,
+		HexEditorExtent * extent)
+{
+	/* a single row stands for every hole or run */
+	if(extent->type != HEET_DATA)
+		return 1;
+	return (extent->size + extents->row_size - 1) / extents->row_size;
+}
+
+
+/* hexeditorextents_scan_end */
+static int _hexeditorextents_scan_end(HexEditorExtents * extents)
+{
+	off_t rows = extents->run_rows;
+
+	extents->run_rows = 0;
+	/* the runs are only a convenience */
+	if(rows < HEXEDITOREXTENTS_RUN_ROWS
+			|| _hexeditorextents_insert(extents,
+				extents->run_offset,
+				rows * extents->row_size, HEET_RUN) != 0)
+		return 0;
+	return 1;
+}
+
+
+/* hexeditorextents_scan_rows */
+static int _hexeditorextents_scan_rows(HexEditorExtents * extents,
+		off_t offset, unsigned char const * buf, size_t rows)
+{
+	const size_t r = extents->row_size;
+	int ret = 0;
+	size_t i;
+	size_t n;
+
+	/* the first row against the last one scanned */
+	if(extents->scan_last_valid
+			&& _hexeditorextents_equal(buf, extents->scan_last, r)
+			== r)
+	{
+		if(extents->run_rows++ == 0)
+			extents->run_offset = offset;
+	}
+	else
+		ret += _hexeditorextents_scan_end(extents);
+	for(i = 1; i < rows;)
+	{
+		/* every row against the one before, at once */
+		if((n = _hexeditorextents_equal(&buf[i * r],
+						&buf[(i - 1) * r],
+						(rows - i) * r) / r) > 0)
+		{
+			if(extents->run_rows == 0)
+				extents->run_offset = offset + i * r;
+			extents->run_rows += n;
+			i += n;
+			continue;
+		}
+		ret += _hexeditorextents_scan_end(extents);
+		i++;
+	}
+	memcpy(extents->scan_last, &buf[(rows - 1) * r], r);
+	extents->scan_last_valid = 1;
+	return ret;
+}
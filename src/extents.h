@@ -0,0 +1,69 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_EXTENTS_H
+# define HEXEDITOR_EXTENTS_H
+
+# include <sys/types.h>
+
+
+/* HexEditorExtents */
+/* public */
+/* types */
+typedef struct _HexEditorExtents HexEditorExtents;
+
+typedef enum _HexEditorExtentsType
+{
+	HEET_DATA = 0,
+	HEET_HOLE,
+	/* rows identical to the one before */
+	HEET_RUN
+} HexEditorExtentsType;
+
+
+/* constants */
+/* the shortest run of identical rows collapsed */
+# define HEXEDITOREXTENTS_RUN_ROWS	4
+
+
+/* functions */
+HexEditorExtents * hexeditorextents_new(int fd, off_t size, off_t granularity,
+		off_t row_size);
+void hexeditorextents_delete(HexEditorExtents * extents);
+
+/* accessors */
+off_t hexeditorextents_get_end(HexEditorExtents * extents, off_t offset,
+		int * hole);
+size_t hexeditorextents_get_holes(HexEditorExtents * extents);
+off_t hexeditorextents_get_rows(HexEditorExtents * extents);
+
+void hexeditorextents_set_size(HexEditorExtents * extents, off_t size);
+
+/* useful */
+int hexeditorextents_add_hole(HexEditorExtents * extents, off_t offset,
+		off_t size);
+int hexeditorextents_copy_runs(HexEditorExtents * extents,
+		HexEditorExtents * from);
+int hexeditorextents_expand(HexEditorExtents * extents, off_t row);
+off_t hexeditorextents_offset_to_row(HexEditorExtents * extents,
+		off_t offset);
+off_t hexeditorextents_row_to_offset(HexEditorExtents * extents, off_t row,
+		off_t * rows, off_t * collapsed, HexEditorExtentsType * type);
+int hexeditorextents_scan(HexEditorExtents * extents, off_t offset,
+		void const * buf, size_t size);
+
+#endif /* !HEXEDITOR_EXTENTS_H */
@@ -0,0 +1,532 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#ifdef __linux__
+# include <sys/mman.h>
+# include <sys/eventfd.h>
+# include <sys/syscall.h>
+# include <linux/io_uring.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <System.h>
+#include "fetcher.h"
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+# define HEXEDITORFETCHER_URING
+#endif
+
+
+/* HexEditorFetcher */
+/* private */
+/* types */
+typedef struct _HexEditorFetcherRequest
+{
+	gint64 offset;
+	unsigned int generation;
+	char * buf;
+	ssize_t res;
+	struct iovec iov;
+} HexEditorFetcherRequest;
+
+#ifdef HEXEDITORFETCHER_URING
+typedef struct _HexEditorFetcherUring
+{
+	int fd;
+	unsigned int entries;
+	unsigned int inflight;
+
+	/* submission queue */
+	void * sq;
+	size_t sq_size;
+	unsigned int * sq_tail;
+	unsigned int * sq_mask;
+	unsigned int * sq_array;
+	struct io_uring_sqe * sqes;
+	size_t sqes_size;
+
+	/* completion queue */
+	void * cq;
+	size_t cq_size;
+	unsigned int * cq_head;
+	unsigned int * cq_tail;
+	unsigned int * cq_mask;
+	struct io_uring_cqe * cqes;
+} HexEditorFetcherUring;
+#endif
+
+struct _HexEditorFetcher
+{
+	int fd;
+	size_t size;
+	HexEditorFetcherEngine engine;
+	HexEditorFetcherCallback callback;
+	void * data;
+
+	/* requests not completed yet, by offset */
+	GHashTable * pending;
+	GQueue waiting;
+
+	/* notifications */
+	int notify[2];
+	GIOChannel * channel;
+	guint source;
+
+	/* threads */
+	GThreadPool * pool;
+	GAsyncQueue * completed;
+
+#ifdef HEXEDITORFETCHER_URING
+	HexEditorFetcherUring uring;
+#endif
+};
+
+
+/* constants */
+#define HEXEDITORFETCHER_URING_ENTRIES	64
+
+
+/* prototypes */
+static void _hexeditorfetcher_complete(HexEditorFetcher * fetcher,
+		HexEditorFetcherRequest * request);
+static void _hexeditorfetcher_notify(HexEditorFetcher * fetcher);
+
+static void _hexeditorfetcher_request_delete(gpointer data);
+
+/* threads */
+static void _hexeditorfetcher_threads_on_request(gpointer data,
+		gpointer user_data);
+
+#ifdef HEXEDITORFETCHER_URING
+/* io_uring */
+static int _hexeditorfetcher_uring_init(HexEditorFetcher * fetcher);
+static void _hexeditorfetcher_uring_destroy(HexEditorFetcher * fetcher);
+static void _hexeditorfetcher_uring_reap(HexEditorFetcher * fetcher,
+		gboolean notify);
+static int _hexeditorfetcher_uring_submit(HexEditorFetcher * fetcher);
+#endif
+
+/* callbacks */
+static gboolean _hexeditorfetcher_on_notify(GIOChannel * channel,
+		GIOCondition condition, gpointer data);
+
+
+/* public */
+/* functions */
+/* hexeditorfetcher_new */
+static int _new_notify(HexEditorFetcher * fetcher);
+
+HexEditorFetcher * hexeditorfetcher_new(int fd, size_t size,
+		HexEditorFetcherEngine engine,
+		HexEditorFetcherCallback callback, void * data)
+{
+	HexEditorFetcher * fetcher;
+	GError * error = NULL;
+
+	if((fetcher = object_new(sizeof(*fetcher))) == NULL)
+		return NULL;
+	fetcher->fd = fd;
+	fetcher->size = size;
+	fetcher->engine = HEFE_THREADS;
+	fetcher->callback = callback;
+	fetcher->data = data;
+	fetcher->pending = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+			NULL, _hexeditorfetcher_request_delete);
+	g_queue_init(&fetcher->waiting);
+	fetcher->channel = NULL;
+	fetcher->source = 0;
+	fetcher->pool = NULL;
+	fetcher->completed = NULL;
+	if(_new_notify(fetcher) != 0)
+	{
+		g_hash_table_destroy(fetcher->pending);
+		object_delete(fetcher);
+		return NULL;
+	}
+#ifdef HEXEDITORFETCHER_URING
+	fetcher->uring.fd = -1;
+	/* fallback to the threads if io_uring is not available */
+	if(engine == HEFE_URING && fetcher->notify[0] == fetcher->notify[1]
+			&& _hexeditorfetcher_uring_init(fetcher) == 0)
+		fetcher->engine = HEFE_URING;
+#else
+	(void) engine;
+#endif
+	if(fetcher->engine == HEFE_THREADS)
+	{
+		fetcher->completed = g_async_queue_new();
+		if((fetcher->pool = g_thread_pool_new(
+						_hexeditorfetcher_threads_on_request,
+						fetcher, HEXEDITORFETCHER_THREADS,
+						FALSE, &error)) == NULL)
+		{
+			error_set_code(1, "%s", error->message);
+			g_error_free(error);
+			hexeditorfetcher_delete(fetcher);
+			return NULL;
+		}
+	}
+	fetcher->channel = g_io_channel_unix_new(fetcher->notify[0]);
+	g_io_channel_set_encoding(fetcher->channel, NULL, NULL);
+	fetcher->source = g_io_add_watch(fetcher->channel, G_IO_IN,
+			_hexeditorfetcher_on_notify, fetcher);
+	return fetcher;
+}
+
+static int _new_notify(HexEditorFetcher * fetcher)
+{
+	int i;
+
+#ifdef __linux__
+	if((fetcher->notify[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) >= 0)
+	{
+		fetcher->notify[1] = fetcher->notify[0];
+		return 0;
+	}
+#endif
+	if(pipe(fetcher->notify) != 0)
+		return -error_set_code(1, "%s", strerror(errno));
+	for(i = 0; i < 2; i++)
+		if(fcntl(fetcher->notify[i], F_SETFL, O_NONBLOCK) != 0
+				|| fcntl(fetcher->notify[i], F_SETFD,
+					FD_CLOEXEC) != 0)
+		{
+			error_set_code(1, "%s", strerror(errno));
+			close(fetcher->notify[0]);
+			close(fetcher->notify[1]);
+			return -1;
+		}
+	return 0;
+}
+
+
+/* hexeditorfetcher_delete */
+void hexeditorfetcher_delete(HexEditorFetcher * fetcher)
+{
+	if(fetcher->source != 0)
+		g_source_remove(fetcher->source);
+	if(fetcher->channel != NULL)
+		g_io_channel_unref(fetcher->channel);
+	/* wait for the requests being processed */
+	if(fetcher->pool != NULL)
+		g_thread_pool_free(fetcher->pool, TRUE, TRUE);
+#ifdef HEXEDITORFETCHER_URING
+	if(fetcher->uring.fd >= 0)
+		_hexeditorfetcher_uring_destroy(fetcher);
+#endif
+	if(fetcher->completed != NULL)
+		g_async_queue_unref(fetcher->completed);
+	/* every request left is still referenced here */
+	g_queue_clear(&fetcher->waiting);
+	g_hash_table_destroy(fetcher->pending);
+	close(fetcher->notify[0]);
+	if(fetcher->notify[1] != fetcher->notify[0])
+		close(fetcher->notify[1]);
+	object_delete(fetcher);
+}
+
+
+/* accessors */
+/* hexeditorfetcher_get_engine */
+HexEditorFetcherEngine hexeditorfetcher_get_engine(HexEditorFetcher * fetcher)
+{
+	return fetcher->engine;
+}
+
+
+/* useful */
+/* hexeditorfetcher_submit */
+int hexeditorfetcher_submit(HexEditorFetcher * fetcher, off_t const * offsets,
+		size_t count, unsigned int generation)
+{
+	size_t i;
+	gint64 offset;
+	HexEditorFetcherRequest * request;
+
+	for(i = 0; i < count; i++)
+	{
+		offset = offsets[i];
+		if(g_hash_table_lookup(fetcher->pending, &offset) != NULL)
+			continue;
+		if((request = object_new(sizeof(*request))) == NULL)
+			return -1;
+		if((request->buf = malloc(fetcher->size)) == NULL)
+		{
+			object_delete(request);
+			return -error_set_code(1, "%s", strerror(errno));
+		}
+		request->offset = offset;
+		request->generation = generation;
+		request->res = 0;
+		request->iov.iov_base = request->buf;
+		request->iov.iov_len = fetcher->size;
+		g_hash_table_insert(fetcher->pending, &request->offset,
+				request);
+		if(fetcher->engine == HEFE_THREADS)
+			g_thread_pool_push(fetcher->pool, request, NULL);
+		else
+			g_queue_push_tail(&fetcher->waiting, request);
+	}
+#ifdef HEXEDITORFETCHER_URING
+	if(fetcher->engine == HEFE_URING)
+		return _hexeditorfetcher_uring_submit(fetcher);
+#endif
+	return 0;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorfetcher_complete */
+static void _hexeditorfetcher_complete(HexEditorFetcher * fetcher,
+		HexEditorFetcherRequest * request)
+{
+	g_hash_table_steal(fetcher->pending, &request->offset);
+	fetcher->callback(fetcher->data, request->generation, request->offset,
+			request->buf, request->res);
+	_hexeditorfetcher_request_delete(request);
+}
+
+
+/* hexeditorfetcher_notify */
+static void _hexeditorfetcher_notify(HexEditorFetcher * fetcher)
+{
+	uint64_t one = 1;
+	ssize_t res;
+
+	/* eventfd counters are written as 64-bit integers */
+	do
+		res = (fetcher->notify[1] == fetcher->notify[0])
+			? write(fetcher->notify[1], &one, sizeof(one))
+			: write(fetcher->notify[1], "", 1);
+	while(res < 0 && errno == EINTR);
+}
+
+
+/* hexeditorfetcher_request_delete */
+static void _hexeditorfetcher_request_delete(gpointer data)
+{
+	HexEditorFetcherRequest * request = data;
+
+	free(request->buf);
+	object_delete(request);
+}
+
+
+/* threads */
+/* hexeditorfetcher_threads_on_request */
+static void _hexeditorfetcher_threads_on_request(gpointer data,
+		gpointer user_data)
+{
+	HexEditorFetcherRequest * request = data;
+	HexEditorFetcher * fetcher = user_data;
+	size_t pos;
+	ssize_t res = 0;
+
+	for(pos = 0; pos < fetcher->size; pos += res)
+		if((res = pread(fetcher->fd, &request->buf[pos],
+						fetcher->size - pos,
+						request->offset + pos)) < 0
+				&& errno == EINTR)
+			res = 0;
+		else if(res <= 0)
+			break;
+	request->res = (res < 0 && pos == 0) ? -errno : (ssize_t)pos;
+	g_async_queue_push(fetcher->completed, request);
+	_hexeditorfetcher_notify(fetcher);
+}
+
+
+#ifdef HEXEDITORFETCHER_URING
+/* io_uring */
+/* hexeditorfetcher_uring_init */
+static int _hexeditorfetcher_uring_init(HexEditorFetcher * fetcher)
+{
+	HexEditorFetcherUring * uring = &fetcher->uring;
+	struct io_uring_params params;
+	char * p;
+
+	memset(&params, 0, sizeof(params));
+	if((uring->fd = syscall(__NR_io_uring_setup,
+					HEXEDITORFETCHER_URING_ENTRIES,
+					&params)) < 0)
+		return -error_set_code(1, "%s", strerror(errno));
+	uring->entries = params.sq_entries;
+	uring->inflight = 0;
+	uring->sq_size = params.sq_off.array
+		+ params.sq_entries * sizeof(unsigned int);
+	uring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	uring->cq_size = params.cq_off.cqes
+		+ params.cq_entries * sizeof(struct io_uring_cqe);
+	uring->sq = mmap(NULL, uring->sq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, uring->fd,
+			IORING_OFF_SQ_RING);
+	uring->sqes = mmap(NULL, uring->sqes_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, uring->fd, IORING_OFF_SQES);
+	uring->cq = mmap(NULL, uring->cq_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, uring->fd,
+			IORING_OFF_CQ_RING);
+	if(uring->sq == MAP_FAILED || uring->sqes == MAP_FAILED
+			|| uring->cq == MAP_FAILED)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		_hexeditorfetcher_uring_destroy(fetcher);
+		return -1;
+	}
+	p = uring->sq;
+	uring->sq_tail = (unsigned int *)(p + params.sq_off.tail);
+	uring->sq_mask = (unsigned int *)(p + params.sq_off.ring_mask);
+	uring->sq_array = (unsigned int *)(p + params.sq_off.array);
+	p = uring->cq;
+	uring->cq_head = (unsigned int *)(p + params.cq_off.head);
+	uring->cq_tail = (unsigned int *)(p + params.cq_off.tail);
+	uring->cq_mask = (unsigned int *)(p + params.cq_off.ring_mask);
+	uring->cqes = (struct io_uring_cqe *)(p + params.cq_off.cqes);
+	/* completions are signaled through the eventfd */
+	if(syscall(__NR_io_uring_register, uring->fd, IORING_REGISTER_EVENTFD,
+				&fetcher->notify[0], 1) != 0)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		_hexeditorfetcher_uring_destroy(fetcher);
+		return -1;
+	}
+	return 0;
+}
+
+
+/* hexeditorfetcher_uring_destroy */
+static void _hexeditorfetcher_uring_destroy(HexEditorFetcher * fetcher)
+{
+	HexEditorFetcherUring * uring = &fetcher->uring;
+
+	/* the kernel may still be writing to the buffers */
+	while(uring->inflight > 0 && uring->cq != MAP_FAILED)
+	{
+		if(syscall(__NR_io_uring_enter, uring->fd, 0, 1,
+					IORING_ENTER_GETEVENTS, NULL, 0) < 0
+				&& errno != EINTR)
+			break;
+		_hexeditorfetcher_uring_reap(fetcher, FALSE);
+	}
+	if(uring->cq != NULL && uring->cq != MAP_FAILED)
+		munmap(uring->cq, uring->cq_size);
+	if(uring->sqes != NULL && uring->sqes != MAP_FAILED)
+		munmap(uring->sqes, uring->sqes_size);
+	if(uring->sq != NULL && uring->sq != MAP_FAILED)
+		munmap(uring->sq, uring->sq_size);
+	close(uring->fd);
+	uring->fd = -1;
+}
+
+
+/* hexeditorfetcher_uring_reap */
+static void _hexeditorfetcher_uring_reap(HexEditorFetcher * fetcher,
+		gboolean notify)
+{
+	HexEditorFetcherUring * uring = &fetcher->uring;
+	struct io_uring_cqe * cqe;
+	HexEditorFetcherRequest * request;
+	unsigned int head;
+
+	for(head = *uring->cq_head; head != __atomic_load_n(uring->cq_tail,
+				__ATOMIC_ACQUIRE);)
+	{
+		cqe = &uring->cqes[head & *uring->cq_mask];
+		request = (HexEditorFetcherRequest *)(uintptr_t)cqe->user_data;
+		request->res = cqe->res;
+		__atomic_store_n(uring->cq_head, ++head, __ATOMIC_RELEASE);
+		uring->inflight--;
+		if(notify)
+			_hexeditorfetcher_complete(fetcher, request);
+	}
+	if(notify)
+		_hexeditorfetcher_uring_submit(fetcher);
+}
+
+
+/* hexeditorfetcher_uring_submit */
+static int _hexeditorfetcher_uring_submit(HexEditorFetcher * fetcher)
+{
+	HexEditorFetcherUring * uring = &fetcher->uring;
+	HexEditorFetcherRequest * request;
+	struct io_uring_sqe * sqe;
+	unsigned int tail;
+	unsigned int index;
+	unsigned int count = 0;
+
+	/* queue as many requests as the ring can hold */
+	for(tail = *uring->sq_tail; uring->inflight + count < uring->entries
+			&& (request = g_queue_pop_head(&fetcher->waiting))
+			!= NULL; tail++, count++)
+	{
+		index = tail & *uring->sq_mask;
+		sqe = &uring->sqes[index];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_READV;
+		sqe->fd = fetcher->fd;
+		sqe->off = request->offset;
+		sqe->addr = (uintptr_t)&request->iov;
+		sqe->len = 1;
+		sqe->user_data = (uintptr_t)request;
+		uring->sq_array[index] = index;
+	}
+	if(count == 0)
+		return 0;
+	__atomic_store_n(uring->sq_tail, tail, __ATOMIC_RELEASE);
+	uring->inflight += count;
+	/* a single system call for the whole batch */
+	while(syscall(__NR_io_uring_enter, uring->fd, count, 0, 0, NULL, 0)
+			< 0)
+		if(errno != EINTR)
+			return -error_set_code(1, "%s", strerror(errno));
+	return 0;
+}
+#endif
+
+
+/* callbacks */
+/* hexeditorfetcher_on_notify */
+static gboolean _hexeditorfetcher_on_notify(GIOChannel * channel,
+		GIOCondition condition, gpointer data)
+{
+	HexEditorFetcher * fetcher = data;
+	char buf[64];
+	HexEditorFetcherRequest * request;
+	(void) channel;
+
+	if(condition != G_IO_IN)
+		return TRUE;
+	/* acknowledge the notifications */
+	while(read(fetcher->notify[0], buf, sizeof(buf)) > 0);
+#ifdef HEXEDITORFETCHER_URING
+	if(fetcher->engine == HEFE_URING)
+	{
+		_hexeditorfetcher_uring_reap(fetcher, TRUE);
+		return TRUE;
+	}
+#endif
+	while((request = g_async_queue_try_pop(fetcher->completed)) != NULL)
+		_hexeditorfetcher_complete(fetcher, request);
+	return TRUE;
+}
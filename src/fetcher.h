@@ -0,0 +1,58 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_FETCHER_H
+# define HEXEDITOR_FETCHER_H
+
+# include <sys/types.h>
+
+
+/* HexEditorFetcher */
+/* public */
+/* types */
+typedef struct _HexEditorFetcher HexEditorFetcher;
+
+/* called from the main loop once a request completed, along with the
+ * generation it was submitted for */
+typedef void (*HexEditorFetcherCallback)(void * data, unsigned int generation,
+		off_t offset, char const * buf, ssize_t size);
+
+typedef enum _HexEditorFetcherEngine
+{
+	HEFE_THREADS = 0,
+	HEFE_URING
+} HexEditorFetcherEngine;
+
+
+/* constants */
+# define HEXEDITORFETCHER_THREADS	4
+
+
+/* functions */
+HexEditorFetcher * hexeditorfetcher_new(int fd, size_t size,
+		HexEditorFetcherEngine engine,
+		HexEditorFetcherCallback callback, void * data);
+void hexeditorfetcher_delete(HexEditorFetcher * fetcher);
+
+/* accessors */
+HexEditorFetcherEngine hexeditorfetcher_get_engine(HexEditorFetcher * fetcher);
+
+/* useful */
+int hexeditorfetcher_submit(HexEditorFetcher * fetcher, off_t const * offsets,
+		size_t count, unsigned int generation);
+
+#endif /* !HEXEDITOR_FETCHER_H */
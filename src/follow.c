@@ -0,0 +1,207 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+# include <sys/inotify.h>
+#endif
+#include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <System.h>
+#include "follow.h"
+
+
+/* HexEditorFollow */
+/* private */
+/* types */
+struct _HexEditorFollow
+{
+	int fd;
+	off_t size;
+	int64_t mtime;
+	HexEditorFollowCallback callback;
+	void * data;
+
+	/* notifications */
+	int inotify;
+	GIOChannel * channel;
+	guint source;
+	/* the size is checked at most every HEXEDITORFOLLOW_DELAY */
+	guint timeout;
+};
+
+
+/* prototypes */
+static void _hexeditorfollow_check(HexEditorFollow * follow);
+static int64_t _hexeditorfollow_mtime(struct stat const * st);
+
+/* callbacks */
+#ifdef __linux__
+static gboolean _hexeditorfollow_on_notify(GIOChannel * channel,
+		GIOCondition condition, gpointer data);
+#endif
+static gboolean _hexeditorfollow_on_poll(gpointer data);
+static gboolean _hexeditorfollow_on_timeout(gpointer data);
+
+
+/* public */
+/* functions */
+/* hexeditorfollow_new */
+HexEditorFollow * hexeditorfollow_new(char const * filename, int fd,
+		HexEditorFollowCallback callback, void * data)
+{
+	HexEditorFollow * follow;
+	struct stat st;
+
+	if(fstat(fd, &st) != 0)
+	{
+		error_set_code(1, "%s: %s", filename, strerror(errno));
+		return NULL;
+	}
+	if((follow = object_new(sizeof(*follow))) == NULL)
+		return NULL;
+	follow->fd = fd;
+	follow->size = st.st_size;
+	follow->mtime = _hexeditorfollow_mtime(&st);
+	follow->callback = callback;
+	follow->data = data;
+	follow->inotify = -1;
+	follow->channel = NULL;
+	follow->source = 0;
+	follow->timeout = 0;
+#ifdef __linux__
+	if((follow->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) >= 0
+			&& inotify_add_watch(follow->inotify, filename,
+				IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE) >= 0)
+	{
+		follow->channel = g_io_channel_unix_new(follow->inotify);
+		g_io_channel_set_encoding(follow->channel, NULL, NULL);
+		follow->source = g_io_add_watch(follow->channel, G_IO_IN,
+				_hexeditorfollow_on_notify, follow);
+		return follow;
+	}
+	if(follow->inotify >= 0)
+		close(follow->inotify);
+	follow->inotify = -1;
+#endif
+	/* poll the size of the file instead */
+	follow->source = g_timeout_add(HEXEDITORFOLLOW_INTERVAL,
+			_hexeditorfollow_on_poll, follow);
+	return follow;
+}
+
+
+/* hexeditorfollow_delete */
+void hexeditorfollow_delete(HexEditorFollow * follow)
+{
+	if(follow->timeout != 0)
+		g_source_remove(follow->timeout);
+	if(follow->source != 0)
+		g_source_remove(follow->source);
+	if(follow->channel != NULL)
+		g_io_channel_unref(follow->channel);
+	if(follow->inotify >= 0)
+		close(follow->inotify);
+	object_delete(follow);
+}
+
+
+/* private */
+/* functions */
+/* hexeditorfollow_check */
+static void _hexeditorfollow_check(HexEditorFollow * follow)
+{
+	struct stat st;
+	int64_t mtime;
+
+	if(fstat(follow->fd, &st) != 0)
+		return;
+	mtime = _hexeditorfollow_mtime(&st);
+	if(st.st_size == follow->size && mtime == follow->mtime)
+		return;
+	follow->size = st.st_size;
+	follow->mtime = mtime;
+	follow->callback(follow->data, follow->size);
+}
+
+
+/* hexeditorfollow_mtime */
+static int64_t _hexeditorfollow_mtime(struct stat const * st)
+{
+	int64_t ret = (int64_t)st->st_mtime * 1000000000;
+
+#if defined(__APPLE__) || defined(__NetBSD__)
+	ret += st->st_mtimespec.tv_nsec;
+#elif defined(__linux__) || defined(__FreeBSD__) || defined(__OpenBSD__)
+	ret += st->st_mtim.tv_nsec;
+#endif
+	return ret;
+}
+
+
+/* callbacks */
+#ifdef __linux__
+/* hexeditorfollow_on_notify */
+static gboolean _hexeditorfollow_on_notify(GIOChannel * channel,
+		GIOCondition condition, gpointer data)
+{
+	HexEditorFollow * follow = data;
+	char buf[4096]
+		__attribute__ ((aligned(__alignof__(struct inotify_event))));
+	ssize_t res;
+	(void) channel;
+
+	if(condition != G_IO_IN)
+	{
+		follow->source = 0;
+		return FALSE;
+	}
+	/* the events only matter as a whole */
+	while((res = read(follow->inotify, buf, sizeof(buf))) > 0
+			|| (res < 0 && errno == EINTR));
+	/* coalesce the writes happening in the meantime */
+	if(follow->timeout == 0)
+		follow->timeout = g_timeout_add(HEXEDITORFOLLOW_DELAY,
+				_hexeditorfollow_on_timeout, follow);
+	return TRUE;
+}
+#endif
+
+
+/* hexeditorfollow_on_poll */
+static gboolean _hexeditorfollow_on_poll(gpointer data)
+{
+	HexEditorFollow * follow = data;
+
+	_hexeditorfollow_check(follow);
+	return TRUE;
+}
+
+
+/* hexeditorfollow_on_timeout */
+static gboolean _hexeditorfollow_on_timeout(gpointer data)
+{
+	HexEditorFollow * follow = data;
+
+	follow->timeout = 0;
+	_hexeditorfollow_check(follow);
+	return FALSE;
+}
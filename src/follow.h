@@ -0,0 +1,45 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_FOLLOW_H
+# define HEXEDITOR_FOLLOW_H
+
+# include <sys/types.h>
+
+
+/* HexEditorFollow */
+/* public */
+/* types */
+typedef struct _HexEditorFollow HexEditorFollow;
+
+/* called from the main loop whenever the file was modified */
+typedef void (*HexEditorFollowCallback)(void * data, off_t size);
+
+
+/* constants */
+/* delay between two notifications, in milliseconds */
+# define HEXEDITORFOLLOW_DELAY		50
+/* when the file cannot be watched */
+# define HEXEDITORFOLLOW_INTERVAL	500
+
+
+/* functions */
+HexEditorFollow * hexeditorfollow_new(char const * filename, int fd,
+		HexEditorFollowCallback callback, void * data);
+void hexeditorfollow_delete(HexEditorFollow * follow);
+
+#endif /* !HEXEDITOR_FOLLOW_H */
@@ -0,0 +1,668 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <libintl.h>
+#include <glib.h>
+#include <System.h>
+#include "format.h"
+#define _(string) gettext(string)
+
+
+/* HexEditorFormat */
+/* private */
+/* types */
+typedef void (*HexEditorFormatKernel)(HexEditorFormat const * format,
+		unsigned char const * buf, char * hex);
+typedef void (*HexEditorFormatDecoder)(HexEditorFormat const * format,
+		off_t offset, unsigned char const * buf, size_t size,
+		char * data);
+
+struct _HexEditorFormat
+{
+	size_t columns;
+	size_t group;
+	int little;
+	HexEditorFormatEncoding encoding;
+	/* for full rows of the common widths */
+	HexEditorFormatKernel kernel;
+	HexEditorFormatDecoder decoder;
+	/* the most bytes output per byte of data */
+	size_t cell;
+
+	/* lookup tables */
+	char digits[16];
+	char hex[512];
+	char data[256];
+	/* of the single-byte encodings */
+	char cells[256][2];
+	unsigned char cells_len[256];
+	unsigned char classes[256];
+};
+
+
+/* prototypes */
+static void _hexeditorformat_generic(HexEditorFormat const * format,
+		unsigned char const * buf, size_t size, char * hex);
+
+/* decoders */
+static void _hexeditorformat_decode_ascii(HexEditorFormat const * format,
+		off_t offset, unsigned char const * buf, size_t size,
+		char * data);
+static void _hexeditorformat_decode_table(HexEditorFormat const * format,
+		off_t offset, unsigned char const * buf, size_t size,
+		char * data);
+static void _hexeditorformat_decode_utf8(HexEditorFormat const * format,
+		off_t offset, unsigned char const * buf, size_t size,
+		char * data);
+static void _hexeditorformat_decode_utf16(HexEditorFormat const * format,
+		off_t offset, unsigned char const * buf, size_t size,
+		char * data);
+
+static size_t _hexeditorformat_encode(gunichar c, char * data,
+		size_t bytes);
+
+
+/* variables */
+/* the EBCDIC code pages only hold the characters of Latin-1 */
+static const unsigned char _hexeditorformat_cp037[256] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x9c, 0x09, 0x86, 0x7f,
+	0x97, 0x8d, 0x8e, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	0x10, 0x11, 0x12, 0x13, 0x9d, 0x85, 0x08, 0x87,
+	0x18, 0x19, 0x92, 0x8f, 0x1c, 0x1d, 0x1e, 0x1f,
+	0x80, 0x81, 0x82, 0x83, 0x84, 0x0a, 0x17, 0x1b,
+	0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x05, 0x06, 0x07,
+	0x90, 0x91, 0x16, 0x93, 0x94, 0x95, 0x96, 0x04,
+	0x98, 0x99, 0x9a, 0x9b, 0x14, 0x15, 0x9e, 0x1a,
+	0x20, 0xa0, 0xe2, 0xe4, 0xe0, 0xe1, 0xe3, 0xe5,
+	0xe7, 0xf1, 0xa2, 0x2e, 0x3c, 0x28, 0x2b, 0x7c,
+	0x26, 0xe9, 0xea, 0xeb, 0xe8, 0xed, 0xee, 0xef,
+	0xec, 0xdf, 0x21, 0x24, 0x2a, 0x29, 0x3b, 0xac,
+	0x2d, 0x2f, 0xc2, 0xc4, 0xc0, 0xc1, 0xc3, 0xc5,
+	0xc7, 0xd1, 0xa6, 0x2c, 0x25, 0x5f, 0x3e, 0x3f,
+	0xf8, 0xc9, 0xca, 0xcb, 0xc8, 0xcd, 0xce, 0xcf,
+	0xcc, 0x60, 0x3a, 0x23, 0x40, 0x27, 0x3d, 0x22,
+	0xd8, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+	0x68, 0x69, 0xab, 0xbb, 0xf0, 0xfd, 0xfe, 0xb1,
+	0xb0, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70,
+	0x71, 0x72, 0xaa, 0xba, 0xe6, 0xb8, 0xc6, 0xa4,
+	0xb5, 0x7e, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+	0x79, 0x7a, 0xa1, 0xbf, 0xd0, 0xdd, 0xde, 0xae,
+	0x5e, 0xa3, 0xa5, 0xb7, 0xa9, 0xa7, 0xb6, 0xbc,
+	0xbd, 0xbe, 0x5b, 0x5d, 0xaf, 0xa8, 0xb4, 0xd7,
+	0x7b, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+	0x48, 0x49, 0xad, 0xf4, 0xf6, 0xf2, 0xf3, 0xf5,
+	0x7d, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f, 0x50,
+	0x51, 0x52, 0xb9, 0xfb, 0xfc, 0xf9, 0xfa, 0xff,
+	0x5c, 0xf7, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+	0x59, 0x5a, 0xb2, 0xd4, 0xd6, 0xd2, 0xd3, 0xd5,
+	0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+	0x38, 0x39, 0xb3, 0xdb, 0xdc, 0xd9, 0xda, 0x9f
+};
+
+static const unsigned char _hexeditorformat_cp500[256] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x9c, 0x09, 0x86, 0x7f,
+	0x97, 0x8d, 0x8e, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	0x10, 0x11, 0x12, 0x13, 0x9d, 0x85, 0x08, 0x87,
+	0x18, 0x19, 0x92, 0x8f, 0x1c, 0x1d, 0x1e, 0x1f,
+	0x80, 0x81, 0x82, 0x83, 0x84, 0x0a, 0x17, 0x1b,
+	0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x05, 0x06, 0x07,
+	0x90, 0x91, 0x16, 0x93, 0x94, 0x95, 0x96, 0x04,
+	0x98, 0x99, 0x9a, 0x9b, 0x14, 0x15, 0x9e, 0x1a,
+	0x20, 0xa0, 0xe2, 0xe4, 0xe0, 0xe1, 0xe3, 0xe5,
+	0xe7, 0xf1, 0x5b, 0x2e, 0x3c, 0x28, 0x2b, 0x21,
+	0x26, 0xe9, 0xea, 0xeb, 0xe8, 0xed, 0xee, 0xef,
+	0xec, 0xdf, 0x5d, 0x24, 0x2a, 0x29, 0x3b, 0x5e,
+	0x2d, 0x2f, 0xc2, 0xc4, 0xc0, 0xc1, 0xc3, 0xc5,
+	0xc7, 0xd1, 0xa6, 0x2c, 0x25, 0x5f, 0x3e, 0x3f,
+	0xf8, 0xc9, 0xca, 0xcb, 0xc8, 0xcd, 0xce, 0xcf,
+	0xcc, 0x60, 0x3a, 0x23, 0x40, 0x27, 0x3d, 0x22,
+	0xd8, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+	0x68, 0x69, 0xab, 0xbb, 0xf0, 0xfd, 0xfe, 0xb1,
+	0xb0, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70,
+	0x71, 0x72, 0xaa, 0xba, 0xe6, 0xb8, 0xc6, 0xa4,
+	0xb5, 0x7e, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+	0x79, 0x7a, 0xa1, 0xbf, 0xd0, 0xdd, 0xde, 0xae,
+	0xa2, 0xa3, 0xa5, 0xb7, 0xa9, 0xa7, 0xb6, 0xbc,
+	0xbd, 0xbe, 0xac, 0x7c, 0xaf, 0xa8, 0xb4, 0xd7,
+	0x7b, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+	0x48, 0x49, 0xad, 0xf4, 0xf6, 0xf2, 0xf3, 0xf5,
+	0x7d, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f, 0x50,
+	0x51, 0x52, 0xb9, 0xfb, 0xfc, 0xf9, 0xfa, 0xff,
+	0x5c, 0xf7, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+	0x59, 0x5a, 0xb2, 0xd4, 0xd6, 0xd2, 0xd3, 0xd5,
+	0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+	0x38, 0x39, 0xb3, 0xdb, 0xdc, 0xd9, 0xda, 0x9f
+};
+
+static const unsigned char _hexeditorformat_cp1047[256] =
+{
+	0x00, 0x01, 0x02, 0x03, 0x9c, 0x09, 0x86, 0x7f,
+	0x97, 0x8d, 0x8e, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+	0x10, 0x11, 0x12, 0x13, 0x9d, 0x0a, 0x08, 0x87,
+	0x18, 0x19, 0x92, 0x8f, 0x1c, 0x1d, 0x1e, 0x1f,
+	0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x17, 0x1b,
+	0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x05, 0x06, 0x07,
+	0x90, 0x91, 0x16, 0x93, 0x94, 0x95, 0x96, 0x04,
+	0x98, 0x99, 0x9a, 0x9b, 0x14, 0x15, 0x9e, 0x1a,
+	0x20, 0xa0, 0xe2, 0xe4, 0xe0, 0xe1, 0xe3, 0xe5,
+	0xe7, 0xf1, 0xa2, 0x2e, 0x3c, 0x28, 0x2b, 0x7c,
+	0x26, 0xe9, 0xea, 0xeb, 0xe8, 0xed, 0xee, 0xef,
+	0xec, 0xdf, 0x21, 0x24, 0x2a, 0x29, 0x3b, 0x5e,
+	0x2d, 0x2f, 0xc2, 0xc4, 0xc0, 0xc1, 0xc3, 0xc5,
+	0xc7, 0xd1, 0xa6, 0x2c, 0x25, 0x5f, 0x3e, 0x3f,
+	0xf8, 0xc9, 0xca, 0xcb, 0xc8, 0xcd, 0xce, 0xcf,
+	0xcc, 0x60, 0x3a, 0x23, 0x40, 0x27, 0x3d, 0x22,
+	0xd8, 0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67,
+	0x68, 0x69, 0xab, 0xbb, 0xf0, 0xfd, 0xfe, 0xb1,
+	0xb0, 0x6a, 0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70,
+	0x71, 0x72, 0xaa, 0xba, 0xe6, 0xb8, 0xc6, 0xa4,
+	0xb5, 0x7e, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78,
+	0x79, 0x7a, 0xa1, 0xbf, 0xd0, 0x5b, 0xde, 0xae,
+	0xac, 0xa3, 0xa5, 0xb7, 0xa9, 0xa7, 0xb6, 0xbc,
+	0xbd, 0xbe, 0xdd, 0xa8, 0xaf, 0x5d, 0xb4, 0xd7,
+	0x7b, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+	0x48, 0x49, 0xad, 0xf4, 0xf6, 0xf2, 0xf3, 0xf5,
+	0x7d, 0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f, 0x50,
+	0x51, 0x52, 0xb9, 0xfb, 0xfc, 0xf9, 0xfa, 0xff,
+	0x5c, 0xf7, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+	0x59, 0x5a, 0xb2, 0xd4, 0xd6, 0xd2, 0xd3, 0xd5,
+	0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37,
+	0x38, 0x39, 0xb3, 0xdb, 0xdc, 0xd9, 0xda, 0x9f
+};
+
+static const struct
+{
+	char const * name;
+	unsigned char const * table;
+	HexEditorFormatDecoder decoder;
+	size_t cell;
+} _hexeditorformat_encodings[HEFE_COUNT] =
+{
+	{ "ascii", NULL, _hexeditorformat_decode_ascii, 1 },
+	{ "latin1", NULL, _hexeditorformat_decode_table, 2 },
+	{ "cp037", _hexeditorformat_cp037, _hexeditorformat_decode_table, 2 },
+	{ "cp500", _hexeditorformat_cp500, _hexeditorformat_decode_table, 2 },
+	{ "cp1047", _hexeditorformat_cp1047, _hexeditorformat_decode_table,
+		2 },
+	{ "utf-8", NULL, _hexeditorformat_decode_utf8, 3 },
+	{ "utf-16le", NULL, _hexeditorformat_decode_utf16, 3 },
+	{ "utf-16be", NULL, _hexeditorformat_decode_utf16, 3 }
+};
+
+
+/* functions */
+/* hexeditorformat_full */
+/* the loops are unrolled once the width and grouping are constants */
+static inline void _hexeditorformat_full(HexEditorFormat const * format,
+		unsigned char const * buf, char * hex,
+		const size_t columns, const size_t group, const int little)
+{
+	size_t i;
+	size_t j;
+	char * p = hex;
+
+	for(i = 0; i < columns; i += group)
+	{
+		for(j = 0; j < group; j++, p += 2)
+			memcpy(p, &format->hex[buf[little ? i + group - 1 - j
+					: i + j] * 2], 2);
+		*(p++) = ' ';
+	}
+	p[-1] = '\n';
+}
+
+
+/* kernels */
+#define HEXEDITORFORMAT_KERNEL(columns, group, little) \
+	static void _hexeditorformat_kernel_ ## columns ## _ ## group \
+		## _ ## little(HexEditorFormat const * format, \
+				unsigned char const * buf, char * hex) \
+	{ \
+		_hexeditorformat_full(format, buf, hex, columns, group, \
+				little); \
+	}
+#define HEXEDITORFORMAT_KERNELS(columns) \
+	HEXEDITORFORMAT_KERNEL(columns, 1, 0) \
+	HEXEDITORFORMAT_KERNEL(columns, 2, 0) \
+	HEXEDITORFORMAT_KERNEL(columns, 2, 1) \
+	HEXEDITORFORMAT_KERNEL(columns, 4, 0) \
+	HEXEDITORFORMAT_KERNEL(columns, 4, 1) \
+	HEXEDITORFORMAT_KERNEL(columns, 8, 0) \
+	HEXEDITORFORMAT_KERNEL(columns, 8, 1)
+
+HEXEDITORFORMAT_KERNELS(8)
+HEXEDITORFORMAT_KERNELS(16)
+HEXEDITORFORMAT_KERNELS(32)
+HEXEDITORFORMAT_KERNELS(64)
+
+#define HEXEDITORFORMAT_ENTRY(columns, group, little) \
+	{ columns, group, little, \
+		_hexeditorformat_kernel_ ## columns ## _ ## group ## _ \
+			## little }
+#define HEXEDITORFORMAT_ENTRIES(columns) \
+	HEXEDITORFORMAT_ENTRY(columns, 1, 0), \
+	HEXEDITORFORMAT_ENTRY(columns, 2, 0), \
+	HEXEDITORFORMAT_ENTRY(columns, 2, 1), \
+	HEXEDITORFORMAT_ENTRY(columns, 4, 0), \
+	HEXEDITORFORMAT_ENTRY(columns, 4, 1), \
+	HEXEDITORFORMAT_ENTRY(columns, 8, 0), \
+	HEXEDITORFORMAT_ENTRY(columns, 8, 1)
+
+static const struct
+{
+	size_t columns;
+	size_t group;
+	int little;
+	HexEditorFormatKernel kernel;
+} _hexeditorformat_kernels[] =
+{
+	HEXEDITORFORMAT_ENTRIES(8),
+	HEXEDITORFORMAT_ENTRIES(16),
+	HEXEDITORFORMAT_ENTRIES(32),
+	HEXEDITORFORMAT_ENTRIES(64)
+};
+
+
+/* public */
+/* functions */
+/* hexeditorformat_new */
+HexEditorFormat * hexeditorformat_new(size_t columns, size_t group,
+		HexEditorFormatEncoding encoding, unsigned int flags)
+{
+	HexEditorFormat * format;
+	char const * digits = (flags & HEXEDITORFORMAT_FLAG_UPPERCASE)
+		? "0123456789ABCDEF" : "0123456789abcdef";
+	unsigned char const * table;
+	size_t i;
+
+	if(columns == 0 || columns > HEXEDITORFORMAT_COLUMNS_MAX
+			|| encoding > HEFE_LAST)
+	{
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	/* the words have to fit the rows */
+	if((group != 1 && group != 2 && group != 4 && group != 8)
+			|| (columns % group) != 0)
+	{
+		error_set_code(1, _("Words of %lu bytes do not fit rows of %lu"
+					" bytes"), (unsigned long)group,
+				(unsigned long)columns);
+		return NULL;
+	}
+	if((format = object_new(sizeof(*format))) == NULL)
+		return NULL;
+	format->columns = columns;
+	format->group = group;
+	format->little = (format->group > 1
+			&& (flags & HEXEDITORFORMAT_FLAG_LITTLE_ENDIAN))
+		? 1 : 0;
+	format->encoding = encoding;
+	format->kernel = NULL;
+	for(i = 0; i < sizeof(_hexeditorformat_kernels)
+			/ sizeof(*_hexeditorformat_kernels); i++)
+		if(_hexeditorformat_kernels[i].columns == format->columns
+				&& _hexeditorformat_kernels[i].group
+				== format->group
+				&& _hexeditorformat_kernels[i].little
+				== format->little)
+		{
+			format->kernel = _hexeditorformat_kernels[i].kernel;
+			break;
+		}
+	format->decoder = _hexeditorformat_encodings[encoding].decoder;
+	format->cell = _hexeditorformat_encodings[encoding].cell;
+	table = _hexeditorformat_encodings[encoding].table;
+	memcpy(format->digits, digits, sizeof(format->digits));
+	for(i = 0; i < sizeof(format->data); i++)
+	{
+		format->hex[i * 2] = digits[i >> 4];
+		format->hex[i * 2 + 1] = digits[i & 0xf];
+		format->data[i] = (isascii(i) && isprint(i)) ? i : '.';
+		format->cells_len[i] = _hexeditorformat_encode((table != NULL)
+				? table[i] : i, format->cells[i], 1);
+		if(i == 0x00)
+			format->classes[i] = HEFC_NUL;
+		else if(i == 0xff)
+			format->classes[i] = HEFC_FF;
+		else if(i >= 0x80)
+			format->classes[i] = HEFC_HIGH;
+		else if(i == ' ' || (i >= '\t' && i <= '\r'))
+			format->classes[i] = HEFC_WHITESPACE;
+		else if(isprint(i))
+			format->classes[i] = HEFC_PRINTABLE;
+		else
+			format->classes[i] = HEFC_CONTROL;
+	}
+	return format;
+}
+
+
+/* hexeditorformat_delete */
+void hexeditorformat_delete(HexEditorFormat * format)
+{
+	object_delete(format);
+}
+
+
+/* accessors */
+/* hexeditorformat_get_columns */
+size_t hexeditorformat_get_columns(HexEditorFormat * format)
+{
+	return format->columns;
+}
+
+
+/* hexeditorformat_get_data_stride */
+size_t hexeditorformat_get_data_stride(HexEditorFormat * format)
+{
+	return format->columns * format->cell + 1;
+}
+
+
+/* hexeditorformat_get_encoding */
+HexEditorFormatEncoding hexeditorformat_get_encoding(HexEditorFormat * format)
+{
+	return format->encoding;
+}
+
+
+/* hexeditorformat_get_encoding_by_name */
+int hexeditorformat_get_encoding_by_name(char const * name,
+		HexEditorFormatEncoding * encoding)
+{
+	size_t i;
+
+	for(i = 0; i < HEFE_COUNT; i++)
+		if(strcasecmp(_hexeditorformat_encodings[i].name, name) == 0)
+		{
+			*encoding = i;
+			return 0;
+		}
+	return -error_set_code(1, "%s: %s", name, _("Unknown encoding"));
+}
+
+
+/* hexeditorformat_get_encoding_name */
+char const * hexeditorformat_get_encoding_name(
+		HexEditorFormatEncoding encoding)
+{
+	return (encoding <= HEFE_LAST)
+		? _hexeditorformat_encodings[encoding].name : NULL;
+}
+
+
+/* hexeditorformat_get_group */
+size_t hexeditorformat_get_group(HexEditorFormat * format)
+{
+	return format->group;
+}
+
+
+/* hexeditorformat_get_hex_position */
+size_t hexeditorformat_get_hex_position(HexEditorFormat * format,
+		size_t column)
+{
+	size_t word = column / format->group;
+	size_t byte = column % format->group;
+
+	if(format->little)
+		byte = format->group - 1 - byte;
+	return word * (format->group * 2 + 1) + byte * 2;
+}
+
+
+/* hexeditorformat_get_hex_stride */
+size_t hexeditorformat_get_hex_stride(HexEditorFormat * format)
+{
+	/* two digits per byte and a separator per word */
+	return format->columns * 2 + format->columns / format->group;
+}
+
+
+/* useful */
+/* hexeditorformat_address */
+void hexeditorformat_address(HexEditorFormat * format, off_t offset,
+		int width, char * addr)
+{
+	int i;
+
+	for(i = width - 1; i >= 0; i--)
+	{
+		addr[i] = format->digits[offset & 0xf];
+		offset >>= 4;
+	}
+	addr[width] = '\n';
+}
+
+
+/* hexeditorformat_classes */
+void hexeditorformat_classes(HexEditorFormat * format,
+		unsigned char const * buf, size_t size, unsigned char * classes)
+{
+	uint64_t word;
+	size_t i;
+	size_t j;
+
+	if(size > format->columns)
+		size = format->columns;
+	for(i = 0; i + sizeof(word) <= size; i += sizeof(word))
+	{
+		/* the padding and erased areas a word at a time */
+		memcpy(&word, &buf[i], sizeof(word));
+		if(word == 0)
+			memset(&classes[i], HEFC_NUL, sizeof(word));
+		else if(word == UINT64_MAX)
+			memset(&classes[i], HEFC_FF, sizeof(word));
+		else
+			for(j = i; j < i + sizeof(word); j++)
+				classes[j] = format->classes[buf[j]];
+	}
+	for(; i < size; i++)
+		classes[i] = format->classes[buf[i]];
+	memset(&classes[size], HEFC_NONE, format->columns - size);
+}
+
+
+/* hexeditorformat_row */
+void hexeditorformat_row(HexEditorFormat * format, off_t offset,
+		unsigned char const * buf, size_t size, char * hex, char * data)
+{
+	if(size == format->columns && format->kernel != NULL)
+		format->kernel(format, buf, hex);
+	else
+		_hexeditorformat_generic(format, buf, size, hex);
+	format->decoder(format, offset, buf, size, data);
+}
+
+
+/* private */
+/* functions */
+/* hexeditorformat_generic */
+static void _hexeditorformat_generic(HexEditorFormat const * format,
+		unsigned char const * buf, size_t size, char * hex)
+{
+	size_t i;
+	size_t j;
+	size_t k;
+	char * p = hex;
+
+	/* padded at the end of the file */
+	for(i = 0; i < format->columns; i += format->group)
+	{
+		for(j = 0; j < format->group; j++, p += 2)
+		{
+			k = format->little ? i + format->group - 1 - j : i + j;
+			if(k < size)
+				memcpy(p, &format->hex[buf[k] * 2], 2);
+			else
+				memset(p, ' ', 2);
+		}
+		*(p++) = ' ';
+	}
+	p[-1] = '\n';
+}
+
+
+/* decoders */
+/* hexeditorformat_decode_ascii */
+static void _hexeditorformat_decode_ascii(HexEditorFormat const * format,
+		off_t offset, unsigned char const * buf, size_t size,
+		char * data)
+{
+	size_t i;
+	(void) offset;
+
+	for(i = 0; i < size; i++)
+		data[i] = format->data[buf[i]];
+	for(; i < format->columns; i++)
+		data[i] = ' ';
+	data[format->columns] = '\n';
+}
+
+
+/* hexeditorformat_decode_table */
+static void _hexeditorformat_decode_table(HexEditorFormat const * format,
+		off_t offset, unsigned char const * buf, size_t size,
+		char * data)
+{
+	size_t i;
+	char * p = data;
+	(void) offset;
+
+	/* the cells are copied whole, whatever their length */
+	for(i = 0; i < size; i++)
+	{
+		memcpy(p, format->cells[buf[i]], sizeof(*format->cells));
+		p += format->cells_len[buf[i]];
+	}
+	for(; i < format->columns; i++)
+		*(p++) = ' ';
+	*p = '\n';
+}
+
+
+/* hexeditorformat_decode_utf8 */
+static void _hexeditorformat_decode_utf8(HexEditorFormat const * format,
+		off_t offset, unsigned char const * buf, size_t size,
+		char * data)
+{
+	size_t i;
+	size_t n;
+	gunichar c;
+	char * p = data;
+	(void) offset;
+
+	/* the sequences cut by the row boundaries are not decoded */
+	for(i = 0; i < size; i += n)
+	{
+		c = g_utf8_get_char_validated((char const *)&buf[i], size - i);
+		if(c == (gunichar)-1 || c == (gunichar)-2)
+		{
+			*(p++) = '.';
+			n = 1;
+			continue;
+		}
+		n = g_utf8_skip[buf[i]];
+		p += _hexeditorformat_encode(c, p, n);
+	}
+	for(; i < format->columns; i++)
+		*(p++) = ' ';
+	*p = '\n';
+}
+
+
+/* hexeditorformat_decode_utf16 */
+static void _hexeditorformat_decode_utf16(HexEditorFormat const * format,
+		off_t offset, unsigned char const * buf, size_t size,
+		char * data)
+{
+	const int little = (format->encoding == HEFE_UTF16LE) ? 1 : 0;
+	size_t i = 0;
+	size_t n;
+	gunichar c;
+	gunichar d;
+	char * p = data;
+
+	/* the code units are aligned on the file */
+	if(offset & 1)
+		*(p++) = (i++ < size) ? '.' : ' ';
+	for(; i + 1 < size; i += n)
+	{
+		c = little ? buf[i] | (buf[i + 1] << 8)
+			: (buf[i] << 8) | buf[i + 1];
+		n = 2;
+		if(c >= 0xd800 && c < 0xdc00 && i + 3 < size)
+		{
+			d = little ? buf[i + 2] | (buf[i + 3] << 8)
+				: (buf[i + 2] << 8) | buf[i + 3];
+			if(d >= 0xdc00 && d < 0xe000)
+			{
+				c = 0x10000 + ((c - 0xd800) << 10)
+					+ (d - 0xdc00);
+				n = 4;
+			}
+		}
+		p += _hexeditorformat_encode(c, p, n);
+	}
+	/* half a code unit */
+	if(i < size)
+		*(p++) = '.';
+	for(i = (i < size) ? size : i; i < format->columns; i++)
+		*(p++) = ' ';
+	*p = '\n';
+}
+
+
+/* hexeditorformat_encode */
+/* outputs a character for bytes of data, keeping the columns aligned */
+static size_t _hexeditorformat_encode(gunichar c, char * data,
+		size_t bytes)
+{
+	size_t ret;
+
+	if(c < 0x80)
+	{
+		data[0] = isprint(c) ? c : '.';
+		ret = 1;
+	}
+	else if(!g_unichar_validate(c) || !g_unichar_isprint(c)
+			|| g_unichar_iszerowidth(c) || g_unichar_ismark(c)
+			|| (bytes < 2 && g_unichar_iswide(c)))
+	{
+		data[0] = '.';
+		ret = 1;
+	}
+	else
+	{
+		ret = g_unichar_to_utf8(c, data);
+		/* the wide characters take two columns */
+		if(g_unichar_iswide(c))
+			bytes--;
+	}
+	/* the remaining bytes are left blank */
+	for(; bytes > 1; bytes--)
+		data[ret++] = ' ';
+	return ret;
+}
@@ -0,0 +1,97 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_FORMAT_H
+# define HEXEDITOR_FORMAT_H
+
+# include <sys/types.h>
+
+
+/* HexEditorFormat */
+/* public */
+/* types */
+typedef struct _HexEditorFormat HexEditorFormat;
+
+/* of the data column */
+typedef enum _HexEditorFormatEncoding
+{
+	HEFE_ASCII = 0,
+	HEFE_LATIN1,
+	HEFE_CP037,
+	HEFE_CP500,
+	HEFE_CP1047,
+	HEFE_UTF8,
+	HEFE_UTF16LE,
+	HEFE_UTF16BE
+} HexEditorFormatEncoding;
+# define HEFE_LAST	HEFE_UTF16BE
+# define HEFE_COUNT	(HEFE_LAST + 1)
+
+/* of the bytes, for coloring */
+typedef enum _HexEditorFormatClass
+{
+	HEFC_NONE = 0,
+	HEFC_NUL,
+	HEFC_PRINTABLE,
+	HEFC_WHITESPACE,
+	HEFC_CONTROL,
+	HEFC_HIGH,
+	HEFC_FF
+} HexEditorFormatClass;
+# define HEFC_LAST	HEFC_FF
+# define HEFC_COUNT	(HEFC_LAST + 1)
+
+
+/* constants */
+# define HEXEDITORFORMAT_COLUMNS	16
+# define HEXEDITORFORMAT_COLUMNS_MAX	256
+
+# define HEXEDITORFORMAT_FLAG_UPPERCASE		0x1
+# define HEXEDITORFORMAT_FLAG_LITTLE_ENDIAN	0x2
+
+
+/* functions */
+HexEditorFormat * hexeditorformat_new(size_t columns, size_t group,
+		HexEditorFormatEncoding encoding, unsigned int flags);
+void hexeditorformat_delete(HexEditorFormat * format);
+
+/* accessors */
+size_t hexeditorformat_get_columns(HexEditorFormat * format);
+size_t hexeditorformat_get_data_stride(HexEditorFormat * format);
+HexEditorFormatEncoding hexeditorformat_get_encoding(HexEditorFormat * format);
+size_t hexeditorformat_get_group(HexEditorFormat * format);
+/* where the digits of a byte of the row are in the hexadecimal column */
+size_t hexeditorformat_get_hex_position(HexEditorFormat * format,
+		size_t column);
+size_t hexeditorformat_get_hex_stride(HexEditorFormat * format);
+
+char const * hexeditorformat_get_encoding_name(
+		HexEditorFormatEncoding encoding);
+int hexeditorformat_get_encoding_by_name(char const * name,
+		HexEditorFormatEncoding * encoding);
+
+/* useful */
+void hexeditorformat_address(HexEditorFormat * format, off_t offset,
+		int width, char * addr);
+/* the classes past size are HEFC_NONE */
+void hexeditorformat_classes(HexEditorFormat * format,
+		unsigned char const * buf, size_t size,
+		unsigned char * classes);
+void hexeditorformat_row(HexEditorFormat * format, off_t offset,
+		unsigned char const * buf, size_t size, char * hex, char * data);
+
+#endif /* !HEXEDITOR_FORMAT_H */
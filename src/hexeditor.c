@@ -23,7 +23,6 @@ static char const _license[] =
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <ctype.h>
 #include <time.h>
 #include <errno.h>
 #include <libintl.h>
@@ -33,6 +32,24 @@ static char const _license[] =
 #include <Desktop.h>
 #include "HexEditor/plugin.h"
 #include "hexeditor.h"
+#include "annotations.h"
+#include "buffer.h"
+#include "codec.h"
+#include "digest.h"
+#include "export.h"
+#include "extents.h"
+#include "fetcher.h"
+#include "follow.h"
+#include "format.h"
+#include "import.h"
+#include "magic.h"
+#include "overview.h"
+#include "process.h"
+#include "rowcache.h"
+#include "search.h"
+#include "sidecar.h"
+#include "spool.h"
+#include "transform.h"
 #include "../config.h"
 #define _(string) gettext(string)
 #define N_(string) string
@@ -48,6 +65,25 @@ static char const _license[] =
 # define BINDIR			PREFIX "/bin"
 #endif
 
+#define HEXEDITOR_SCAN_SIZE	65536
+#define HEXEDITOR_IMPORT_SIZE	(1024 * 1024)
+#define HEXEDITOR_BLOCK_ROWS	64
+#define HEXEDITOR_FLAG_UPPERCASE	0x1
+#define HEXEDITOR_FLAG_LITTLE_ENDIAN	0x2
+#define HEXEDITOR_FLAG_CLASSES	0x4
+#define HEXEDITOR_OVERVIEW_WIDTH	24
+/* the runs per row colored, the rows with more are not */
+#define HEXEDITOR_CLASS_RUNS	8
+/* the hits highlighted, and the bytes shown around them */
+#define HEXEDITOR_SEARCH_ANNOTATIONS	65536
+#define HEXEDITOR_SEARCH_CONTEXT	4
+#define HEXEDITOR_SEARCH_PREVIEW	8
+#if GTK_CHECK_VERSION(3, 16, 0)
+# define HEXEDITOR_POLICY_ROWS	GTK_POLICY_EXTERNAL
+#else
+# define HEXEDITOR_POLICY_ROWS	GTK_POLICY_AUTOMATIC
+#endif
+
 
 /* HexEditor */
 /* private */
@@ -58,18 +94,89 @@ struct _HexEditor
 
 	char * filename;
 	int fd;
+	HexEditorBuffer * buffer;
+	HexEditorCodec * codec;
+	/* the memory of a process instead */
+	HexEditorProcess * process;
+	/* or what was read from a pipe */
+	HexEditorSpool * spool;
+	/* the holes of sparse files */
+	HexEditorExtents * extents;
+	/* the runs of identical rows scanned again */
+	guint runs_source;
+	off_t runs_offset;
+	off_t runs_end;
+	HexEditorFetcher * fetcher;
+	/* the pages it could not read, then read synchronously */
+	off_t * fetch_failed;
+	size_t fetch_failed_cnt;
+	unsigned int fetch_failed_generation;
+	HexEditorSidecar * sidecar;
+	HexEditorFollow * follow;
+	/* the size notified while the file is transformed in place */
+	off_t follow_size;
 	GIOChannel * channel;
 	guint source;
-	gsize offset;
-	gsize size;
+	/* the scan waits for the file to grow */
+	gboolean tail;
+	/* pipes are read whether they are scanned or not */
+	guint spool_source;
+	guint spool_grow;
+	/* the scan waits for the pipe */
+	gboolean spool_wait;
+	/* changes since the scan */
+	HexEditorDigest * digest;
+	guint verify_source;
+	off_t verify_offset;
+	/* the blocks compared stop there, or at the end if negative */
+	off_t verify_end;
+	/* the last block digested is checked first, if only appended to */
+	gboolean verify_tail;
+	char * verify_buf;
+	unsigned int verify_changes;
+	/* what the scan found, for the minimap */
+	HexEditorOverview * overview;
+	/* bookmarks and highlights */
+	HexEditorAnnotations * annotations;
+	gboolean annotations_changed;
+	/* a range written to another file */
+	HexEditorExport * export;
+	guint export_source;
+	int export_fd;
+	char * export_filename;
+	/* removed when incomplete, unless a device or pipe */
+	gboolean export_regular;
+	/* a range modified in place or into another file */
+	HexEditorTransform * transform;
+	guint transform_source;
+	off_t transform_offset;
+	int transform_fd;
+	char * transform_filename;
+	/* removed when incomplete, unless a device or pipe */
+	gboolean transform_regular;
+	/* the hits of the last search */
+	HexEditorSearch * search;
+	guint search_source;
+	size_t search_annotated;
+	/* started once compressed files are indexed */
+	HexEditorSearch * search_pending;
+	off_t offset;
+	off_t size;
 	time_t time;
 
 	/* preferences */
 	HexEditorPrefs prefs;
 
+	/* view */
+	HexEditorFormat * format;
+	HexEditorRowCache * rowcache;
+
 	/* widgets */
 	GtkWidget * widget;
 	GtkWidget * window;
+	GtkToolItem * tb_follow;
+	GtkToolItem * tb_colors;
+	GtkWidget * tb_encoding;
 	PangoFontDescription * bold;
 #if GTK_CHECK_VERSION(2, 18, 0)
 	GtkWidget * infobar;
@@ -77,24 +184,51 @@ struct _HexEditor
 #endif
 	GtkWidget * view_addr;
 	GtkTextBuffer * view_addr_tbuf;
-	GtkTextIter view_addr_iter;
 	GtkWidget * view_hex;
 	GtkTextBuffer * view_hex_tbuf;
-	GtkTextIter view_hex_iter;
 	GtkWidget * view_data;
 	GtkTextBuffer * view_data_tbuf;
-	GtkTextIter view_data_iter;
+	GtkWidget * view_overview;
+	GtkAdjustment * view_adjustment;
+	int view_addr_width;
+	int view_row_height;
+	unsigned int view_rows;
+	guint view_source;
 	/* progress */
 	GtkWidget * pg_window;
 	GtkWidget * pg_progress;
 	/* plug-ins */
 	GtkWidget * pl_view;
+	GtkWidget * pl_format;
 	GtkListStore * pl_store;
 	GtkWidget * pl_combo;
 	GtkWidget * pl_box;
 	HexEditorPluginHelper pl_helper;
+	/* search */
+	GtkWidget * se_view;
+	GtkWidget * se_label;
+	GtkWidget * se_text;
+	GtkTextBuffer * se_tbuf;
+	GtkAdjustment * se_adjustment;
+	unsigned int se_rows;
 };
 
+/* the rows displayed, for their annotations */
+typedef struct _HexEditorViewRows
+{
+	HexEditor * hexeditor;
+	off_t const * offsets;
+	size_t rows;
+} HexEditorViewRows;
+
+/* the bytes of a row in the same class, as displayed */
+typedef struct _HexEditorClassRun
+{
+	unsigned int class;
+	size_t start;
+	size_t end;
+} HexEditorClassRun;
+
 
 /* constants */
 typedef enum _HexEditorPluginColumn
@@ -111,6 +245,15 @@ typedef enum _HexEditorPluginColumn
 #define HEPC_LAST	HEPC_WIDGET
 #define HEPC_COUNT	(HEPC_LAST + 1)
 
+typedef enum _HexEditorSearchType
+{
+	HEST_HEXADECIMAL = 0,
+	HEST_TEXT,
+	HEST_REGEX
+} HexEditorSearchType;
+#define HEST_LAST	HEST_REGEX
+#define HEST_COUNT	(HEST_LAST + 1)
+
 
 /* prototypes */
 /* accessors */
@@ -119,29 +262,189 @@ static int _hexeditor_plugin_is_enabled(HexEditor * hexeditor,
 		char const * plugin);
 
 /* useful */
+static void _hexeditor_annotations_restore(HexEditor * hexeditor);
+static void _hexeditor_annotations_store(HexEditor * hexeditor);
 static void _hexeditor_close(HexEditor * hexeditor, gboolean plugins);
+static void _close_reset(HexEditor * hexeditor);
 static int _hexeditor_config_load(HexEditor * hexeditor);
+static void _hexeditor_detect(HexEditor * hexeditor, char const * buf,
+		size_t size);
 static int _hexeditor_error(HexEditor * hexeditor, char const * message,
 		int ret);
+static void _hexeditor_export_finish(HexEditor * hexeditor, gboolean success);
+static void _hexeditor_extents_open(HexEditor * hexeditor, gboolean runs);
+static gchar * _hexeditor_filename(HexEditor * hexeditor, char const * title,
+		gboolean save);
+static int _hexeditor_hex(char const * text, unsigned char ** buf,
+		size_t * size);
+static int _hexeditor_import(HexEditorImport ** import, int fd,
+		char const * text, size_t size, unsigned char * buf);
+static int _hexeditor_import_finish(HexEditor * hexeditor,
+		HexEditorImport * import, int fd, char const * filename,
+		gboolean regular, int ret);
+static int _hexeditor_open_output(HexEditor * hexeditor,
+		char const * filename, gboolean * edited, gboolean * regular);
+static int _hexeditor_plugin_annotate(HexEditor * hexeditor,
+		HexEditorPluginAnnotation type, off_t offset, off_t size,
+		char const * label);
+static void _hexeditor_plugin_annotate_clear(HexEditor * hexeditor,
+		HexEditorPluginAnnotation type);
+static off_t _hexeditor_plugin_get_size(HexEditor * hexeditor);
+static ssize_t _hexeditor_plugin_read(HexEditor * hexeditor, off_t offset,
+		void * buffer, size_t size);
+static int _hexeditor_prefetch(HexEditor * hexeditor, off_t const * offsets,
+		size_t count);
+static void _hexeditor_runs_start(HexEditor * hexeditor);
+static void _hexeditor_scan_cancel(HexEditor * hexeditor);
+static void _hexeditor_scan_finish(HexEditor * hexeditor, gboolean eof);
+static void _hexeditor_scan_start(HexEditor * hexeditor);
+static int _hexeditor_search(HexEditor * hexeditor, HexEditorSearch * search);
+static void _hexeditor_search_clear(HexEditor * hexeditor);
+static void _hexeditor_search_finish(HexEditor * hexeditor);
+static void _hexeditor_search_render(HexEditor * hexeditor);
+static void _hexeditor_search_update(HexEditor * hexeditor);
+static void _hexeditor_sidecar_open(HexEditor * hexeditor);
+static void _hexeditor_transform_finish(HexEditor * hexeditor,
+		gboolean success);
+static void _hexeditor_verify_start(HexEditor * hexeditor, off_t offset,
+		off_t end);
+
+/* view */
+static unsigned int _hexeditor_view_flags(HexEditor * hexeditor);
+static int _hexeditor_view_format(HexEditor * hexeditor);
+static void _hexeditor_view_grow(HexEditor * hexeditor, off_t size);
+static off_t _hexeditor_view_offset(HexEditor * hexeditor, off_t row,
+		off_t * rows, off_t * collapsed, HexEditorExtentsType * type);
+static void _hexeditor_view_overview(HexEditor * hexeditor, cairo_t * cairo);
+static void _hexeditor_view_overview_scroll(HexEditor * hexeditor, gdouble y);
+static void _hexeditor_view_queue(HexEditor * hexeditor);
+static void _hexeditor_view_refresh(HexEditor * hexeditor);
+static void _hexeditor_view_render(HexEditor * hexeditor);
+static off_t _hexeditor_view_row(HexEditor * hexeditor, off_t offset);
+static off_t _hexeditor_view_rows(HexEditor * hexeditor);
+static void _hexeditor_view_scroll_to(HexEditor * hexeditor, gdouble row);
+static int _hexeditor_view_width(HexEditor * hexeditor);
 
 /* callbacks */
+static gboolean _hexeditor_on_codec(gpointer data);
+static ssize_t _hexeditor_on_codec_read(void * data, void * buf, size_t size,
+		off_t offset);
+static void _hexeditor_on_colors_toggled(gpointer data);
+static void _hexeditor_on_fetch(void * data, unsigned int generation,
+		off_t offset, char const * buf, ssize_t size);
+static void _hexeditor_on_encoding_changed(gpointer data);
+static gboolean _hexeditor_on_export(gpointer data);
+static void _hexeditor_on_follow(void * data, off_t size);
+static void _hexeditor_on_follow_toggled(gpointer data);
+static void _hexeditor_on_goto(gpointer data);
 static void _hexeditor_on_open(gpointer data);
+static gboolean _hexeditor_on_overview_button_press(GtkWidget * widget,
+		GdkEventButton * event, gpointer data);
+#if GTK_CHECK_VERSION(3, 0, 0)
+static gboolean _hexeditor_on_overview_draw(GtkWidget * widget,
+		cairo_t * cairo, gpointer data);
+#else
+static gboolean _hexeditor_on_overview_expose(GtkWidget * widget,
+		GdkEventExpose * event, gpointer data);
+#endif
+static gboolean _hexeditor_on_overview_motion(GtkWidget * widget,
+		GdkEventMotion * event, gpointer data);
 static void _hexeditor_on_plugin_combo_change(gpointer data);
 #ifdef EMBEDDED
 static void _hexeditor_on_preferences(gpointer data);
 #endif
+static gboolean _hexeditor_on_process(gpointer data);
+static ssize_t _hexeditor_on_process_read(void * data, void * buf,
+		size_t size, off_t offset);
 static void _hexeditor_on_progress_cancel(gpointer data);
 static gboolean _hexeditor_on_progress_delete(gpointer data);
 #ifdef EMBEDDED
 static void _hexeditor_on_properties(gpointer data);
 #endif
+static void _hexeditor_on_refresh(gpointer data);
+static gboolean _hexeditor_on_runs(gpointer data);
+static gboolean _hexeditor_on_search(gpointer data);
+static gboolean _hexeditor_on_search_button_press(GtkWidget * widget,
+		GdkEventButton * event, gpointer data);
+static void _hexeditor_on_search_close(gpointer data);
+static gboolean _hexeditor_on_search_scroll(GtkWidget * widget,
+		GdkEventScroll * event, gpointer data);
+static void _hexeditor_on_search_size_allocate(GtkWidget * widget,
+		GtkAllocation * allocation, gpointer data);
+static void _hexeditor_on_search_value_changed(gpointer data);
+static gboolean _hexeditor_on_spool(gpointer data);
+static gboolean _hexeditor_on_spool_can_read(GIOChannel * channel,
+		GIOCondition condition, gpointer data);
+static gboolean _hexeditor_on_spool_grow(gpointer data);
+static ssize_t _hexeditor_on_spool_read(void * data, void * buf, size_t size,
+		off_t offset);
+static gboolean _hexeditor_on_transform(gpointer data);
+static void _hexeditor_on_view_annotation(void * data,
+		HexEditorAnnotation const * annotation);
+static gboolean _hexeditor_on_view_button_press(GtkWidget * widget,
+		GdkEventButton * event, gpointer data);
+static gboolean _hexeditor_on_view_idle(gpointer data);
+static gboolean _hexeditor_on_view_key_press(GtkWidget * widget,
+		GdkEventKey * event, gpointer data);
+static gboolean _hexeditor_on_view_query_tooltip(GtkWidget * widget,
+		gint x, gint y, gboolean keyboard, GtkTooltip * tooltip,
+		gpointer data);
+static void _hexeditor_on_view_tooltip(void * data,
+		HexEditorAnnotation const * annotation);
+static gboolean _hexeditor_on_view_scroll(GtkWidget * widget,
+		GdkEventScroll * event, gpointer data);
+static void _hexeditor_on_view_size_allocate(GtkWidget * widget,
+		GtkAllocation * allocation, gpointer data);
+static gboolean _hexeditor_on_verify(gpointer data);
+static void _hexeditor_on_view_value_changed(gpointer data);
 
 
 /* variables */
+/* Tango: butter, orange, chameleon and sky blue */
+static const uint32_t _hexeditor_annotation_colors[HEAT_COUNT] =
+{
+	0xfce94f, 0xfcaf3e, 0x8ae234, 0x729fcf
+};
+
+/* Tango: aluminium, chameleon, butter, sky blue and scarlet red, the
+ * printable characters keep the default */
+static const uint32_t _hexeditor_class_colors[HEFC_COUNT] =
+{
+	0, 0x888a85, 0, 0x4e9a06, 0xc4a000, 0x3465a4, 0xcc0000
+};
+
+static char const * _hexeditor_encodings[HEFE_COUNT] =
+{
+	N_("ASCII"), N_("Latin-1"), N_("EBCDIC (037)"), N_("EBCDIC (500)"),
+	N_("EBCDIC (1047)"), "UTF-8", "UTF-16LE", "UTF-16BE"
+};
+
+static char const * _hexeditor_transforms[HETO_COUNT] =
+{
+	N_("XOR with the key"), N_("Add the key"), N_("Subtract the key"),
+	N_("Rotate left"), N_("Swap 16-bit words"), N_("Swap 32-bit words"),
+	N_("Swap 64-bit words"), N_("Fill with the key")
+};
+
+static char const * _hexeditor_export_formats[HEEF_COUNT] =
+{
+	N_("Raw binary"), N_("C array"), N_("Python array"), "Base64",
+	"Intel HEX", "Motorola S-record", N_("Hexadecimal dump (xxd)")
+};
+
+static char const * _hexeditor_search_types[HEST_COUNT] =
+{
+	N_("Hexadecimal"), N_("Text"), N_("Regular expression")
+};
+
 static DesktopToolbar _hexeditor_toolbar[] =
 {
 	{ N_("Open"), G_CALLBACK(_hexeditor_on_open), GTK_STOCK_OPEN, 0, 0,
 		NULL },
+	{ N_("Go to"), G_CALLBACK(_hexeditor_on_goto), GTK_STOCK_JUMP_TO, 0, 0,
+		NULL },
+	{ N_("Refresh"), G_CALLBACK(_hexeditor_on_refresh), GTK_STOCK_REFRESH,
+		0, 0, NULL },
 #ifdef EMBEDDED
 	{ "", NULL, NULL, 0, 0, NULL },
 	{ N_("Properties"), G_CALLBACK(_hexeditor_on_properties),
@@ -157,37 +460,126 @@ static DesktopToolbar _hexeditor_toolbar[] =
 /* public */
 /* functions */
 /* hexeditor_new */
+static GtkWidget * _new_overview(HexEditor * hexeditor);
 static void _new_plugins(HexEditor * hexeditor);
 static void _new_progress(HexEditor * hexeditor);
+static void _new_search(HexEditor * hexeditor);
+static GtkWidget * _new_view(HexEditor * hexeditor, GtkTextBuffer ** tbuf);
 
 HexEditor * hexeditor_new(GtkWidget * window, GtkAccelGroup * group,
 		HexEditorPrefs * prefs, char const * filename)
 {
 	HexEditor * hexeditor;
 	GtkWidget * vbox;
+	GtkWidget * paned;
 	GtkWidget * hpaned;
 	GtkWidget * hbox;
 	GtkWidget * widget;
-	GtkAdjustment * adjustment;
+	GtkToolItem * toolitem;
 	char const * p;
+	size_t i;
 
 	if((hexeditor = object_new(sizeof(*hexeditor))) == NULL)
 		return NULL;
 	/* default preferences */
 	hexeditor->prefs.uppercase = 0;
+	hexeditor->prefs.rowcache = HEXEDITORROWCACHE_BUDGET;
+	hexeditor->prefs.fetcher = 0;
+	hexeditor->prefs.sidecar = 1;
+	hexeditor->prefs.follow = 0;
+	hexeditor->prefs.decompress = 1;
+	hexeditor->prefs.columns = HEXEDITORFORMAT_COLUMNS;
+	hexeditor->prefs.group = 1;
+	hexeditor->prefs.little_endian = 0;
+	hexeditor->prefs.encoding = HEFE_ASCII;
+	hexeditor->prefs.overview = 1;
+	hexeditor->prefs.colors = 0;
 	if((hexeditor->config = config_new()) == NULL
 			|| _hexeditor_config_load(hexeditor) != 0)
 		_hexeditor_error(NULL, _("Error while loading configuration"),
 				1);
 	hexeditor->filename = NULL;
 	hexeditor->fd = -1;
+	hexeditor->buffer = NULL;
+	hexeditor->codec = NULL;
+	hexeditor->process = NULL;
+	hexeditor->spool = NULL;
+	hexeditor->extents = NULL;
+	hexeditor->runs_source = 0;
+	hexeditor->runs_offset = 0;
+	hexeditor->runs_end = 0;
+	hexeditor->fetcher = NULL;
+	hexeditor->fetch_failed = NULL;
+	hexeditor->fetch_failed_cnt = 0;
+	hexeditor->fetch_failed_generation = 0;
+	hexeditor->sidecar = NULL;
+	hexeditor->follow = NULL;
+	hexeditor->follow_size = -1;
 	hexeditor->channel = NULL;
 	hexeditor->source = 0;
+	hexeditor->tail = FALSE;
+	hexeditor->spool_source = 0;
+	hexeditor->spool_grow = 0;
+	hexeditor->spool_wait = FALSE;
+	hexeditor->digest = NULL;
+	hexeditor->verify_source = 0;
+	hexeditor->verify_offset = 0;
+	hexeditor->verify_end = -1;
+	hexeditor->verify_tail = FALSE;
+	hexeditor->verify_buf = NULL;
+	hexeditor->verify_changes = 0;
+	hexeditor->overview = NULL;
+	hexeditor->annotations = hexeditorannotations_new();
+	hexeditor->export = NULL;
+	hexeditor->export_source = 0;
+	hexeditor->export_fd = -1;
+	hexeditor->export_filename = NULL;
+	hexeditor->export_regular = FALSE;
+	hexeditor->transform = NULL;
+	hexeditor->transform_source = 0;
+	hexeditor->transform_offset = 0;
+	hexeditor->transform_fd = -1;
+	hexeditor->transform_filename = NULL;
+	hexeditor->transform_regular = FALSE;
+	hexeditor->search = NULL;
+	hexeditor->search_source = 0;
+	hexeditor->search_pending = NULL;
+	hexeditor->search_annotated = 0;
+	hexeditor->annotations_changed = FALSE;
 	hexeditor->offset = 0;
 	hexeditor->size = 0;
 	hexeditor->time = 0;
 	if(prefs != NULL)
 		hexeditor->prefs = *prefs;
+	hexeditor->format = NULL;
+	hexeditor->rowcache = NULL;
+	if(_hexeditor_view_format(hexeditor) != 0)
+	{
+		/* the defaults always work, but tell why they are used */
+		_hexeditor_error(NULL, error_get(NULL), 1);
+		hexeditor->prefs.columns = HEXEDITORFORMAT_COLUMNS;
+		hexeditor->prefs.group = 1;
+		hexeditor->prefs.encoding = HEFE_ASCII;
+		_hexeditor_view_format(hexeditor);
+	}
+	if(hexeditor->annotations == NULL || hexeditor->format == NULL
+			|| (hexeditor->rowcache = hexeditorrowcache_new(
+					hexeditor->prefs.rowcache)) == NULL)
+	{
+		if(hexeditor->format != NULL)
+			hexeditorformat_delete(hexeditor->format);
+		if(hexeditor->annotations != NULL)
+			hexeditorannotations_delete(hexeditor->annotations);
+		if(hexeditor->config != NULL)
+			config_delete(hexeditor->config);
+		object_delete(hexeditor);
+		return NULL;
+	}
+	hexeditor->view_addr_width = 8;
+	hexeditor->view_row_height = 0;
+	hexeditor->view_rows = 0;
+	hexeditor->view_source = 0;
+	hexeditor->se_rows = 0;
 	hexeditor->bold = pango_font_description_new();
 	pango_font_description_set_weight(hexeditor->bold, PANGO_WEIGHT_BOLD);
 	hexeditor->window = window;
@@ -196,6 +588,45 @@ HexEditor * hexeditor_new(GtkWidget * window, GtkAccelGroup * group,
 	vbox = hexeditor->widget;
 	/* toolbar */
 	widget = desktop_toolbar_create(_hexeditor_toolbar, hexeditor, group);
+	hexeditor->tb_follow = gtk_toggle_tool_button_new_from_stock(
+			GTK_STOCK_GOTO_BOTTOM);
+	gtk_tool_button_set_label(GTK_TOOL_BUTTON(hexeditor->tb_follow),
+			_("Follow"));
+	gtk_toggle_tool_button_set_active(GTK_TOGGLE_TOOL_BUTTON(
+				hexeditor->tb_follow),
+			hexeditor->prefs.follow ? TRUE : FALSE);
+	g_signal_connect_swapped(hexeditor->tb_follow, "toggled", G_CALLBACK(
+				_hexeditor_on_follow_toggled), hexeditor);
+	gtk_toolbar_insert(GTK_TOOLBAR(widget), hexeditor->tb_follow, -1);
+	hexeditor->tb_colors = gtk_toggle_tool_button_new_from_stock(
+			GTK_STOCK_SELECT_COLOR);
+	gtk_tool_button_set_label(GTK_TOOL_BUTTON(hexeditor->tb_colors),
+			_("Colors"));
+	gtk_toggle_tool_button_set_active(GTK_TOGGLE_TOOL_BUTTON(
+				hexeditor->tb_colors),
+			hexeditor->prefs.colors ? TRUE : FALSE);
+	g_signal_connect_swapped(hexeditor->tb_colors, "toggled", G_CALLBACK(
+				_hexeditor_on_colors_toggled), hexeditor);
+	gtk_toolbar_insert(GTK_TOOLBAR(widget), hexeditor->tb_colors, -1);
+	toolitem = gtk_tool_item_new();
+#if GTK_CHECK_VERSION(2, 24, 0)
+	hexeditor->tb_encoding = gtk_combo_box_text_new();
+	for(i = 0; i < HEFE_COUNT; i++)
+		gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(
+					hexeditor->tb_encoding),
+				_(_hexeditor_encodings[i]));
+#else
+	hexeditor->tb_encoding = gtk_combo_box_new_text();
+	for(i = 0; i < HEFE_COUNT; i++)
+		gtk_combo_box_append_text(GTK_COMBO_BOX(hexeditor->tb_encoding),
+				_(_hexeditor_encodings[i]));
+#endif
+	gtk_combo_box_set_active(GTK_COMBO_BOX(hexeditor->tb_encoding),
+			hexeditor->prefs.encoding);
+	g_signal_connect_swapped(hexeditor->tb_encoding, "changed", G_CALLBACK(
+				_hexeditor_on_encoding_changed), hexeditor);
+	gtk_container_add(GTK_CONTAINER(toolitem), hexeditor->tb_encoding);
+	gtk_toolbar_insert(GTK_TOOLBAR(widget), toolitem, -1);
 	gtk_box_pack_start(GTK_BOX(vbox), widget, FALSE, TRUE, 0);
 #if GTK_CHECK_VERSION(2, 18, 0)
 	/* infobar */
@@ -221,51 +652,51 @@ HexEditor * hexeditor_new(GtkWidget * window, GtkAccelGroup * group,
 	gtk_paned_set_position(GTK_PANED(hpaned), 500);
 	hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
 	/* view: address */
+	hexeditor->view_addr = _new_view(hexeditor, &hexeditor->view_addr_tbuf);
 	widget = gtk_scrolled_window_new(NULL, NULL);
 	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(widget),
-			GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
-	adjustment = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(
-				widget));
-	hexeditor->view_addr = gtk_text_view_new();
-	hexeditor->view_addr_tbuf = gtk_text_view_get_buffer(
-			GTK_TEXT_VIEW(hexeditor->view_addr));
-	gtk_text_buffer_get_end_iter(hexeditor->view_addr_tbuf,
-			&hexeditor->view_addr_iter);
-	gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(hexeditor->view_addr),
-			FALSE);
-	gtk_text_view_set_editable(GTK_TEXT_VIEW(hexeditor->view_addr), FALSE);
+			GTK_POLICY_NEVER, HEXEDITOR_POLICY_ROWS);
+	g_signal_connect(widget, "size-allocate", G_CALLBACK(
+				_hexeditor_on_view_size_allocate), hexeditor);
 	gtk_container_add(GTK_CONTAINER(widget), hexeditor->view_addr);
 	gtk_box_pack_start(GTK_BOX(hbox), widget, FALSE, TRUE, 0);
 	/* view: hexadecimal */
-	widget = gtk_scrolled_window_new(NULL, adjustment);
+	hexeditor->view_hex = _new_view(hexeditor, &hexeditor->view_hex_tbuf);
+	widget = gtk_scrolled_window_new(NULL, NULL);
 	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(widget),
-			GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-	hexeditor->view_hex = gtk_text_view_new();
-	hexeditor->view_hex_tbuf = gtk_text_view_get_buffer(
-			GTK_TEXT_VIEW(hexeditor->view_hex));
-	gtk_text_buffer_get_end_iter(hexeditor->view_hex_tbuf,
-			&hexeditor->view_hex_iter);
-	gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(hexeditor->view_hex),
-			FALSE);
-	gtk_text_view_set_editable(GTK_TEXT_VIEW(hexeditor->view_hex), FALSE);
+			GTK_POLICY_AUTOMATIC, HEXEDITOR_POLICY_ROWS);
 	gtk_container_add(GTK_CONTAINER(widget), hexeditor->view_hex);
 	gtk_box_pack_start(GTK_BOX(hbox), widget, TRUE, TRUE, 4);
 	/* view: data */
-	widget = gtk_scrolled_window_new(NULL, adjustment);
+	hexeditor->view_data = _new_view(hexeditor, &hexeditor->view_data_tbuf);
+	widget = gtk_scrolled_window_new(NULL, NULL);
 	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(widget),
-			GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
-	hexeditor->view_data = gtk_text_view_new();
-	hexeditor->view_data_tbuf = gtk_text_view_get_buffer(
-			GTK_TEXT_VIEW(hexeditor->view_data));
-	gtk_text_buffer_get_end_iter(hexeditor->view_data_tbuf,
-			&hexeditor->view_data_iter);
-	gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(hexeditor->view_data),
-			FALSE);
-	gtk_text_view_set_editable(GTK_TEXT_VIEW(hexeditor->view_data), FALSE);
+			GTK_POLICY_NEVER, HEXEDITOR_POLICY_ROWS);
 	gtk_container_add(GTK_CONTAINER(widget), hexeditor->view_data);
+	gtk_box_pack_start(GTK_BOX(hbox), widget, FALSE, TRUE, 0);
+	/* view: minimap */
+	hexeditor->view_overview = _new_overview(hexeditor);
+	gtk_box_pack_start(GTK_BOX(hbox), hexeditor->view_overview, FALSE,
+			TRUE, 0);
+	/* view: scrollbar, counted in rows over the whole file */
+	hexeditor->view_adjustment = GTK_ADJUSTMENT(gtk_adjustment_new(0.0,
+				0.0, 0.0, 1.0, 1.0, 0.0));
+	g_signal_connect_swapped(hexeditor->view_adjustment, "value-changed",
+			G_CALLBACK(_hexeditor_on_view_value_changed), hexeditor);
+#if GTK_CHECK_VERSION(3, 0, 0)
+	widget = gtk_scrollbar_new(GTK_ORIENTATION_VERTICAL,
+			hexeditor->view_adjustment);
+#else
+	widget = gtk_vscrollbar_new(hexeditor->view_adjustment);
+#endif
 	gtk_box_pack_start(GTK_BOX(hbox), widget, FALSE, TRUE, 0);
 	gtk_paned_add1(GTK_PANED(hpaned), hbox);
-	gtk_box_pack_start(GTK_BOX(vbox), hpaned, TRUE, TRUE, 0);
+	/* search, next to the plug-ins */
+	paned = gtk_paned_new(GTK_ORIENTATION_HORIZONTAL);
+	gtk_paned_pack1(GTK_PANED(paned), hpaned, TRUE, FALSE);
+	_new_search(hexeditor);
+	gtk_paned_pack2(GTK_PANED(paned), hexeditor->se_view, FALSE, TRUE);
+	gtk_box_pack_start(GTK_BOX(vbox), paned, TRUE, TRUE, 0);
 	p = (hexeditor->config != NULL)
 		? config_get(hexeditor->config, NULL, "font") : NULL;
 	hexeditor_set_font(hexeditor, p);
@@ -281,6 +712,30 @@ HexEditor * hexeditor_new(GtkWidget * window, GtkAccelGroup * group,
 	return hexeditor;
 }
 
+static GtkWidget * _new_overview(HexEditor * hexeditor)
+{
+	GtkWidget * widget;
+
+	widget = gtk_drawing_area_new();
+	gtk_widget_set_size_request(widget, HEXEDITOR_OVERVIEW_WIDTH, -1);
+	gtk_widget_add_events(widget, GDK_BUTTON_PRESS_MASK
+			| GDK_BUTTON_MOTION_MASK);
+#if GTK_CHECK_VERSION(3, 0, 0)
+	g_signal_connect(widget, "draw", G_CALLBACK(
+				_hexeditor_on_overview_draw), hexeditor);
+#else
+	g_signal_connect(widget, "expose-event", G_CALLBACK(
+				_hexeditor_on_overview_expose), hexeditor);
+#endif
+	g_signal_connect(widget, "button-press-event", G_CALLBACK(
+				_hexeditor_on_overview_button_press),
+			hexeditor);
+	g_signal_connect(widget, "motion-notify-event", G_CALLBACK(
+				_hexeditor_on_overview_motion), hexeditor);
+	gtk_widget_set_no_show_all(widget, !hexeditor->prefs.overview);
+	return widget;
+}
+
 static void _new_plugins(HexEditor * hexeditor)
 {
 	GtkCellRenderer * renderer;
@@ -292,6 +747,10 @@ static void _new_plugins(HexEditor * hexeditor)
 	hexeditor->pl_view = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
 	gtk_container_set_border_width(GTK_CONTAINER(hexeditor->pl_view), 4);
 	gtk_widget_set_no_show_all(hexeditor->pl_view, TRUE);
+	hexeditor->pl_format = gtk_label_new(NULL);
+	gtk_misc_set_alignment(GTK_MISC(hexeditor->pl_format), 0.0, 0.5);
+	gtk_box_pack_start(GTK_BOX(hexeditor->pl_view), hexeditor->pl_format,
+			FALSE, TRUE, 0);
 	hexeditor->pl_store = gtk_list_store_new(HEPC_COUNT, G_TYPE_STRING,
 			G_TYPE_BOOLEAN, GDK_TYPE_PIXBUF, G_TYPE_STRING,
 			G_TYPE_POINTER, G_TYPE_POINTER, G_TYPE_POINTER,
@@ -317,6 +776,10 @@ static void _new_plugins(HexEditor * hexeditor)
 			TRUE, 0);
 	hexeditor->pl_helper.hexeditor = hexeditor;
 	hexeditor->pl_helper.error = _hexeditor_error;
+	hexeditor->pl_helper.read = _hexeditor_plugin_read;
+	hexeditor->pl_helper.get_size = _hexeditor_plugin_get_size;
+	hexeditor->pl_helper.annotate = _hexeditor_plugin_annotate;
+	hexeditor->pl_helper.annotate_clear = _hexeditor_plugin_annotate_clear;
 	/* load the plug-ins */
 	if((plugins = config_get(hexeditor->config, NULL, "plugins")) == NULL
 			|| strlen(plugins) == 0)
@@ -348,7 +811,6 @@ static void _new_progress(HexEditor * hexeditor)
 	gtk_container_set_border_width(GTK_CONTAINER(hexeditor->pg_window), 16);
 	gtk_window_set_decorated(GTK_WINDOW(hexeditor->pg_window), FALSE);
 	gtk_window_set_default_size(GTK_WINDOW(hexeditor->pg_window), 200, 50);
-	gtk_window_set_modal(GTK_WINDOW(hexeditor->pg_window), TRUE);
 	gtk_window_set_title(GTK_WINDOW(hexeditor->pg_window), _("Progress"));
 	gtk_window_set_transient_for(GTK_WINDOW(hexeditor->pg_window),
 			GTK_WINDOW(hexeditor->window));
@@ -372,6 +834,83 @@ static void _new_progress(HexEditor * hexeditor)
 	gtk_container_add(GTK_CONTAINER(hexeditor->pg_window), hbox);
 }
 
+static void _new_search(HexEditor * hexeditor)
+{
+	GtkWidget * hbox;
+	GtkWidget * widget;
+
+	hexeditor->se_view = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
+	gtk_container_set_border_width(GTK_CONTAINER(hexeditor->se_view), 4);
+	gtk_widget_set_no_show_all(hexeditor->se_view, TRUE);
+	hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+	hexeditor->se_label = gtk_label_new(NULL);
+	gtk_misc_set_alignment(GTK_MISC(hexeditor->se_label), 0.0, 0.5);
+	gtk_box_pack_start(GTK_BOX(hbox), hexeditor->se_label, TRUE, TRUE, 0);
+	widget = gtk_button_new();
+	gtk_button_set_image(GTK_BUTTON(widget), gtk_image_new_from_stock(
+				GTK_STOCK_CLOSE, GTK_ICON_SIZE_MENU));
+	gtk_button_set_relief(GTK_BUTTON(widget), GTK_RELIEF_NONE);
+	g_signal_connect_swapped(widget, "clicked", G_CALLBACK(
+				_hexeditor_on_search_close), hexeditor);
+	gtk_box_pack_start(GTK_BOX(hbox), widget, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(hexeditor->se_view), hbox, FALSE, TRUE, 0);
+	/* the hits, only the rows displayed are rendered */
+	hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 0);
+	hexeditor->se_text = gtk_text_view_new();
+	hexeditor->se_tbuf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(
+				hexeditor->se_text));
+	gtk_text_buffer_create_tag(hexeditor->se_tbuf, "hit", "weight",
+			PANGO_WEIGHT_BOLD, NULL);
+	gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(hexeditor->se_text),
+			FALSE);
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(hexeditor->se_text), FALSE);
+	g_signal_connect(hexeditor->se_text, "button-press-event", G_CALLBACK(
+				_hexeditor_on_search_button_press), hexeditor);
+	g_signal_connect(hexeditor->se_text, "scroll-event", G_CALLBACK(
+				_hexeditor_on_search_scroll), hexeditor);
+	widget = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(widget),
+			GTK_POLICY_AUTOMATIC, HEXEDITOR_POLICY_ROWS);
+	g_signal_connect(widget, "size-allocate", G_CALLBACK(
+				_hexeditor_on_search_size_allocate), hexeditor);
+	gtk_container_add(GTK_CONTAINER(widget), hexeditor->se_text);
+	gtk_box_pack_start(GTK_BOX(hbox), widget, TRUE, TRUE, 0);
+	hexeditor->se_adjustment = GTK_ADJUSTMENT(gtk_adjustment_new(0.0, 0.0,
+				0.0, 1.0, 1.0, 0.0));
+	g_signal_connect_swapped(hexeditor->se_adjustment, "value-changed",
+			G_CALLBACK(_hexeditor_on_search_value_changed),
+			hexeditor);
+#if GTK_CHECK_VERSION(3, 0, 0)
+	widget = gtk_scrollbar_new(GTK_ORIENTATION_VERTICAL,
+			hexeditor->se_adjustment);
+#else
+	widget = gtk_vscrollbar_new(hexeditor->se_adjustment);
+#endif
+	gtk_box_pack_start(GTK_BOX(hbox), widget, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(hexeditor->se_view), hbox, TRUE, TRUE, 0);
+}
+
+static GtkWidget * _new_view(HexEditor * hexeditor, GtkTextBuffer ** tbuf)
+{
+	GtkWidget * view;
+
+	view = gtk_text_view_new();
+	*tbuf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(view));
+	gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(view), FALSE);
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(view), FALSE);
+	g_signal_connect(view, "button-press-event", G_CALLBACK(
+				_hexeditor_on_view_button_press), hexeditor);
+	g_signal_connect(view, "key-press-event", G_CALLBACK(
+				_hexeditor_on_view_key_press), hexeditor);
+	g_signal_connect(view, "scroll-event", G_CALLBACK(
+				_hexeditor_on_view_scroll), hexeditor);
+	/* the labels of the annotations */
+	gtk_widget_set_has_tooltip(view, TRUE);
+	g_signal_connect(view, "query-tooltip", G_CALLBACK(
+				_hexeditor_on_view_query_tooltip), hexeditor);
+	return view;
+}
+
 
 /* hexeditor_delete */
 static void _delete_plugins(HexEditor * hexeditor);
@@ -381,6 +920,9 @@ void hexeditor_delete(HexEditor * hexeditor)
 	_hexeditor_close(hexeditor, FALSE);
 	_delete_plugins(hexeditor);
 	pango_font_description_free(hexeditor->bold);
+	hexeditorrowcache_delete(hexeditor->rowcache);
+	hexeditorformat_delete(hexeditor->format);
+	hexeditorannotations_delete(hexeditor->annotations);
 	if(hexeditor->config != NULL)
 		config_delete(hexeditor->config);
 	object_delete(hexeditor);
@@ -416,10 +958,104 @@ GtkWidget * hexeditor_get_widget(HexEditor * hexeditor)
 }
 
 
+/* hexeditor_set_colors */
+void hexeditor_set_colors(HexEditor * hexeditor, gboolean colors)
+{
+	hexeditor->prefs.colors = colors ? 1 : 0;
+	if(gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(
+					hexeditor->tb_colors)) != colors)
+		gtk_toggle_tool_button_set_active(GTK_TOGGLE_TOOL_BUTTON(
+					hexeditor->tb_colors), colors);
+	/* the rows are formatted again, with or without their classes */
+	if(hexeditor->rowcache != NULL)
+		hexeditorrowcache_expire(hexeditor->rowcache,
+				hexeditor->prefs.columns,
+				_hexeditor_view_flags(hexeditor));
+	_hexeditor_view_render(hexeditor);
+}
+
+
+/* hexeditor_set_columns */
+void hexeditor_set_columns(HexEditor * hexeditor, size_t columns)
+{
+	const size_t previous = hexeditor->prefs.columns;
+	off_t offset = -1;
+	off_t rows;
+	off_t collapsed;
+	HexEditorExtentsType type;
+
+	if(columns == previous)
+		return;
+	/* keep the same data at the top of the view */
+	if(hexeditor->buffer != NULL)
+		offset = _hexeditor_view_offset(hexeditor,
+				gtk_adjustment_get_value(
+					hexeditor->view_adjustment), &rows,
+				&collapsed, &type);
+	hexeditor->prefs.columns = columns;
+	if(_hexeditor_view_format(hexeditor) != 0)
+	{
+		hexeditor->prefs.columns = previous;
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		return;
+	}
+	/* the rows are numbered differently, and their runs found again */
+	if(hexeditor->buffer != NULL)
+	{
+		_hexeditor_extents_open(hexeditor, FALSE);
+		_hexeditor_runs_start(hexeditor);
+	}
+	_hexeditor_view_refresh(hexeditor);
+	if(offset >= 0)
+		_hexeditor_view_scroll_to(hexeditor, _hexeditor_view_row(
+					hexeditor, offset));
+}
+
+
+/* hexeditor_set_encoding */
+int hexeditor_set_encoding(HexEditor * hexeditor, char const * encoding)
+{
+	HexEditorFormatEncoding e;
+	const unsigned int previous = hexeditor->prefs.encoding;
+
+	if(hexeditorformat_get_encoding_by_name(encoding, &e) != 0)
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	hexeditor->prefs.encoding = e;
+	/* only the rows are formatted again */
+	if(_hexeditor_view_format(hexeditor) != 0)
+	{
+		hexeditor->prefs.encoding = previous;
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	}
+	if(gtk_combo_box_get_active(GTK_COMBO_BOX(hexeditor->tb_encoding))
+			!= (gint)e)
+		gtk_combo_box_set_active(GTK_COMBO_BOX(hexeditor->tb_encoding),
+				e);
+	_hexeditor_view_render(hexeditor);
+	return 0;
+}
+
+
+/* hexeditor_set_follow */
+void hexeditor_set_follow(HexEditor * hexeditor, gboolean follow)
+{
+	hexeditor->prefs.follow = follow ? 1 : 0;
+	if(gtk_toggle_tool_button_get_active(GTK_TOGGLE_TOOL_BUTTON(
+					hexeditor->tb_follow)) != follow)
+		gtk_toggle_tool_button_set_active(GTK_TOGGLE_TOOL_BUTTON(
+					hexeditor->tb_follow), follow);
+	/* the plug-ins were waiting for more data */
+	if(!follow && hexeditor->tail)
+		_hexeditor_scan_finish(hexeditor, TRUE);
+}
+
+
 /* hexeditor_set_font */
 void hexeditor_set_font(HexEditor * hexeditor, char const * font)
 {
 	PangoFontDescription * desc;
+	PangoLayout * layout;
+	GtkAllocation allocation;
 
 	if(font == NULL)
 	{
@@ -431,723 +1067,5041 @@ void hexeditor_set_font(HexEditor * hexeditor, char const * font)
 	gtk_widget_override_font(hexeditor->view_addr, desc);
 	gtk_widget_override_font(hexeditor->view_hex, desc);
 	gtk_widget_override_font(hexeditor->view_data, desc);
+	gtk_widget_override_font(hexeditor->se_text, desc);
+	/* measure the height of a row */
+	layout = gtk_widget_create_pango_layout(hexeditor->view_hex, "0");
+	pango_layout_set_font_description(layout, desc);
+	pango_layout_get_pixel_size(layout, NULL, &hexeditor->view_row_height);
+	g_object_unref(layout);
 	pango_font_description_free(desc);
+	/* the number of visible rows depends on the font */
+	gtk_widget_get_allocation(gtk_widget_get_parent(hexeditor->view_addr),
+			&allocation);
+	hexeditor->view_rows = (hexeditor->view_row_height > 0
+			&& allocation.height > 0)
+		? allocation.height / hexeditor->view_row_height : 0;
+	_hexeditor_view_queue(hexeditor);
+}
+
+
+/* hexeditor_set_group */
+void hexeditor_set_group(HexEditor * hexeditor, size_t group,
+		gboolean little_endian)
+{
+	const size_t previous = hexeditor->prefs.group;
+	const int endian = hexeditor->prefs.little_endian;
+
+	hexeditor->prefs.group = group;
+	hexeditor->prefs.little_endian = little_endian ? 1 : 0;
+	if(_hexeditor_view_format(hexeditor) != 0)
+	{
+		/* only 1, 2, 4 or 8 bytes, dividing the rows */
+		hexeditor->prefs.group = previous;
+		hexeditor->prefs.little_endian = endian;
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+	}
+	else
+		_hexeditor_view_render(hexeditor);
+}
+
+
+/* hexeditor_set_uppercase */
+void hexeditor_set_uppercase(HexEditor * hexeditor, gboolean uppercase)
+{
+	hexeditor->prefs.uppercase = uppercase ? 1 : 0;
+	if(_hexeditor_view_format(hexeditor) != 0)
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+	else
+		_hexeditor_view_render(hexeditor);
 }
 
 
 /* useful */
-/* hexeditor_close */
-void hexeditor_close(HexEditor * hexeditor)
+/* hexeditor_annotate */
+int hexeditor_annotate(HexEditor * hexeditor, off_t offset, off_t size,
+		char const * label, unsigned int color)
 {
-	_hexeditor_close(hexeditor, TRUE);
+	HexEditorAnnotation annotation;
+
+	if(hexeditor->buffer == NULL)
+		return -1;
+	annotation.offset = offset;
+	annotation.size = size;
+	annotation.type = HEAT_USER;
+	annotation.color = color;
+	annotation.label = label;
+	if(hexeditorannotations_add(hexeditor->annotations, &annotation) != 0)
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	hexeditor->annotations_changed = TRUE;
+	_hexeditor_view_queue(hexeditor);
+	return 0;
 }
 
 
-/* hexeditor_load */
-int hexeditor_load(HexEditor * hexeditor, char const * plugin)
+/* hexeditor_annotate_dialog */
+static GtkWidget * _annotate_dialog_field(GtkWidget * vbox,
+		GtkSizeGroup * group, char const * label, GtkWidget * widget);
+static int _annotate_dialog_value(GtkWidget * entry, off_t * value);
+
+int hexeditor_annotate_dialog(HexEditor * hexeditor)
 {
-	Plugin * p;
-	HexEditorPluginDefinition * hepd;
-	HexEditorPlugin * hep;
-	GtkWidget * widget;
-	GtkTreeIter iter;
-	GtkIconTheme * theme;
-	GdkPixbuf * icon = NULL;
+	int ret = -1;
+	const unsigned int flags = GTK_DIALOG_MODAL
+		| GTK_DIALOG_DESTROY_WITH_PARENT;
+	GtkWidget * dialog;
+	GtkWidget * vbox;
+	GtkSizeGroup * group;
+	GtkWidget * entry_offset;
+	GtkWidget * entry_size;
+	GtkWidget * entry_label;
+	GtkWidget * button;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	GdkRGBA rgba;
+#else
+	GdkColor gcolor;
+#endif
+	unsigned int color = _hexeditor_annotation_colors[HEAT_USER];
+	char buf[32];
+	char const * label;
+	off_t offset;
+	off_t size;
+	off_t rows;
+	off_t collapsed;
+	HexEditorExtentsType type;
+	int response;
 
-#ifdef DEBUG
-	fprintf(stderr, "DEBUG: %s(\"%s\")\n", __func__, plugin);
+	if(hexeditor->buffer == NULL)
+		return -1;
+	dialog = gtk_dialog_new_with_buttons(_("Annotate..."),
+			GTK_WINDOW(hexeditor->window), flags,
+			GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+			GTK_STOCK_REMOVE, GTK_RESPONSE_REJECT,
+			GTK_STOCK_OK, GTK_RESPONSE_ACCEPT, NULL);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog),
+			GTK_RESPONSE_ACCEPT);
+#if GTK_CHECK_VERSION(2, 14, 0)
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+#else
+	vbox = dialog->vbox;
 #endif
-	if(_hexeditor_plugin_is_enabled(hexeditor, plugin))
-		return 0;
-	if((p = plugin_new(LIBDIR, PACKAGE, "plugins", plugin)) == NULL)
-		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
-	if((hepd = plugin_lookup(p, "plugin")) == NULL)
-	{
-		plugin_delete(p);
-		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
-	}
-	if(hepd->init == NULL || hepd->destroy == NULL
-			|| hepd->get_widget == NULL
-			|| (hep = hepd->init(&hexeditor->pl_helper)) == NULL)
-	{
-		plugin_delete(p);
-		/* FIXME the error may not be set */
-		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
-	}
-	widget = hepd->get_widget(hep);
-	gtk_widget_hide(widget);
-	theme = gtk_icon_theme_get_default();
-	if(hepd->icon != NULL)
-		icon = gtk_icon_theme_load_icon(theme, hepd->icon, 24, 0, NULL);
-	if(icon == NULL)
-		icon = gtk_icon_theme_load_icon(theme, "gnome-settings", 24, 0,
-				NULL);
-#if GTK_CHECK_VERSION(2, 6, 0)
-	gtk_list_store_insert_with_values(hexeditor->pl_store, &iter, -1,
+	group = gtk_size_group_new(GTK_SIZE_GROUP_HORIZONTAL);
+	/* the first row displayed by default */
+	if((offset = _hexeditor_view_offset(hexeditor, gtk_adjustment_get_value(
+						hexeditor->view_adjustment),
+					&rows, &collapsed, &type)) < 0)
+		offset = 0;
+	snprintf(buf, sizeof(buf), "0x%llx", (unsigned long long)offset);
+	entry_offset = _annotate_dialog_field(vbox, group, _("Offset:"),
+			gtk_entry_new());
+	gtk_entry_set_text(GTK_ENTRY(entry_offset), buf);
+	snprintf(buf, sizeof(buf), "%lu",
+			(unsigned long)hexeditor->prefs.columns);
+	entry_size = _annotate_dialog_field(vbox, group, _("Size:"),
+			gtk_entry_new());
+	gtk_entry_set_text(GTK_ENTRY(entry_size), buf);
+	entry_label = _annotate_dialog_field(vbox, group, _("Label:"),
+			gtk_entry_new());
+#if GTK_CHECK_VERSION(3, 0, 0)
+	rgba.red = ((color >> 16) & 0xff) / 255.0;
+	rgba.green = ((color >> 8) & 0xff) / 255.0;
+	rgba.blue = (color & 0xff) / 255.0;
+	rgba.alpha = 1.0;
+	button = gtk_color_button_new_with_rgba(&rgba);
 #else
-	gtk_list_store_append(hexeditor->pl_store, &iter);
-	gtk_list_store_set(hexeditor->pl_store, &iter,
+	gcolor.red = ((color >> 16) & 0xff) * 0x101;
+	gcolor.green = ((color >> 8) & 0xff) * 0x101;
+	gcolor.blue = (color & 0xff) * 0x101;
+	button = gtk_color_button_new_with_color(&gcolor);
 #endif
-			HEPC_NAME, plugin, HEPC_ICON, icon,
-			HEPC_NAME_DISPLAY, hepd->name,
-			HEPC_PLUGIN, p, HEPC_HEXEDITORPLUGINDEFINITION, hepd,
-			HEPC_HEXEDITORPLUGIN, hep, HEPC_WIDGET, widget, -1);
-	if(icon != NULL)
-		g_object_unref(icon);
-	gtk_box_pack_start(GTK_BOX(hexeditor->pl_box), widget, TRUE, TRUE, 0);
-	if(gtk_widget_get_no_show_all(hexeditor->pl_view) == TRUE)
+	_annotate_dialog_field(vbox, group, _("Color:"), button);
+	g_object_unref(group);
+	gtk_widget_show_all(vbox);
+	response = gtk_dialog_run(GTK_DIALOG(dialog));
+	if(response == GTK_RESPONSE_ACCEPT || response == GTK_RESPONSE_REJECT)
 	{
-		gtk_combo_box_set_active(GTK_COMBO_BOX(hexeditor->pl_combo), 0);
-		gtk_widget_set_no_show_all(hexeditor->pl_view, FALSE);
-		gtk_widget_show_all(hexeditor->pl_view);
+		/* accept decimal, or hexadecimal with the "0x" prefix */
+		if(_annotate_dialog_value(entry_offset, &offset) != 0
+				|| _annotate_dialog_value(entry_size, &size)
+				!= 0 || size == 0)
+			ret = -_hexeditor_error(hexeditor, _("Invalid range"),
+					1);
+		else if(response == GTK_RESPONSE_REJECT)
+		{
+			if(hexeditorannotations_remove(hexeditor->annotations,
+						offset, size) > 0)
+			{
+				hexeditor->annotations_changed = TRUE;
+				_hexeditor_view_queue(hexeditor);
+			}
+			ret = 0;
+		}
+		else
+		{
+#if GTK_CHECK_VERSION(3, 4, 0)
+			gtk_color_chooser_get_rgba(GTK_COLOR_CHOOSER(button),
+					&rgba);
+			color = ((unsigned int)(rgba.red * 255.0) << 16)
+				| ((unsigned int)(rgba.green * 255.0) << 8)
+				| (unsigned int)(rgba.blue * 255.0);
+#elif GTK_CHECK_VERSION(3, 0, 0)
+			gtk_color_button_get_rgba(GTK_COLOR_BUTTON(button),
+					&rgba);
+			color = ((unsigned int)(rgba.red * 255.0) << 16)
+				| ((unsigned int)(rgba.green * 255.0) << 8)
+				| (unsigned int)(rgba.blue * 255.0);
+#else
+			gtk_color_button_get_color(GTK_COLOR_BUTTON(button),
+					&gcolor);
+			color = ((gcolor.red >> 8) << 16)
+				| (gcolor.green & 0xff00) | (gcolor.blue >> 8);
+#endif
+			label = gtk_entry_get_text(GTK_ENTRY(entry_label));
+			ret = hexeditor_annotate(hexeditor, offset, size,
+					(label[0] != '\0') ? label : NULL,
+					color);
+		}
 	}
-	return 0;
+	gtk_widget_destroy(dialog);
+	return ret;
 }
 
+static GtkWidget * _annotate_dialog_field(GtkWidget * vbox,
+		GtkSizeGroup * group, char const * label, GtkWidget * widget)
+{
+	GtkWidget * hbox;
+	GtkWidget * lwidget;
 
-/* hexeditor_open */
-static gboolean _open_on_can_read(GIOChannel * channel, GIOCondition condition,
-		gpointer data);
-static gboolean _open_on_idle(gpointer data);
-static void _open_plugins_read(HexEditor * hexeditor, char const * buf,
-		size_t size);
-static void _open_progress(HexEditor * hexeditor);
-static void _open_read_1(HexEditor * hexeditor, char * buf, gsize pos);
-static void _open_read_16(HexEditor * hexeditor, char * buf, gsize pos);
+	hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+	gtk_container_set_border_width(GTK_CONTAINER(hbox), 4);
+	lwidget = gtk_label_new(label);
+#if GTK_CHECK_VERSION(3, 0, 0)
+	g_object_set(lwidget, "halign", GTK_ALIGN_START, NULL);
+#else
+	gtk_misc_set_alignment(GTK_MISC(lwidget), 0.0, 0.5);
+#endif
+	gtk_size_group_add_widget(group, lwidget);
+	gtk_box_pack_start(GTK_BOX(hbox), lwidget, FALSE, TRUE, 0);
+	if(GTK_IS_ENTRY(widget))
+		gtk_entry_set_activates_default(GTK_ENTRY(widget), TRUE);
+	gtk_box_pack_start(GTK_BOX(hbox), widget, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, TRUE, 0);
+	return widget;
+}
 
-int hexeditor_open(HexEditor * hexeditor, char const * filename)
+static int _annotate_dialog_value(GtkWidget * entry, off_t * value)
 {
-	char buf[256];
+	char const * p;
+	char * q;
+	unsigned long long v;
+
+	p = gtk_entry_get_text(GTK_ENTRY(entry));
+	errno = 0;
+	v = strtoull(p, &q, 0);
+	if(p[0] == '\0' || *q != '\0' || errno != 0 || (off_t)v < 0)
+		return -1;
+	*value = v;
+	return 0;
+}
+
+
+/* hexeditor_annotations_load */
+int hexeditor_annotations_load(HexEditor * hexeditor, char const * filename)
+{
+	int ret;
+	HexEditorAnnotations * annotations;
 	gchar * p;
-	struct stat st;
+	gsize size;
+	GError * error = NULL;
 
+	if(hexeditor->buffer == NULL)
+		return -1;
 	if(filename == NULL)
-		return hexeditor_open_dialog(hexeditor);
-	hexeditor_close(hexeditor);
-	if((hexeditor->filename = strdup(filename)) == NULL)
-		return -_hexeditor_error(hexeditor, strerror(errno), 1);
-	if((hexeditor->fd = open(filename, O_RDONLY)) < 0)
 	{
-		free(hexeditor->filename);
-		hexeditor->filename = NULL;
-		return -_hexeditor_error(hexeditor, strerror(errno), 1);
+		if((p = _hexeditor_filename(hexeditor,
+						_("Load annotations..."),
+						FALSE)) == NULL)
+			return -1;
+		ret = hexeditor_annotations_load(hexeditor, p);
+		g_free(p);
+		return ret;
 	}
-	p = g_filename_display_name(filename);
-	snprintf(buf, sizeof(buf), "%s - %s", _("Hexadecimal editor"), p);
+	if(g_file_get_contents(filename, &p, &size, &error) != TRUE)
+	{
+		ret = -_hexeditor_error(hexeditor, error->message, 1);
+		g_error_free(error);
+		return ret;
+	}
+	annotations = hexeditorannotations_new_from_buffer(p, size);
 	g_free(p);
-	gtk_window_set_title(GTK_WINDOW(hexeditor->window), buf);
-	hexeditor->channel = g_io_channel_unix_new(hexeditor->fd);
-	g_io_channel_set_encoding(hexeditor->channel, NULL, NULL);
-	hexeditor->source = g_io_add_watch(hexeditor->channel, G_IO_IN,
-			_open_on_can_read, hexeditor);
-	hexeditor->offset = 0;
-	hexeditor->size = 0;
-	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(hexeditor->pg_progress),
-			0.0);
-	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(hexeditor->pg_progress), "");
-	if(fstat(hexeditor->fd, &st) == 0)
-		hexeditor->size = st.st_size;
-	hexeditor->time = time(NULL);
-	gtk_widget_show_all(hexeditor->pg_window);
+	if(annotations == NULL)
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	/* replaces the current set */
+	hexeditorannotations_delete(hexeditor->annotations);
+	hexeditor->annotations = annotations;
+	hexeditor->annotations_changed = TRUE;
+	_hexeditor_view_queue(hexeditor);
 	return 0;
 }
 
-static gboolean _open_on_can_read(GIOChannel * channel, GIOCondition condition,
-		gpointer data)
+
+/* hexeditor_annotations_save */
+int hexeditor_annotations_save(HexEditor * hexeditor, char const * filename)
 {
-	HexEditor * hexeditor = data;
-	GIOStatus status;
-	char buf[BUFSIZ];
-	gsize size = sizeof(buf);
+	int ret = 0;
+	gchar * p;
+	void * buf;
+	size_t size;
 	GError * error = NULL;
-	gsize i;
 
-	if(channel != hexeditor->channel || condition != G_IO_IN)
-		return FALSE;
-	status = g_io_channel_read_chars(channel, buf, size, &size, &error);
-	if(status == G_IO_STATUS_AGAIN)
-		/* this status can be ignored */
-		return TRUE;
-	if(status != G_IO_STATUS_NORMAL && status != G_IO_STATUS_EOF)
+	if(hexeditor->buffer == NULL)
+		return -1;
+	if(filename == NULL)
 	{
-		hexeditor->source = 0;
-		hexeditor_close(hexeditor);
-		if(status == G_IO_STATUS_ERROR)
-		{
-			_hexeditor_error(hexeditor, error->message, 1);
-			g_error_free(error);
-		}
-		gtk_widget_hide(hexeditor->pg_window);
-		return FALSE;
+		if((p = _hexeditor_filename(hexeditor,
+						_("Save annotations..."), TRUE))
+				== NULL)
+			return -1;
+		ret = hexeditor_annotations_save(hexeditor, p);
+		g_free(p);
+		return ret;
 	}
-	/* read until the end of a line */
-	for(i = 0; ((hexeditor->offset + i) % 16) != 0 && i < size; i++)
-		_open_read_1(hexeditor, buf, i);
-	/* read complete lines */
-	for(; i + 15 < size; i += 16)
-		_open_read_16(hexeditor, buf, i);
-	/* read until the end of the buffer */
-	for(; i < size; i++)
-		_open_read_1(hexeditor, buf, i);
-	/* tell the plug-ins */
-	_open_plugins_read(hexeditor, buf, size);
-	hexeditor->offset += size;
-	if(status == G_IO_STATUS_EOF)
+	if(hexeditorannotations_get_buffer(hexeditor->annotations, &buf,
+				&size) != 0)
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	if(g_file_set_contents(filename, buf, size, &error) != TRUE)
 	{
-		/* tell the plug-ins if relevant */
-		if(size != 0)
-			_open_plugins_read(hexeditor, NULL, 0);
-		hexeditor->source = 0;
-		gtk_widget_set_sensitive(hexeditor->view_addr, TRUE);
-		gtk_widget_set_sensitive(hexeditor->view_hex, TRUE);
-		gtk_widget_set_sensitive(hexeditor->view_data, TRUE);
-		gtk_widget_hide(hexeditor->pg_window);
-		return FALSE;
+		ret = -_hexeditor_error(hexeditor, error->message, 1);
+		g_error_free(error);
 	}
-	_open_progress(hexeditor);
-	hexeditor->source = g_idle_add(_open_on_idle, hexeditor);
-	return FALSE;
+	free(buf);
+	return ret;
 }
 
-static gboolean _open_on_idle(gpointer data)
-{
-	HexEditor * hexeditor = data;
-
-	hexeditor->source = g_io_add_watch(hexeditor->channel, G_IO_IN,
-			_open_on_can_read, hexeditor);
-	return FALSE;
-}
 
-static void _open_plugins_read(HexEditor * hexeditor, char const * buf,
-		size_t size)
+/* hexeditor_close */
+void hexeditor_close(HexEditor * hexeditor)
 {
-	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
-	GtkTreeIter iter;
-	gboolean valid;
-	HexEditorPluginDefinition * hepd;
-	HexEditorPlugin * hep;
-
-	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
-			valid = gtk_tree_model_iter_next(model, &iter))
-	{
-		gtk_tree_model_get(model, &iter,
-				HEPC_HEXEDITORPLUGINDEFINITION, &hepd,
-				HEPC_HEXEDITORPLUGIN, &hep, -1);
-		if(hepd->read != NULL)
-			hepd->read(hep, hexeditor->offset, buf, size);
-	}
+	_hexeditor_close(hexeditor, TRUE);
 }
 
-static void _open_progress(HexEditor * hexeditor)
+
+/* hexeditor_export */
+int hexeditor_export(HexEditor * hexeditor, char const * filename,
+		unsigned int format, off_t offset, off_t size)
 {
-	time_t t;
-	gdouble fraction;
-	char buf[16];
-	GtkProgressBar * progress = GTK_PROGRESS_BAR(hexeditor->pg_progress);
+	HexEditorExport * export;
+	int fd;
+	gboolean regular;
 
-	/* pulse the progress bar once per second */
-	if((t = time(NULL)) <= hexeditor->time)
-		return;
-	hexeditor->time = t;
-	if(hexeditor->size == 0)
+	if(hexeditor->buffer == NULL)
+		return -1;
+	if(hexeditor->export != NULL || hexeditor->transform != NULL
+			|| hexeditor->search_source != 0)
+		return -_hexeditor_error(hexeditor,
+				_("Another operation is in progress"), 1);
+	if(offset >= hexeditor->size || size == 0)
+		return -_hexeditor_error(hexeditor, _("Invalid range"), 1);
+	if(size > hexeditor->size - offset)
+		size = hexeditor->size - offset;
+	if((fd = _hexeditor_open_output(hexeditor, filename, NULL, &regular))
+			< 0)
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	/* read the file directly, without going through the pages */
+	if(hexeditor->codec != NULL)
+		export = hexeditorexport_new_reader(format,
+				_hexeditor_on_codec_read, hexeditor->codec,
+				offset, size, fd);
+	else if(hexeditor->process != NULL)
+		export = hexeditorexport_new_reader(format,
+				_hexeditor_on_process_read, hexeditor->process,
+				offset, size, fd);
+	else if(hexeditor->spool != NULL)
+		export = hexeditorexport_new_reader(format,
+				_hexeditor_on_spool_read, hexeditor->spool,
+				offset, size, fd);
+	else
+		export = hexeditorexport_new(format, hexeditor->fd, offset,
+				size, fd);
+	if(export != NULL && (hexeditor->export_filename = strdup(filename))
+			== NULL)
 	{
-		gtk_progress_bar_pulse(progress);
-		return;
-	}
-	fraction = hexeditor->offset;
-	fraction = fraction / hexeditor->size;
-	gtk_progress_bar_set_fraction(progress, fraction);
-	snprintf(buf, sizeof(buf), "%.1f%%", fraction * 100);
-	gtk_progress_bar_set_text(progress, buf);
-}
-
-static void _open_read_1(HexEditor * hexeditor, char * buf, gsize pos)
-{
-	char buf2[16];
-	GtkTextBuffer * taddr;
-	GtkTextBuffer * thex;
-	GtkTextBuffer * tdata;
-	int c;
-	int size;
-
-	taddr = hexeditor->view_addr_tbuf;
-	thex = hexeditor->view_hex_tbuf;
-	tdata = hexeditor->view_data_tbuf;
-	c = (unsigned char)buf[pos];
-	if(((hexeditor->offset + pos) % 16) == 0)
-	{
-		/* address */
-		size = snprintf(buf2, sizeof(buf2), hexeditor->prefs.uppercase
-				? "%s%08X" : "%s%08x",
-				(hexeditor->offset + pos) ? "\n" : "",
-				(unsigned int)(hexeditor->offset + pos));
-		gtk_text_buffer_insert(taddr, &hexeditor->view_addr_iter,
-				buf2, size);
-		/* hexadecimal value */
-		size = snprintf(buf2, sizeof(buf2), hexeditor->prefs.uppercase
-				? "%s%02X" : "%s%02x",
-				(hexeditor->offset + pos) ? "\n" : "", c);
-		gtk_text_buffer_insert(thex, &hexeditor->view_hex_iter,
-				buf2, size);
-		if(hexeditor->offset + pos != 0)
-			/* character value */
-			gtk_text_buffer_insert(tdata,
-					&hexeditor->view_data_iter, "\n", 1);
+		error_set_code(1, "%s", strerror(errno));
+		hexeditorexport_delete(export);
+		export = NULL;
 	}
-	else
+	if(export == NULL)
 	{
-		/* hexadecimal value */
-		size = snprintf(buf2, sizeof(buf2), hexeditor->prefs.uppercase
-				? " %02X" : " %02x", c);
-		gtk_text_buffer_insert(thex, &hexeditor->view_hex_iter,
-				buf2, size);
-	}
-	/* character value */
-	size = snprintf(buf2, sizeof(buf2), "%c", (isascii(c) && isprint(c))
-			? c : '.');
-	gtk_text_buffer_insert(tdata, &hexeditor->view_data_iter, buf2, size);
-}
-
-static void _open_read_16(HexEditor * hexeditor, char * buf, gsize pos)
-{
-	GtkTextBuffer * taddr;
-	GtkTextBuffer * thex;
-	GtkTextBuffer * tdata;
-	unsigned char c[16];
-	int i;
-	char buf2[64];
-
-	taddr = hexeditor->view_addr_tbuf;
-	thex = hexeditor->view_hex_tbuf;
-	tdata = hexeditor->view_data_tbuf;
-	/* address */
-	i = snprintf(buf2, sizeof(buf2), hexeditor->prefs.uppercase
-			? "%s%08X" : "%s%08x",
-			(hexeditor->offset + pos) ? "\n" : "",
-			(unsigned int)(hexeditor->offset + pos));
-	gtk_text_buffer_insert(taddr, &hexeditor->view_addr_iter, buf2, i);
-	/* hexadecimal values */
-	for(i = 0; i < 16; i++)
-		c[i] = (unsigned char)buf[pos + i];
-	i = snprintf(buf2, sizeof(buf2), hexeditor->prefs.uppercase
-			? "%s%02X %02X %02X %02X %02X %02X %02X %02X"
-			" %02X %02X %02X %02X %02X %02X %02X %02X"
-			: "%s%02x %02x %02x %02x %02x %02x %02x %02x"
-			" %02x %02x %02x %02x %02x %02x %02x %02x",
-			(hexeditor->offset + pos) ? "\n" : "",
-			c[0], c[1], c[2], c[3], c[4], c[5], c[6], c[7],
-			c[8], c[9], c[10], c[11], c[12], c[13], c[14], c[15]);
-	gtk_text_buffer_insert(thex, &hexeditor->view_hex_iter, buf2, i);
-	/* character values */
-	if(hexeditor->offset + pos != 0)
-		gtk_text_buffer_insert(tdata, &hexeditor->view_data_iter,
-				"\n", 1);
-	for(i = 0; i < 16; i++)
-		if(!isascii(c[i]) || !isprint(c[i]))
-			c[i] = '.';
-	gtk_text_buffer_insert(tdata, &hexeditor->view_data_iter,
-			(char const *)c, 16);
+		close(fd);
+		if(regular)
+			unlink(filename);
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	}
+	hexeditor->export = export;
+	hexeditor->export_fd = fd;
+	hexeditor->export_regular = regular;
+	hexeditor->export_source = g_idle_add(_hexeditor_on_export, hexeditor);
+	hexeditor->time = 0;
+	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(hexeditor->pg_progress),
+			0.0);
+	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(hexeditor->pg_progress),
+			"");
+	gtk_widget_show_all(hexeditor->pg_window);
+	return 0;
 }
 
 
-/* hexeditor_open_dialog */
-int hexeditor_open_dialog(HexEditor * hexeditor)
+/* hexeditor_export_dialog */
+int hexeditor_export_dialog(HexEditor * hexeditor)
 {
-	int ret;
+	int ret = -1;
 	GtkWidget * dialog;
-	GtkFileFilter * filter;
+	GtkWidget * vbox;
+	GtkSizeGroup * group;
+	GtkWidget * entry_offset;
+	GtkWidget * entry_size;
+	GtkWidget * combo;
+	char buf[32];
 	gchar * filename = NULL;
+	off_t offset;
+	off_t size;
+	int format;
+	size_t i;
 
-	dialog = gtk_file_chooser_dialog_new(_("Open file..."),
+	if(hexeditor->buffer == NULL)
+		return -1;
+	dialog = gtk_file_chooser_dialog_new(_("Export..."),
 			GTK_WINDOW(hexeditor->window),
-			GTK_FILE_CHOOSER_ACTION_OPEN,
+			GTK_FILE_CHOOSER_ACTION_SAVE,
 			GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
-			GTK_STOCK_OPEN, GTK_RESPONSE_ACCEPT, NULL);
-	filter = gtk_file_filter_new();
-	gtk_file_filter_set_name(filter, _("All files"));
-	gtk_file_filter_add_pattern(filter, "*");
-	gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dialog), filter);
+			GTK_STOCK_SAVE, GTK_RESPONSE_ACCEPT, NULL);
+#if GTK_CHECK_VERSION(2, 8, 0)
+	gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dialog),
+			TRUE);
+#endif
+	/* the range, the whole file by default */
+	vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 0);
+	group = gtk_size_group_new(GTK_SIZE_GROUP_HORIZONTAL);
+	entry_offset = _annotate_dialog_field(vbox, group, _("Offset:"),
+			gtk_entry_new());
+	gtk_entry_set_text(GTK_ENTRY(entry_offset), "0x0");
+	snprintf(buf, sizeof(buf), "%llu", (unsigned long long)hexeditor->size);
+	entry_size = _annotate_dialog_field(vbox, group, _("Size:"),
+			gtk_entry_new());
+	gtk_entry_set_text(GTK_ENTRY(entry_size), buf);
+#if GTK_CHECK_VERSION(2, 24, 0)
+	combo = gtk_combo_box_text_new();
+	for(i = 0; i < HEEF_COUNT; i++)
+		gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo),
+				_(_hexeditor_export_formats[i]));
+#else
+	combo = gtk_combo_box_new_text();
+	for(i = 0; i < HEEF_COUNT; i++)
+		gtk_combo_box_append_text(GTK_COMBO_BOX(combo),
+				_(_hexeditor_export_formats[i]));
+#endif
+	gtk_combo_box_set_active(GTK_COMBO_BOX(combo), HEEF_RAW);
+	_annotate_dialog_field(vbox, group, _("Format:"), combo);
+	g_object_unref(group);
+	gtk_widget_show_all(vbox);
+	gtk_file_chooser_set_extra_widget(GTK_FILE_CHOOSER(dialog), vbox);
 	if(gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
-		filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(
-					dialog));
+	{
+		format = gtk_combo_box_get_active(GTK_COMBO_BOX(combo));
+		if(_annotate_dialog_value(entry_offset, &offset) != 0
+				|| _annotate_dialog_value(entry_size, &size)
+				!= 0 || size == 0)
+			_hexeditor_error(hexeditor, _("Invalid range"), 1);
+		else if(format >= 0)
+			filename = gtk_file_chooser_get_filename(
+					GTK_FILE_CHOOSER(dialog));
+	}
 	gtk_widget_destroy(dialog);
 	if(filename == NULL)
 		return -1;
-	ret = hexeditor_open(hexeditor, filename);
+	ret = hexeditor_export(hexeditor, filename, format, offset, size);
 	g_free(filename);
 	return ret;
 }
 
 
-/* hexeditor_show_preferences */
-void hexeditor_show_preferences(HexEditor * hexeditor, gboolean show)
+/* hexeditor_goto */
+int hexeditor_goto(HexEditor * hexeditor, off_t offset)
 {
-	/* FIXME implement */
+	if(hexeditor->buffer == NULL)
+		return -1;
+	if(offset < 0 || offset > hexeditor->size)
+		return -_hexeditor_error(hexeditor, _("Offset out of range"), 1);
+	_hexeditor_view_scroll_to(hexeditor, _hexeditor_view_row(hexeditor,
+				offset));
+	return 0;
 }
 
 
-/* hexeditor_show_properties */
-static GtkWidget * _properties_widget(HexEditor * hexeditor,
-		GtkSizeGroup * group, char const * label, GtkWidget * value);
+/* hexeditor_goto_bookmark */
+int hexeditor_goto_bookmark(HexEditor * hexeditor)
+{
+	HexEditorAnnotation annotation;
+	off_t offset;
+	off_t rows;
+	off_t collapsed;
+	HexEditorExtentsType type;
 
-void hexeditor_show_properties(HexEditor * hexeditor, gboolean show)
+	if(hexeditor->buffer == NULL)
+		return -1;
+	/* the next one past the first row displayed, or the first one */
+	if((offset = _hexeditor_view_offset(hexeditor, gtk_adjustment_get_value(
+						hexeditor->view_adjustment),
+					&rows, &collapsed, &type)) < 0)
+		offset = -1;
+	else
+		offset += hexeditor->prefs.columns - 1;
+	if(hexeditorannotations_get_next(hexeditor->annotations, HEAT_USER,
+				offset, &annotation) != 0
+			&& hexeditorannotations_get_next(
+				hexeditor->annotations, HEAT_USER, -1,
+				&annotation) != 0)
+		return -1;
+	return hexeditor_goto(hexeditor, annotation.offset);
+}
+
+
+/* hexeditor_goto_dialog */
+int hexeditor_goto_dialog(HexEditor * hexeditor)
 {
+	int ret = -1;
 	const unsigned int flags = GTK_DIALOG_MODAL
 		| GTK_DIALOG_DESTROY_WITH_PARENT;
 	GtkWidget * dialog;
-	GtkSizeGroup * hgroup;
-	GtkSizeGroup * vgroup;
 	GtkWidget * vbox;
-	GtkWidget * widget;
-	String * s;
-	gchar * p;
-	gchar * q;
-	GError * error = NULL;
+	GtkWidget * hbox;
+	GtkWidget * entry;
+	char const * p;
+	char * q;
+	unsigned long long offset;
 
-	if(show == FALSE)
-		/* XXX should really hide the window */
-		return;
-	dialog = gtk_message_dialog_new(GTK_WINDOW(hexeditor->window), flags,
-			GTK_MESSAGE_INFO, GTK_BUTTONS_CLOSE,
-#if GTK_CHECK_VERSION(2, 6, 0)
-			"%s", _("Properties"));
-	gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
-#endif
-			"");
-#if GTK_CHECK_VERSION(2, 10, 0)
-	gtk_message_dialog_set_image(GTK_MESSAGE_DIALOG(dialog),
-			gtk_image_new_from_icon_name("gtk-properties",
-				GTK_ICON_SIZE_DIALOG));
-#endif
-	if(hexeditor->filename == NULL)
-		s = string_new(_("Properties"));
-	else
-	{
-		p = g_path_get_basename(hexeditor->filename);
-		s = string_new_format(_("Properties of %s"), p);
-		g_free(p);
-	}
-	if(s != NULL)
-		gtk_window_set_title(GTK_WINDOW(dialog), s);
-	string_delete(s);
-	hgroup = gtk_size_group_new(GTK_SIZE_GROUP_HORIZONTAL);
-	vgroup = gtk_size_group_new(GTK_SIZE_GROUP_VERTICAL);
+	if(hexeditor->buffer == NULL)
+		return -1;
+	dialog = gtk_dialog_new_with_buttons(_("Go to offset..."),
+			GTK_WINDOW(hexeditor->window), flags,
+			GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+			GTK_STOCK_JUMP_TO, GTK_RESPONSE_ACCEPT, NULL);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog),
+			GTK_RESPONSE_ACCEPT);
 #if GTK_CHECK_VERSION(2, 14, 0)
 	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
 #else
 	vbox = dialog->vbox;
 #endif
-	/* filename */
-	/* XXX the filename may be relative */
-	p = g_strdup((hexeditor->filename != NULL) ? hexeditor->filename : "");
-	if((q = g_filename_to_utf8(p, -1, NULL, NULL, &error)) == NULL)
+	hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+	gtk_container_set_border_width(GTK_CONTAINER(hbox), 4);
+	gtk_box_pack_start(GTK_BOX(hbox), gtk_label_new(_("Offset:")), FALSE,
+			TRUE, 0);
+	entry = gtk_entry_new();
+	gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+	gtk_entry_set_text(GTK_ENTRY(entry), "0x");
+	gtk_box_pack_start(GTK_BOX(hbox), entry, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, TRUE, 0);
+	gtk_widget_show_all(vbox);
+	if(gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
 	{
-		_hexeditor_error(NULL, error->message, 1);
-		g_error_free(error);
-		q = p;
+		/* accept decimal, or hexadecimal with the "0x" prefix */
+		p = gtk_entry_get_text(GTK_ENTRY(entry));
+		errno = 0;
+		offset = strtoull(p, &q, 0);
+		if(p[0] == '\0' || *q != '\0' || errno != 0)
+			ret = -_hexeditor_error(hexeditor, _("Invalid offset"),
+					1);
+		else
+			ret = hexeditor_goto(hexeditor, offset);
 	}
-	widget = gtk_entry_new();
-	gtk_editable_set_editable(GTK_EDITABLE(widget), FALSE);
-	gtk_entry_set_text(GTK_ENTRY(widget), q);
-	gtk_size_group_add_widget(vgroup, widget);
-	g_free(p);
-	widget = _properties_widget(hexeditor, hgroup, _("Filename:"), widget);
-	gtk_box_pack_start(GTK_BOX(vbox), widget, FALSE, FALSE, 0);
-	/* FIXME implement more properties */
-	gtk_widget_show_all(vbox);
-	gtk_dialog_run(GTK_DIALOG(dialog));
 	gtk_widget_destroy(dialog);
+	return ret;
 }
 
-static GtkWidget * _properties_widget(HexEditor * hexeditor,
-		GtkSizeGroup * group, char const * label, GtkWidget * value)
+
+/* hexeditor_import */
+int hexeditor_import(HexEditor * hexeditor, char const * input,
+		char const * output)
 {
-	GtkWidget * hbox;
-	GtkWidget * widget;
+	int ret = 0;
+	gchar * p;
+	int in;
+	int out;
+	struct stat st;
+	struct stat st2;
+	gboolean regular;
+	HexEditorImport * import = NULL;
+	char * text;
+	unsigned char * buf;
+	ssize_t len;
 
-	hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
-	widget = gtk_label_new(label);
-	gtk_widget_override_font(widget, hexeditor->bold);
-#if GTK_CHECK_VERSION(3, 0, 0)
-	g_object_set(widget, "halign", GTK_ALIGN_START, NULL);
-#else
-	gtk_misc_set_alignment(GTK_MISC(widget), 0.0, 0.5);
-#endif
-	gtk_size_group_add_widget(group, widget);
-	gtk_box_pack_start(GTK_BOX(hbox), widget, FALSE, TRUE, 0);
-	gtk_box_pack_start(GTK_BOX(hbox), value, TRUE, TRUE, 0);
-	return hbox;
+	/* the text, then where to decode it */
+	if(input == NULL)
+	{
+		if((p = _hexeditor_filename(hexeditor, _("Import..."), FALSE))
+				== NULL)
+			return -1;
+		ret = hexeditor_import(hexeditor, p, output);
+		g_free(p);
+		return ret;
+	}
+	if(output == NULL)
+	{
+		if((p = _hexeditor_filename(hexeditor, _("Save as..."), TRUE))
+				== NULL)
+			return -1;
+		ret = hexeditor_import(hexeditor, input, p);
+		g_free(p);
+		return ret;
+	}
+	if((in = open(input, O_RDONLY)) < 0)
+		return -_hexeditor_error(hexeditor, strerror(errno), 1);
+	/* the text would be gone before it is read */
+	if(fstat(in, &st) == 0 && stat(output, &st2) == 0
+			&& st.st_dev == st2.st_dev && st.st_ino == st2.st_ino)
+	{
+		close(in);
+		return -_hexeditor_error(hexeditor,
+				_("This is the file being imported"), 1);
+	}
+	/* the file being edited is refused as well */
+	if((out = _hexeditor_open_output(hexeditor, output, NULL,
+					&regular)) < 0)
+	{
+		close(in);
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	}
+	text = malloc(HEXEDITOR_IMPORT_SIZE);
+	buf = malloc(HEXEDITOR_IMPORT_SIZE);
+	if(text == NULL || buf == NULL)
+		ret = -error_set_code(1, "%s", strerror(errno));
+	while(ret == 0 && (len = read(in, text, HEXEDITOR_IMPORT_SIZE)) != 0)
+		if(len < 0 && errno != EINTR)
+			ret = -error_set_code(1, "%s", strerror(errno));
+		else if(len > 0)
+			ret = _hexeditor_import(&import, out, text, len,
+					buf);
+	free(text);
+	free(buf);
+	close(in);
+	return _hexeditor_import_finish(hexeditor, import, out, output,
+			regular, ret);
 }
 
 
-/* hexeditor_unload */
-int hexeditor_unload(HexEditor * hexeditor, char const * plugin)
+/* hexeditor_load */
+int hexeditor_load(HexEditor * hexeditor, char const * plugin)
 {
-	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
-	GtkTreeIter iter;
-	gboolean valid;
-	gchar * p;
-	Plugin * pp;
+	Plugin * p;
 	HexEditorPluginDefinition * hepd;
 	HexEditorPlugin * hep;
 	GtkWidget * widget;
+	GtkTreeIter iter;
+	GtkIconTheme * theme;
+	GdkPixbuf * icon = NULL;
 
-	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
-			valid = gtk_tree_model_iter_next(model, &iter))
+#ifdef DEBUG
+	fprintf(stderr, "DEBUG: %s(\"%s\")\n", __func__, plugin);
+#endif
+	if(_hexeditor_plugin_is_enabled(hexeditor, plugin))
+		return 0;
+	if((p = hexeditor_plugin_load(plugin, &hepd)) == NULL)
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	if(hepd->get_widget == NULL
+			|| (hep = hepd->init(&hexeditor->pl_helper)) == NULL)
 	{
-		gtk_tree_model_get(model, &iter, HEPC_NAME, &p,
-				HEPC_PLUGIN, &pp,
+		plugin_delete(p);
+		/* FIXME the error may not be set */
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	}
+	widget = hepd->get_widget(hep);
+	gtk_widget_hide(widget);
+	theme = gtk_icon_theme_get_default();
+	if(hepd->icon != NULL)
+		icon = gtk_icon_theme_load_icon(theme, hepd->icon, 24, 0, NULL);
+	if(icon == NULL)
+		icon = gtk_icon_theme_load_icon(theme, "gnome-settings", 24, 0,
+				NULL);
+#if GTK_CHECK_VERSION(2, 6, 0)
+	gtk_list_store_insert_with_values(hexeditor->pl_store, &iter, -1,
+#else
+	gtk_list_store_append(hexeditor->pl_store, &iter);
+	gtk_list_store_set(hexeditor->pl_store, &iter,
+#endif
+			HEPC_NAME, plugin, HEPC_ICON, icon,
+			HEPC_NAME_DISPLAY, hepd->name,
+			HEPC_PLUGIN, p, HEPC_HEXEDITORPLUGINDEFINITION, hepd,
+			HEPC_HEXEDITORPLUGIN, hep, HEPC_WIDGET, widget, -1);
+	if(icon != NULL)
+		g_object_unref(icon);
+	gtk_box_pack_start(GTK_BOX(hexeditor->pl_box), widget, TRUE, TRUE, 0);
+	if(gtk_widget_get_no_show_all(hexeditor->pl_view) == TRUE)
+	{
+		gtk_combo_box_set_active(GTK_COMBO_BOX(hexeditor->pl_combo), 0);
+		gtk_widget_set_no_show_all(hexeditor->pl_view, FALSE);
+		gtk_widget_show_all(hexeditor->pl_view);
+		/* only the current plug-in is visible */
+		_hexeditor_on_plugin_combo_change(hexeditor);
+	}
+	return 0;
+}
+
+
+/* hexeditor_open */
+static int _open_codec(HexEditor * hexeditor);
+static void _open_detect(HexEditor * hexeditor);
+static gboolean _open_on_can_read(GIOChannel * channel, GIOCondition condition,
+		gpointer data);
+static gboolean _open_on_can_read_hole(HexEditor * hexeditor, off_t end);
+static gboolean _open_on_idle(gpointer data);
+static void _open_plugins_hole(HexEditor * hexeditor, off_t offset,
+		off_t size);
+static void _open_plugins_read(HexEditor * hexeditor, off_t offset,
+		char const * buf, size_t size);
+static int _open_plugins_restore(HexEditor * hexeditor);
+static void _open_plugins_save(HexEditor * hexeditor);
+static void _open_progress(HexEditor * hexeditor);
+
+int hexeditor_open(HexEditor * hexeditor, char const * filename)
+{
+	char buf[256];
+	gchar * p;
+	struct stat st;
+	off_t size;
+
+	if(filename == NULL)
+		return hexeditor_open_dialog(hexeditor);
+	hexeditor_close(hexeditor);
+	if((hexeditor->filename = strdup(filename)) == NULL)
+		return -_hexeditor_error(hexeditor, strerror(errno), 1);
+	hexeditor->fd = (strcmp(filename, "-") == 0) ? dup(STDIN_FILENO)
+		: open(filename, O_RDONLY);
+	if(hexeditor->fd < 0 || fstat(hexeditor->fd, &st) != 0)
+	{
+		_hexeditor_error(hexeditor, strerror(errno), 1);
+		hexeditor_close(hexeditor);
+		return -1;
+	}
+	hexeditor->size = st.st_size;
+	/* pipes and sockets are kept as they are read */
+	if(!S_ISREG(st.st_mode) && lseek(hexeditor->fd, 0, SEEK_CUR) < 0)
+	{
+		hexeditor->size = 0;
+		if((hexeditor->spool = hexeditorspool_new(hexeditor->fd,
+						HEXEDITORSPOOL_MEMORY)) == NULL)
+		{
+			_hexeditor_error(hexeditor, error_get(NULL), 1);
+			hexeditor_close(hexeditor);
+			return -1;
+		}
+	}
+	/* block devices only report their size when seeking */
+	else if(!S_ISREG(st.st_mode)
+			&& (size = lseek(hexeditor->fd, 0, SEEK_END)) > 0
+			&& lseek(hexeditor->fd, 0, SEEK_SET) == 0)
+		hexeditor->size = size;
+	/* the results of a previous analysis, if any */
+	if(S_ISREG(st.st_mode))
+	{
+		_hexeditor_sidecar_open(hexeditor);
+		_hexeditor_annotations_restore(hexeditor);
+	}
+	/* corrupt or truncated files are still displayed as they are */
+	if(hexeditor->prefs.decompress && S_ISREG(st.st_mode)
+			&& _open_codec(hexeditor) != 0)
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+	if(hexeditor->codec != NULL)
+		hexeditor->buffer = hexeditorbuffer_new_reader(
+				_hexeditor_on_codec_read, hexeditor->codec,
+				hexeditor->size, 0);
+	else if(hexeditor->spool != NULL)
+		hexeditor->buffer = hexeditorbuffer_new_reader(
+				_hexeditor_on_spool_read, hexeditor->spool,
+				hexeditor->size, 0);
+	else
+		hexeditor->buffer = hexeditorbuffer_new(hexeditor->fd,
+				hexeditor->size, 0);
+	if(hexeditor->buffer == NULL)
+	{
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		hexeditor_close(hexeditor);
+		return -1;
+	}
+	/* holes are neither displayed nor scanned */
+	_hexeditor_extents_open(hexeditor, FALSE);
+	/* the view may then read asynchronously */
+	if(hexeditor->prefs.fetcher != 0 && hexeditor->codec == NULL
+			&& hexeditor->spool == NULL
+			&& (hexeditor->fetcher = hexeditorfetcher_new(
+					hexeditor->fd,
+					HEXEDITORBUFFER_PAGE_SIZE,
+					(hexeditor->prefs.fetcher > 1)
+					? HEFE_URING : HEFE_THREADS,
+					_hexeditor_on_fetch, hexeditor))
+			== NULL)
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+	/* watch for changes */
+	if(S_ISREG(st.st_mode) && hexeditor->codec == NULL
+			&& (hexeditor->follow = hexeditorfollow_new(filename,
+					hexeditor->fd, _hexeditor_on_follow,
+					hexeditor)) == NULL)
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+	/* pipes are read as the data comes, even without a scan */
+	if(hexeditor->spool != NULL)
+	{
+		hexeditor->channel = g_io_channel_unix_new(hexeditor->fd);
+		hexeditor->spool_source = g_io_add_watch(hexeditor->channel,
+				G_IO_IN | G_IO_HUP,
+				_hexeditor_on_spool_can_read, hexeditor);
+	}
+	p = g_filename_display_name(filename);
+	snprintf(buf, sizeof(buf), "%s - %s", _("Hexadecimal editor"), p);
+	g_free(p);
+	gtk_window_set_title(GTK_WINDOW(hexeditor->window), buf);
+	/* display the first rows right away */
+	_hexeditor_view_width(hexeditor);
+	gtk_widget_set_sensitive(hexeditor->view_addr, TRUE);
+	gtk_widget_set_sensitive(hexeditor->view_hex, TRUE);
+	gtk_widget_set_sensitive(hexeditor->view_data, TRUE);
+	gtk_adjustment_set_value(hexeditor->view_adjustment, 0.0);
+	_hexeditor_view_refresh(hexeditor);
+	/* the results are not final while following the file, and
+	 * compressed files have to be indexed first anyway */
+	if(!hexeditor->prefs.follow && (hexeditor->codec == NULL
+				|| hexeditorcodec_is_complete(
+					hexeditor->codec))
+			&& _open_plugins_restore(hexeditor) == 0)
+	{
+		_open_detect(hexeditor);
+		return 0;
+	}
+	_hexeditor_scan_start(hexeditor);
+	return 0;
+}
+
+static int _open_codec(HexEditor * hexeditor)
+{
+	HexEditorCodecType type;
+	String * dir;
+	String * filename = NULL;
+	uint64_t key = 0;
+
+	if((type = hexeditorcodec_detect(hexeditor->fd)) == HECT_NONE)
+		return 0;
+	/* the index is saved along with the results of the plug-ins */
+	if(hexeditor->sidecar != NULL
+			&& (dir = _hexeditor_get_config_filename(
+					HEXEDITOR_SIDECAR_DIRECTORY)) != NULL)
+	{
+		if(mkdir(dir, 0700) == 0 || errno == EEXIST)
+			filename = string_new_append(
+					hexeditorsidecar_get_filename(
+						hexeditor->sidecar), ".index",
+					NULL);
+		key = hexeditorsidecar_get_key(hexeditor->sidecar);
+		string_delete(dir);
+	}
+	hexeditor->codec = hexeditorcodec_new(hexeditor->fd, type, filename,
+			key);
+	if(filename != NULL)
+		string_delete(filename);
+	if(hexeditor->codec == NULL)
+		return -1;
+	/* known right away if indexed previously */
+	hexeditor->size = hexeditorcodec_get_size(hexeditor->codec);
+	return 0;
+}
+
+static void _open_detect(HexEditor * hexeditor)
+{
+	char buf[HEXEDITOR_SCAN_SIZE];
+	ssize_t size;
+
+	/* the first chunk was not read again */
+	if((size = hexeditorbuffer_read(hexeditor->buffer, 0, buf,
+					sizeof(buf))) >= 0)
+		_hexeditor_detect(hexeditor, buf, size);
+}
+
+static gboolean _open_on_can_read(GIOChannel * channel, GIOCondition condition,
+		gpointer data)
+{
+	HexEditor * hexeditor = data;
+	GIOStatus status;
+	char buf[HEXEDITOR_SCAN_SIZE];
+	gsize size = sizeof(buf);
+	GError * error = NULL;
+	off_t end = 0;
+	int hole = 0;
+	int runs;
+
+	if(channel != hexeditor->channel || condition != G_IO_IN)
+		return FALSE;
+	/* the holes are skipped, the plug-ins are only told about them */
+	if(hexeditor->extents != NULL && (end = hexeditorextents_get_end(
+					hexeditor->extents, hexeditor->offset,
+					&hole)) > hexeditor->offset && hole)
+		return _open_on_can_read_hole(hexeditor, end);
+	else if(hexeditor->extents != NULL && end > hexeditor->offset
+			&& (off_t)size > end - hexeditor->offset)
+		size = end - hexeditor->offset;
+	status = g_io_channel_read_chars(channel, buf, size, &size, &error);
+	if(status == G_IO_STATUS_AGAIN)
+		/* this status can be ignored */
+		return TRUE;
+	if(status != G_IO_STATUS_NORMAL && status != G_IO_STATUS_EOF)
+	{
+		hexeditor->source = 0;
+		hexeditor_close(hexeditor);
+		if(status == G_IO_STATUS_ERROR)
+		{
+			_hexeditor_error(hexeditor, error->message, 1);
+			g_error_free(error);
+		}
+		gtk_widget_hide(hexeditor->pg_window);
+		return FALSE;
+	}
+	/* tell the plug-ins */
+	_open_plugins_read(hexeditor, hexeditor->offset, buf, size);
+	/* collapse the runs of identical rows */
+	if(hexeditor->extents != NULL)
+	{
+		runs = hexeditorextents_scan(hexeditor->extents,
+				hexeditor->offset, buf, size);
+		if(status == G_IO_STATUS_EOF)
+			runs += hexeditorextents_scan(hexeditor->extents,
+					hexeditor->offset + size, NULL, 0);
+		if(runs > 0)
+			_hexeditor_view_queue(hexeditor);
+	}
+	hexeditor->offset += size;
+	if(hexeditor->digest != NULL
+			&& hexeditordigest_append(hexeditor->digest, buf, size)
+			!= 0)
+	{
+		hexeditordigest_delete(hexeditor->digest);
+		hexeditor->digest = NULL;
+	}
+	if(status == G_IO_STATUS_EOF)
+	{
+		hexeditor->source = 0;
+		gtk_widget_hide(hexeditor->pg_window);
+		/* resumed as the file grows */
+		if(hexeditor->prefs.follow && hexeditor->follow != NULL)
+			hexeditor->tail = TRUE;
+		else
+			/* tell the plug-ins if relevant */
+			_hexeditor_scan_finish(hexeditor, (size != 0)
+					? TRUE : FALSE);
+		return FALSE;
+	}
+	_open_progress(hexeditor);
+	hexeditor->source = g_idle_add(_open_on_idle, hexeditor);
+	return FALSE;
+}
+
+static gboolean _open_on_can_read_hole(HexEditor * hexeditor, off_t end)
+{
+	off_t size = end - hexeditor->offset;
+
+	if(lseek(hexeditor->fd, end, SEEK_SET) != end)
+	{
+		hexeditor->source = 0;
+		_hexeditor_error(hexeditor, strerror(errno), 1);
+		gtk_widget_hide(hexeditor->pg_window);
+		return FALSE;
+	}
+	_open_plugins_hole(hexeditor, hexeditor->offset, size);
+	hexeditor->offset = end;
+	if(hexeditor->digest != NULL
+			&& hexeditordigest_append_zero(hexeditor->digest, size)
+			!= 0)
+	{
+		hexeditordigest_delete(hexeditor->digest);
+		hexeditor->digest = NULL;
+	}
+	_open_progress(hexeditor);
+	return TRUE;
+}
+
+static gboolean _open_on_idle(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	hexeditor->source = g_io_add_watch(hexeditor->channel, G_IO_IN,
+			_open_on_can_read, hexeditor);
+	return FALSE;
+}
+
+static void _open_plugins_hole(HexEditor * hexeditor, off_t offset,
+		off_t size)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
+	GtkTreeIter iter;
+	gboolean valid;
+	HexEditorPluginDefinition * hepd;
+	HexEditorPlugin * hep;
+
+	/* the minimap as well */
+	if(hexeditor->overview != NULL)
+		hexeditoroverview_hole(hexeditor->overview, offset, size);
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
+			valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gtk_tree_model_get(model, &iter,
 				HEPC_HEXEDITORPLUGINDEFINITION, &hepd,
-				HEPC_HEXEDITORPLUGIN, &hep,
-				HEPC_WIDGET, &widget, -1);
-		if(strcmp(plugin, p) == 0)
+				HEPC_HEXEDITORPLUGIN, &hep, -1);
+		if(hepd->hole != NULL)
+			hepd->hole(hep, offset, size);
+	}
+}
+
+static void _open_plugins_read(HexEditor * hexeditor, off_t offset,
+		char const * buf, size_t size)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
+	GtkTreeIter iter;
+	gboolean valid;
+	HexEditorPluginDefinition * hepd;
+	HexEditorPlugin * hep;
+
+	/* what the file is, before the plug-ins look at it */
+	if(offset == 0 && buf != NULL)
+		_hexeditor_detect(hexeditor, buf, size);
+	if(hexeditor->overview != NULL)
+		hexeditoroverview_scan(hexeditor->overview, offset, buf, size);
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
+			valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gtk_tree_model_get(model, &iter,
+				HEPC_HEXEDITORPLUGINDEFINITION, &hepd,
+				HEPC_HEXEDITORPLUGIN, &hep, -1);
+		if(hepd->read != NULL)
+			hepd->read(hep, offset, buf, size);
+	}
+}
+
+static int _open_plugins_restore(HexEditor * hexeditor)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
+	GtkTreeIter iter;
+	gboolean valid;
+	gchar * name;
+	String * section;
+	HexEditorPluginDefinition * hepd;
+	HexEditorPlugin * hep;
+	void const * buf;
+	size_t size;
+	int res;
+
+	if(hexeditor->sidecar == NULL)
+		return -1;
+	/* the scan is only skipped if every plug-in is restored */
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
+			valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gtk_tree_model_get(model, &iter, HEPC_NAME, &name,
+				HEPC_HEXEDITORPLUGINDEFINITION, &hepd,
+				HEPC_HEXEDITORPLUGIN, &hep, -1);
+		section = string_new_append("plugin/", name, NULL);
+		g_free(name);
+		if(hepd->read == NULL)
+			res = 0;
+		else if(hepd->restore == NULL || section == NULL
+				|| (buf = hexeditorsidecar_get(
+						hexeditor->sidecar, section,
+						&size)) == NULL)
+			res = -1;
+		else
+			res = hepd->restore(hep, buf, size);
+		if(section != NULL)
+			string_delete(section);
+		if(res != 0)
+		{
+			_close_reset(hexeditor);
+			return -1;
+		}
+	}
+	/* the minimap is scanned again if missing */
+	if(hexeditor->prefs.overview)
+	{
+		if((buf = hexeditorsidecar_get(hexeditor->sidecar, "overview",
+						&size)) == NULL
+				|| (hexeditor->overview
+					= hexeditoroverview_new_from_buffer(
+						buf, size)) == NULL
+				|| hexeditoroverview_get_size(
+					hexeditor->overview)
+				!= hexeditor->size)
+		{
+			_close_reset(hexeditor);
+			return -1;
+		}
+		gtk_widget_queue_draw(hexeditor->view_overview);
+	}
+	/* to detect the changes to come */
+	if((buf = hexeditorsidecar_get(hexeditor->sidecar, "digest", &size))
+			!= NULL)
+		hexeditor->digest = hexeditordigest_new_from_buffer(buf, size);
+	return 0;
+}
+
+static void _open_plugins_save(HexEditor * hexeditor)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
+	GtkTreeIter iter;
+	gboolean valid;
+	gchar * name;
+	String * section;
+	HexEditorPluginDefinition * hepd;
+	HexEditorPlugin * hep;
+	void * buf;
+	size_t size;
+	int cnt = 0;
+
+	if(hexeditor->sidecar == NULL)
+		return;
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
+			valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gtk_tree_model_get(model, &iter, HEPC_NAME, &name,
+				HEPC_HEXEDITORPLUGINDEFINITION, &hepd,
+				HEPC_HEXEDITORPLUGIN, &hep, -1);
+		section = string_new_append("plugin/", name, NULL);
+		g_free(name);
+		buf = NULL;
+		size = 0;
+		if(hepd->save != NULL && section != NULL
+				&& hepd->save(hep, &buf, &size) == 0
+				&& hexeditorsidecar_set(hexeditor->sidecar,
+					section, buf, size) == 0)
+			cnt++;
+		free(buf);
+		if(section != NULL)
+			string_delete(section);
+	}
+	if(hexeditor->overview != NULL
+			&& hexeditoroverview_get_buffer(hexeditor->overview,
+				&buf, &size) == 0)
+	{
+		if(hexeditorsidecar_set(hexeditor->sidecar, "overview", buf,
+					size) == 0)
+			cnt++;
+		free(buf);
+	}
+	if(cnt > 0 && hexeditor->digest != NULL
+			&& hexeditordigest_get_buffer(hexeditor->digest, &buf,
+				&size) == 0)
+	{
+		hexeditorsidecar_set(hexeditor->sidecar, "digest", buf, size);
+		free(buf);
+	}
+	if(cnt > 0 && hexeditorsidecar_save(hexeditor->sidecar) != 0)
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+}
+
+static void _open_progress(HexEditor * hexeditor)
+{
+	time_t t;
+	gdouble fraction;
+	char buf[16];
+	GtkProgressBar * progress = GTK_PROGRESS_BAR(hexeditor->pg_progress);
+
+	/* the export shows its own progress meanwhile */
+	if(hexeditor->export != NULL || hexeditor->transform != NULL
+			|| hexeditor->search_source != 0)
+		return;
+	/* pulse the progress bar once per second */
+	if((t = time(NULL)) <= hexeditor->time)
+		return;
+	hexeditor->time = t;
+	if(hexeditor->codec != NULL)
+		/* the size is only known once decompressed */
+		fraction = hexeditorcodec_get_progress(hexeditor->codec);
+	else if(hexeditor->size == 0 || (hexeditor->spool != NULL
+				&& !hexeditorspool_is_complete(
+					hexeditor->spool)))
+	{
+		gtk_progress_bar_pulse(progress);
+		return;
+	}
+	else
+	{
+		fraction = hexeditor->offset;
+		fraction = fraction / hexeditor->size;
+	}
+	gtk_progress_bar_set_fraction(progress, fraction);
+	snprintf(buf, sizeof(buf), "%.1f%%", fraction * 100);
+	gtk_progress_bar_set_text(progress, buf);
+	gtk_widget_queue_draw(hexeditor->view_overview);
+}
+
+
+/* hexeditor_open_dialog */
+int hexeditor_open_dialog(HexEditor * hexeditor)
+{
+	int ret;
+	GtkWidget * dialog;
+	GtkFileFilter * filter;
+	gchar * filename = NULL;
+
+	dialog = gtk_file_chooser_dialog_new(_("Open file..."),
+			GTK_WINDOW(hexeditor->window),
+			GTK_FILE_CHOOSER_ACTION_OPEN,
+			GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+			GTK_STOCK_OPEN, GTK_RESPONSE_ACCEPT, NULL);
+	filter = gtk_file_filter_new();
+	gtk_file_filter_set_name(filter, _("All files"));
+	gtk_file_filter_add_pattern(filter, "*");
+	gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dialog), filter);
+	if(gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+		filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(
+					dialog));
+	gtk_widget_destroy(dialog);
+	if(filename == NULL)
+		return -1;
+	ret = hexeditor_open(hexeditor, filename);
+	g_free(filename);
+	return ret;
+}
+
+
+/* hexeditor_open_process */
+int hexeditor_open_process(HexEditor * hexeditor, pid_t pid)
+{
+	char buf[256];
+	char const * name;
+
+	hexeditor_close(hexeditor);
+	snprintf(buf, sizeof(buf), "/proc/%ld/mem", (long)pid);
+	if((hexeditor->filename = strdup(buf)) == NULL)
+		return -_hexeditor_error(hexeditor, strerror(errno), 1);
+	/* the mappings form a sparse address space */
+	if((hexeditor->process = hexeditorprocess_new(pid)) == NULL
+			|| (hexeditor->buffer = hexeditorbuffer_new_reader(
+					_hexeditor_on_process_read,
+					hexeditor->process,
+					hexeditorprocess_get_size(
+						hexeditor->process), 0))
+			== NULL)
+	{
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		hexeditor_close(hexeditor);
+		return -1;
+	}
+	hexeditor->size = hexeditorprocess_get_size(hexeditor->process);
+	/* the unmapped ranges are neither displayed nor scanned */
+	_hexeditor_extents_open(hexeditor, FALSE);
+	if((name = hexeditorprocess_get_name(hexeditor->process)) != NULL)
+		snprintf(buf, sizeof(buf), "%s - %s (%ld)",
+				_("Hexadecimal editor"), name, (long)pid);
+	else
+		snprintf(buf, sizeof(buf), "%s - %s %ld",
+				_("Hexadecimal editor"), _("process"),
+				(long)pid);
+	gtk_window_set_title(GTK_WINDOW(hexeditor->window), buf);
+	_hexeditor_view_width(hexeditor);
+	gtk_widget_set_sensitive(hexeditor->view_addr, TRUE);
+	gtk_widget_set_sensitive(hexeditor->view_hex, TRUE);
+	gtk_widget_set_sensitive(hexeditor->view_data, TRUE);
+	gtk_adjustment_set_value(hexeditor->view_adjustment, 0.0);
+	_hexeditor_view_refresh(hexeditor);
+	_hexeditor_scan_start(hexeditor);
+	return 0;
+}
+
+
+/* hexeditor_open_process_dialog */
+int hexeditor_open_process_dialog(HexEditor * hexeditor)
+{
+	int ret = -1;
+	const unsigned int flags = GTK_DIALOG_MODAL
+		| GTK_DIALOG_DESTROY_WITH_PARENT;
+	GtkWidget * dialog;
+	GtkWidget * vbox;
+	GtkWidget * hbox;
+	GtkWidget * entry;
+	char const * p;
+	char * q;
+	long pid;
+
+	dialog = gtk_dialog_new_with_buttons(_("Open process..."),
+			GTK_WINDOW(hexeditor->window), flags,
+			GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+			GTK_STOCK_OPEN, GTK_RESPONSE_ACCEPT, NULL);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog),
+			GTK_RESPONSE_ACCEPT);
+#if GTK_CHECK_VERSION(2, 14, 0)
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+#else
+	vbox = dialog->vbox;
+#endif
+	hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+	gtk_container_set_border_width(GTK_CONTAINER(hbox), 4);
+	gtk_box_pack_start(GTK_BOX(hbox), gtk_label_new(_("Process ID:")),
+			FALSE, TRUE, 0);
+	entry = gtk_entry_new();
+	gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+	gtk_box_pack_start(GTK_BOX(hbox), entry, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, TRUE, 0);
+	gtk_widget_show_all(vbox);
+	if(gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+	{
+		p = gtk_entry_get_text(GTK_ENTRY(entry));
+		errno = 0;
+		pid = strtol(p, &q, 10);
+		if(p[0] == '\0' || *q != '\0' || errno != 0 || pid <= 0
+				|| (pid_t)pid != pid)
+			ret = -_hexeditor_error(hexeditor,
+					_("Invalid process ID"), 1);
+		else
+		{
+			gtk_widget_destroy(dialog);
+			return hexeditor_open_process(hexeditor, pid);
+		}
+	}
+	gtk_widget_destroy(dialog);
+	return ret;
+}
+
+
+/* hexeditor_paste */
+int hexeditor_paste(HexEditor * hexeditor, char const * filename)
+{
+	int ret = 0;
+	gchar * p;
+	gchar * text;
+	int fd;
+	gboolean regular;
+	HexEditorImport * import = NULL;
+	unsigned char * buf;
+	size_t size;
+	size_t i;
+
+	if(filename == NULL)
+	{
+		if((p = _hexeditor_filename(hexeditor, _("Paste as..."), TRUE))
+				== NULL)
+			return -1;
+		ret = hexeditor_paste(hexeditor, p);
+		g_free(p);
+		return ret;
+	}
+	if((text = gtk_clipboard_wait_for_text(gtk_clipboard_get(
+						GDK_SELECTION_CLIPBOARD)))
+			== NULL)
+		return -_hexeditor_error(hexeditor,
+				_("There is no text to paste"), 1);
+	/* the file being edited is refused */
+	if((fd = _hexeditor_open_output(hexeditor, filename, NULL,
+					&regular)) < 0)
+	{
+		g_free(text);
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	}
+	if((buf = malloc(HEXEDITOR_IMPORT_SIZE)) == NULL)
+		ret = -error_set_code(1, "%s", strerror(errno));
+	/* in chunks, the memory used remains bounded */
+	for(i = 0, size = strlen(text); ret == 0 && i < size;
+			i += HEXEDITOR_IMPORT_SIZE)
+		ret = _hexeditor_import(&import, fd, &text[i],
+				(size - i < HEXEDITOR_IMPORT_SIZE) ? size - i
+				: HEXEDITOR_IMPORT_SIZE, buf);
+	free(buf);
+	g_free(text);
+	return _hexeditor_import_finish(hexeditor, import, fd, filename,
+			regular, ret);
+}
+
+
+/* hexeditor_refresh */
+int hexeditor_refresh(HexEditor * hexeditor)
+{
+	HexEditorProcess * process = hexeditor->process;
+
+	/* the files are followed instead */
+	if(process == NULL)
+		return 0;
+	/* the workers read through the mappings */
+	if(hexeditor->export != NULL || hexeditor->transform != NULL
+			|| hexeditor->search_source != 0)
+		return -_hexeditor_error(hexeditor,
+				_("Another operation is in progress"), 1);
+	if(hexeditorprocess_refresh(process) != 0)
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	/* the memory may have changed anywhere, and be mapped differently */
+	hexeditor->size = hexeditorprocess_get_size(process);
+	hexeditorbuffer_flush(hexeditor->buffer);
+	hexeditorbuffer_set_size(hexeditor->buffer, hexeditor->size);
+	hexeditorrowcache_flush(hexeditor->rowcache);
+	_hexeditor_extents_open(hexeditor, FALSE);
+	_hexeditor_view_width(hexeditor);
+	_hexeditor_view_refresh(hexeditor);
+	return 0;
+}
+
+
+/* hexeditor_plugin_load */
+Plugin * hexeditor_plugin_load(char const * plugin,
+		HexEditorPluginDefinition ** definition)
+{
+	Plugin * p;
+
+	if((p = plugin_new(LIBDIR, PACKAGE, "plugins", plugin)) == NULL)
+		return NULL;
+	if((*definition = plugin_lookup(p, "plugin")) == NULL)
+	{
+		plugin_delete(p);
+		return NULL;
+	}
+	/* built against another layout of the definition or the helper */
+	if((*definition)->version != HEXEDITOR_PLUGIN_VERSION)
+	{
+		error_set_code(1, "%s: %s", plugin,
+				_("Incompatible version of the plug-in"));
+		plugin_delete(p);
+		return NULL;
+	}
+	/* the instances have to be released */
+	if((*definition)->init == NULL || (*definition)->destroy == NULL)
+	{
+		error_set_code(1, "%s: %s", plugin, strerror(EINVAL));
+		plugin_delete(p);
+		return NULL;
+	}
+	return p;
+}
+
+
+/* hexeditor_search */
+int hexeditor_search(HexEditor * hexeditor, unsigned char const * pattern,
+		size_t size)
+{
+	HexEditorSearch * search;
+
+	if(hexeditor->buffer == NULL)
+		return -1;
+	if((search = hexeditorsearch_new(pattern, size)) == NULL)
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	return _hexeditor_search(hexeditor, search);
+}
+
+
+/* hexeditor_search_dialog */
+int hexeditor_search_dialog(HexEditor * hexeditor)
+{
+	int ret = -1;
+	const unsigned int flags = GTK_DIALOG_MODAL
+		| GTK_DIALOG_DESTROY_WITH_PARENT;
+	GtkWidget * dialog;
+	GtkWidget * vbox;
+	GtkSizeGroup * group;
+	GtkWidget * entry;
+	GtkWidget * combo;
+	char const * text;
+	unsigned char * pattern = NULL;
+	size_t size = 0;
+	int type = -1;
+	size_t i;
+
+	if(hexeditor->buffer == NULL)
+		return -1;
+	dialog = gtk_dialog_new_with_buttons(_("Find all..."),
+			GTK_WINDOW(hexeditor->window), flags,
+			GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+			GTK_STOCK_FIND, GTK_RESPONSE_ACCEPT, NULL);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog),
+			GTK_RESPONSE_ACCEPT);
+#if GTK_CHECK_VERSION(2, 14, 0)
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+#else
+	vbox = dialog->vbox;
+#endif
+	group = gtk_size_group_new(GTK_SIZE_GROUP_HORIZONTAL);
+	entry = _annotate_dialog_field(vbox, group, _("Pattern:"),
+			gtk_entry_new());
+	gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+#if GTK_CHECK_VERSION(2, 24, 0)
+	combo = gtk_combo_box_text_new();
+	for(i = 0; i < HEST_COUNT; i++)
+		gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo),
+				_(_hexeditor_search_types[i]));
+#else
+	combo = gtk_combo_box_new_text();
+	for(i = 0; i < HEST_COUNT; i++)
+		gtk_combo_box_append_text(GTK_COMBO_BOX(combo),
+				_(_hexeditor_search_types[i]));
+#endif
+	gtk_combo_box_set_active(GTK_COMBO_BOX(combo), HEST_HEXADECIMAL);
+	_annotate_dialog_field(vbox, group, _("Type:"), combo);
+	g_object_unref(group);
+	gtk_widget_show_all(vbox);
+	if(gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+	{
+		text = gtk_entry_get_text(GTK_ENTRY(entry));
+		/* the expressions are compiled when searching */
+		switch((type = gtk_combo_box_get_active(GTK_COMBO_BOX(combo))))
+		{
+			case HEST_HEXADECIMAL:
+				ret = _hexeditor_hex(text, &pattern, &size);
+				break;
+			case HEST_TEXT:
+				pattern = (unsigned char *)strdup(text);
+				if((size = strlen(text)) > 0 && pattern != NULL)
+					ret = 0;
+				break;
+			case HEST_REGEX:
+				if((pattern = (unsigned char *)strdup(text))
+						!= NULL)
+					ret = 0;
+				break;
+		}
+		if(ret != 0)
+			_hexeditor_error(hexeditor, _("Invalid pattern"), 1);
+	}
+	gtk_widget_destroy(dialog);
+	if(ret == 0 && type == HEST_REGEX)
+		ret = hexeditor_search_regex(hexeditor, (char *)pattern);
+	else if(ret == 0)
+		ret = hexeditor_search(hexeditor, pattern, size);
+	free(pattern);
+	return ret;
+}
+
+
+/* hexeditor_search_regex */
+int hexeditor_search_regex(HexEditor * hexeditor, char const * expression)
+{
+	HexEditorSearch * search;
+
+	if(hexeditor->buffer == NULL)
+		return -1;
+	if((search = hexeditorsearch_new_regex(expression)) == NULL)
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	return _hexeditor_search(hexeditor, search);
+}
+
+
+/* hexeditor_show_preferences */
+void hexeditor_show_preferences(HexEditor * hexeditor, gboolean show)
+{
+	/* FIXME implement */
+}
+
+
+/* hexeditor_show_properties */
+static GtkWidget * _properties_widget(HexEditor * hexeditor,
+		GtkSizeGroup * group, char const * label, GtkWidget * value);
+
+void hexeditor_show_properties(HexEditor * hexeditor, gboolean show)
+{
+	const unsigned int flags = GTK_DIALOG_MODAL
+		| GTK_DIALOG_DESTROY_WITH_PARENT;
+	GtkWidget * dialog;
+	GtkSizeGroup * hgroup;
+	GtkSizeGroup * vgroup;
+	GtkWidget * vbox;
+	GtkWidget * widget;
+	String * s;
+	gchar * p;
+	gchar * q;
+	GError * error = NULL;
+
+	if(show == FALSE)
+		/* XXX should really hide the window */
+		return;
+	dialog = gtk_message_dialog_new(GTK_WINDOW(hexeditor->window), flags,
+			GTK_MESSAGE_INFO, GTK_BUTTONS_CLOSE,
+#if GTK_CHECK_VERSION(2, 6, 0)
+			"%s", _("Properties"));
+	gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+#endif
+			"");
+#if GTK_CHECK_VERSION(2, 10, 0)
+	gtk_message_dialog_set_image(GTK_MESSAGE_DIALOG(dialog),
+			gtk_image_new_from_icon_name("gtk-properties",
+				GTK_ICON_SIZE_DIALOG));
+#endif
+	if(hexeditor->filename == NULL)
+		s = string_new(_("Properties"));
+	else
+	{
+		p = g_path_get_basename(hexeditor->filename);
+		s = string_new_format(_("Properties of %s"), p);
+		g_free(p);
+	}
+	if(s != NULL)
+		gtk_window_set_title(GTK_WINDOW(dialog), s);
+	string_delete(s);
+	hgroup = gtk_size_group_new(GTK_SIZE_GROUP_HORIZONTAL);
+	vgroup = gtk_size_group_new(GTK_SIZE_GROUP_VERTICAL);
+#if GTK_CHECK_VERSION(2, 14, 0)
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+#else
+	vbox = dialog->vbox;
+#endif
+	/* filename */
+	/* XXX the filename may be relative */
+	p = g_strdup((hexeditor->filename != NULL) ? hexeditor->filename : "");
+	if((q = g_filename_to_utf8(p, -1, NULL, NULL, &error)) == NULL)
+	{
+		_hexeditor_error(NULL, error->message, 1);
+		g_error_free(error);
+		q = p;
+	}
+	widget = gtk_entry_new();
+	gtk_editable_set_editable(GTK_EDITABLE(widget), FALSE);
+	gtk_entry_set_text(GTK_ENTRY(widget), q);
+	gtk_size_group_add_widget(vgroup, widget);
+	g_free(p);
+	widget = _properties_widget(hexeditor, hgroup, _("Filename:"), widget);
+	gtk_box_pack_start(GTK_BOX(vbox), widget, FALSE, FALSE, 0);
+	/* FIXME implement more properties */
+	gtk_widget_show_all(vbox);
+	gtk_dialog_run(GTK_DIALOG(dialog));
+	gtk_widget_destroy(dialog);
+}
+
+static GtkWidget * _properties_widget(HexEditor * hexeditor,
+		GtkSizeGroup * group, char const * label, GtkWidget * value)
+{
+	GtkWidget * hbox;
+	GtkWidget * widget;
+
+	hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+	widget = gtk_label_new(label);
+	gtk_widget_override_font(widget, hexeditor->bold);
+#if GTK_CHECK_VERSION(3, 0, 0)
+	g_object_set(widget, "halign", GTK_ALIGN_START, NULL);
+#else
+	gtk_misc_set_alignment(GTK_MISC(widget), 0.0, 0.5);
+#endif
+	gtk_size_group_add_widget(group, widget);
+	gtk_box_pack_start(GTK_BOX(hbox), widget, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), value, TRUE, TRUE, 0);
+	return hbox;
+}
+
+
+/* hexeditor_transform */
+int hexeditor_transform(HexEditor * hexeditor, unsigned int operation,
+		unsigned char const * key, size_t key_size, off_t offset,
+		off_t size, char const * filename)
+{
+	int ret;
+	HexEditorTransform * transform;
+	HexEditorBufferReader reader = NULL;
+	void * data = NULL;
+	gboolean edited;
+	gboolean regular = FALSE;
+	int fd = -1;
+
+	if(hexeditor->buffer == NULL)
+		return -1;
+	if(hexeditor->export != NULL || hexeditor->transform != NULL
+			|| hexeditor->search_source != 0)
+		return -_hexeditor_error(hexeditor,
+				_("Another operation is in progress"), 1);
+	if(offset >= hexeditor->size || size == 0)
+		return -_hexeditor_error(hexeditor, _("Invalid range"), 1);
+	if(size > hexeditor->size - offset)
+		size = hexeditor->size - offset;
+	/* writing to the file being edited transforms it in place */
+	if(filename != NULL && (fd = _hexeditor_open_output(hexeditor,
+					filename, &edited, &regular)) < 0)
+	{
+		if(!edited)
+			return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+		filename = NULL;
+	}
+	/* only the file itself can be written to */
+	if(filename == NULL && (hexeditor->filename == NULL
+				|| hexeditor->codec != NULL
+				|| hexeditor->process != NULL
+				|| hexeditor->spool != NULL))
+		return -_hexeditor_error(hexeditor,
+				_("This file cannot be modified in place"), 1);
+	if((transform = hexeditortransform_new(operation, key, key_size))
+			== NULL)
+	{
+		if(fd >= 0)
+			close(fd);
+		if(regular)
+			unlink(filename);
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	}
+	if(filename == NULL && (fd = open(hexeditor->filename, O_WRONLY)) < 0)
+	{
+		hexeditortransform_delete(transform);
+		return -_hexeditor_error(hexeditor, strerror(errno), 1);
+	}
+	/* read the file directly, without going through the pages */
+	if(hexeditor->codec != NULL)
+	{
+		reader = _hexeditor_on_codec_read;
+		data = hexeditor->codec;
+	}
+	else if(hexeditor->process != NULL)
+	{
+		reader = _hexeditor_on_process_read;
+		data = hexeditor->process;
+	}
+	else if(hexeditor->spool != NULL)
+	{
+		reader = _hexeditor_on_spool_read;
+		data = hexeditor->spool;
+	}
+	if(filename != NULL && (hexeditor->transform_filename = strdup(
+					filename)) == NULL)
+		ret = -error_set_code(1, "%s", strerror(errno));
+	else
+		/* a new file gets a copy of the rest */
+		ret = hexeditortransform_start(transform, hexeditor->fd,
+				reader, data, offset, size, (filename != NULL)
+				? hexeditor->size : 0, fd);
+	if(ret != 0)
+	{
+		hexeditortransform_delete(transform);
+		close(fd);
+		if(filename != NULL && regular)
+			unlink(filename);
+		free(hexeditor->transform_filename);
+		hexeditor->transform_filename = NULL;
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	}
+	hexeditor->transform = transform;
+	hexeditor->transform_offset = offset;
+	hexeditor->transform_fd = fd;
+	hexeditor->transform_regular = regular;
+	/* the workers are polled for their progress */
+	hexeditor->transform_source = g_timeout_add(250,
+			_hexeditor_on_transform, hexeditor);
+	hexeditor->time = 0;
+	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(hexeditor->pg_progress),
+			0.0);
+	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(hexeditor->pg_progress),
+			"");
+	gtk_widget_show_all(hexeditor->pg_window);
+	return 0;
+}
+
+
+/* hexeditor_transform_dialog */
+static int _transform_dialog_key(unsigned int operation, char const * text,
+		unsigned char ** key, size_t * key_size);
+
+int hexeditor_transform_dialog(HexEditor * hexeditor)
+{
+	int ret = -1;
+	const unsigned int flags = GTK_DIALOG_MODAL
+		| GTK_DIALOG_DESTROY_WITH_PARENT;
+	GtkWidget * dialog;
+	GtkWidget * vbox;
+	GtkSizeGroup * group;
+	GtkWidget * entry_offset;
+	GtkWidget * entry_size;
+	GtkWidget * combo;
+	GtkWidget * entry_key;
+	GtkWidget * button;
+	char buf[32];
+	gboolean place = FALSE;
+	gchar * filename = NULL;
+	unsigned char * key = NULL;
+	size_t key_size = 0;
+	off_t offset;
+	off_t size;
+	int operation = -1;
+	size_t i;
+
+	if(hexeditor->buffer == NULL)
+		return -1;
+	dialog = gtk_dialog_new_with_buttons(_("Transform..."),
+			GTK_WINDOW(hexeditor->window), flags,
+			GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+			GTK_STOCK_OK, GTK_RESPONSE_ACCEPT, NULL);
+	gtk_dialog_set_default_response(GTK_DIALOG(dialog),
+			GTK_RESPONSE_ACCEPT);
+#if GTK_CHECK_VERSION(2, 14, 0)
+	vbox = gtk_dialog_get_content_area(GTK_DIALOG(dialog));
+#else
+	vbox = dialog->vbox;
+#endif
+	/* the range, the whole file by default */
+	group = gtk_size_group_new(GTK_SIZE_GROUP_HORIZONTAL);
+	entry_offset = _annotate_dialog_field(vbox, group, _("Offset:"),
+			gtk_entry_new());
+	gtk_entry_set_text(GTK_ENTRY(entry_offset), "0x0");
+	snprintf(buf, sizeof(buf), "%llu", (unsigned long long)hexeditor->size);
+	entry_size = _annotate_dialog_field(vbox, group, _("Size:"),
+			gtk_entry_new());
+	gtk_entry_set_text(GTK_ENTRY(entry_size), buf);
+#if GTK_CHECK_VERSION(2, 24, 0)
+	combo = gtk_combo_box_text_new();
+	for(i = 0; i < HETO_COUNT; i++)
+		gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo),
+				_(_hexeditor_transforms[i]));
+#else
+	combo = gtk_combo_box_new_text();
+	for(i = 0; i < HETO_COUNT; i++)
+		gtk_combo_box_append_text(GTK_COMBO_BOX(combo),
+				_(_hexeditor_transforms[i]));
+#endif
+	gtk_combo_box_set_active(GTK_COMBO_BOX(combo), HETO_XOR);
+	_annotate_dialog_field(vbox, group, _("Operation:"), combo);
+	entry_key = _annotate_dialog_field(vbox, group, _("Key:"),
+			gtk_entry_new());
+	g_object_unref(group);
+	button = gtk_check_button_new_with_mnemonic(
+			_("Modify the file in _place"));
+	gtk_widget_set_sensitive(button, hexeditor->filename != NULL
+			&& hexeditor->codec == NULL
+			&& hexeditor->process == NULL
+			&& hexeditor->spool == NULL);
+	gtk_box_pack_start(GTK_BOX(vbox), button, FALSE, TRUE, 0);
+	gtk_widget_show_all(vbox);
+	if(gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+	{
+		operation = gtk_combo_box_get_active(GTK_COMBO_BOX(combo));
+		place = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+		if(_annotate_dialog_value(entry_offset, &offset) != 0
+				|| _annotate_dialog_value(entry_size, &size)
+				!= 0 || size == 0)
+		{
+			_hexeditor_error(hexeditor, _("Invalid range"), 1);
+			operation = -1;
+		}
+		else if(operation >= 0 && _transform_dialog_key(operation,
+					gtk_entry_get_text(GTK_ENTRY(
+							entry_key)),
+					&key, &key_size) != 0)
+		{
+			_hexeditor_error(hexeditor, _("Invalid key"), 1);
+			operation = -1;
+		}
+	}
+	gtk_widget_destroy(dialog);
+	if(operation < 0)
+		return -1;
+	if(place || (filename = _hexeditor_filename(hexeditor, _("Save as..."),
+					TRUE)) != NULL)
+		ret = hexeditor_transform(hexeditor, operation, key, key_size,
+				offset, size, filename);
+	g_free(filename);
+	free(key);
+	return ret;
+}
+
+static int _transform_dialog_key(unsigned int operation, char const * text,
+		unsigned char ** key, size_t * key_size)
+{
+	unsigned long bits;
+	char * p;
+
+	switch(operation)
+	{
+		case HETO_ROTATE:
+			/* the number of bits */
+			errno = 0;
+			bits = strtoul(text, &p, 0);
+			if(text[0] == '\0' || *p != '\0' || errno != 0
+					|| bits > 7
+					|| (*key = malloc(1)) == NULL)
+				return -1;
+			(*key)[0] = bits;
+			*key_size = 1;
+			return 0;
+		case HETO_SWAP16:
+		case HETO_SWAP32:
+		case HETO_SWAP64:
+			/* no key */
+			return 0;
+	}
+	/* the bytes in hexadecimal */
+	return _hexeditor_hex(text, key, key_size);
+}
+
+
+/* hexeditor_unload */
+int hexeditor_unload(HexEditor * hexeditor, char const * plugin)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
+	GtkTreeIter iter;
+	gboolean valid;
+	gchar * p;
+	Plugin * pp;
+	HexEditorPluginDefinition * hepd;
+	HexEditorPlugin * hep;
+	GtkWidget * widget;
+
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
+			valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gtk_tree_model_get(model, &iter, HEPC_NAME, &p,
+				HEPC_PLUGIN, &pp,
+				HEPC_HEXEDITORPLUGINDEFINITION, &hepd,
+				HEPC_HEXEDITORPLUGIN, &hep,
+				HEPC_WIDGET, &widget, -1);
+		if(strcmp(plugin, p) == 0)
+			break;
+		g_free(p);
+	}
+	if(valid != TRUE)
+		return 0;
+	g_free(p);
+	gtk_list_store_remove(hexeditor->pl_store, &iter);
+	gtk_container_remove(GTK_CONTAINER(hexeditor->pl_box), widget);
+	hepd->destroy(hep);
+	plugin_delete(pp);
+	if(gtk_tree_model_iter_n_children(model, NULL) == 0)
+	{
+		gtk_widget_set_no_show_all(hexeditor->pl_view, TRUE);
+		gtk_widget_hide(hexeditor->pl_view);
+	}
+	else if(gtk_combo_box_get_active(GTK_COMBO_BOX(hexeditor->pl_combo))
+			< 0)
+		gtk_combo_box_set_active(GTK_COMBO_BOX(hexeditor->pl_combo), 0);
+	return 0;
+}
+
+
+/* private */
+/* functions */
+/* accessors */
+/* hexeditor_get_config_filename */
+static String * _hexeditor_get_config_filename(char const * filename)
+{
+	char const * homedir;
+
+	if((homedir = getenv("HOME")) == NULL)
+		homedir = g_get_home_dir();
+	return string_new_append(homedir, "/", filename, NULL);
+}
+
+
+/* hexeditor_plugin_is_enabled */
+static int _hexeditor_plugin_is_enabled(HexEditor * hexeditor,
+		char const * plugin)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
+	GtkTreeIter iter;
+	gchar * p;
+	gboolean valid;
+	int res;
+
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
+			valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gtk_tree_model_get(model, &iter, HEPC_NAME, &p, -1);
+		res = strcmp(p, plugin);
+		g_free(p);
+		if(res == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+/* useful */
+/* hexeditor_annotations_restore */
+static void _hexeditor_annotations_restore(HexEditor * hexeditor)
+{
+	HexEditorAnnotations * annotations;
+	void const * buf;
+	size_t size;
+
+	if(hexeditor->sidecar == NULL || (buf = hexeditorsidecar_get(
+					hexeditor->sidecar, "annotations",
+					&size)) == NULL)
+		return;
+	if((annotations = hexeditorannotations_new_from_buffer(buf, size))
+			== NULL)
+	{
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		return;
+	}
+	hexeditorannotations_delete(hexeditor->annotations);
+	hexeditor->annotations = annotations;
+}
+
+
+/* hexeditor_annotations_store */
+static void _hexeditor_annotations_store(HexEditor * hexeditor)
+{
+	void * buf;
+	size_t size;
+
+	if(hexeditor->annotations_changed == FALSE
+			|| hexeditor->sidecar == NULL)
+		return;
+	hexeditor->annotations_changed = FALSE;
+	/* the search results and the fields displayed are not kept */
+	hexeditorannotations_clear(hexeditor->annotations, HEAT_SEARCH);
+	hexeditorannotations_clear(hexeditor->annotations, HEAT_TEMPLATE);
+	if(hexeditorannotations_get_buffer(hexeditor->annotations, &buf, &size)
+			!= 0)
+	{
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		return;
+	}
+	if(hexeditorsidecar_set(hexeditor->sidecar, "annotations", buf, size)
+			!= 0 || hexeditorsidecar_save(hexeditor->sidecar) != 0)
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+	free(buf);
+}
+
+
+/* hexeditor_close */
+static void _hexeditor_close(HexEditor * hexeditor, gboolean plugins)
+{
+	unsigned int i;
+
+	if(hexeditor->source != 0)
+		g_source_remove(hexeditor->source);
+	hexeditor->source = 0;
+	hexeditor->offset = 0;
+	hexeditor->size = 0;
+	hexeditor->time = 0;
+	hexeditor->tail = FALSE;
+	if(hexeditor->spool_source != 0)
+		g_source_remove(hexeditor->spool_source);
+	hexeditor->spool_source = 0;
+	if(hexeditor->spool_grow != 0)
+		g_source_remove(hexeditor->spool_grow);
+	hexeditor->spool_grow = 0;
+	hexeditor->spool_wait = FALSE;
+	if(hexeditor->verify_source != 0)
+		g_source_remove(hexeditor->verify_source);
+	hexeditor->verify_source = 0;
+	free(hexeditor->verify_buf);
+	hexeditor->verify_buf = NULL;
+	if(hexeditor->digest != NULL)
+		hexeditordigest_delete(hexeditor->digest);
+	hexeditor->digest = NULL;
+	if(hexeditor->overview != NULL)
+		hexeditoroverview_delete(hexeditor->overview);
+	hexeditor->overview = NULL;
+	if(hexeditor->follow != NULL)
+		hexeditorfollow_delete(hexeditor->follow);
+	hexeditor->follow = NULL;
+	hexeditor->follow_size = -1;
+	_hexeditor_export_finish(hexeditor, FALSE);
+	_hexeditor_transform_finish(hexeditor, FALSE);
+	_hexeditor_search_clear(hexeditor);
+	_hexeditor_annotations_store(hexeditor);
+	for(i = 0; i < HEAT_COUNT; i++)
+		hexeditorannotations_clear(hexeditor->annotations, i);
+	/* wait for the pending reads before releasing the buffer */
+	if(hexeditor->fetcher != NULL)
+		hexeditorfetcher_delete(hexeditor->fetcher);
+	hexeditor->fetcher = NULL;
+	free(hexeditor->fetch_failed);
+	hexeditor->fetch_failed = NULL;
+	hexeditor->fetch_failed_cnt = 0;
+	if(hexeditor->sidecar != NULL)
+		hexeditorsidecar_delete(hexeditor->sidecar);
+	hexeditor->sidecar = NULL;
+	if(hexeditor->buffer != NULL)
+		hexeditorbuffer_delete(hexeditor->buffer);
+	hexeditor->buffer = NULL;
+	if(hexeditor->runs_source != 0)
+		g_source_remove(hexeditor->runs_source);
+	hexeditor->runs_source = 0;
+	if(hexeditor->extents != NULL)
+		hexeditorextents_delete(hexeditor->extents);
+	hexeditor->extents = NULL;
+	if(hexeditor->codec != NULL)
+		hexeditorcodec_delete(hexeditor->codec);
+	hexeditor->codec = NULL;
+	if(hexeditor->process != NULL)
+		hexeditorprocess_delete(hexeditor->process);
+	hexeditor->process = NULL;
+	if(hexeditor->spool != NULL)
+		hexeditorspool_delete(hexeditor->spool);
+	hexeditor->spool = NULL;
+	hexeditorrowcache_flush(hexeditor->rowcache);
+	gtk_adjustment_set_value(hexeditor->view_adjustment, 0.0);
+	_hexeditor_view_refresh(hexeditor);
+	if(hexeditor->channel != NULL)
+	{
+		g_io_channel_shutdown(hexeditor->channel, TRUE, NULL);
+		g_io_channel_unref(hexeditor->channel);
+		hexeditor->channel = NULL;
+		hexeditor->fd = -1;
+	}
+	if(hexeditor->fd >= 0 && close(hexeditor->fd) != 0)
+		_hexeditor_error(hexeditor, strerror(errno), 1);
+	hexeditor->fd = -1;
+	free(hexeditor->filename);
+	hexeditor->filename = NULL;
+	gtk_widget_hide(hexeditor->pg_window);
+	gtk_widget_set_sensitive(hexeditor->view_addr, FALSE);
+	gtk_widget_set_sensitive(hexeditor->view_hex, FALSE);
+	gtk_widget_set_sensitive(hexeditor->view_data, FALSE);
+	gtk_window_set_title(GTK_WINDOW(hexeditor->window),
+			_("Hexadecimal editor"));
+	if(plugins == TRUE)
+		_close_reset(hexeditor);
+}
+
+static void _close_reset(HexEditor * hexeditor)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
+	GtkTreeIter iter;
+	gboolean valid;
+	Plugin * plugin;
+	HexEditorPluginDefinition * hepd;
+	HexEditorPlugin * hep;
+	GtkWidget * widget;
+
+	gtk_label_set_text(GTK_LABEL(hexeditor->pl_format), "");
+	/* reset every plug-in */
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;)
+	{
+		gtk_tree_model_get(model, &iter, HEPC_PLUGIN, &plugin,
+				HEPC_HEXEDITORPLUGINDEFINITION, &hepd,
+				HEPC_HEXEDITORPLUGIN, &hep,
+				HEPC_WIDGET, &widget, -1);
+		gtk_container_remove(GTK_CONTAINER(hexeditor->pl_box), widget);
+		hepd->destroy(hep);
+		if((hep = hepd->init(&hexeditor->pl_helper)) == NULL)
+		{
+			gtk_list_store_remove(hexeditor->pl_store, &iter);
+			continue;
+		}
+		widget = hepd->get_widget(hep);
+		gtk_box_pack_start(GTK_BOX(hexeditor->pl_box), widget, TRUE,
+				TRUE, 0);
+		gtk_list_store_set(hexeditor->pl_store, &iter,
+				HEPC_HEXEDITORPLUGIN, hep,
+				HEPC_WIDGET, widget, -1);
+		valid = gtk_tree_model_iter_next(model, &iter);
+	}
+	if(gtk_combo_box_get_active(GTK_COMBO_BOX(hexeditor->pl_combo)) < 0
+			&& gtk_tree_model_iter_n_children(model, NULL) > 0)
+		gtk_combo_box_set_active(GTK_COMBO_BOX(hexeditor->pl_combo), 0);
+	else
+		_hexeditor_on_plugin_combo_change(hexeditor);
+}
+
+
+/* hexeditor_config_load */
+static int _hexeditor_config_load(HexEditor * hexeditor)
+{
+	int ret;
+	String * filename;
+	String const * p;
+	HexEditorFormatEncoding encoding;
+
+	if(hexeditor->config == NULL)
+		return -1; /* XXX report error */
+	if((filename = _hexeditor_get_config_filename(HEXEDITOR_CONFIG_FILE))
+			== NULL)
+		return -1;
+	if((ret = config_load(hexeditor->config, filename)) != 0)
+		ret = -_hexeditor_error(NULL, error_get(NULL), 1);
+	free(filename);
+	/* uppercase */
+	if((p = config_get(hexeditor->config, NULL, "uppercase")) != NULL)
+		hexeditor->prefs.uppercase = (strtol(p, NULL, 10) > 0) ? 1 : 0;
+	/* memory budget for the formatted rows, in kilobytes */
+	if((p = config_get(hexeditor->config, NULL, "rowcache")) != NULL)
+		hexeditor->prefs.rowcache = strtoul(p, NULL, 10) * 1024;
+	/* asynchronous reads */
+	if((p = config_get(hexeditor->config, NULL, "fetcher")) == NULL)
+		hexeditor->prefs.fetcher = 0;
+	else if(strcmp(p, "uring") == 0)
+		hexeditor->prefs.fetcher = 2;
+	else if(strcmp(p, "threads") == 0)
+		hexeditor->prefs.fetcher = 1;
+	/* results of the plug-ins */
+	if((p = config_get(hexeditor->config, NULL, "sidecar")) != NULL)
+		hexeditor->prefs.sidecar = (strtol(p, NULL, 10) > 0) ? 1 : 0;
+	/* follow the files as they grow */
+	if((p = config_get(hexeditor->config, NULL, "follow")) != NULL)
+		hexeditor->prefs.follow = (strtol(p, NULL, 10) > 0) ? 1 : 0;
+	/* gzip and xz files */
+	if((p = config_get(hexeditor->config, NULL, "decompress")) != NULL)
+		hexeditor->prefs.decompress = (strtol(p, NULL, 10) > 0) ? 1 : 0;
+	/* bytes per row */
+	if((p = config_get(hexeditor->config, NULL, "columns")) != NULL)
+		hexeditor->prefs.columns = strtoul(p, NULL, 10);
+	/* bytes per word, and their order */
+	if((p = config_get(hexeditor->config, NULL, "group")) != NULL)
+		hexeditor->prefs.group = strtoul(p, NULL, 10);
+	if((p = config_get(hexeditor->config, NULL, "endian")) != NULL)
+		hexeditor->prefs.little_endian = (strcmp(p, "little") == 0)
+			? 1 : 0;
+	/* minimap */
+	if((p = config_get(hexeditor->config, NULL, "overview")) != NULL)
+		hexeditor->prefs.overview = (strtol(p, NULL, 10) > 0) ? 1 : 0;
+	/* of the data column */
+	if((p = config_get(hexeditor->config, NULL, "encoding")) != NULL
+			&& hexeditorformat_get_encoding_by_name(p,
+				&encoding) == 0)
+		hexeditor->prefs.encoding = encoding;
+	/* of the bytes by class */
+	if((p = config_get(hexeditor->config, NULL, "colors")) != NULL)
+		hexeditor->prefs.colors = (strtol(p, NULL, 10) > 0) ? 1 : 0;
+	/* FIXME also import the font and plug-in values from here */
+	return ret;
+}
+
+
+/* hexeditor_detect */
+static void _hexeditor_detect(HexEditor * hexeditor, char const * buf,
+		size_t size)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
+	GtkTreeIter iter;
+	gboolean valid;
+	HexEditorPluginDefinition * hepd;
+	HexEditorPlugin * hep;
+	HexEditorMagic * magic;
+	char text[256];
+
+	if((magic = hexeditormagic_detect(buf, size)) == NULL)
+	{
+		snprintf(text, sizeof(text), "%s %s", _("Format:"),
+				_("unknown"));
+		gtk_label_set_text(GTK_LABEL(hexeditor->pl_format), text);
+		return;
+	}
+	snprintf(text, sizeof(text), "%s %s", _("Format:"),
+			_(magic->description));
+	gtk_label_set_text(GTK_LABEL(hexeditor->pl_format), text);
+	/* display the first plug-in supporting this format */
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
+			valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gtk_tree_model_get(model, &iter,
+				HEPC_HEXEDITORPLUGINDEFINITION, &hepd,
+				HEPC_HEXEDITORPLUGIN, &hep, -1);
+		if(hepd->format != NULL && hepd->format(hep, magic->name) == 0)
+		{
+			gtk_combo_box_set_active_iter(GTK_COMBO_BOX(
+						hexeditor->pl_combo), &iter);
+			break;
+		}
+	}
+}
+
+
+/* hexeditor_error */
+static int _error_text(char const * message, int ret);
+
+static int _hexeditor_error(HexEditor * hexeditor, char const * message,
+		int ret)
+{
+#if !GTK_CHECK_VERSION(2, 18, 0)
+	GtkWidget * dialog;
+#endif
+
+	if(hexeditor == NULL)
+		return _error_text(message, ret);
+#if GTK_CHECK_VERSION(2, 18, 0)
+	gtk_label_set_text(GTK_LABEL(hexeditor->infobar_label), message);
+	gtk_widget_show(hexeditor->infobar);
+#else
+	dialog = gtk_message_dialog_new(GTK_WINDOW(hexeditor->window),
+			GTK_DIALOG_DESTROY_WITH_PARENT, GTK_MESSAGE_ERROR,
+			GTK_BUTTONS_CLOSE,
+# if GTK_CHECK_VERSION(2, 6, 0)
+			"%s", _("Error"));
+	gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+# endif
+			"%s", message);
+	gtk_window_set_title(GTK_WINDOW(dialog), _("Error"));
+	gtk_dialog_run(GTK_DIALOG(dialog));
+	gtk_widget_destroy(dialog);
+#endif
+	return ret;
+}
+
+static int _error_text(char const * message, int ret)
+{
+	fprintf(stderr, "%s: %s\n", PROGNAME_HEXEDITOR, message);
+	return ret;
+}
+
+
+/* hexeditor_export_finish */
+static void _hexeditor_export_finish(HexEditor * hexeditor, gboolean success)
+{
+	if(hexeditor->export == NULL)
+		return;
+	if(hexeditor->export_source != 0)
+		g_source_remove(hexeditor->export_source);
+	hexeditor->export_source = 0;
+	hexeditorexport_delete(hexeditor->export);
+	hexeditor->export = NULL;
+	if(close(hexeditor->export_fd) != 0 && success)
+	{
+		_hexeditor_error(hexeditor, strerror(errno), 1);
+		success = FALSE;
+	}
+	hexeditor->export_fd = -1;
+	/* do not leave incomplete files behind */
+	if(!success && hexeditor->export_regular)
+		unlink(hexeditor->export_filename);
+	free(hexeditor->export_filename);
+	hexeditor->export_filename = NULL;
+	/* the scan may still be running */
+	if(hexeditor->source == 0)
+		gtk_widget_hide(hexeditor->pg_window);
+}
+
+
+/* hexeditor_extents_open */
+static HexEditorExtents * _extents_open_process(HexEditor * hexeditor);
+
+static void _hexeditor_extents_open(HexEditor * hexeditor, gboolean runs)
+{
+	HexEditorExtents * extents;
+
+	/* the runs still being scanned again are only kept if copied */
+	if(!runs && hexeditor->runs_source != 0)
+	{
+		g_source_remove(hexeditor->runs_source);
+		hexeditor->runs_source = 0;
+	}
+	/* decompressed data has no holes */
+	if(hexeditor->process != NULL)
+		extents = _extents_open_process(hexeditor);
+	else if((extents = hexeditorextents_new((hexeditor->codec == NULL
+						&& hexeditor->spool == NULL)
+					? hexeditor->fd : -1, hexeditor->size,
+					HEXEDITOR_BLOCK_ROWS
+					* hexeditor->prefs.columns,
+					hexeditor->prefs.columns)) == NULL)
+		/* then read everything */
+		extents = hexeditorextents_new(-1, hexeditor->size,
+				HEXEDITOR_BLOCK_ROWS
+				* hexeditor->prefs.columns,
+				hexeditor->prefs.columns);
+	if(extents != NULL && runs && hexeditor->extents != NULL
+			&& hexeditorextents_copy_runs(extents,
+				hexeditor->extents) != 0)
+	{
+		hexeditorextents_delete(extents);
+		extents = NULL;
+	}
+	if(hexeditor->extents != NULL)
+		hexeditorextents_delete(hexeditor->extents);
+	hexeditor->extents = extents;
+}
+
+static HexEditorExtents * _extents_open_process(HexEditor * hexeditor)
+{
+	HexEditorExtents * extents;
+	size_t i;
+	off_t start;
+	off_t end;
+	off_t last;
+
+	if((extents = hexeditorextents_new(-1, hexeditor->size,
+					HEXEDITOR_BLOCK_ROWS
+					* hexeditor->prefs.columns,
+					hexeditor->prefs.columns)) == NULL)
+		return NULL;
+	/* the gaps between the mappings are holes */
+	for(i = 0, last = 0; hexeditorprocess_get_mapping(hexeditor->process,
+				i, &start, &end, NULL) == 0; i++, last = end)
+		if(start > last && hexeditorextents_add_hole(extents, last,
+					start - last) != 0)
+		{
+			hexeditorextents_delete(extents);
+			return NULL;
+		}
+	return extents;
+}
+
+
+/* hexeditor_filename */
+static gchar * _hexeditor_filename(HexEditor * hexeditor, char const * title,
+		gboolean save)
+{
+	GtkWidget * dialog;
+	GtkFileFilter * filter;
+	gchar * filename = NULL;
+
+	dialog = gtk_file_chooser_dialog_new(title,
+			GTK_WINDOW(hexeditor->window),
+			save ? GTK_FILE_CHOOSER_ACTION_SAVE
+			: GTK_FILE_CHOOSER_ACTION_OPEN,
+			GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+			save ? GTK_STOCK_SAVE : GTK_STOCK_OPEN,
+			GTK_RESPONSE_ACCEPT, NULL);
+#if GTK_CHECK_VERSION(2, 8, 0)
+	if(save)
+		gtk_file_chooser_set_do_overwrite_confirmation(
+				GTK_FILE_CHOOSER(dialog), TRUE);
+#endif
+	filter = gtk_file_filter_new();
+	gtk_file_filter_set_name(filter, _("All files"));
+	gtk_file_filter_add_pattern(filter, "*");
+	gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dialog), filter);
+	if(gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+		filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(
+					dialog));
+	gtk_widget_destroy(dialog);
+	return filename;
+}
+
+
+/* hexeditor_hex */
+static int _hexeditor_hex(char const * text, unsigned char ** buf,
+		size_t * size)
+{
+	HexEditorImport * import;
+	size_t len;
+	ssize_t first;
+	ssize_t last;
+
+	/* the bytes in hexadecimal, as imported */
+	len = strlen(text);
+	if((import = hexeditorimport_new(HEIF_HEX)) == NULL)
+		return -1;
+	if((*buf = malloc(len + 2)) == NULL
+			|| (first = hexeditorimport_decode(import, text, len,
+					*buf)) < 0
+			|| (last = hexeditorimport_finish(import,
+					&(*buf)[first])) < 0
+			|| first + last == 0)
+	{
+		hexeditorimport_delete(import);
+		free(*buf);
+		*buf = NULL;
+		return -1;
+	}
+	hexeditorimport_delete(import);
+	*size = first + last;
+	return 0;
+}
+
+
+/* hexeditor_import */
+static int _import_error(HexEditorImport * import);
+static int _import_write(int fd, unsigned char const * buf, size_t size);
+
+static int _hexeditor_import(HexEditorImport ** import, int fd,
+		char const * text, size_t size, unsigned char * buf)
+{
+	ssize_t len;
+
+	/* the format is detected from the beginning of the text */
+	if(*import == NULL && (*import = hexeditorimport_new(
+					hexeditorimport_detect(text, size)))
+			== NULL)
+		return -1;
+	if((len = hexeditorimport_decode(*import, text, size, buf)) < 0)
+		return _import_error(*import);
+	return _import_write(fd, buf, len);
+}
+
+static int _import_error(HexEditorImport * import)
+{
+	char message[256];
+
+	/* where the text is invalid */
+	snprintf(message, sizeof(message), _("Line %lld, column %lld: %s"),
+			(long long)hexeditorimport_get_line(import),
+			(long long)hexeditorimport_get_column(import),
+			error_get(NULL));
+	return -error_set_code(1, "%s", message);
+}
+
+static int _import_write(int fd, unsigned char const * buf, size_t size)
+{
+	ssize_t len;
+
+	for(; size > 0; buf += len, size -= len)
+		if((len = write(fd, buf, size)) < 0)
+		{
+			if(errno != EINTR)
+				return -error_set_code(1, "%s",
+						strerror(errno));
+			len = 0;
+		}
+	return 0;
+}
+
+
+/* hexeditor_import_finish */
+static int _hexeditor_import_finish(HexEditor * hexeditor,
+		HexEditorImport * import, int fd, char const * filename,
+		gboolean regular, int ret)
+{
+	unsigned char buf[2];
+	ssize_t len;
+
+	if(import != NULL)
+	{
+		if(ret == 0 && (len = hexeditorimport_finish(import, buf)) < 0)
+			ret = _import_error(import);
+		else if(ret == 0)
+			ret = _import_write(fd, buf, len);
+		hexeditorimport_delete(import);
+	}
+	if(close(fd) != 0 && ret == 0)
+		ret = -error_set_code(1, "%s", strerror(errno));
+	if(ret != 0)
+	{
+		/* do not leave incomplete files behind */
+		if(regular)
+			unlink(filename);
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	}
+	/* the result is opened in place of the current file */
+	return hexeditor_open(hexeditor, filename);
+}
+
+
+/* hexeditor_open_output */
+static int _hexeditor_open_output(HexEditor * hexeditor,
+		char const * filename, gboolean * edited, gboolean * regular)
+{
+	int fd;
+	struct stat st;
+	struct stat st2;
+
+	if(edited != NULL)
+		*edited = FALSE;
+	if(regular != NULL)
+		*regular = FALSE;
+	if((fd = open(filename, O_WRONLY | O_CREAT, 0666)) < 0)
+		return -error_set_code(1, "%s", strerror(errno));
+	if(fstat(fd, &st) != 0)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+	/* the file being edited is still read from, and is left intact */
+	if(hexeditor->fd >= 0 && fstat(hexeditor->fd, &st2) == 0
+			&& st.st_dev == st2.st_dev && st.st_ino == st2.st_ino)
+	{
+		close(fd);
+		if(edited != NULL)
+			*edited = TRUE;
+		return -error_set_code(1, "%s",
+				_("This is the file being edited"));
+	}
+	/* devices and pipes are written to as they are */
+	if(!S_ISREG(st.st_mode))
+		return fd;
+	if(ftruncate(fd, 0) != 0)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+	if(regular != NULL)
+		*regular = TRUE;
+	return fd;
+}
+
+
+/* hexeditor_plugin_annotate */
+static int _hexeditor_plugin_annotate(HexEditor * hexeditor,
+		HexEditorPluginAnnotation type, off_t offset, off_t size,
+		char const * label)
+{
+	HexEditorAnnotation annotation;
+
+	if(hexeditor->buffer == NULL)
+		return -error_set_code(1, "%s", strerror(EBADF));
+	annotation.offset = offset;
+	annotation.size = size;
+	annotation.type = (type == HEPA_FIELD) ? HEAT_TEMPLATE : HEAT_PLUGIN;
+	annotation.color = _hexeditor_annotation_colors[annotation.type];
+	annotation.label = label;
+	if(hexeditorannotations_add(hexeditor->annotations, &annotation) != 0)
+		return -1;
+	if(annotation.type == HEAT_PLUGIN)
+		hexeditor->annotations_changed = TRUE;
+	_hexeditor_view_queue(hexeditor);
+	return 0;
+}
+
+
+/* hexeditor_plugin_annotate_clear */
+static void _hexeditor_plugin_annotate_clear(HexEditor * hexeditor,
+		HexEditorPluginAnnotation type)
+{
+	hexeditorannotations_clear(hexeditor->annotations, (type == HEPA_FIELD)
+			? HEAT_TEMPLATE : HEAT_PLUGIN);
+	_hexeditor_view_queue(hexeditor);
+}
+
+
+/* hexeditor_plugin_get_size */
+static off_t _hexeditor_plugin_get_size(HexEditor * hexeditor)
+{
+	if(hexeditor->buffer == NULL)
+		return -error_set_code(1, "%s", strerror(EBADF));
+	return hexeditor->size;
+}
+
+
+/* hexeditor_plugin_read */
+static ssize_t _hexeditor_plugin_read(HexEditor * hexeditor, off_t offset,
+		void * buffer, size_t size)
+{
+	if(hexeditor->buffer == NULL)
+		return -error_set_code(1, "%s", strerror(EBADF));
+	/* through the page cache, like the view */
+	return hexeditorbuffer_read(hexeditor->buffer, offset, buffer, size);
+}
+
+
+/* hexeditor_prefetch */
+static int _prefetch_failed(HexEditor * hexeditor, off_t page);
+static int _prefetch_process(HexEditor * hexeditor, off_t const * pages,
+		size_t count);
+
+static int _hexeditor_prefetch(HexEditor * hexeditor, off_t const * offsets,
+		size_t count)
+{
+	int ret;
+	off_t * pages;
+	size_t i;
+	size_t cnt;
+
+	if((hexeditor->fetcher == NULL && hexeditor->process == NULL)
+			|| count == 0)
+		return 0;
+	/* the pages would be outdated as soon as read */
+	if(hexeditor->transform != NULL
+			&& hexeditor->transform_filename == NULL)
+		return 0;
+	if((pages = malloc(sizeof(*pages) * count)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	/* only request the pages missing from the buffer */
+	for(i = 0, cnt = 0; i < count; i++)
+	{
+		if(offsets[i] < 0 || offsets[i] >= hexeditor->size
+				|| hexeditorbuffer_is_cached(hexeditor->buffer,
+					offsets[i]))
+			continue;
+		pages[cnt] = offsets[i] - (offsets[i]
+				% HEXEDITORBUFFER_PAGE_SIZE);
+		/* read synchronously by the view instead */
+		if(_prefetch_failed(hexeditor, pages[cnt]))
+			continue;
+		if(cnt == 0 || pages[cnt - 1] != pages[cnt])
+			cnt++;
+	}
+	if(hexeditor->process != NULL)
+	{
+		/* read right away, but in a single call */
+		ret = (cnt > 0) ? _prefetch_process(hexeditor, pages, cnt) : 0;
+		free(pages);
+		return ret;
+	}
+	ret = (cnt > 0) ? hexeditorfetcher_submit(hexeditor->fetcher, pages,
+			cnt, hexeditorbuffer_get_generation(hexeditor->buffer))
+		: 0;
+	free(pages);
+	return (ret == 0) ? (int)cnt : ret;
+}
+
+static int _prefetch_failed(HexEditor * hexeditor, off_t page)
+{
+	size_t i;
+
+	/* tried again once the file is read again */
+	if(hexeditor->fetch_failed_generation
+			!= hexeditorbuffer_get_generation(hexeditor->buffer))
+		hexeditor->fetch_failed_cnt = 0;
+	for(i = 0; i < hexeditor->fetch_failed_cnt; i++)
+		if(hexeditor->fetch_failed[i] == page)
+			return 1;
+	return 0;
+}
+
+static int _prefetch_process(HexEditor * hexeditor, off_t const * pages,
+		size_t count)
+{
+	const size_t size = HEXEDITORBUFFER_PAGE_SIZE;
+	char * buf;
+	size_t i;
+	int ret = 0;
+
+	if((buf = malloc(size * count)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	if(hexeditorprocess_readv(hexeditor->process, pages, count, size, buf)
+			!= 0)
+		ret = -1;
+	for(i = 0; ret == 0 && i < count; i++)
+		ret = hexeditorbuffer_fill(hexeditor->buffer, pages[i],
+				&buf[i * size],
+				(hexeditor->size - pages[i] < (off_t)size)
+				? (size_t)(hexeditor->size - pages[i])
+				: size);
+	free(buf);
+	return ret;
+}
+
+
+/* hexeditor_runs_start */
+static void _hexeditor_runs_start(HexEditor * hexeditor)
+{
+	if(hexeditor->runs_source != 0)
+		g_source_remove(hexeditor->runs_source);
+	hexeditor->runs_source = 0;
+	if(hexeditor->extents == NULL)
+		return;
+	/* the scan finds the runs past where it is */
+	hexeditor->runs_offset = 0;
+	hexeditor->runs_end = (hexeditor->source != 0 || hexeditor->spool_wait)
+		? hexeditor->offset : hexeditor->size;
+	hexeditor->runs_source = g_idle_add(_hexeditor_on_runs, hexeditor);
+}
+
+
+/* hexeditor_scan_cancel */
+static void _hexeditor_scan_cancel(HexEditor * hexeditor)
+{
+	if(hexeditor->source == 0 && !hexeditor->spool_wait)
+		return;
+	/* the file remains open, only the plug-ins are interrupted, and
+	 * pipes are still read */
+	if(hexeditor->source != 0)
+		g_source_remove(hexeditor->source);
+	hexeditor->source = 0;
+	hexeditor->spool_wait = FALSE;
+	gtk_widget_hide(hexeditor->pg_window);
+	/* compressed files are not indexed any further */
+	if(hexeditor->search_pending != NULL)
+		hexeditorsearch_delete(hexeditor->search_pending);
+	hexeditor->search_pending = NULL;
+	_close_reset(hexeditor);
+}
+
+
+/* hexeditor_scan_finish */
+static void _hexeditor_scan_finish(HexEditor * hexeditor, gboolean eof)
+{
+	hexeditor->tail = FALSE;
+	if(eof)
+		_open_plugins_read(hexeditor, hexeditor->offset, NULL, 0);
+	if(hexeditor->digest != NULL)
+		hexeditordigest_complete(hexeditor->digest);
+	_open_plugins_save(hexeditor);
+	gtk_widget_queue_draw(hexeditor->view_overview);
+}
+
+
+/* hexeditor_scan_start */
+static void _hexeditor_scan_start(HexEditor * hexeditor)
+{
+	/* stream the file to the plug-ins in the background */
+	if(gtk_tree_model_iter_n_children(GTK_TREE_MODEL(hexeditor->pl_store),
+				NULL) == 0 && !hexeditor->prefs.overview
+			&& (hexeditor->codec == NULL
+				|| hexeditorcodec_is_complete(
+					hexeditor->codec))
+			&& (hexeditor->spool == NULL
+				|| hexeditorspool_is_complete(
+					hexeditor->spool)))
+		return;
+	/* the plug-ins report their findings again */
+	hexeditorannotations_clear(hexeditor->annotations, HEAT_PLUGIN);
+	/* and summarize it for the minimap */
+	if(hexeditor->overview != NULL)
+		hexeditoroverview_delete(hexeditor->overview);
+	if((hexeditor->overview = hexeditor->prefs.overview
+				? hexeditoroverview_new(hexeditor->size)
+				: NULL) == NULL && hexeditor->prefs.overview)
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+	/* compressed files are indexed at the same time */
+	if(hexeditor->codec != NULL)
+		hexeditor->source = g_idle_add(_hexeditor_on_codec, hexeditor);
+	else if(hexeditor->process != NULL)
+		hexeditor->source = g_idle_add(_hexeditor_on_process,
+				hexeditor);
+	/* and pipes kept as they are read */
+	else if(hexeditor->spool != NULL)
+		hexeditor->source = g_idle_add(_hexeditor_on_spool, hexeditor);
+	else if(hexeditor->channel == NULL)
+	{
+		hexeditor->channel = g_io_channel_unix_new(hexeditor->fd);
+		g_io_channel_set_encoding(hexeditor->channel, NULL, NULL);
+		/* read directly into the buffer of the scan */
+		g_io_channel_set_buffered(hexeditor->channel, FALSE);
+	}
+	else if(lseek(hexeditor->fd, 0, SEEK_SET) != 0)
+	{
+		_hexeditor_error(hexeditor, strerror(errno), 1);
+		return;
+	}
+	if(hexeditor->codec == NULL && hexeditor->process == NULL
+			&& hexeditor->spool == NULL)
+	{
+		hexeditor->source = g_io_add_watch(hexeditor->channel, G_IO_IN,
+				_open_on_can_read, hexeditor);
+		if(hexeditor->digest != NULL)
+			hexeditordigest_reset(hexeditor->digest);
+		else
+			hexeditor->digest = hexeditordigest_new();
+	}
+	hexeditor->offset = 0;
+	hexeditor->tail = FALSE;
+	hexeditor->spool_wait = FALSE;
+	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(hexeditor->pg_progress),
+			0.0);
+	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(hexeditor->pg_progress), "");
+	hexeditor->time = time(NULL);
+	gtk_widget_show_all(hexeditor->pg_window);
+}
+
+
+/* hexeditor_search */
+static int _hexeditor_search(HexEditor * hexeditor, HexEditorSearch * search)
+{
+	HexEditorBufferReader reader = NULL;
+	void * data = NULL;
+	off_t margin;
+	off_t offset;
+	off_t end;
+	off_t start;
+	off_t stop;
+	int hole;
+
+	if(hexeditor->export != NULL || hexeditor->transform != NULL)
+	{
+		hexeditorsearch_delete(search);
+		return -_hexeditor_error(hexeditor,
+				_("Another operation is in progress"), 1);
+	}
+	/* the size of compressed files is only known once indexed */
+	if(hexeditor->codec != NULL
+			&& !hexeditorcodec_is_complete(hexeditor->codec))
+	{
+		if(hexeditor->source == 0)
+		{
+			hexeditorsearch_delete(search);
+			return -_hexeditor_error(hexeditor,
+					_("The file is not indexed"), 1);
+		}
+		if(hexeditor->search_pending != NULL)
+			hexeditorsearch_delete(hexeditor->search_pending);
+		hexeditor->search_pending = search;
+		return 0;
+	}
+	/* the holes only hold zeros, the hits may still begin or end there */
+	margin = hexeditorsearch_get_hole_margin(search);
+	for(offset = 0; offset < hexeditor->size; offset = end)
+	{
+		hole = 0;
+		if(hexeditor->extents == NULL || margin < 0
+				|| (end = hexeditorextents_get_end(
+						hexeditor->extents, offset,
+						&hole)) <= offset
+				|| end > hexeditor->size)
+			end = hexeditor->size;
+		if(hole)
+			continue;
+		start = (offset > margin) ? offset - margin : 0;
+		stop = (hexeditor->size - end > margin) ? end + margin
+			: hexeditor->size;
+		if(hexeditorsearch_add_range(search, start, stop - start) != 0)
+			break;
+	}
+	/* read the file directly, without going through the pages */
+	if(hexeditor->codec != NULL)
+	{
+		reader = _hexeditor_on_codec_read;
+		data = hexeditor->codec;
+	}
+	else if(hexeditor->process != NULL)
+	{
+		reader = _hexeditor_on_process_read;
+		data = hexeditor->process;
+	}
+	else if(hexeditor->spool != NULL)
+	{
+		reader = _hexeditor_on_spool_read;
+		data = hexeditor->spool;
+	}
+	if(offset < hexeditor->size || hexeditorsearch_start(search,
+				hexeditor->fd, reader, data) != 0)
+	{
+		hexeditorsearch_delete(search);
+		return -_hexeditor_error(hexeditor, error_get(NULL), 1);
+	}
+	/* the hits of the previous search are replaced */
+	_hexeditor_search_clear(hexeditor);
+	hexeditor->search = search;
+	hexeditor->search_source = g_timeout_add(250, _hexeditor_on_search,
+			hexeditor);
+	gtk_widget_set_no_show_all(hexeditor->se_view, FALSE);
+	gtk_widget_show_all(hexeditor->se_view);
+	_hexeditor_search_update(hexeditor);
+	hexeditor->time = 0;
+	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(hexeditor->pg_progress),
+			0.0);
+	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(hexeditor->pg_progress),
+			"");
+	gtk_widget_show_all(hexeditor->pg_window);
+	return 0;
+}
+
+
+/* hexeditor_search_clear */
+static void _hexeditor_search_clear(HexEditor * hexeditor)
+{
+	if(hexeditor->search_pending != NULL)
+		hexeditorsearch_delete(hexeditor->search_pending);
+	hexeditor->search_pending = NULL;
+	if(hexeditor->search == NULL)
+		return;
+	_hexeditor_search_finish(hexeditor);
+	hexeditorsearch_delete(hexeditor->search);
+	hexeditor->search = NULL;
+	hexeditor->search_annotated = 0;
+	hexeditorannotations_clear(hexeditor->annotations, HEAT_SEARCH);
+	_hexeditor_view_queue(hexeditor);
+	gtk_adjustment_set_value(hexeditor->se_adjustment, 0.0);
+	gtk_text_buffer_set_text(hexeditor->se_tbuf, "", 0);
+	gtk_widget_set_no_show_all(hexeditor->se_view, TRUE);
+	gtk_widget_hide(hexeditor->se_view);
+}
+
+
+/* hexeditor_search_finish */
+static void _hexeditor_search_finish(HexEditor * hexeditor)
+{
+	if(hexeditor->search_source == 0)
+		return;
+	g_source_remove(hexeditor->search_source);
+	hexeditor->search_source = 0;
+	/* the hits found so far are kept */
+	hexeditorsearch_cancel(hexeditor->search);
+	hexeditorsearch_poll(hexeditor->search);
+	_hexeditor_search_update(hexeditor);
+	/* the scan may still be running */
+	if(hexeditor->source == 0)
+		gtk_widget_hide(hexeditor->pg_window);
+}
+
+
+/* hexeditor_search_render */
+static void _search_render_hit(HexEditor * hexeditor, GtkTextIter * iter,
+		off_t offset, size_t size);
+
+static void _hexeditor_search_render(HexEditor * hexeditor)
+{
+	GtkTextIter iter;
+	size_t size;
+	size_t i;
+	size_t first;
+	off_t offset;
+
+	gtk_text_buffer_set_text(hexeditor->se_tbuf, "", 0);
+	if(hexeditor->search == NULL)
+		return;
+	gtk_text_buffer_get_end_iter(hexeditor->se_tbuf, &iter);
+	/* only the hits displayed are decoded */
+	first = gtk_adjustment_get_value(hexeditor->se_adjustment);
+	for(i = first; i < first + hexeditor->se_rows && (offset
+				= hexeditorsearch_get_hit(hexeditor->search,
+					i, &size)) >= 0; i++)
+	{
+		if(i > first)
+			gtk_text_buffer_insert(hexeditor->se_tbuf, &iter, "\n",
+					1);
+		_search_render_hit(hexeditor, &iter, offset, size);
+	}
+}
+
+static void _search_render_hit(HexEditor * hexeditor, GtkTextIter * iter,
+		off_t offset, size_t size)
+{
+	char const * format = hexeditor->prefs.uppercase ? "%02X " : "%02x ";
+	unsigned char buf[HEXEDITOR_SEARCH_CONTEXT * 2
+		+ HEXEDITOR_SEARCH_PREVIEW];
+	char text[32];
+	off_t start;
+	ssize_t len;
+	ssize_t i;
+
+	snprintf(text, sizeof(text), "0x%0*llx  ", hexeditor->view_addr_width,
+			(unsigned long long)offset);
+	gtk_text_buffer_insert(hexeditor->se_tbuf, iter, text, -1);
+	/* some context around the beginning of the hit */
+	start = (offset > HEXEDITOR_SEARCH_CONTEXT)
+		? offset - HEXEDITOR_SEARCH_CONTEXT : 0;
+	if(size > HEXEDITOR_SEARCH_PREVIEW)
+		size = HEXEDITOR_SEARCH_PREVIEW;
+	if((len = hexeditorbuffer_read(hexeditor->buffer, start, buf,
+					offset - start + size
+					+ HEXEDITOR_SEARCH_CONTEXT)) <= 0)
+		return;
+	for(i = 0; i < len; i++)
+	{
+		snprintf(text, sizeof(text), format, buf[i]);
+		if(start + i >= offset && start + i < offset + (off_t)size)
+			gtk_text_buffer_insert_with_tags_by_name(
+					hexeditor->se_tbuf, iter, text, -1,
+					"hit", NULL);
+		else
+			gtk_text_buffer_insert(hexeditor->se_tbuf, iter, text,
+					-1);
+	}
+	for(i = 0; i < len; i++)
+		text[i] = (buf[i] >= 0x20 && buf[i] < 0x7f) ? buf[i] : '.';
+	gtk_text_buffer_insert(hexeditor->se_tbuf, iter, " ", 1);
+	gtk_text_buffer_insert(hexeditor->se_tbuf, iter, text, len);
+}
+
+
+/* hexeditor_search_update */
+static void _hexeditor_search_update(HexEditor * hexeditor)
+{
+	HexEditorAnnotation annotation;
+	size_t count;
+	size_t size;
+	gdouble rows;
+	char buf[64];
+
+	count = hexeditorsearch_get_count(hexeditor->search);
+	snprintf(buf, sizeof(buf), _("Hits: %lu"), (unsigned long)count);
+	gtk_label_set_text(GTK_LABEL(hexeditor->se_label), buf);
+	/* only so many hits are highlighted */
+	annotation.type = HEAT_SEARCH;
+	annotation.color = _hexeditor_annotation_colors[HEAT_SEARCH];
+	annotation.label = NULL;
+	if(hexeditor->search_annotated < count
+			&& hexeditor->search_annotated
+			< HEXEDITOR_SEARCH_ANNOTATIONS)
+	{
+		for(; hexeditor->search_annotated < count
+				&& hexeditor->search_annotated
+				< HEXEDITOR_SEARCH_ANNOTATIONS;
+				hexeditor->search_annotated++)
+		{
+			annotation.offset = hexeditorsearch_get_hit(
+					hexeditor->search,
+					hexeditor->search_annotated, &size);
+			annotation.size = size;
+			if(hexeditorannotations_add(hexeditor->annotations,
+						&annotation) != 0)
+				break;
+		}
+		_hexeditor_view_queue(hexeditor);
+	}
+	rows = count;
+	gtk_adjustment_configure(hexeditor->se_adjustment,
+			gtk_adjustment_get_value(hexeditor->se_adjustment),
+			0.0, rows, 1.0, MAX(hexeditor->se_rows, 1),
+			MIN(hexeditor->se_rows, rows));
+	_hexeditor_search_render(hexeditor);
+}
+
+
+/* hexeditor_sidecar_open */
+static void _hexeditor_sidecar_open(HexEditor * hexeditor)
+{
+	String * dir;
+
+	if(hexeditor->sidecar != NULL)
+		hexeditorsidecar_delete(hexeditor->sidecar);
+	hexeditor->sidecar = NULL;
+	if(hexeditor->prefs.sidecar == 0
+			|| (dir = _hexeditor_get_config_filename(
+					HEXEDITOR_SIDECAR_DIRECTORY)) == NULL)
+		return;
+	hexeditor->sidecar = hexeditorsidecar_new(hexeditor->fd, dir);
+	string_delete(dir);
+}
+
+
+/* hexeditor_transform_finish */
+static void _hexeditor_transform_finish(HexEditor * hexeditor,
+		gboolean success)
+{
+	char * filename = hexeditor->transform_filename;
+	off_t size;
+	off_t end;
+
+	if(hexeditor->transform == NULL)
+		return;
+	if(hexeditor->transform_source != 0)
+		g_source_remove(hexeditor->transform_source);
+	hexeditor->transform_source = 0;
+	end = hexeditor->transform_offset + hexeditortransform_get_size(
+			hexeditor->transform);
+	/* waits for the workers */
+	hexeditortransform_delete(hexeditor->transform);
+	hexeditor->transform = NULL;
+	if(close(hexeditor->transform_fd) != 0 && success)
+	{
+		_hexeditor_error(hexeditor, strerror(errno), 1);
+		success = FALSE;
+	}
+	hexeditor->transform_fd = -1;
+	hexeditor->transform_filename = NULL;
+	/* the scan may still be running */
+	if(hexeditor->source == 0)
+		gtk_widget_hide(hexeditor->pg_window);
+	if(filename == NULL && hexeditor->follow_size >= 0)
+	{
+		/* the file was modified by someone else meanwhile */
+		size = hexeditor->follow_size;
+		hexeditor->follow_size = -1;
+		_hexeditor_on_follow(hexeditor, size);
+	}
+	else if(filename == NULL)
+	{
+		/* even when cancelled, a part of the range was modified */
+		hexeditorbuffer_flush(hexeditor->buffer);
+		hexeditorrowcache_flush(hexeditor->rowcache);
+		_hexeditor_view_refresh(hexeditor);
+		/* only the blocks of the range are compared again */
+		_hexeditor_verify_start(hexeditor, hexeditor->transform_offset,
+				end);
+	}
+	else if(!success && hexeditor->transform_regular)
+		/* do not leave incomplete files behind */
+		unlink(filename);
+	else if(success)
+		hexeditor_open(hexeditor, filename);
+	free(filename);
+}
+
+
+/* hexeditor_verify_start */
+static void _hexeditor_verify_start(HexEditor * hexeditor, off_t offset,
+		off_t end)
+{
+	off_t size;
+
+	if(gtk_tree_model_iter_n_children(GTK_TREE_MODEL(hexeditor->pl_store),
+				NULL) == 0)
+		return;
+	/* the plug-ins can only be told about the blocks modified or
+	 * appended once they have seen the whole file */
+	if(hexeditor->source != 0 || hexeditor->tail
+			|| hexeditor->digest == NULL
+			|| !hexeditordigest_is_complete(hexeditor->digest)
+			|| hexeditor->size < hexeditordigest_get_size(
+				hexeditor->digest))
+	{
+		if(hexeditor->source != 0)
+			_hexeditor_scan_cancel(hexeditor);
+		else
+			_close_reset(hexeditor);
+		_hexeditor_sidecar_open(hexeditor);
+		_hexeditor_scan_start(hexeditor);
+		return;
+	}
+	if(hexeditor->verify_buf == NULL && (hexeditor->verify_buf = malloc(
+					HEXEDITORDIGEST_BLOCK_SIZE)) == NULL)
+	{
+		_hexeditor_error(hexeditor, strerror(errno), 1);
+		return;
+	}
+	/* compare the blocks of the range again, but when the whole file
+	 * grew only those appended if the last block digested is unchanged,
+	 * as nothing else tells where it was modified */
+	size = hexeditordigest_get_size(hexeditor->digest);
+	hexeditor->verify_tail = (offset == 0 && end < 0 && size > 0
+			&& hexeditor->size > size) ? TRUE : FALSE;
+	if(hexeditor->verify_tail)
+		offset = size - 1;
+	hexeditor->verify_offset = offset - offset % HEXEDITORDIGEST_BLOCK_SIZE;
+	hexeditor->verify_end = end;
+	hexeditor->verify_changes = 0;
+	if(hexeditor->verify_source == 0)
+		hexeditor->verify_source = g_idle_add(_hexeditor_on_verify,
+				hexeditor);
+}
+
+
+/* view */
+/* hexeditor_view_queue */
+static void _hexeditor_view_queue(HexEditor * hexeditor)
+{
+	if(hexeditor->view_source == 0)
+		hexeditor->view_source = g_idle_add(_hexeditor_on_view_idle,
+				hexeditor);
+}
+
+
+/* hexeditor_view_refresh */
+static void _hexeditor_view_refresh(HexEditor * hexeditor)
+{
+	gdouble rows;
+
+	if(hexeditor->view_source != 0)
+		g_source_remove(hexeditor->view_source);
+	hexeditor->view_source = 0;
+	rows = _hexeditor_view_rows(hexeditor);
+	gtk_adjustment_configure(hexeditor->view_adjustment,
+			gtk_adjustment_get_value(hexeditor->view_adjustment),
+			0.0, rows, 1.0, MAX(hexeditor->view_rows, 1),
+			MIN(hexeditor->view_rows, rows));
+	_hexeditor_view_render(hexeditor);
+}
+
+
+/* hexeditor_view_render */
+static void _view_render_annotations(HexEditor * hexeditor,
+		off_t const * offsets, size_t rows);
+static void _view_render_apply(GtkTextBuffer * tbuf, GtkTextTag * tag,
+		size_t line, size_t start, size_t line_end, size_t end);
+static HexEditorRowBlock * _view_render_block(HexEditor * hexeditor,
+		off_t block);
+static void _view_render_classes(HexEditor * hexeditor, GtkTextBuffer * tbuf,
+		unsigned char const * classes, size_t rows, gboolean hex);
+static int _view_render_fetch(HexEditor * hexeditor, off_t row, off_t last);
+static size_t _view_render_length(char const * data, size_t stride);
+static void _view_render_marker(HexEditor * hexeditor, off_t offset,
+		char const * text, char * addr, char * hex, char * data);
+static void _view_render_row(HexEditor * hexeditor, off_t offset,
+		unsigned char const * buf, size_t size,
+		char * addr, char * hex, char * data);
+static GtkTextTag * _view_render_tag(GtkTextBuffer * tbuf,
+		char const * property, uint32_t color);
+
+static void _hexeditor_view_render(HexEditor * hexeditor)
+{
+	const size_t columns = hexeditor->prefs.columns;
+	const size_t addr_stride = hexeditor->view_addr_width + 1;
+	const size_t hex_stride = hexeditorformat_get_hex_stride(
+			hexeditor->format);
+	const size_t data_stride = hexeditorformat_get_data_stride(
+			hexeditor->format);
+	size_t rows = hexeditor->view_rows;
+	HexEditorRowBlock * block;
+	off_t * offsets;
+	unsigned char * classes = NULL;
+	char * addr;
+	char * hex;
+	char * data;
+	char buf[80];
+	off_t row;
+	off_t last;
+	off_t offset;
+	off_t left;
+	off_t collapsed;
+	HexEditorExtentsType type;
+	size_t i;
+	size_t j;
+	size_t n;
+	size_t cnt;
+	size_t pos = 0;
+	size_t len = 0;
+
+	if(hexeditor->buffer == NULL || rows == 0)
+	{
+		gtk_text_buffer_set_text(hexeditor->view_addr_tbuf, "", 0);
+		gtk_text_buffer_set_text(hexeditor->view_hex_tbuf, "", 0);
+		gtk_text_buffer_set_text(hexeditor->view_data_tbuf, "", 0);
+		gtk_widget_queue_draw(hexeditor->view_overview);
+		return;
+	}
+	row = gtk_adjustment_get_value(hexeditor->view_adjustment);
+	last = MIN(_hexeditor_view_rows(hexeditor), row + (off_t)rows);
+	/* rendered again once the missing pages are read */
+	if((hexeditor->fetcher != NULL || hexeditor->process != NULL)
+			&& _view_render_fetch(hexeditor, row, last) > 0)
+		return;
+	offsets = malloc(rows * sizeof(*offsets));
+	if(hexeditor->prefs.colors)
+		classes = malloc(rows * columns);
+	addr = malloc(rows * addr_stride);
+	hex = malloc(rows * hex_stride);
+	data = malloc(rows * data_stride);
+	if(offsets == NULL || (hexeditor->prefs.colors && classes == NULL)
+			|| addr == NULL || hex == NULL || data == NULL)
+	{
+		_hexeditor_error(hexeditor, strerror(errno), 1);
+		last = row;
+	}
+	/* assemble the visible rows from the formatted blocks */
+	for(; row < last; row += cnt, pos += cnt)
+	{
+		if((offset = _hexeditor_view_offset(hexeditor, row, &left,
+						&collapsed, &type)) < 0)
+			break;
+		if(type != HEET_DATA)
+		{
+			/* a single row for the whole extent */
+			if(type == HEET_HOLE)
+				snprintf(buf, sizeof(buf),
+						_("<hole of %llu bytes>"),
+						(unsigned long long)collapsed);
+			else
+				snprintf(buf, sizeof(buf),
+						_("* <%llu identical rows>"),
+						(unsigned long long)collapsed
+						/ columns);
+			_view_render_marker(hexeditor, offset, buf,
+					&addr[pos * addr_stride],
+					&hex[pos * hex_stride], &data[len]);
+			len += _view_render_length(&data[len], data_stride);
+			offsets[pos] = -1;
+			if(classes != NULL)
+				memset(&classes[pos * columns], HEFC_NONE,
+						columns);
+			cnt = 1;
+			continue;
+		}
+		if((block = _view_render_block(hexeditor, offset
+						/ (HEXEDITOR_BLOCK_ROWS
+							* columns))) == NULL)
+			break;
+		if((i = (offset / columns) % HEXEDITOR_BLOCK_ROWS)
+				>= block->rows)
+			break;
+		cnt = MIN(block->rows - i, (size_t)(last - row));
+		cnt = MIN(cnt, (size_t)left);
+		for(j = 0; j < cnt; j++)
+			offsets[pos + j] = offset + j * columns;
+		if(classes != NULL && block->classes != NULL)
+			memcpy(&classes[pos * columns],
+					&block->classes[i * columns],
+					cnt * columns);
+		else if(classes != NULL)
+			memset(&classes[pos * columns], HEFC_NONE,
+					cnt * columns);
+		memcpy(&addr[pos * addr_stride], &block->addr[i * addr_stride],
+				cnt * addr_stride);
+		memcpy(&hex[pos * hex_stride], &block->hex[i * hex_stride],
+				cnt * hex_stride);
+		/* the rows of some encodings end before their stride */
+		for(j = i; j < i + cnt; j++, len += n)
+		{
+			n = _view_render_length(&block->data[j * data_stride],
+					data_stride);
+			memcpy(&data[len], &block->data[j * data_stride], n);
+		}
+	}
+	/* the last newline is not displayed */
+	gtk_text_buffer_set_text(hexeditor->view_addr_tbuf, addr,
+			(pos > 0) ? pos * addr_stride - 1 : 0);
+	gtk_text_buffer_set_text(hexeditor->view_hex_tbuf, hex,
+			(pos > 0) ? pos * hex_stride - 1 : 0);
+	gtk_text_buffer_set_text(hexeditor->view_data_tbuf, data,
+			(len > 0) ? len - 1 : 0);
+	/* highlighted by range, only over the rows displayed */
+	if(hexeditorannotations_get_count(hexeditor->annotations) > 0)
+		_view_render_annotations(hexeditor, offsets, pos);
+	/* colored by runs of the same class */
+	if(classes != NULL)
+	{
+		_view_render_classes(hexeditor, hexeditor->view_hex_tbuf,
+				classes, pos, TRUE);
+		_view_render_classes(hexeditor, hexeditor->view_data_tbuf,
+				classes, pos, FALSE);
+	}
+	/* where the rows displayed are */
+	gtk_widget_queue_draw(hexeditor->view_overview);
+	free(data);
+	free(hex);
+	free(addr);
+	free(classes);
+	free(offsets);
+}
+
+static void _view_render_annotations(HexEditor * hexeditor,
+		off_t const * offsets, size_t rows)
+{
+	HexEditorViewRows view;
+	size_t first;
+	size_t last;
+
+	/* the first and last rows of data */
+	for(first = 0; first < rows && offsets[first] < 0; first++);
+	for(last = rows; last > first && offsets[last - 1] < 0; last--);
+	if(first == last)
+		return;
+	view.hexeditor = hexeditor;
+	view.offsets = offsets;
+	view.rows = rows;
+	hexeditorannotations_query(hexeditor->annotations, offsets[first],
+			offsets[last - 1] + hexeditor->prefs.columns
+			- offsets[first], _hexeditor_on_view_annotation, &view);
+}
+
+static void _view_render_apply(GtkTextBuffer * tbuf, GtkTextTag * tag,
+		size_t line, size_t start, size_t line_end, size_t end)
+{
+	GtkTextIter iter;
+	GtkTextIter iter_end;
+	size_t chars;
+
+	gtk_text_buffer_get_iter_at_line(tbuf, &iter, line);
+	/* the rows of some encodings are shorter */
+	if(start >= (chars = gtk_text_iter_get_chars_in_line(&iter)))
+		return;
+	gtk_text_iter_set_line_offset(&iter, start);
+	gtk_text_buffer_get_iter_at_line(tbuf, &iter_end, line_end);
+	chars = gtk_text_iter_get_chars_in_line(&iter_end);
+	gtk_text_iter_set_line_offset(&iter_end, MIN(end, chars));
+	gtk_text_buffer_apply_tag(tbuf, tag, &iter, &iter_end);
+}
+
+static HexEditorRowBlock * _view_render_block(HexEditor * hexeditor,
+		off_t block)
+{
+	const size_t columns = hexeditor->prefs.columns;
+	HexEditorRowCacheKey key;
+	HexEditorRowBlock * ret;
+	unsigned char buf[HEXEDITOR_BLOCK_ROWS * HEXEDITORFORMAT_COLUMNS_MAX];
+	ssize_t size;
+	size_t i;
+
+	key.offset = block * HEXEDITOR_BLOCK_ROWS * columns;
+	key.columns = columns;
+	key.flags = _hexeditor_view_flags(hexeditor);
+	if((ret = hexeditorrowcache_lookup(hexeditor->rowcache, &key)) != NULL)
+		return ret;
+	if((size = hexeditorbuffer_read(hexeditor->buffer, key.offset, buf,
+					HEXEDITOR_BLOCK_ROWS * columns)) < 0)
+	{
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		/* left blank, rather than reported again on every render */
+		hexeditorbuffer_fill(hexeditor->buffer, key.offset
+				- (key.offset % HEXEDITORBUFFER_PAGE_SIZE),
+				(char const *)buf, 0);
+		return NULL;
+	}
+	if(size == 0)
+		/* the file was truncated */
+		return NULL;
+	if((ret = hexeditorrowblock_new((size + columns - 1) / columns,
+					hexeditor->view_addr_width + 1,
+					hexeditorformat_get_hex_stride(
+						hexeditor->format),
+					hexeditorformat_get_data_stride(
+						hexeditor->format),
+					hexeditor->prefs.colors ? columns : 0))
+			== NULL)
+	{
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		return NULL;
+	}
+	for(i = 0; i < ret->rows; i++)
+		_view_render_row(hexeditor, key.offset + i * columns,
+				&buf[i * columns],
+				MIN(size - i * columns, columns),
+				&ret->addr[i * ret->addr_stride],
+				&ret->hex[i * ret->hex_stride],
+				&ret->data[i * ret->data_stride]);
+	if(ret->classes != NULL)
+		for(i = 0; i < ret->rows; i++)
+			hexeditorformat_classes(hexeditor->format,
+					&buf[i * columns],
+					MIN(size - i * columns, columns),
+					&ret->classes[i * ret->classes_stride]);
+	if(hexeditorrowcache_insert(hexeditor->rowcache, &key, ret) != 0)
+	{
+		hexeditorrowblock_delete(ret);
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		return NULL;
+	}
+	return ret;
+}
+
+static void _view_render_classes(HexEditor * hexeditor, GtkTextBuffer * tbuf,
+		unsigned char const * classes, size_t rows, gboolean hex)
+{
+	const size_t columns = hexeditor->prefs.columns;
+	const size_t group = hexeditorformat_get_group(hexeditor->format);
+	const size_t width = hex ? 2 : 1;
+	const int little = (_hexeditor_view_flags(hexeditor)
+			& HEXEDITOR_FLAG_LITTLE_ENDIAN) ? 1 : 0;
+	HexEditorClassRun runs[HEXEDITOR_CLASS_RUNS + 1];
+	size_t cnt;
+	unsigned int run = HEFC_NONE;
+	uint32_t color;
+	size_t run_line = 0;
+	size_t run_start = 0;
+	size_t run_line_end = 0;
+	size_t run_end = 0;
+	unsigned int class;
+	size_t position;
+	size_t i;
+	size_t j;
+	size_t k;
+
+	for(i = 0; i < rows; i++)
+	{
+		/* the runs of the row, in the order displayed */
+		for(cnt = 0, k = 0; k < columns; k++)
+		{
+			j = (hex && little) ? k - (k % group) + group - 1
+				- (k % group) : k;
+			position = hex ? hexeditorformat_get_hex_position(
+					hexeditor->format, j) : k;
+			class = classes[i * columns + j];
+			if(cnt > 0 && runs[cnt - 1].class == class)
+			{
+				runs[cnt - 1].end = position + width;
+				continue;
+			}
+			runs[cnt].class = class;
+			runs[cnt].start = position;
+			runs[cnt].end = position + width;
+			if(++cnt > HEXEDITOR_CLASS_RUNS)
+				break;
+		}
+		/* the colors are exact or none, as the rows too mixed would
+		 * cost a tag per byte */
+		if(cnt > HEXEDITOR_CLASS_RUNS)
+		{
+			runs[0].class = HEFC_NONE;
+			runs[0].start = 0;
+			runs[0].end = 0;
+			cnt = 1;
+		}
+		/* the runs go on across the rows */
+		for(k = 0; k < cnt; k++)
+		{
+			if(k == 0 && i > 0 && runs[k].class == run)
+			{
+				run_line_end = i;
+				run_end = runs[k].end;
+				continue;
+			}
+			/* the printable characters keep the default color */
+			if((color = _hexeditor_class_colors[run]) != 0)
+				_view_render_apply(tbuf, _view_render_tag(tbuf,
+							"foreground", color),
+						run_line, run_start,
+						run_line_end, run_end);
+			run = runs[k].class;
+			run_line = i;
+			run_start = runs[k].start;
+			run_line_end = i;
+			run_end = runs[k].end;
+		}
+	}
+	if((color = _hexeditor_class_colors[run]) != 0)
+		_view_render_apply(tbuf, _view_render_tag(tbuf, "foreground",
+					color), run_line, run_start,
+				run_line_end, run_end);
+}
+
+static int _view_render_fetch(HexEditor * hexeditor, off_t row, off_t last)
+{
+	int ret;
+	const off_t columns = hexeditor->prefs.columns;
+	const off_t block = HEXEDITOR_BLOCK_ROWS * columns;
+	HexEditorRowCacheKey key;
+	off_t offsets[HEXEDITORBUFFER_READAHEAD];
+	size_t cnt = 0;
+	off_t offset;
+	off_t rows;
+	off_t collapsed;
+	HexEditorExtentsType type;
+
+	key.columns = columns;
+	key.flags = _hexeditor_view_flags(hexeditor);
+	/* collect the blocks neither formatted nor buffered yet */
+	for(; row < last && cnt + 1 < sizeof(offsets) / sizeof(*offsets);
+			row += rows)
+	{
+		if((offset = _hexeditor_view_offset(hexeditor, row, &rows,
+						&collapsed, &type)) < 0)
+			break;
+		if(type != HEET_DATA)
+			continue;
+		/* the rows left in this block */
+		rows = MIN(rows, HEXEDITOR_BLOCK_ROWS - (offset / columns)
+				% HEXEDITOR_BLOCK_ROWS);
+		key.offset = offset - (offset % block);
+		if(hexeditorrowcache_lookup(hexeditor->rowcache, &key) != NULL)
+			continue;
+		/* the blocks of odd widths may straddle two pages */
+		offsets[cnt++] = key.offset;
+		if((key.offset + block - 1) / HEXEDITORBUFFER_PAGE_SIZE
+				!= key.offset / HEXEDITORBUFFER_PAGE_SIZE)
+			offsets[cnt++] = key.offset + block - 1;
+	}
+	if((ret = _hexeditor_prefetch(hexeditor, offsets, cnt)) < 0)
+		/* read synchronously instead */
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+	return ret;
+}
+
+static size_t _view_render_length(char const * data, size_t stride)
+{
+	char const * p;
+
+	/* up to the newline */
+	return ((p = memchr(data, '\n', stride)) != NULL)
+		? (size_t)(p - data) + 1 : stride;
+}
+
+static void _view_render_marker(HexEditor * hexeditor, off_t offset,
+		char const * text, char * addr, char * hex, char * data)
+{
+	_view_render_row(hexeditor, offset, NULL, 0, addr, hex, data);
+	/* within the hexadecimal column */
+	memcpy(hex, text, MIN(strlen(text), hexeditorformat_get_hex_stride(
+					hexeditor->format) - 1));
+}
+
+static void _view_render_row(HexEditor * hexeditor, off_t offset,
+		unsigned char const * buf, size_t size,
+		char * addr, char * hex, char * data)
+{
+	hexeditorformat_address(hexeditor->format, offset,
+			hexeditor->view_addr_width, addr);
+	/* padded at the end of the file */
+	hexeditorformat_row(hexeditor->format, offset, buf, size, hex, data);
+}
+
+static GtkTextTag * _view_render_tag(GtkTextBuffer * tbuf,
+		char const * property, uint32_t color)
+{
+	GtkTextTag * tag;
+	char name[32];
+	char value[8];
+
+	/* one tag per property and color */
+	snprintf(name, sizeof(name), "%s-%06x", property, (unsigned int)color);
+	if((tag = gtk_text_tag_table_lookup(gtk_text_buffer_get_tag_table(
+						tbuf), name)) != NULL)
+		return tag;
+	snprintf(value, sizeof(value), "#%06x", (unsigned int)color);
+	return gtk_text_buffer_create_tag(tbuf, name, property, value, NULL);
+}
+
+
+/* hexeditor_view_flags */
+static unsigned int _hexeditor_view_flags(HexEditor * hexeditor)
+{
+	unsigned int ret = hexeditor->view_addr_width << 8;
+
+	if(hexeditor->prefs.uppercase)
+		ret |= HEXEDITOR_FLAG_UPPERCASE;
+	/* the words are only ever swapped when grouped */
+	if(hexeditorformat_get_group(hexeditor->format) > 1
+			&& hexeditor->prefs.little_endian)
+		ret |= HEXEDITOR_FLAG_LITTLE_ENDIAN;
+	ret |= hexeditorformat_get_group(hexeditor->format) << 4;
+	ret |= hexeditorformat_get_encoding(hexeditor->format) << 16;
+	if(hexeditor->prefs.colors)
+		ret |= HEXEDITOR_FLAG_CLASSES;
+	return ret;
+}
+
+
+/* hexeditor_view_format */
+static int _hexeditor_view_format(HexEditor * hexeditor)
+{
+	HexEditorFormat * format;
+	unsigned int flags = 0;
+
+	if(hexeditor->prefs.uppercase)
+		flags |= HEXEDITORFORMAT_FLAG_UPPERCASE;
+	if(hexeditor->prefs.little_endian)
+		flags |= HEXEDITORFORMAT_FLAG_LITTLE_ENDIAN;
+	if((format = hexeditorformat_new(hexeditor->prefs.columns,
+					hexeditor->prefs.group,
+					hexeditor->prefs.encoding, flags))
+			== NULL)
+		return -1;
+	if(hexeditor->format != NULL)
+		hexeditorformat_delete(hexeditor->format);
+	hexeditor->format = format;
+	/* the rows formatted otherwise are no longer needed */
+	if(hexeditor->rowcache != NULL)
+		hexeditorrowcache_expire(hexeditor->rowcache,
+				hexeditor->prefs.columns,
+				_hexeditor_view_flags(hexeditor));
+	return 0;
+}
+
+
+/* hexeditor_view_grow */
+static void _hexeditor_view_grow(HexEditor * hexeditor, off_t size)
+{
+	const off_t block = HEXEDITOR_BLOCK_ROWS * hexeditor->prefs.columns;
+	off_t from = MIN(hexeditor->size, size);
+
+	/* forget what was read past the former end of the file */
+	hexeditorbuffer_set_size(hexeditor->buffer, size);
+	hexeditorrowcache_invalidate(hexeditor->rowcache, from - (from % block),
+			MAX(hexeditor->size, size) - from + block);
+	hexeditor->size = size;
+	if(hexeditor->overview != NULL && hexeditoroverview_set_size(
+				hexeditor->overview, size) != 0)
+	{
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		hexeditoroverview_delete(hexeditor->overview);
+		hexeditor->overview = NULL;
+	}
+	if(hexeditor->extents == NULL
+			|| hexeditorextents_get_holes(hexeditor->extents) > 0)
+		/* the holes may have changed as well */
+		_hexeditor_extents_open(hexeditor, TRUE);
+	else
+		hexeditorextents_set_size(hexeditor->extents, size);
+	if(_hexeditor_view_width(hexeditor) != 0)
+		hexeditorrowcache_expire(hexeditor->rowcache,
+				hexeditor->prefs.columns,
+				_hexeditor_view_flags(hexeditor));
+	_hexeditor_view_refresh(hexeditor);
+}
+
+
+/* hexeditor_view_offset */
+static off_t _hexeditor_view_offset(HexEditor * hexeditor, off_t row,
+		off_t * rows, off_t * collapsed, HexEditorExtentsType * type)
+{
+	if(hexeditor->extents != NULL)
+		return hexeditorextents_row_to_offset(hexeditor->extents, row,
+				rows, collapsed, type);
+	if(row < 0 || row >= _hexeditor_view_rows(hexeditor))
+		return -1;
+	*rows = _hexeditor_view_rows(hexeditor) - row;
+	*collapsed = 0;
+	*type = HEET_DATA;
+	return row * hexeditor->prefs.columns;
+}
+
+
+/* hexeditor_view_overview */
+static void _hexeditor_view_overview(HexEditor * hexeditor, cairo_t * cairo)
+{
+	/* Tango colors, by class */
+	static const double colors[HEOC_COUNT][3] =
+	{
+		{ 0.73, 0.74, 0.71 },	/* not scanned yet */
+		{ 0.93, 0.93, 0.93 },	/* zeros */
+		{ 0.33, 0.34, 0.33 },	/* 0xff */
+		{ 0.20, 0.40, 0.64 },	/* text */
+		{ 0.80, 0.00, 0.00 },	/* compressed or encrypted */
+		{ 0.96, 0.47, 0.00 }	/* anything else */
+	};
+	GtkAllocation allocation;
+	HexEditorOverviewClass c;
+	HexEditorOverviewClass last = HEOC_UNKNOWN;
+	const off_t size = hexeditor->size;
+	off_t span;
+	off_t row;
+	off_t rows;
+	off_t collapsed;
+	off_t first;
+	off_t end;
+	HexEditorExtentsType type;
+	double top;
+	double bottom;
+	int y;
+	int from = 0;
+
+	gtk_widget_get_allocation(hexeditor->view_overview, &allocation);
+	if(hexeditor->overview == NULL || size == 0 || allocation.height <= 0)
+		return;
+	/* a single summary per row of pixels, whatever the size */
+	span = MAX(size / allocation.height, 1);
+	for(y = 0; y <= allocation.height; y++)
+	{
+		c = (y < allocation.height) ? hexeditoroverview_get_class(
+				hexeditor->overview, (double)size * y
+				/ allocation.height, span) : HEOC_UNKNOWN;
+		if(y > 0 && y < allocation.height && c == last)
+			continue;
+		if(y > from)
+		{
+			cairo_set_source_rgb(cairo, colors[last][0],
+					colors[last][1], colors[last][2]);
+			cairo_rectangle(cairo, 0.0, from, allocation.width,
+					y - from);
+			cairo_fill(cairo);
+		}
+		from = y;
+		last = c;
+	}
+	/* the rows displayed */
+	row = gtk_adjustment_get_value(hexeditor->view_adjustment);
+	if((first = _hexeditor_view_offset(hexeditor, row, &rows, &collapsed,
+					&type)) < 0)
+		return;
+	if((end = _hexeditor_view_offset(hexeditor, row + hexeditor->view_rows,
+					&rows, &collapsed, &type)) < 0)
+		end = size;
+	top = (double)first * allocation.height / size;
+	bottom = MAX((double)end * allocation.height / size, top + 2.0);
+	cairo_rectangle(cairo, 0.5, top + 0.5, allocation.width - 1.0,
+			bottom - top - 1.0);
+	cairo_set_source_rgba(cairo, 0.0, 0.0, 0.0, 0.2);
+	cairo_fill_preserve(cairo);
+	cairo_set_source_rgb(cairo, 0.0, 0.0, 0.0);
+	cairo_set_line_width(cairo, 1.0);
+	cairo_stroke(cairo);
+}
+
+
+/* hexeditor_view_overview_scroll */
+static void _hexeditor_view_overview_scroll(HexEditor * hexeditor, gdouble y)
+{
+	GtkAllocation allocation;
+	off_t offset;
+
+	gtk_widget_get_allocation(hexeditor->view_overview, &allocation);
+	if(hexeditor->buffer == NULL || hexeditor->size == 0
+			|| allocation.height <= 0)
+		return;
+	/* centered on the position clicked */
+	offset = CLAMP(y, 0.0, allocation.height) * hexeditor->size
+		/ allocation.height;
+	offset = MIN(offset, hexeditor->size - 1);
+	_hexeditor_view_scroll_to(hexeditor, _hexeditor_view_row(hexeditor,
+				offset) - (gdouble)hexeditor->view_rows / 2);
+}
+
+
+/* hexeditor_view_row */
+static off_t _hexeditor_view_row(HexEditor * hexeditor, off_t offset)
+{
+	if(hexeditor->extents != NULL)
+		return hexeditorextents_offset_to_row(hexeditor->extents,
+				offset);
+	return offset / hexeditor->prefs.columns;
+}
+
+
+/* hexeditor_view_rows */
+static off_t _hexeditor_view_rows(HexEditor * hexeditor)
+{
+	if(hexeditor->extents != NULL)
+		return hexeditorextents_get_rows(hexeditor->extents);
+	return (hexeditor->size + hexeditor->prefs.columns - 1)
+		/ hexeditor->prefs.columns;
+}
+
+
+/* hexeditor_view_scroll_to */
+static void _hexeditor_view_scroll_to(HexEditor * hexeditor, gdouble row)
+{
+	GtkAdjustment * adjustment = hexeditor->view_adjustment;
+	gdouble upper;
+
+	upper = gtk_adjustment_get_upper(adjustment)
+		- gtk_adjustment_get_page_size(adjustment);
+	gtk_adjustment_set_value(adjustment, CLAMP(row, 0.0, MAX(upper, 0.0)));
+}
+
+
+/* hexeditor_view_width */
+static int _hexeditor_view_width(HexEditor * hexeditor)
+{
+	int width;
+	off_t size;
+
+	/* one more digit for every nibble past 32 bits */
+	for(width = 8, size = hexeditor->size >> 32; size > 0; size >>= 4)
+		width++;
+	/* the addresses of processes are displayed in full */
+	if(hexeditor->process != NULL)
+		width = 16;
+	if(width == hexeditor->view_addr_width)
+		return 0;
+	hexeditor->view_addr_width = width;
+	return 1;
+}
+
+
+/* callbacks */
+/* hexeditor_on_codec */
+static gboolean _hexeditor_on_codec(gpointer data)
+{
+	HexEditor * hexeditor = data;
+	HexEditorSearch * search = hexeditor->search_pending;
+	char buf[HEXEDITOR_SCAN_SIZE];
+	ssize_t res;
+	off_t size;
+
+	/* the plug-ins see the decompressed data as it is indexed */
+	if((res = hexeditorcodec_read(hexeditor->codec, buf, sizeof(buf),
+					hexeditor->offset)) < 0)
+	{
+		hexeditor->source = 0;
+		gtk_widget_hide(hexeditor->pg_window);
+		if(search != NULL)
+			hexeditorsearch_delete(search);
+		hexeditor->search_pending = NULL;
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		return FALSE;
+	}
+	/* the plug-ins may read back what they are given */
+	if((size = hexeditorcodec_get_size(hexeditor->codec))
+			> hexeditor->size)
+		_hexeditor_view_grow(hexeditor, size);
+	if(res > 0)
+	{
+		_open_plugins_read(hexeditor, hexeditor->offset, buf, res);
+		hexeditor->offset += res;
+	}
+	/* collapse the runs of identical rows, within the data displayed */
+	if(hexeditor->extents != NULL && hexeditorextents_scan(
+				hexeditor->extents, hexeditor->offset - res,
+				(res > 0) ? buf : NULL, res) > 0)
+		_hexeditor_view_queue(hexeditor);
+	if(res > 0)
+	{
+		_open_progress(hexeditor);
+		return TRUE;
+	}
+	hexeditor->source = 0;
+	gtk_widget_hide(hexeditor->pg_window);
+	/* later jumps only decompress from the nearest checkpoint */
+	if(hexeditorcodec_save(hexeditor->codec) != 0)
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+	_hexeditor_scan_finish(hexeditor, TRUE);
+	/* the whole file can be searched now */
+	hexeditor->search_pending = NULL;
+	if(search != NULL)
+		_hexeditor_search(hexeditor, search);
+	return FALSE;
+}
+
+
+/* hexeditor_on_codec_read */
+static ssize_t _hexeditor_on_codec_read(void * data, void * buf, size_t size,
+		off_t offset)
+{
+	HexEditorCodec * codec = data;
+
+	return hexeditorcodec_read(codec, buf, size, offset);
+}
+
+
+/* hexeditor_on_colors_toggled */
+static void _hexeditor_on_colors_toggled(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	hexeditor_set_colors(hexeditor, gtk_toggle_tool_button_get_active(
+				GTK_TOGGLE_TOOL_BUTTON(hexeditor->tb_colors)));
+}
+
+
+/* hexeditor_on_encoding_changed */
+static void _hexeditor_on_encoding_changed(gpointer data)
+{
+	HexEditor * hexeditor = data;
+	gint active;
+
+	if((active = gtk_combo_box_get_active(GTK_COMBO_BOX(
+						hexeditor->tb_encoding))) < 0
+			|| (unsigned int)active == hexeditor->prefs.encoding)
+		return;
+	hexeditor_set_encoding(hexeditor, hexeditorformat_get_encoding_name(
+				active));
+}
+
+
+/* hexeditor_on_export */
+static gboolean _hexeditor_on_export(gpointer data)
+{
+	HexEditor * hexeditor = data;
+	GtkProgressBar * progress = GTK_PROGRESS_BAR(hexeditor->pg_progress);
+	int res;
+	time_t t;
+	gdouble fraction;
+	char buf[16];
+
+	if((res = hexeditorexport_step(hexeditor->export)) <= 0)
+	{
+		hexeditor->export_source = 0;
+		_hexeditor_export_finish(hexeditor, (res == 0) ? TRUE : FALSE);
+		if(res < 0)
+			_hexeditor_error(hexeditor, error_get(NULL), 1);
+		return FALSE;
+	}
+	/* once per second, the scan may have hidden the window */
+	if((t = time(NULL)) > hexeditor->time)
+	{
+		hexeditor->time = t;
+		fraction = hexeditorexport_get_position(hexeditor->export);
+		fraction = fraction / hexeditorexport_get_size(
+				hexeditor->export);
+		gtk_progress_bar_set_fraction(progress, fraction);
+		snprintf(buf, sizeof(buf), "%.1f%%", fraction * 100);
+		gtk_progress_bar_set_text(progress, buf);
+		gtk_widget_show(hexeditor->pg_window);
+		gtk_widget_queue_draw(hexeditor->view_overview);
+	}
+	return TRUE;
+}
+
+
+/* hexeditor_on_fetch */
+static void _hexeditor_on_fetch(void * data, unsigned int generation,
+		off_t offset, char const * buf, ssize_t size)
+{
+	HexEditor * hexeditor = data;
+	off_t * p;
+
+	/* the file was reloaded or modified since: request it again */
+	if(generation != hexeditorbuffer_get_generation(hexeditor->buffer))
+	{
+		_hexeditor_view_queue(hexeditor);
+		return;
+	}
+	if(size < 0)
+	{
+		/* read synchronously by the next render instead, which
+		 * reports the error if it persists */
+		if((p = realloc(hexeditor->fetch_failed, sizeof(*p)
+						* (hexeditor->fetch_failed_cnt
+							+ 1))) == NULL)
+		{
+			_hexeditor_error(hexeditor, strerror(-size), 1);
+			return;
+		}
+		if(hexeditor->fetch_failed_generation != generation)
+			hexeditor->fetch_failed_cnt = 0;
+		hexeditor->fetch_failed = p;
+		hexeditor->fetch_failed_generation = generation;
+		p[hexeditor->fetch_failed_cnt++] = offset;
+	}
+	/* short pages end where the file did, which the buffer expects */
+	else if(hexeditorbuffer_fill(hexeditor->buffer, offset, buf, size)
+			!= 0)
+	{
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		return;
+	}
+	_hexeditor_view_queue(hexeditor);
+}
+
+
+/* hexeditor_on_follow */
+static void _follow_append(HexEditor * hexeditor, off_t size);
+static void _follow_reload(HexEditor * hexeditor, off_t size);
+
+static void _hexeditor_on_follow(void * data, off_t size)
+{
+	HexEditor * hexeditor = data;
+
+	/* the transform modifies the file itself, and is waited for */
+	if(hexeditor->transform != NULL
+			&& hexeditor->transform_filename == NULL)
+	{
+		hexeditor->follow_size = size;
+		return;
+	}
+	if(hexeditor->prefs.follow && size > hexeditor->size)
+		_follow_append(hexeditor, size);
+	else
+		_follow_reload(hexeditor, size);
+}
+
+static void _follow_append(HexEditor * hexeditor, off_t size)
+{
+	const off_t offset = hexeditor->size;
+	gdouble value;
+	gboolean bottom;
+
+	value = gtk_adjustment_get_value(hexeditor->view_adjustment);
+	bottom = (value + gtk_adjustment_get_page_size(
+				hexeditor->view_adjustment)
+			>= gtk_adjustment_get_upper(
+				hexeditor->view_adjustment)) ? TRUE : FALSE;
+	_hexeditor_view_grow(hexeditor, size);
+	/* keep the last rows in sight */
+	if(bottom)
+		_hexeditor_view_scroll_to(hexeditor,
+				gtk_adjustment_get_upper(
+					hexeditor->view_adjustment));
+	if(hexeditor->tail)
+	{
+		/* feed the plug-ins with the new data */
+		hexeditor->tail = FALSE;
+		hexeditor->source = g_io_add_watch(hexeditor->channel, G_IO_IN,
+				_open_on_can_read, hexeditor);
+	}
+	/* the blocks appended are compared, keeping the digest */
+	else if(hexeditor->source == 0 && hexeditor->digest != NULL
+			&& hexeditordigest_is_complete(hexeditor->digest))
+		_hexeditor_verify_start(hexeditor, 0, -1);
+	/* the scan was complete before following, and resumes from there */
+	else if(hexeditor->source == 0 && hexeditor->channel != NULL
+			&& hexeditor->offset == offset)
+		hexeditor->source = g_io_add_watch(hexeditor->channel, G_IO_IN,
+				_open_on_can_read, hexeditor);
+}
+
+static void _follow_reload(HexEditor * hexeditor, off_t size)
+{
+	/* what is displayed is cheap to read again */
+	hexeditorbuffer_flush(hexeditor->buffer);
+	hexeditorbuffer_set_size(hexeditor->buffer, size);
+	hexeditorrowcache_flush(hexeditor->rowcache);
+	hexeditor->size = size;
+	/* the runs of identical rows may be gone */
+	_hexeditor_extents_open(hexeditor, FALSE);
+	_hexeditor_view_width(hexeditor);
+	_hexeditor_view_refresh(hexeditor);
+	/* only tell the plug-ins about the blocks modified */
+	_hexeditor_verify_start(hexeditor, 0, -1);
+}
+
+
+/* hexeditor_on_follow_toggled */
+static void _hexeditor_on_follow_toggled(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	hexeditor_set_follow(hexeditor, gtk_toggle_tool_button_get_active(
+				GTK_TOGGLE_TOOL_BUTTON(hexeditor->tb_follow)));
+}
+
+
+/* hexeditor_on_goto */
+static void _hexeditor_on_goto(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	hexeditor_goto_dialog(hexeditor);
+}
+
+
+/* hexeditor_on_open */
+static void _hexeditor_on_open(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	hexeditor_open_dialog(hexeditor);
+}
+
+
+/* hexeditor_on_overview_button_press */
+static gboolean _hexeditor_on_overview_button_press(GtkWidget * widget,
+		GdkEventButton * event, gpointer data)
+{
+	HexEditor * hexeditor = data;
+	(void) widget;
+
+	if(event->type != GDK_BUTTON_PRESS || event->button != 1)
+		return FALSE;
+	_hexeditor_view_overview_scroll(hexeditor, event->y);
+	return TRUE;
+}
+
+
+#if GTK_CHECK_VERSION(3, 0, 0)
+/* hexeditor_on_overview_draw */
+static gboolean _hexeditor_on_overview_draw(GtkWidget * widget,
+		cairo_t * cairo, gpointer data)
+{
+	HexEditor * hexeditor = data;
+	(void) widget;
+
+	_hexeditor_view_overview(hexeditor, cairo);
+	return TRUE;
+}
+#else
+/* hexeditor_on_overview_expose */
+static gboolean _hexeditor_on_overview_expose(GtkWidget * widget,
+		GdkEventExpose * event, gpointer data)
+{
+	HexEditor * hexeditor = data;
+	cairo_t * cairo;
+	(void) event;
+
+	cairo = gdk_cairo_create(gtk_widget_get_window(widget));
+	_hexeditor_view_overview(hexeditor, cairo);
+	cairo_destroy(cairo);
+	return TRUE;
+}
+#endif
+
+
+/* hexeditor_on_overview_motion */
+static gboolean _hexeditor_on_overview_motion(GtkWidget * widget,
+		GdkEventMotion * event, gpointer data)
+{
+	HexEditor * hexeditor = data;
+	(void) widget;
+
+	/* dragged like a scrollbar */
+	if(!(event->state & GDK_BUTTON1_MASK))
+		return FALSE;
+	_hexeditor_view_overview_scroll(hexeditor, event->y);
+	return TRUE;
+}
+
+
+/* hexeditor_on_plugin_combo_change */
+static void _hexeditor_on_plugin_combo_change(gpointer data)
+{
+	HexEditor * hexeditor = data;
+	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
+	GtkTreeIter active;
+	GtkTreeIter iter;
+	gboolean valid;
+	GtkTreePath * a = NULL;
+	GtkTreePath * p;
+	GtkWidget * widget;
+
+	if(gtk_combo_box_get_active_iter(GTK_COMBO_BOX(hexeditor->pl_combo),
+				&active) == TRUE)
+		a = gtk_tree_model_get_path(model, &active);
+	/* only show the widget of the plug-in selected */
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
+			valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gtk_tree_model_get(model, &iter, HEPC_WIDGET, &widget, -1);
+		p = gtk_tree_model_get_path(model, &iter);
+		if(a != NULL && gtk_tree_path_compare(a, p) == 0)
+			gtk_widget_show(widget);
+		else
+			gtk_widget_hide(widget);
+		gtk_tree_path_free(p);
+	}
+	if(a != NULL)
+		gtk_tree_path_free(a);
+}
+
+
+#ifdef EMBEDDED
+/* hexeditor_on_preferences */
+static void _hexeditor_on_preferences(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	hexeditor_show_preferences(hexeditor, TRUE);
+}
+#endif
+
+
+/* hexeditor_on_process */
+static gboolean _hexeditor_on_process(gpointer data)
+{
+	HexEditor * hexeditor = data;
+	char buf[HEXEDITOR_SCAN_SIZE];
+	size_t size = sizeof(buf);
+	ssize_t res;
+	off_t end = 0;
+	int hole = 0;
+
+	/* the unmapped ranges are skipped, the plug-ins are only told */
+	if(hexeditor->extents != NULL && (end = hexeditorextents_get_end(
+					hexeditor->extents, hexeditor->offset,
+					&hole)) > hexeditor->offset && hole)
+	{
+		_open_plugins_hole(hexeditor, hexeditor->offset,
+				end - hexeditor->offset);
+		hexeditor->offset = end;
+		_open_progress(hexeditor);
+		return TRUE;
+	}
+	else if(end > hexeditor->offset && (off_t)size > end - hexeditor->offset)
+		size = end - hexeditor->offset;
+	if((res = hexeditorprocess_read(hexeditor->process, buf, size,
+					hexeditor->offset)) < 0)
+	{
+		hexeditor->source = 0;
+		gtk_widget_hide(hexeditor->pg_window);
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		return FALSE;
+	}
+	if(res > 0)
+	{
+		_open_plugins_read(hexeditor, hexeditor->offset, buf, res);
+		if(hexeditor->extents != NULL && hexeditorextents_scan(
+					hexeditor->extents, hexeditor->offset,
+					buf, res) > 0)
+			_hexeditor_view_queue(hexeditor);
+		hexeditor->offset += res;
+		_open_progress(hexeditor);
+		return TRUE;
+	}
+	hexeditor->source = 0;
+	gtk_widget_hide(hexeditor->pg_window);
+	if(hexeditor->extents != NULL && hexeditorextents_scan(
+				hexeditor->extents, hexeditor->offset, NULL, 0)
+			> 0)
+		_hexeditor_view_queue(hexeditor);
+	_hexeditor_scan_finish(hexeditor, TRUE);
+	return FALSE;
+}
+
+
+/* hexeditor_on_process_read */
+static ssize_t _hexeditor_on_process_read(void * data, void * buf,
+		size_t size, off_t offset)
+{
+	HexEditorProcess * process = data;
+
+	return hexeditorprocess_read(process, buf, size, offset);
+}
+
+
+/* hexeditor_on_progress_cancel */
+static void _hexeditor_on_progress_cancel(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	if(hexeditor->export != NULL)
+		_hexeditor_export_finish(hexeditor, FALSE);
+	else if(hexeditor->transform != NULL)
+		_hexeditor_transform_finish(hexeditor, FALSE);
+	else if(hexeditor->search_source != 0)
+		_hexeditor_search_finish(hexeditor);
+	else
+		_hexeditor_scan_cancel(hexeditor);
+}
+
+
+/* hexeditor_on_progress_delete */
+static gboolean _hexeditor_on_progress_delete(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	gtk_widget_show(hexeditor->pg_window);
+	return TRUE;
+}
+
+
+#ifdef EMBEDDED
+/* hexeditor_on_properties */
+static void _hexeditor_on_properties(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	hexeditor_show_properties(hexeditor, TRUE);
+}
+#endif
+
+
+/* hexeditor_on_refresh */
+static void _hexeditor_on_refresh(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	hexeditor_refresh(hexeditor);
+}
+
+
+/* hexeditor_on_runs */
+static gboolean _hexeditor_on_runs(gpointer data)
+{
+	HexEditor * hexeditor = data;
+	char buf[HEXEDITOR_SCAN_SIZE];
+	off_t offset = hexeditor->runs_offset;
+	size_t size = sizeof(buf);
+	ssize_t res = 0;
+	off_t end = 0;
+	int hole = 0;
+
+	if(hexeditor->extents == NULL)
+	{
+		hexeditor->runs_source = 0;
+		return FALSE;
+	}
+	/* the holes are skipped */
+	if(offset < hexeditor->runs_end && (end = hexeditorextents_get_end(
+					hexeditor->extents, offset, &hole))
+			> offset && hole)
+	{
+		hexeditor->runs_offset = end;
+		return TRUE;
+	}
+	if(end > offset && (off_t)size > end - offset)
+		size = end - offset;
+	if((off_t)size > hexeditor->runs_end - offset)
+		size = hexeditor->runs_end - offset;
+	/* read the file directly, without going through the pages */
+	if(size == 0)
+		res = 0;
+	else if(hexeditor->codec != NULL)
+		res = hexeditorcodec_read(hexeditor->codec, buf, size, offset);
+	else if(hexeditor->process != NULL)
+		res = hexeditorprocess_read(hexeditor->process, buf, size,
+				offset);
+	else if(hexeditor->spool != NULL)
+		res = hexeditorspool_read(hexeditor->spool, buf, size, offset);
+	else if((res = pread(hexeditor->fd, buf, size, offset)) < 0
+			&& errno == EINTR)
+		/* tried again */
+		return TRUE;
+	/* they are only displayed, and are not worth an error */
+	if(res <= 0)
+	{
+		hexeditor->runs_source = 0;
+		if(hexeditorextents_scan(hexeditor->extents, offset, NULL, 0)
+				> 0)
+			_hexeditor_view_queue(hexeditor);
+		return FALSE;
+	}
+	if(hexeditorextents_scan(hexeditor->extents, offset, buf, res) > 0)
+		_hexeditor_view_queue(hexeditor);
+	hexeditor->runs_offset += res;
+	return TRUE;
+}
+
+
+/* hexeditor_on_search */
+static gboolean _hexeditor_on_search(gpointer data)
+{
+	HexEditor * hexeditor = data;
+	GtkProgressBar * progress = GTK_PROGRESS_BAR(hexeditor->pg_progress);
+	int res;
+	gdouble fraction;
+	char buf[16];
+
+	/* the hits are shown as they are found */
+	if((res = hexeditorsearch_poll(hexeditor->search)) <= 0)
+	{
+		if(res < 0)
+			_hexeditor_error(hexeditor, error_get(NULL), 1);
+		_hexeditor_search_finish(hexeditor);
+		return FALSE;
+	}
+	_hexeditor_search_update(hexeditor);
+	fraction = hexeditorsearch_get_position(hexeditor->search);
+	fraction = fraction / hexeditorsearch_get_size(hexeditor->search);
+	gtk_progress_bar_set_fraction(progress, fraction);
+	snprintf(buf, sizeof(buf), "%.1f%%", fraction * 100);
+	gtk_progress_bar_set_text(progress, buf);
+	/* the scan may have hidden the window */
+	gtk_widget_show(hexeditor->pg_window);
+	return TRUE;
+}
+
+
+/* hexeditor_on_search_button_press */
+static gboolean _hexeditor_on_search_button_press(GtkWidget * widget,
+		GdkEventButton * event, gpointer data)
+{
+	HexEditor * hexeditor = data;
+	GtkTextIter iter;
+	gint x;
+	gint y;
+	size_t index;
+	off_t offset;
+
+	if(event->type != GDK_BUTTON_PRESS || event->button != 1
+			|| hexeditor->search == NULL)
+		return FALSE;
+	/* go to the hit clicked */
+	gtk_text_view_window_to_buffer_coords(GTK_TEXT_VIEW(widget),
+			GTK_TEXT_WINDOW_TEXT, event->x, event->y, &x, &y);
+	gtk_text_view_get_iter_at_location(GTK_TEXT_VIEW(widget), &iter, x, y);
+	index = gtk_adjustment_get_value(hexeditor->se_adjustment);
+	index += gtk_text_iter_get_line(&iter);
+	if((offset = hexeditorsearch_get_hit(hexeditor->search, index, NULL))
+			< 0)
+		return FALSE;
+	hexeditor_goto(hexeditor, offset);
+	return TRUE;
+}
+
+
+/* hexeditor_on_search_close */
+static void _hexeditor_on_search_close(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	_hexeditor_search_clear(hexeditor);
+}
+
+
+/* hexeditor_on_search_scroll */
+static gboolean _hexeditor_on_search_scroll(GtkWidget * widget,
+		GdkEventScroll * event, gpointer data)
+{
+	HexEditor * hexeditor = data;
+	GtkAdjustment * adjustment = hexeditor->se_adjustment;
+	gdouble delta;
+	gdouble upper;
+	(void) widget;
+
+	switch(event->direction)
+	{
+		case GDK_SCROLL_UP:
+			delta = -3.0;
 			break;
-		g_free(p);
+		case GDK_SCROLL_DOWN:
+			delta = 3.0;
+			break;
+#if GTK_CHECK_VERSION(3, 4, 0)
+		case GDK_SCROLL_SMOOTH:
+			if(gdk_event_get_scroll_deltas((GdkEvent *)event, NULL,
+						&delta) != TRUE)
+				return FALSE;
+			delta *= 3.0;
+			break;
+#endif
+		default:
+			return FALSE;
 	}
-	if(valid != TRUE)
-		return 0;
-	g_free(p);
-	gtk_list_store_remove(hexeditor->pl_store, &iter);
-	gtk_container_remove(GTK_CONTAINER(hexeditor->pl_box), widget);
-	hepd->destroy(hep);
-	plugin_delete(pp);
-	if(gtk_tree_model_iter_n_children(model, NULL) == 0)
+	upper = gtk_adjustment_get_upper(adjustment)
+		- gtk_adjustment_get_page_size(adjustment);
+	gtk_adjustment_set_value(adjustment, CLAMP(delta
+				+ gtk_adjustment_get_value(adjustment), 0.0,
+				MAX(upper, 0.0)));
+	return TRUE;
+}
+
+
+/* hexeditor_on_search_size_allocate */
+static void _hexeditor_on_search_size_allocate(GtkWidget * widget,
+		GtkAllocation * allocation, gpointer data)
+{
+	HexEditor * hexeditor = data;
+	unsigned int rows;
+	(void) widget;
+
+	if(hexeditor->view_row_height <= 0)
+		return;
+	rows = allocation->height / hexeditor->view_row_height;
+	if(rows == hexeditor->se_rows)
+		return;
+	hexeditor->se_rows = rows;
+	if(hexeditor->search != NULL)
+		_hexeditor_search_update(hexeditor);
+}
+
+
+/* hexeditor_on_search_value_changed */
+static void _hexeditor_on_search_value_changed(gpointer data)
+{
+	HexEditor * hexeditor = data;
+
+	_hexeditor_search_render(hexeditor);
+}
+
+
+/* hexeditor_on_spool */
+static gboolean _spool_scan(HexEditor * hexeditor, char const * buf,
+		ssize_t res);
+
+static gboolean _hexeditor_on_spool(gpointer data)
+{
+	HexEditor * hexeditor = data;
+	char buf[HEXEDITOR_SCAN_SIZE];
+	ssize_t res = 0;
+
+	/* what was kept already, then the rest as it comes */
+	if(hexeditor->offset < hexeditorspool_get_size(hexeditor->spool))
+		res = hexeditorspool_read(hexeditor->spool, buf, sizeof(buf),
+				hexeditor->offset);
+	else if(hexeditor->spool_source != 0)
+	{
+		/* resumed once the pipe was read further */
+		hexeditor->source = 0;
+		hexeditor->spool_wait = TRUE;
+		return FALSE;
+	}
+	return _spool_scan(hexeditor, buf, res);
+}
+
+static gboolean _spool_scan(HexEditor * hexeditor, char const * buf,
+		ssize_t res)
+{
+	off_t size;
+
+	if(res < 0)
+	{
+		hexeditor->source = 0;
+		gtk_widget_hide(hexeditor->pg_window);
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+		return FALSE;
+	}
+	if(res > 0)
 	{
-		gtk_widget_set_no_show_all(hexeditor->pl_view, TRUE);
-		gtk_widget_hide(hexeditor->pl_view);
+		/* the plug-ins may read back what they are given, and the
+		 * view would only grow later */
+		if(hexeditor->offset + res > hexeditor->size
+				&& (size = hexeditorspool_get_size(
+						hexeditor->spool))
+				> hexeditor->size)
+			_hexeditor_view_grow(hexeditor, size);
+		_open_plugins_read(hexeditor, hexeditor->offset, buf, res);
+		if(hexeditor->extents != NULL && hexeditorextents_scan(
+					hexeditor->extents, hexeditor->offset,
+					buf, res) > 0)
+			_hexeditor_view_queue(hexeditor);
+		hexeditor->offset += res;
+		_open_progress(hexeditor);
+		return TRUE;
 	}
-	else if(gtk_combo_box_get_active(GTK_COMBO_BOX(hexeditor->pl_combo))
-			< 0)
-		gtk_combo_box_set_active(GTK_COMBO_BOX(hexeditor->pl_combo), 0);
-	return 0;
+	hexeditor->source = 0;
+	gtk_widget_hide(hexeditor->pg_window);
+	if(hexeditor->extents != NULL && hexeditorextents_scan(
+				hexeditor->extents, hexeditor->offset, NULL, 0)
+			> 0)
+		_hexeditor_view_queue(hexeditor);
+	_hexeditor_scan_finish(hexeditor, TRUE);
+	return FALSE;
 }
 
 
-/* private */
-/* functions */
-/* accessors */
-/* hexeditor_get_config_filename */
-static String * _hexeditor_get_config_filename(char const * filename)
+/* hexeditor_on_spool_can_read */
+static gboolean _hexeditor_on_spool_can_read(GIOChannel * channel,
+		GIOCondition condition, gpointer data)
 {
-	char const * homedir;
+	HexEditor * hexeditor = data;
+	char buf[HEXEDITOR_SCAN_SIZE];
+	ssize_t res;
 
-	if((homedir = getenv("HOME")) == NULL)
-		homedir = g_get_home_dir();
-	return string_new_append(homedir, "/", filename, NULL);
+	(void) condition;
+	if(channel != hexeditor->channel)
+		return FALSE;
+	if((res = hexeditorspool_fill(hexeditor->spool, buf, sizeof(buf))) < 0)
+		_hexeditor_error(hexeditor, error_get(NULL), 1);
+	/* the view grows along, at most a few times per second */
+	if(hexeditor->spool_grow == 0)
+		hexeditor->spool_grow = g_timeout_add(100,
+				_hexeditor_on_spool_grow, hexeditor);
+	if(res <= 0)
+		hexeditor->spool_source = 0;
+	if(hexeditor->spool_wait)
+	{
+		hexeditor->spool_wait = FALSE;
+		hexeditor->source = g_idle_add(_hexeditor_on_spool, hexeditor);
+	}
+	return (res > 0) ? TRUE : FALSE;
 }
 
 
-/* hexeditor_plugin_is_enabled */
-static int _hexeditor_plugin_is_enabled(HexEditor * hexeditor,
-		char const * plugin)
+/* hexeditor_on_spool_grow */
+static gboolean _hexeditor_on_spool_grow(gpointer data)
 {
-	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
-	GtkTreeIter iter;
-	gchar * p;
-	gboolean valid;
-	int res;
+	HexEditor * hexeditor = data;
+	off_t size;
 
-	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
-			valid = gtk_tree_model_iter_next(model, &iter))
-	{
-		gtk_tree_model_get(model, &iter, HEPC_NAME, &p, -1);
-		res = strcmp(p, plugin);
-		g_free(p);
-		if(res == 0)
-			return TRUE;
-	}
+	hexeditor->spool_grow = 0;
+	if((size = hexeditorspool_get_size(hexeditor->spool))
+			> hexeditor->size)
+		_hexeditor_view_grow(hexeditor, size);
 	return FALSE;
 }
 
 
-/* useful */
-/* hexeditor_close */
-static void _close_reset(HexEditor * hexeditor);
+/* hexeditor_on_spool_read */
+static ssize_t _hexeditor_on_spool_read(void * data, void * buf, size_t size,
+		off_t offset)
+{
+	HexEditorSpool * spool = data;
 
-static void _hexeditor_close(HexEditor * hexeditor, gboolean plugins)
+	return hexeditorspool_read(spool, buf, size, offset);
+}
+
+
+/* hexeditor_on_transform */
+static gboolean _hexeditor_on_transform(gpointer data)
 {
-	if(hexeditor->source != 0)
-		g_source_remove(hexeditor->source);
-	hexeditor->source = 0;
-	hexeditor->offset = 0;
-	hexeditor->size = 0;
-	hexeditor->time = 0;
-	gtk_text_buffer_set_text(hexeditor->view_addr_tbuf, "", 0);
-	gtk_text_buffer_get_end_iter(hexeditor->view_addr_tbuf,
-			&hexeditor->view_addr_iter);
-	gtk_text_buffer_set_text(hexeditor->view_hex_tbuf, "", 0);
-	gtk_text_buffer_get_end_iter(hexeditor->view_hex_tbuf,
-			&hexeditor->view_hex_iter);
-	gtk_text_buffer_set_text(hexeditor->view_data_tbuf, "", 0);
-	gtk_text_buffer_get_end_iter(hexeditor->view_data_tbuf,
-			&hexeditor->view_data_iter);
-	if(hexeditor->channel != NULL)
+	HexEditor * hexeditor = data;
+	GtkProgressBar * progress = GTK_PROGRESS_BAR(hexeditor->pg_progress);
+	int res;
+	gdouble fraction;
+	char buf[16];
+
+	if((res = hexeditortransform_poll(hexeditor->transform)) <= 0)
 	{
-		g_io_channel_shutdown(hexeditor->channel, TRUE, NULL);
-		g_io_channel_unref(hexeditor->channel);
-		hexeditor->channel = NULL;
-		hexeditor->fd = -1;
+		hexeditor->transform_source = 0;
+		if(res < 0)
+			_hexeditor_error(hexeditor, error_get(NULL), 1);
+		_hexeditor_transform_finish(hexeditor, (res == 0) ? TRUE
+				: FALSE);
+		return FALSE;
 	}
-	if(hexeditor->fd >= 0 && close(hexeditor->fd) != 0)
-		_hexeditor_error(hexeditor, strerror(errno), 1);
-	hexeditor->fd = -1;
-	free(hexeditor->filename);
-	hexeditor->filename = NULL;
-	gtk_widget_hide(hexeditor->pg_window);
-	gtk_widget_set_sensitive(hexeditor->view_addr, FALSE);
-	gtk_widget_set_sensitive(hexeditor->view_hex, FALSE);
-	gtk_widget_set_sensitive(hexeditor->view_data, FALSE);
-	gtk_window_set_title(GTK_WINDOW(hexeditor->window),
-			_("Hexadecimal editor"));
-	if(plugins == TRUE)
-		_close_reset(hexeditor);
+	fraction = hexeditortransform_get_position(hexeditor->transform);
+	fraction = fraction / hexeditortransform_get_size(
+			hexeditor->transform);
+	gtk_progress_bar_set_fraction(progress, fraction);
+	snprintf(buf, sizeof(buf), "%.1f%%", fraction * 100);
+	gtk_progress_bar_set_text(progress, buf);
+	/* the scan may have hidden the window */
+	gtk_widget_show(hexeditor->pg_window);
+	return TRUE;
 }
 
-static void _close_reset(HexEditor * hexeditor)
+
+/* hexeditor_on_view_annotation */
+static void _hexeditor_on_view_annotation(void * data,
+		HexEditorAnnotation const * annotation)
 {
-	GtkTreeModel * model = GTK_TREE_MODEL(hexeditor->pl_store);
-	GtkTreeIter iter;
-	gboolean valid;
-	Plugin * plugin;
-	HexEditorPluginDefinition * hepd;
-	HexEditorPlugin * hep;
-	GtkWidget * widget;
+	HexEditorViewRows * view = data;
+	HexEditor * hexeditor = view->hexeditor;
+	const size_t columns = hexeditor->prefs.columns;
+	const size_t group = hexeditorformat_get_group(hexeditor->format);
+	const off_t end = annotation->offset + annotation->size;
+	GtkTextTag * hex;
+	GtkTextTag * text;
+	size_t i;
+	size_t from;
+	size_t to;
+	size_t start;
+	size_t stop;
 
-	/* reset every plug-in */
-	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;)
+	hex = _view_render_tag(hexeditor->view_hex_tbuf, "background",
+			annotation->color);
+	text = _view_render_tag(hexeditor->view_data_tbuf, "background",
+			annotation->color);
+	for(i = 0; i < view->rows; i++)
 	{
-		gtk_tree_model_get(model, &iter, HEPC_PLUGIN, &plugin,
-				HEPC_HEXEDITORPLUGINDEFINITION, &hepd,
-				HEPC_HEXEDITORPLUGIN, &hep, -1);
-		hepd->destroy(hep);
-		if((hep = hepd->init(&hexeditor->pl_helper)) == NULL)
-		{
-			gtk_list_store_remove(hexeditor->pl_store, &iter);
+		if(view->offsets[i] < 0
+				|| view->offsets[i] + (off_t)columns
+				<= annotation->offset)
 			continue;
-		}
-		widget = hepd->get_widget(hep);
-		gtk_list_store_set(hexeditor->pl_store, &iter,
-				HEPC_HEXEDITORPLUGIN, hep,
-				HEPC_WIDGET, widget, -1);
-		valid = gtk_tree_model_iter_next(model, &iter);
+		if(view->offsets[i] >= end)
+			break;
+		/* the bytes of this row */
+		from = MAX(annotation->offset, view->offsets[i])
+			- view->offsets[i];
+		to = MIN(end, view->offsets[i] + (off_t)columns)
+			- view->offsets[i];
+		/* the words may be displayed backwards */
+		start = MIN(hexeditorformat_get_hex_position(hexeditor->format,
+					from),
+				hexeditorformat_get_hex_position(
+					hexeditor->format, MIN(from
+						- (from % group) + group,
+						to) - 1));
+		stop = MAX(hexeditorformat_get_hex_position(hexeditor->format,
+					to - 1),
+				hexeditorformat_get_hex_position(
+					hexeditor->format, MAX(to - 1
+						- ((to - 1) % group), from)))
+			+ 2;
+		_view_render_apply(hexeditor->view_hex_tbuf, hex, i, start, i,
+				stop);
+		_view_render_apply(hexeditor->view_data_tbuf, text, i, from, i,
+				to);
 	}
 }
 
 
-/* hexeditor_config_load */
-static int _hexeditor_config_load(HexEditor * hexeditor)
+/* hexeditor_on_view_button_press */
+static gboolean _hexeditor_on_view_button_press(GtkWidget * widget,
+		GdkEventButton * event, gpointer data)
 {
-	int ret;
-	String * filename;
-	String const * p;
+	HexEditor * hexeditor = data;
+	GtkTextIter iter;
+	gint x;
+	gint y;
+	off_t row;
 
-	if(hexeditor->config == NULL)
-		return -1; /* XXX report error */
-	if((filename = _hexeditor_get_config_filename(HEXEDITOR_CONFIG_FILE))
-			== NULL)
-		return -1;
-	if((ret = config_load(hexeditor->config, filename)) != 0)
-		ret = -_hexeditor_error(NULL, error_get(NULL), 1);
-	free(filename);
-	/* uppercase */
-	if((p = config_get(hexeditor->config, NULL, "uppercase")) != NULL)
-		hexeditor->prefs.uppercase = (strtol(p, NULL, 10) > 0) ? 1 : 0;
-	/* FIXME also import the font and plug-in values from here */
-	return ret;
+	if(event->type != GDK_2BUTTON_PRESS || event->button != 1
+			|| hexeditor->extents == NULL)
+		return FALSE;
+	/* the runs of identical rows are expanded on double-click */
+	gtk_text_view_window_to_buffer_coords(GTK_TEXT_VIEW(widget),
+			GTK_TEXT_WINDOW_TEXT, event->x, event->y, &x, &y);
+	gtk_text_view_get_iter_at_location(GTK_TEXT_VIEW(widget), &iter, x, y);
+	row = gtk_adjustment_get_value(hexeditor->view_adjustment);
+	row += gtk_text_iter_get_line(&iter);
+	if(hexeditorextents_expand(hexeditor->extents, row) != 0)
+		return FALSE;
+	_hexeditor_view_refresh(hexeditor);
+	return TRUE;
 }
 
 
-/* hexeditor_error */
-static int _error_text(char const * message, int ret);
-
-static int _hexeditor_error(HexEditor * hexeditor, char const * message,
-		int ret)
+/* hexeditor_on_view_idle */
+static gboolean _hexeditor_on_view_idle(gpointer data)
 {
-#if !GTK_CHECK_VERSION(2, 18, 0)
-	GtkWidget * dialog;
-#endif
+	HexEditor * hexeditor = data;
 
-	if(hexeditor == NULL)
-		return _error_text(message, ret);
-#if GTK_CHECK_VERSION(2, 18, 0)
-	gtk_label_set_text(GTK_LABEL(hexeditor->infobar_label), message);
-	gtk_widget_show(hexeditor->infobar);
-#else
-	dialog = gtk_message_dialog_new(GTK_WINDOW(hexeditor->window),
-			GTK_DIALOG_DESTROY_WITH_PARENT, GTK_MESSAGE_ERROR,
-			GTK_BUTTONS_CLOSE,
-# if GTK_CHECK_VERSION(2, 6, 0)
-			"%s", _("Error"));
-	gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
-# endif
-			"%s", message);
-	gtk_window_set_title(GTK_WINDOW(dialog), _("Error"));
-	gtk_dialog_run(GTK_DIALOG(dialog));
-	gtk_widget_destroy(dialog);
-#endif
-	return ret;
+	hexeditor->view_source = 0;
+	_hexeditor_view_refresh(hexeditor);
+	return FALSE;
 }
 
-static int _error_text(char const * message, int ret)
+
+/* hexeditor_on_view_key_press */
+static gboolean _hexeditor_on_view_key_press(GtkWidget * widget,
+		GdkEventKey * event, gpointer data)
 {
-	fprintf(stderr, "%s: %s\n", PROGNAME_HEXEDITOR, message);
-	return ret;
+	HexEditor * hexeditor = data;
+	gdouble row;
+	gdouble page;
+	(void) widget;
+
+	row = gtk_adjustment_get_value(hexeditor->view_adjustment);
+	page = gtk_adjustment_get_page_size(hexeditor->view_adjustment);
+	switch(event->keyval)
+	{
+		case GDK_KEY_Up:
+			row -= 1.0;
+			break;
+		case GDK_KEY_Down:
+			row += 1.0;
+			break;
+		case GDK_KEY_Page_Up:
+		case GDK_KEY_KP_Page_Up:
+			row -= page;
+			break;
+		case GDK_KEY_Page_Down:
+		case GDK_KEY_KP_Page_Down:
+			row += page;
+			break;
+		case GDK_KEY_Home:
+			if((event->state & GDK_CONTROL_MASK) == 0)
+				return FALSE;
+			row = 0.0;
+			break;
+		case GDK_KEY_End:
+			if((event->state & GDK_CONTROL_MASK) == 0)
+				return FALSE;
+			row = gtk_adjustment_get_upper(
+					hexeditor->view_adjustment);
+			break;
+		default:
+			return FALSE;
+	}
+	_hexeditor_view_scroll_to(hexeditor, row);
+	return TRUE;
 }
 
 
-/* callbacks */
-/* hexeditor_on_open */
-static void _hexeditor_on_open(gpointer data)
+/* hexeditor_on_view_query_tooltip */
+static gboolean _hexeditor_on_view_query_tooltip(GtkWidget * widget,
+		gint x, gint y, gboolean keyboard, GtkTooltip * tooltip,
+		gpointer data)
 {
 	HexEditor * hexeditor = data;
+	const size_t columns = hexeditor->prefs.columns;
+	GtkTextIter iter;
+	String * labels = NULL;
+	off_t offset;
+	off_t size = columns;
+	off_t rows;
+	off_t collapsed;
+	HexEditorExtentsType type;
+	size_t column;
+	size_t position;
+	size_t i;
 
-	hexeditor_open_dialog(hexeditor);
+	if(keyboard || hexeditor->buffer == NULL
+			|| hexeditorannotations_get_count(
+				hexeditor->annotations) == 0)
+		return FALSE;
+	gtk_text_view_window_to_buffer_coords(GTK_TEXT_VIEW(widget),
+			GTK_TEXT_WINDOW_TEXT, x, y, &x, &y);
+	gtk_text_view_get_iter_at_location(GTK_TEXT_VIEW(widget), &iter, x, y);
+	if((offset = _hexeditor_view_offset(hexeditor,
+					gtk_adjustment_get_value(
+						hexeditor->view_adjustment)
+					+ gtk_text_iter_get_line(&iter),
+					&rows, &collapsed, &type)) < 0
+			|| type != HEET_DATA)
+		return FALSE;
+	/* the byte pointed at, or the whole row for the address */
+	column = gtk_text_iter_get_line_offset(&iter);
+	if(widget == hexeditor->view_hex)
+	{
+		for(i = 0; i < columns; i++)
+		{
+			position = hexeditorformat_get_hex_position(
+					hexeditor->format, i);
+			if(column >= position && column < position + 2)
+				break;
+		}
+		offset += i;
+		size = 1;
+	}
+	else if(widget == hexeditor->view_data)
+	{
+		offset += (i = column);
+		size = 1;
+	}
+	else
+		i = 0;
+	if(i >= columns)
+		return FALSE;
+	hexeditorannotations_query(hexeditor->annotations, offset, size,
+			_hexeditor_on_view_tooltip, &labels);
+	if(labels == NULL)
+		return FALSE;
+	gtk_tooltip_set_text(tooltip, labels);
+	string_delete(labels);
+	return TRUE;
 }
 
 
-/* hexeditor_on_plugin_combo_change */
-static void _hexeditor_on_plugin_combo_change(gpointer data)
+/* hexeditor_on_view_scroll */
+static gboolean _hexeditor_on_view_scroll(GtkWidget * widget,
+		GdkEventScroll * event, gpointer data)
 {
-	/* FIXME implement */
+	HexEditor * hexeditor = data;
+	gdouble delta;
+	(void) widget;
+
+	switch(event->direction)
+	{
+		case GDK_SCROLL_UP:
+			delta = -3.0;
+			break;
+		case GDK_SCROLL_DOWN:
+			delta = 3.0;
+			break;
+#if GTK_CHECK_VERSION(3, 4, 0)
+		case GDK_SCROLL_SMOOTH:
+			if(gdk_event_get_scroll_deltas((GdkEvent *)event, NULL,
+						&delta) != TRUE)
+				return FALSE;
+			delta *= 3.0;
+			break;
+#endif
+		default:
+			return FALSE;
+	}
+	_hexeditor_view_scroll_to(hexeditor, delta + gtk_adjustment_get_value(
+				hexeditor->view_adjustment));
+	return TRUE;
 }
 
 
-#ifdef EMBEDDED
-/* hexeditor_on_preferences */
-static void _hexeditor_on_preferences(gpointer data)
+/* hexeditor_on_view_size_allocate */
+static void _hexeditor_on_view_size_allocate(GtkWidget * widget,
+		GtkAllocation * allocation, gpointer data)
 {
 	HexEditor * hexeditor = data;
+	unsigned int rows;
+	(void) widget;
 
-	hexeditor_show_preferences(hexeditor, TRUE);
+	if(hexeditor->view_row_height <= 0)
+		return;
+	rows = allocation->height / hexeditor->view_row_height;
+	if(rows == hexeditor->view_rows)
+		return;
+	/* the view is refreshed once the layout is complete */
+	hexeditor->view_rows = rows;
+	_hexeditor_view_queue(hexeditor);
 }
-#endif
 
 
-/* hexeditor_on_progress_cancel */
-static void _hexeditor_on_progress_cancel(gpointer data)
+/* hexeditor_on_verify */
+static int _verify_hole(HexEditor * hexeditor);
+static int _verify_tail(HexEditor * hexeditor, off_t offset, size_t size);
+
+static gboolean _hexeditor_on_verify(gpointer data)
 {
 	HexEditor * hexeditor = data;
+	off_t offset = hexeditor->verify_offset;
+	size_t size;
+	ssize_t res;
 
-	hexeditor_close(hexeditor);
+	if(!hexeditor->verify_tail && hexeditor->extents != NULL
+			&& offset < hexeditor->size
+			&& _verify_hole(hexeditor) == 0)
+		return TRUE;
+	if(offset >= hexeditor->size || (hexeditor->verify_end >= 0
+				&& offset >= hexeditor->verify_end))
+	{
+		hexeditor->verify_source = 0;
+		hexeditordigest_truncate(hexeditor->digest, hexeditor->size);
+		if(hexeditor->verify_changes == 0)
+			return FALSE;
+		/* the results of the plug-ins are complete again */
+		_open_plugins_read(hexeditor, hexeditor->size, NULL, 0);
+		_hexeditor_sidecar_open(hexeditor);
+		_open_plugins_save(hexeditor);
+		return FALSE;
+	}
+	for(size = 0; size < HEXEDITORDIGEST_BLOCK_SIZE; size += res)
+		if((res = pread(hexeditor->fd, &hexeditor->verify_buf[size],
+						HEXEDITORDIGEST_BLOCK_SIZE
+						- size, offset + size)) == 0)
+			break;
+		else if(res < 0 && errno == EINTR)
+			res = 0;
+		else if(res < 0)
+		{
+			hexeditor->verify_source = 0;
+			_hexeditor_error(hexeditor, strerror(errno), 1);
+			return FALSE;
+		}
+	hexeditor->verify_offset += HEXEDITORDIGEST_BLOCK_SIZE;
+	if(hexeditor->verify_tail && _verify_tail(hexeditor, offset, size)
+			!= 0)
+		return TRUE;
+	if(size == 0
+			|| hexeditordigest_compare(hexeditor->digest, offset,
+				hexeditor->verify_buf, size) <= 0)
+		return TRUE;
+	/* this block was modified */
+	hexeditor->verify_changes++;
+	_open_plugins_read(hexeditor, offset, hexeditor->verify_buf, size);
+	return TRUE;
 }
 
+static int _verify_hole(HexEditor * hexeditor)
+{
+	const size_t block = HEXEDITORDIGEST_BLOCK_SIZE;
+	off_t offset;
+	off_t end;
+	off_t size;
+	int hole;
+	size_t i;
 
-/* hexeditor_on_progress_delete */
-static gboolean _hexeditor_on_progress_delete(gpointer data)
+	/* compare the blocks in holes without reading them */
+	for(i = 0; i < 1024; i++)
+	{
+		offset = hexeditor->verify_offset;
+		size = MIN((off_t)block, hexeditor->size - offset);
+		if(size <= 0)
+			break;
+		end = hexeditorextents_get_end(hexeditor->extents, offset,
+				&hole);
+		if(hole == 0 || end < offset + size)
+			break;
+		hexeditor->verify_offset += block;
+		if(hexeditordigest_compare_zero(hexeditor->digest, offset,
+					size) <= 0)
+			continue;
+		/* this block was modified */
+		hexeditor->verify_changes++;
+		_open_plugins_hole(hexeditor, offset, size);
+	}
+	return (i > 0) ? 0 : -1;
+}
+
+static int _verify_tail(HexEditor * hexeditor, off_t offset, size_t size)
 {
-	HexEditor * hexeditor = data;
+	const off_t end = hexeditordigest_get_size(hexeditor->digest);
 
-	gtk_widget_show(hexeditor->pg_window);
-	return TRUE;
+	hexeditor->verify_tail = FALSE;
+	/* the file was appended to if what was digested is still there */
+	if(offset + (off_t)size >= end && hexeditordigest_compare(
+				hexeditor->digest, offset,
+				hexeditor->verify_buf, end - offset) == 0)
+		return 0;
+	/* otherwise every block is compared again */
+	hexeditor->verify_offset = 0;
+	return -1;
 }
 
 
-#ifdef EMBEDDED
-/* hexeditor_on_properties */
-static void _hexeditor_on_properties(gpointer data)
+/* hexeditor_on_view_tooltip */
+static void _hexeditor_on_view_tooltip(void * data,
+		HexEditorAnnotation const * annotation)
+{
+	String ** labels = data;
+	String * p;
+
+	if(annotation->label == NULL)
+		return;
+	/* one label per line */
+	if((p = (*labels == NULL) ? string_new(annotation->label)
+				: string_new_append(*labels, "\n",
+					annotation->label, NULL)) == NULL)
+		return;
+	if(*labels != NULL)
+		string_delete(*labels);
+	*labels = p;
+}
+
+
+/* hexeditor_on_view_value_changed */
+static void _hexeditor_on_view_value_changed(gpointer data)
 {
 	HexEditor * hexeditor = data;
 
-	hexeditor_show_properties(hexeditor, TRUE);
+	_hexeditor_view_render(hexeditor);
 }
-#endif
@@ -27,11 +27,33 @@
 typedef struct _HexEditorPrefs
 {
 	int uppercase;
+	size_t rowcache;
+	/* asynchronous reads: 0 (none), 1 (threads) or 2 (io_uring) */
+	int fetcher;
+	/* keep the results of the plug-ins across sessions */
+	int sidecar;
+	/* keep reading as the file grows */
+	int follow;
+	/* show compressed files decompressed */
+	int decompress;
+	/* bytes per row */
+	size_t columns;
+	/* bytes per word: 1, 2, 4 or 8 */
+	size_t group;
+	/* display the words as little-endian */
+	int little_endian;
+	/* of the data column, as listed in format.h */
+	unsigned int encoding;
+	/* a minimap of the whole file */
+	int overview;
+	/* color the bytes by class */
+	int colors;
 } HexEditorPrefs;
 
 
 /* constants */
 # define HEXEDITOR_CONFIG_FILE ".hexeditor"
+# define HEXEDITOR_SIDECAR_DIRECTORY ".hexeditor.cache"
 
 
 /* functions */
@@ -42,16 +64,55 @@ void hexeditor_delete(HexEditor * hexeditor);
 /* accessors */
 GtkWidget * hexeditor_get_widget(HexEditor * hexeditor);
 
+void hexeditor_set_colors(HexEditor * hexeditor, gboolean colors);
+void hexeditor_set_columns(HexEditor * hexeditor, size_t columns);
+int hexeditor_set_encoding(HexEditor * hexeditor, char const * encoding);
+void hexeditor_set_follow(HexEditor * hexeditor, gboolean follow);
 void hexeditor_set_font(HexEditor * hexeditor, char const * font);
+void hexeditor_set_group(HexEditor * hexeditor, size_t group,
+		gboolean little_endian);
+void hexeditor_set_uppercase(HexEditor * hexeditor, gboolean uppercase);
 
 /* useful */
+int hexeditor_annotate(HexEditor * hexeditor, off_t offset, off_t size,
+		char const * label, unsigned int color);
+int hexeditor_annotate_dialog(HexEditor * hexeditor);
+int hexeditor_annotations_load(HexEditor * hexeditor, char const * filename);
+int hexeditor_annotations_save(HexEditor * hexeditor, char const * filename);
 void hexeditor_close(HexEditor * hexeditor);
+/* the format as listed in export.h */
+int hexeditor_export(HexEditor * hexeditor, char const * filename,
+		unsigned int format, off_t offset, off_t size);
+int hexeditor_export_dialog(HexEditor * hexeditor);
+int hexeditor_goto(HexEditor * hexeditor, off_t offset);
+int hexeditor_goto_bookmark(HexEditor * hexeditor);
+int hexeditor_goto_dialog(HexEditor * hexeditor);
+int hexeditor_import(HexEditor * hexeditor, char const * input,
+		char const * output);
 int hexeditor_open(HexEditor * hexeditor, char const * filename);
 int hexeditor_open_dialog(HexEditor * hexeditor);
+int hexeditor_open_process(HexEditor * hexeditor, pid_t pid);
+int hexeditor_open_process_dialog(HexEditor * hexeditor);
+int hexeditor_paste(HexEditor * hexeditor, char const * filename);
+/* reads the memory and the mappings of processes again */
+int hexeditor_refresh(HexEditor * hexeditor);
+/* lists every occurrence of the pattern */
+int hexeditor_search(HexEditor * hexeditor, unsigned char const * pattern,
+		size_t size);
+int hexeditor_search_dialog(HexEditor * hexeditor);
+int hexeditor_search_regex(HexEditor * hexeditor, char const * expression);
+/* the operation as listed in transform.h, in place if filename is NULL */
+int hexeditor_transform(HexEditor * hexeditor, unsigned int operation,
+		unsigned char const * key, size_t key_size, off_t offset,
+		off_t size, char const * filename);
+int hexeditor_transform_dialog(HexEditor * hexeditor);
 
 /* plug-ins */
 int hexeditor_load(HexEditor * hexeditor, char const * plugin);
 int hexeditor_unload(HexEditor * hexeditor, char const * plugin);
+/* the definition of a plug-in, without any instance */
+Plugin * hexeditor_plugin_load(char const * plugin,
+		HexEditorPluginDefinition ** definition);
 
 void hexeditor_show_preferences(HexEditor * hexeditor, gboolean show);
 void hexeditor_show_properties(HexEditor * hexeditor, gboolean show);
@@ -0,0 +1,397 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <libintl.h>
+#include <System.h>
+#include "import.h"
+#define _(string) gettext(string)
+
+
+/* HexEditorImport */
+/* private */
+/* types */
+struct _HexEditorImport
+{
+	HexEditorImportFormat format;
+	/* the characters before the chunk, and where the line started */
+	off_t position;
+	off_t line;
+	off_t line_start;
+	/* where the last error was found */
+	off_t error_line;
+	off_t error_column;
+
+	/* hexadecimal: the first digit of a byte, after "0x" or not */
+	int nibble;
+	int prefixed;
+	/* base64: the characters of the group, and the padding allowed */
+	uint32_t group;
+	unsigned int group_cnt;
+	unsigned int padding;
+	int done;
+};
+
+
+/* constants */
+/* as looked up, the digits and values are positive */
+#define HEXEDITORIMPORT_SPACE	-1
+#define HEXEDITORIMPORT_INVALID	-2
+#define HEXEDITORIMPORT_PADDING	-3
+
+/* the text looked at to tell the formats apart */
+#define HEXEDITORIMPORT_DETECT	4096
+
+
+/* variables */
+static pthread_once_t _hexeditorimport_once = PTHREAD_ONCE_INIT;
+static signed char _hexeditorimport_hex[256];
+static signed char _hexeditorimport_base64[256];
+
+
+/* prototypes */
+static void _hexeditorimport_init(void);
+
+static ssize_t _hexeditorimport_base64_decode(HexEditorImport * import,
+		unsigned char const * text, size_t size, unsigned char * buf);
+static ssize_t _hexeditorimport_error(HexEditorImport * import, size_t index,
+		char const * message);
+static ssize_t _hexeditorimport_hex_decode(HexEditorImport * import,
+		unsigned char const * text, size_t size, unsigned char * buf);
+
+
+/* public */
+/* functions */
+/* hexeditorimport_new */
+HexEditorImport * hexeditorimport_new(HexEditorImportFormat format)
+{
+	HexEditorImport * import;
+
+	pthread_once(&_hexeditorimport_once, _hexeditorimport_init);
+	if((import = object_new(sizeof(*import))) == NULL)
+		return NULL;
+	import->format = format;
+	import->position = 0;
+	import->line = 1;
+	import->line_start = 0;
+	import->error_line = 0;
+	import->error_column = 0;
+	import->nibble = -1;
+	import->prefixed = 0;
+	import->group = 0;
+	import->group_cnt = 0;
+	import->padding = 0;
+	import->done = 0;
+	return import;
+}
+
+
+/* hexeditorimport_delete */
+void hexeditorimport_delete(HexEditorImport * import)
+{
+	object_delete(import);
+}
+
+
+/* accessors */
+/* hexeditorimport_get_column */
+off_t hexeditorimport_get_column(HexEditorImport * import)
+{
+	return import->error_column;
+}
+
+
+/* hexeditorimport_get_line */
+off_t hexeditorimport_get_line(HexEditorImport * import)
+{
+	return import->error_line;
+}
+
+
+/* useful */
+/* hexeditorimport_decode */
+ssize_t hexeditorimport_decode(HexEditorImport * import, char const * text,
+		size_t size, unsigned char * buf)
+{
+	ssize_t ret;
+
+	if(import->format == HEIF_BASE64)
+		ret = _hexeditorimport_base64_decode(import,
+				(unsigned char const *)text, size, buf);
+	else
+		ret = _hexeditorimport_hex_decode(import,
+				(unsigned char const *)text, size, buf);
+	if(ret >= 0)
+		import->position += size;
+	return ret;
+}
+
+
+/* hexeditorimport_detect */
+HexEditorImportFormat hexeditorimport_detect(char const * text, size_t size)
+{
+	unsigned char const * t = (unsigned char const *)text;
+	size_t i;
+
+	pthread_once(&_hexeditorimport_once, _hexeditorimport_init);
+	/* base64 as soon as something else than hexadecimal is found */
+	size = (size < HEXEDITORIMPORT_DETECT) ? size : HEXEDITORIMPORT_DETECT;
+	for(i = 0; i < size; i++)
+		if(_hexeditorimport_hex[t[i]] == HEXEDITORIMPORT_INVALID
+				&& t[i] != 'x' && t[i] != 'X')
+			return HEIF_BASE64;
+	return HEIF_HEX;
+}
+
+
+/* hexeditorimport_finish */
+ssize_t hexeditorimport_finish(HexEditorImport * import, unsigned char * buf)
+{
+	if(import->format == HEIF_BASE64)
+		switch(import->group_cnt)
+		{
+			case 0:
+				return 0;
+			case 1:
+				return _hexeditorimport_error(import, 0,
+						_("Truncated data"));
+			case 2:
+				buf[0] = import->group >> 4;
+				return 1;
+			default:
+				buf[0] = import->group >> 10;
+				buf[1] = import->group >> 2;
+				return 2;
+		}
+	if(import->nibble < 0)
+		return 0;
+	/* a single digit is only valid as in "0x1" */
+	if(!import->prefixed)
+		return _hexeditorimport_error(import, 0,
+				_("Odd number of digits"));
+	buf[0] = import->nibble;
+	return 1;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorimport_init */
+static void _hexeditorimport_init(void)
+{
+	char const base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz0123456789+/";
+	char const spaces[] = " \t\r\n";
+	size_t i;
+
+	memset(_hexeditorimport_hex, HEXEDITORIMPORT_INVALID,
+			sizeof(_hexeditorimport_hex));
+	memset(_hexeditorimport_base64, HEXEDITORIMPORT_INVALID,
+			sizeof(_hexeditorimport_base64));
+	for(i = 0; i < 10; i++)
+		_hexeditorimport_hex['0' + i] = i;
+	for(i = 0; i < 6; i++)
+	{
+		_hexeditorimport_hex['a' + i] = 10 + i;
+		_hexeditorimport_hex['A' + i] = 10 + i;
+	}
+	for(i = 0; spaces[i] != '\0'; i++)
+	{
+		_hexeditorimport_hex[(unsigned char)spaces[i]]
+			= HEXEDITORIMPORT_SPACE;
+		_hexeditorimport_base64[(unsigned char)spaces[i]]
+			= HEXEDITORIMPORT_SPACE;
+	}
+	/* as in C arrays */
+	_hexeditorimport_hex[','] = HEXEDITORIMPORT_SPACE;
+	for(i = 0; i < 64; i++)
+		_hexeditorimport_base64[(unsigned char)base64[i]] = i;
+	/* the URL and filename safe alphabet too */
+	_hexeditorimport_base64['-'] = 62;
+	_hexeditorimport_base64['_'] = 63;
+	_hexeditorimport_base64['='] = HEXEDITORIMPORT_PADDING;
+}
+
+
+/* hexeditorimport_base64_decode */
+static ssize_t _hexeditorimport_base64_decode(HexEditorImport * import,
+		unsigned char const * text, size_t size, unsigned char * buf)
+{
+	signed char const * table = _hexeditorimport_base64;
+	unsigned char * b = buf;
+	size_t i = 0;
+	int v;
+	uint32_t group;
+
+	while(i < size)
+	{
+		/* whole groups at once, as most of the text */
+		if(import->group_cnt == 0 && !import->done)
+			for(; i + 3 < size; i += 4)
+			{
+				if((table[text[i]] | table[text[i + 1]]
+							| table[text[i + 2]]
+							| table[text[i + 3]])
+						< 0)
+					break;
+				group = (table[text[i]] << 18)
+					| (table[text[i + 1]] << 12)
+					| (table[text[i + 2]] << 6)
+					| table[text[i + 3]];
+				b[0] = group >> 16;
+				b[1] = group >> 8;
+				b[2] = group;
+				b += 3;
+			}
+		if(i == size)
+			break;
+		if((v = table[text[i]]) >= 0)
+		{
+			if(import->done)
+				return _hexeditorimport_error(import, i,
+						_("Data after the padding"));
+			import->group = (import->group << 6) | v;
+			if(++import->group_cnt == 4)
+			{
+				b[0] = import->group >> 16;
+				b[1] = import->group >> 8;
+				b[2] = import->group;
+				b += 3;
+				import->group = 0;
+				import->group_cnt = 0;
+			}
+		}
+		else if(v == HEXEDITORIMPORT_SPACE)
+		{
+			if(text[i] == '\n')
+			{
+				import->line++;
+				import->line_start = import->position + i + 1;
+			}
+		}
+		else if(v == HEXEDITORIMPORT_PADDING
+				&& import->group_cnt >= 2)
+		{
+			/* the last group, shorter */
+			if(import->group_cnt == 2)
+				*(b++) = import->group >> 4;
+			else
+			{
+				b[0] = import->group >> 10;
+				b[1] = import->group >> 2;
+				b += 2;
+			}
+			import->padding = 3 - import->group_cnt;
+			import->group = 0;
+			import->group_cnt = 0;
+			import->done = 1;
+		}
+		else if(v == HEXEDITORIMPORT_PADDING && import->done
+				&& import->padding > 0)
+			import->padding--;
+		else
+			return _hexeditorimport_error(import, i,
+					(v == HEXEDITORIMPORT_PADDING)
+					? _("Invalid padding")
+					: _("Invalid character"));
+		i++;
+	}
+	return b - buf;
+}
+
+
+/* hexeditorimport_error */
+static ssize_t _hexeditorimport_error(HexEditorImport * import, size_t index,
+		char const * message)
+{
+	import->error_line = import->line;
+	import->error_column = import->position + index - import->line_start
+		+ 1;
+	return -error_set_code(1, "%s", message);
+}
+
+
+/* hexeditorimport_hex_decode */
+static ssize_t _hexeditorimport_hex_decode(HexEditorImport * import,
+		unsigned char const * text, size_t size, unsigned char * buf)
+{
+	signed char const * table = _hexeditorimport_hex;
+	unsigned char * b = buf;
+	size_t i = 0;
+	size_t j;
+	int v;
+
+	while(i < size)
+	{
+		/* pairs of digits at once, as most of the text */
+		if(import->nibble < 0)
+		{
+			for(j = i; i + 1 < size; i += 2)
+			{
+				if((table[text[i]] | table[text[i + 1]]) < 0)
+					break;
+				*(b++) = (table[text[i]] << 4)
+					| table[text[i + 1]];
+			}
+			if(i != j)
+				import->prefixed = 0;
+		}
+		if(i == size)
+			break;
+		if((v = table[text[i]]) >= 0)
+		{
+			if(import->nibble < 0)
+				import->nibble = v;
+			else
+			{
+				*(b++) = (import->nibble << 4) | v;
+				import->nibble = -1;
+				import->prefixed = 0;
+			}
+		}
+		else if(v == HEXEDITORIMPORT_SPACE)
+		{
+			/* a single digit is only valid as in "0x1" */
+			if(import->nibble >= 0 && !import->prefixed)
+				return _hexeditorimport_error(import, i,
+						_("Odd number of digits"));
+			else if(import->nibble >= 0)
+				*(b++) = import->nibble;
+			import->nibble = -1;
+			import->prefixed = 0;
+			if(text[i] == '\n')
+			{
+				import->line++;
+				import->line_start = import->position + i + 1;
+			}
+		}
+		else if((text[i] == 'x' || text[i] == 'X')
+				&& import->nibble == 0)
+		{
+			/* the "0x" prefix */
+			import->nibble = -1;
+			import->prefixed = 1;
+		}
+		else
+			return _hexeditorimport_error(import, i,
+					_("Invalid character"));
+		i++;
+	}
+	return b - buf;
+}
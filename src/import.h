@@ -0,0 +1,56 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_IMPORT_H
+# define HEXEDITOR_IMPORT_H
+
+# include <sys/types.h>
+
+
+/* HexEditorImport */
+/* public */
+/* types */
+typedef struct _HexEditorImport HexEditorImport;
+
+typedef enum _HexEditorImportFormat
+{
+	HEIF_HEX = 0,
+	HEIF_BASE64
+} HexEditorImportFormat;
+# define HEIF_LAST	HEIF_BASE64
+# define HEIF_COUNT	(HEIF_LAST + 1)
+
+
+/* functions */
+HexEditorImport * hexeditorimport_new(HexEditorImportFormat format);
+void hexeditorimport_delete(HexEditorImport * import);
+
+/* accessors */
+/* where the last error was found, from 1 */
+off_t hexeditorimport_get_column(HexEditorImport * import);
+off_t hexeditorimport_get_line(HexEditorImport * import);
+
+/* useful */
+/* buf holds at least size bytes, returns the bytes decoded */
+ssize_t hexeditorimport_decode(HexEditorImport * import, char const * text,
+		size_t size, unsigned char * buf);
+/* buf holds at least 2 bytes, returns the last bytes decoded */
+ssize_t hexeditorimport_finish(HexEditorImport * import, unsigned char * buf);
+
+HexEditorImportFormat hexeditorimport_detect(char const * text, size_t size);
+
+#endif /* !HEXEDITOR_IMPORT_H */
@@ -0,0 +1,241 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include "magic.h"
+#define N_(string) string
+
+
+/* HexEditorMagic */
+/* private */
+/* types */
+typedef struct _HexEditorMagicEntry
+{
+	off_t offset;
+	char const * magic;
+	size_t magic_size;
+	/* checks the rest of the header (optional) */
+	int (*verify)(unsigned char const * buf, size_t size);
+	HexEditorMagic format;
+} HexEditorMagicEntry;
+
+
+/* prototypes */
+static void _hexeditormagic_init(void);
+
+static int _magic_verify_bmp(unsigned char const * buf, size_t size);
+static int _magic_verify_fat(unsigned char const * buf, size_t size);
+static int _magic_verify_pe(unsigned char const * buf, size_t size);
+static int _magic_verify_wav(unsigned char const * buf, size_t size);
+
+
+/* constants */
+#define MAGIC(offset, magic, verify, name, description) \
+	{ offset, magic, sizeof(magic) - 1, verify, { name, description } }
+
+/* the more specific entries first */
+static const HexEditorMagicEntry _hexeditormagic_entries[] =
+{
+	MAGIC(0, "\177ELF\002", NULL, "ELF (64-bit)",
+			N_("ELF executable (64-bit)")),
+	MAGIC(0, "\177ELF\001", NULL, "ELF (32-bit)",
+			N_("ELF executable (32-bit)")),
+	MAGIC(0, "MZ", _magic_verify_pe, "PE", N_("PE executable")),
+	MAGIC(0, "MZ", NULL, "MZ", N_("MS-DOS executable")),
+	MAGIC(0, "\xfe\xed\xfa\xce", NULL, "Mach-O (32-bit)",
+			N_("Mach-O executable (32-bit, big endian)")),
+	MAGIC(0, "\xce\xfa\xed\xfe", NULL, "Mach-O (32-bit)",
+			N_("Mach-O executable (32-bit, little endian)")),
+	MAGIC(0, "\xfe\xed\xfa\xcf", NULL, "Mach-O (64-bit)",
+			N_("Mach-O executable (64-bit, big endian)")),
+	MAGIC(0, "\xcf\xfa\xed\xfe", NULL, "Mach-O (64-bit)",
+			N_("Mach-O executable (64-bit, little endian)")),
+	MAGIC(0, "\xca\xfe\xba\xbe", _magic_verify_fat, "Mach-O (universal)",
+			N_("Mach-O universal binary")),
+	MAGIC(0, "\xca\xfe\xba\xbe", NULL, "Java", N_("Java class file")),
+	MAGIC(0, "PK\003\004", NULL, "ZIP", N_("ZIP archive")),
+	MAGIC(0, "PK\005\006", NULL, "ZIP", N_("ZIP archive (empty)")),
+	MAGIC(0, "\x89PNG\r\n\x1a\n", NULL, "PNG", N_("PNG image")),
+	MAGIC(0, "GIF87a", NULL, "GIF", N_("GIF image")),
+	MAGIC(0, "GIF89a", NULL, "GIF", N_("GIF image")),
+	MAGIC(0, "\xff\xd8\xff", NULL, "JPEG", N_("JPEG image")),
+	MAGIC(0, "BM", _magic_verify_bmp, "BMP", N_("BMP image")),
+	MAGIC(0, "II*\0", NULL, "TIFF", N_("TIFF image (little endian)")),
+	MAGIC(0, "MM\0*", NULL, "TIFF", N_("TIFF image (big endian)")),
+	MAGIC(0, "RIFF", _magic_verify_wav, "WAV", N_("WAV audio")),
+	MAGIC(0, "RIFF", NULL, "RIFF", N_("RIFF container")),
+	MAGIC(0, "OggS", NULL, "Ogg", N_("Ogg container")),
+	MAGIC(0, "fLaC", NULL, "FLAC", N_("FLAC audio")),
+	MAGIC(0, "%PDF-", NULL, "PDF", N_("PDF document")),
+	MAGIC(0, "SQLite format 3", NULL, "SQLite",
+			N_("SQLite 3 database")),
+	MAGIC(0, "hsqs", NULL, "SquashFS",
+			N_("SquashFS filesystem (little endian)")),
+	MAGIC(0, "sqsh", NULL, "SquashFS",
+			N_("SquashFS filesystem (big endian)")),
+	MAGIC(0, "UBI#", NULL, "UBI", N_("UBI image")),
+	MAGIC(0, "\x31\x18\x10\x06", NULL, "UBIFS", N_("UBIFS image")),
+	MAGIC(0, "\x45\x3d\xcd\x28", NULL, "CramFS", N_("CramFS filesystem")),
+	MAGIC(0, "\x27\x05\x19\x56", NULL, "uImage", N_("U-Boot image")),
+	MAGIC(0, "\xd0\x0d\xfe\xed", NULL, "FDT", N_("Device tree blob")),
+	MAGIC(0, "\x1f\x8b", NULL, "gzip", N_("gzip compressed data")),
+	MAGIC(0, "\xfd" "7zXZ", NULL, "xz", N_("xz compressed data")),
+	MAGIC(0, "BZh", NULL, "bzip2", N_("bzip2 compressed data")),
+	MAGIC(0, "7z\xbc\xaf\x27\x1c", NULL, "7-Zip", N_("7-Zip archive")),
+	MAGIC(0, "\x28\xb5\x2f\xfd", NULL, "Zstandard",
+			N_("Zstandard compressed data")),
+	MAGIC(0, "\x04\x22\x4d\x18", NULL, "LZ4",
+			N_("LZ4 compressed data")),
+	MAGIC(0, "070701", NULL, "cpio", N_("cpio archive")),
+	MAGIC(0, "070702", NULL, "cpio", N_("cpio archive")),
+	MAGIC(0, "!<arch>\n", NULL, "ar", N_("ar archive")),
+	MAGIC(257, "ustar", NULL, "tar", N_("tar archive")),
+	MAGIC(0x438, "\x53\xef", NULL, "ext2", N_("ext2/3/4 filesystem")),
+	MAGIC(0x8001, "CD001", NULL, "ISO 9660", N_("ISO 9660 filesystem"))
+};
+#define MAGIC_ENTRIES	(sizeof(_hexeditormagic_entries) \
+		/ sizeof(*_hexeditormagic_entries))
+
+/* the offsets of the entries, checked in turn */
+#define MAGIC_OFFSETS	4
+
+
+/* variables */
+static pthread_once_t _hexeditormagic_once = PTHREAD_ONCE_INIT;
+static off_t _hexeditormagic_offsets[MAGIC_OFFSETS];
+static size_t _hexeditormagic_offsets_cnt;
+/* the first entry for every offset and first byte, then the next one */
+static int16_t _hexeditormagic_index[MAGIC_OFFSETS][256];
+static int16_t _hexeditormagic_next[MAGIC_ENTRIES];
+
+
+/* public */
+/* functions */
+/* hexeditormagic_detect */
+HexEditorMagic * hexeditormagic_detect(void const * buf, size_t size)
+{
+	unsigned char const * b = buf;
+	HexEditorMagicEntry const * e;
+	size_t i;
+	int16_t j;
+
+	pthread_once(&_hexeditormagic_once, _hexeditormagic_init);
+	for(i = 0; i < _hexeditormagic_offsets_cnt; i++)
+	{
+		if((size_t)_hexeditormagic_offsets[i] >= size)
+			continue;
+		/* only the entries starting with this very byte */
+		for(j = _hexeditormagic_index[i][b[
+				_hexeditormagic_offsets[i]]]; j >= 0;
+				j = _hexeditormagic_next[j])
+		{
+			e = &_hexeditormagic_entries[j];
+			if(e->offset + e->magic_size > size
+					|| memcmp(&b[e->offset], e->magic,
+						e->magic_size) != 0)
+				continue;
+			if(e->verify != NULL && e->verify(b, size) != 0)
+				continue;
+			return &e->format;
+		}
+	}
+	return NULL;
+}
+
+
+/* private */
+/* functions */
+/* hexeditormagic_init */
+static void _hexeditormagic_init(void)
+{
+	HexEditorMagicEntry const * e;
+	size_t i;
+	size_t j;
+	int16_t * p;
+
+	memset(_hexeditormagic_index, -1, sizeof(_hexeditormagic_index));
+	for(i = 0; i < MAGIC_ENTRIES; i++)
+	{
+		e = &_hexeditormagic_entries[i];
+		for(j = 0; j < _hexeditormagic_offsets_cnt; j++)
+			if(_hexeditormagic_offsets[j] == e->offset)
+				break;
+		if(j == _hexeditormagic_offsets_cnt)
+		{
+			if(j == MAGIC_OFFSETS)
+				/* MAGIC_OFFSETS is too low */
+				continue;
+			_hexeditormagic_offsets[_hexeditormagic_offsets_cnt++]
+				= e->offset;
+		}
+		/* appended, to keep the order of the table */
+		_hexeditormagic_next[i] = -1;
+		for(p = &_hexeditormagic_index[j][(unsigned char)e->magic[0]];
+				*p >= 0; p = &_hexeditormagic_next[*p]);
+		*p = i;
+	}
+}
+
+
+/* magic_verify_bmp */
+static int _magic_verify_bmp(unsigned char const * buf, size_t size)
+{
+	/* the reserved fields are zero */
+	if(size < 10)
+		return -1;
+	return (buf[6] | buf[7] | buf[8] | buf[9]) == 0 ? 0 : -1;
+}
+
+
+/* magic_verify_fat */
+static int _magic_verify_fat(unsigned char const * buf, size_t size)
+{
+	uint32_t count;
+
+	/* shared with Java classes, where the version comes instead */
+	if(size < 8)
+		return -1;
+	count = ((uint32_t)buf[4] << 24) | (buf[5] << 16) | (buf[6] << 8)
+		| buf[7];
+	return (count > 0 && count < 45) ? 0 : -1;
+}
+
+
+/* magic_verify_pe */
+static int _magic_verify_pe(unsigned char const * buf, size_t size)
+{
+	uint32_t offset;
+
+	if(size < 0x40)
+		return -1;
+	offset = buf[0x3c] | (buf[0x3d] << 8) | (buf[0x3e] << 16)
+		| ((uint32_t)buf[0x3f] << 24);
+	if(offset > size - 4)
+		return -1;
+	return memcmp(&buf[offset], "PE\0\0", 4) == 0 ? 0 : -1;
+}
+
+
+/* magic_verify_wav */
+static int _magic_verify_wav(unsigned char const * buf, size_t size)
+{
+	if(size < 12)
+		return -1;
+	return memcmp(&buf[8], "WAVE", 4) == 0 ? 0 : -1;
+}
@@ -0,0 +1,38 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_MAGIC_H
+# define HEXEDITOR_MAGIC_H
+
+# include <sys/types.h>
+
+
+/* HexEditorMagic */
+/* public */
+/* types */
+typedef const struct _HexEditorMagic
+{
+	/* also the name of the template or plug-in handling it */
+	char const * name;
+	char const * description;
+} HexEditorMagic;
+
+
+/* functions */
+HexEditorMagic * hexeditormagic_detect(void const * buf, size_t size);
+
+#endif /* !HEXEDITOR_MAGIC_H */
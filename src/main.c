@@ -16,11 +16,16 @@
 
 
 #include <unistd.h>
+#include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 #include <locale.h>
 #include <libintl.h>
 #include <gtk/gtk.h>
 #include <System.h>
+#include "batch.h"
+#include "hexeditor.h"
 #include "window.h"
 #include "../config.h"
 #define _(string) gettext(string)
@@ -43,20 +48,118 @@
 
 /* private */
 /* prototypes */
-static int _hexeditor(char const * filename);
+static int _batch(HexEditorBatchFormat format, char const * plugins,
+		unsigned int jobs, int filec, char * filev[]);
+static int _hexeditor(char const * filename, pid_t pid);
 
 static int _error(char const * message, int ret);
 static int _usage(void);
 
 
 /* functions */
+/* batch */
+static int _batch_files(HexEditorBatch * batch, int filec, char * filev[]);
+static int _batch_plugins(HexEditorBatch * batch, char const * plugins);
+
+static int _batch(HexEditorBatchFormat format, char const * plugins,
+		unsigned int jobs, int filec, char * filev[])
+{
+	HexEditorBatch * batch;
+	int ret;
+
+	if((batch = hexeditorbatch_new(format, stdout)) == NULL)
+		return -error_print(PACKAGE);
+	if(_batch_plugins(batch, plugins) != 0
+			|| _batch_files(batch, filec, filev) != 0
+			|| (ret = hexeditorbatch_run(batch, jobs)) < 0)
+		ret = -error_print(PACKAGE);
+	hexeditorbatch_delete(batch);
+	return ret;
+}
+
+static int _batch_files(HexEditorBatch * batch, int filec, char * filev[])
+{
+	int i;
+	char * line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	int ret = 0;
+
+	for(i = 0; i < filec; i++)
+		if(hexeditorbatch_add(batch, filev[i]) != 0)
+			return -1;
+	if(filec > 0)
+		return 0;
+	/* one filename per line otherwise, as from find(1) */
+	while(ret == 0 && (len = getline(&line, &size, stdin)) > 0)
+	{
+		if(line[len - 1] == '\n')
+			line[--len] = '\0';
+		if(len > 0)
+			ret = hexeditorbatch_add(batch, line);
+	}
+	free(line);
+	return ret;
+}
+
+static int _batch_plugins(HexEditorBatch * batch, char const * plugins)
+{
+	Config * config = NULL;
+	char const * homedir;
+	String * filename;
+	char * p;
+	char * q;
+	char * r;
+	int ret = 0;
+
+	/* the plug-ins of the editor by default */
+	if(plugins == NULL)
+	{
+		if((homedir = getenv("HOME")) == NULL)
+			homedir = g_get_home_dir();
+		if((config = config_new()) == NULL
+				|| (filename = string_new_append(homedir, "/",
+						HEXEDITOR_CONFIG_FILE, NULL))
+				== NULL)
+		{
+			if(config != NULL)
+				config_delete(config);
+			return -1;
+		}
+		if(config_load(config, filename) == 0)
+			plugins = config_get(config, NULL, "plugins");
+		string_delete(filename);
+	}
+	if(plugins == NULL || (p = strdup(plugins)) == NULL)
+	{
+		if(config != NULL)
+			config_delete(config);
+		return (plugins == NULL) ? 0 : -error_set_code(1, "%s",
+				strerror(errno));
+	}
+	for(q = p; ret == 0 && q != NULL; q = r)
+	{
+		if((r = strchr(q, ',')) != NULL)
+			*(r++) = '\0';
+		if(*q != '\0')
+			ret = hexeditorbatch_load(batch, q);
+	}
+	free(p);
+	if(config != NULL)
+		config_delete(config);
+	return ret;
+}
+
+
 /* hexeditor */
-static int _hexeditor(char const * filename)
+static int _hexeditor(char const * filename, pid_t pid)
 {
 	HexEditorWindow * hexeditor;
 
 	if((hexeditor = hexeditorwindow_new(filename)) == NULL)
 		return error_print(PACKAGE);
+	if(pid > 0)
+		hexeditorwindow_open_process(hexeditor, pid);
 	gtk_main();
 	hexeditorwindow_delete(hexeditor);
 	return 0;
@@ -75,7 +178,15 @@ static int _error(char const * message, int ret)
 /* usage */
 static int _usage(void)
 {
-	fprintf(stderr, _("Usage: %s [filename]\n"), PROGNAME);
+	fprintf(stderr, _("Usage: %s [filename | -]\n"
+"       %s -p pid\n"
+"       %s -b [-c][-j jobs][-P plugins] [filename...]\n"
+"  -p	Inspect the memory of a running process\n"
+"  -b	Analyse files with the plug-ins, without a window\n"
+"  -c	Output CSV instead of JSON\n"
+"  -j	Number of files analysed at once (default: one per processor)\n"
+"  -P	Plug-ins to run, separated by commas (default: as configured)\n"),
+			PROGNAME, PROGNAME, PROGNAME);
 	return 1;
 }
 
@@ -87,23 +198,70 @@ int main(int argc, char * argv[])
 {
 	int o;
 	char const * filename = NULL;
+	pid_t pid = 0;
+	int batch = 0;
+	HexEditorBatchFormat format = HEBF_JSON;
+	unsigned long jobs = 0;
+	char const * plugins = NULL;
+	gboolean display;
+	long l;
+	char * p;
 
 	if(setlocale(LC_ALL, "") == NULL)
 		_error("setlocale", 1);
 	bindtextdomain(PACKAGE, LOCALEDIR);
 	textdomain(PACKAGE);
-	gtk_init(&argc, &argv);
-	while((o = getopt(argc, argv, "")) != -1)
+	/* the batch mode does not need any display */
+	display = gtk_init_check(&argc, &argv);
+	while((o = getopt(argc, argv, "bcj:P:p:")) != -1)
 		switch(o)
 		{
+			case 'b':
+				batch = 1;
+				break;
+			case 'c':
+				format = HEBF_CSV;
+				break;
+			case 'j':
+				jobs = strtoul(optarg, &p, 10);
+				if(optarg[0] == '\0' || *p != '\0' || jobs == 0
+						|| jobs > 4096)
+					return _usage();
+				break;
+			case 'P':
+				plugins = optarg;
+				break;
+			case 'p':
+				errno = 0;
+				l = strtol(optarg, &p, 10);
+				/* pid_t may be narrower than long */
+				if(optarg[0] == '\0' || *p != '\0' || errno != 0
+						|| l <= 0 || (pid_t)l != l)
+					return _usage();
+				pid = l;
+				break;
 			default:
 				return _usage();
 		}
+	if(batch && pid > 0)
+		return _usage();
+	if(batch)
+		return (_batch(format, plugins, jobs, argc - optind,
+					&argv[optind]) == 0) ? 0 : 2;
+	if(format != HEBF_JSON || jobs != 0 || plugins != NULL)
+		return _usage();
+	if(display != TRUE)
+	{
+		fputs(PROGNAME ": Cannot open display\n", stderr);
+		return 2;
+	}
 	if(optind == argc)
 		filename = NULL;
+	else if(pid > 0)
+		return _usage();
 	else if(optind + 1 == argc)
 		filename = argv[optind];
 	else
 		return _usage();
-	return (_hexeditor(filename) == 0) ? 0 : 2;
+	return (_hexeditor(filename, pid) == 0) ? 0 : 2;
 }
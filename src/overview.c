@@ -0,0 +1,476 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <System.h>
+#include "overview.h"
+
+
+/* HexEditorOverview */
+/* private */
+/* types */
+typedef struct _HexEditorOverviewNode
+{
+	/* out of 255 for every class */
+	unsigned char share[HEOC_COUNT];
+	/* the children changed */
+	unsigned char dirty;
+} HexEditorOverviewNode;
+
+struct _HexEditorOverview
+{
+	off_t size;
+	/* a power of two, larger as the file grows */
+	off_t block;
+
+	/* the summaries of the blocks, then the coarser levels, each half the
+	 * size of the previous one */
+	HexEditorOverviewNode * levels[64];
+	size_t levels_cnt[64];
+	size_t levels_alloc[64];
+	size_t levels_levels;
+
+	/* the block being scanned */
+	off_t scan_offset;
+	uint64_t scan_histogram[256];
+	uint64_t scan_cnt;
+};
+
+/* as saved */
+typedef struct _HexEditorOverviewHeader
+{
+	uint64_t size;
+	uint64_t block;
+} HexEditorOverviewHeader;
+
+
+/* constants */
+/* in bits per byte, for compressed or encrypted data */
+#define HEXEDITOROVERVIEW_ENTROPY	7.2
+
+
+/* prototypes */
+static void _hexeditoroverview_commit(HexEditorOverview * overview);
+static void _hexeditoroverview_feed(HexEditorOverview * overview,
+		unsigned char const * buf, size_t size);
+static HexEditorOverviewNode * _hexeditoroverview_node(
+		HexEditorOverview * overview, size_t level, size_t index);
+static int _hexeditoroverview_resize(HexEditorOverview * overview,
+		off_t size);
+
+
+/* public */
+/* functions */
+/* hexeditoroverview_new */
+HexEditorOverview * hexeditoroverview_new(off_t size)
+{
+	HexEditorOverview * overview;
+
+	if((overview = object_new(sizeof(*overview))) == NULL)
+		return NULL;
+	overview->size = 0;
+	overview->block = HEXEDITOROVERVIEW_BLOCK_SIZE;
+	memset(overview->levels, 0, sizeof(overview->levels));
+	memset(overview->levels_cnt, 0, sizeof(overview->levels_cnt));
+	memset(overview->levels_alloc, 0, sizeof(overview->levels_alloc));
+	overview->levels_levels = 0;
+	overview->scan_offset = 0;
+	memset(overview->scan_histogram, 0, sizeof(overview->scan_histogram));
+	overview->scan_cnt = 0;
+	if(_hexeditoroverview_resize(overview, size) != 0)
+	{
+		hexeditoroverview_delete(overview);
+		return NULL;
+	}
+	return overview;
+}
+
+
+/* hexeditoroverview_new_from_buffer */
+HexEditorOverview * hexeditoroverview_new_from_buffer(void const * buf,
+		size_t size)
+{
+	HexEditorOverview * overview;
+	HexEditorOverviewHeader header;
+	char const * p = buf;
+	size_t i;
+
+	if(size < sizeof(header))
+	{
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	memcpy(&header, buf, sizeof(header));
+	if((overview = hexeditoroverview_new(header.size)) == NULL)
+		return NULL;
+	if(overview->block != (off_t)header.block
+			|| (size - sizeof(header)) / HEOC_COUNT
+			!= overview->levels_cnt[0])
+	{
+		hexeditoroverview_delete(overview);
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	for(i = 0, p += sizeof(header); i < overview->levels_cnt[0];
+			i++, p += HEOC_COUNT)
+		memcpy(overview->levels[0][i].share, p, HEOC_COUNT);
+	overview->scan_offset = header.size;
+	return overview;
+}
+
+
+/* hexeditoroverview_delete */
+void hexeditoroverview_delete(HexEditorOverview * overview)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(overview->levels) / sizeof(*overview->levels);
+			i++)
+		free(overview->levels[i]);
+	object_delete(overview);
+}
+
+
+/* accessors */
+/* hexeditoroverview_get_buffer */
+int hexeditoroverview_get_buffer(HexEditorOverview * overview, void ** buf,
+		size_t * size)
+{
+	HexEditorOverviewHeader header;
+	char * p;
+	size_t i;
+
+	header.size = overview->size;
+	header.block = overview->block;
+	*size = sizeof(header) + overview->levels_cnt[0] * HEOC_COUNT;
+	if((p = malloc(*size)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	*buf = p;
+	memcpy(p, &header, sizeof(header));
+	for(i = 0, p += sizeof(header); i < overview->levels_cnt[0];
+			i++, p += HEOC_COUNT)
+		memcpy(p, overview->levels[0][i].share, HEOC_COUNT);
+	return 0;
+}
+
+
+/* hexeditoroverview_get_class */
+HexEditorOverviewClass hexeditoroverview_get_class(
+		HexEditorOverview * overview, off_t offset, off_t size)
+{
+	HexEditorOverviewClass ret = HEOC_UNKNOWN;
+	HexEditorOverviewNode * node;
+	size_t level;
+	size_t index;
+	size_t i;
+
+	if(offset < 0 || offset >= overview->size)
+		return HEOC_UNKNOWN;
+	/* the coarsest level still as fine as the range */
+	for(level = 0; level < overview->levels_levels
+			&& (overview->block << (level + 1)) <= size; level++);
+	index = offset / (overview->block << level);
+	node = _hexeditoroverview_node(overview, level, index);
+	for(i = 1; i < HEOC_COUNT; i++)
+		if(node->share[i] > node->share[ret])
+			ret = i;
+	return ret;
+}
+
+
+/* hexeditoroverview_get_size */
+off_t hexeditoroverview_get_size(HexEditorOverview * overview)
+{
+	return overview->size;
+}
+
+
+/* hexeditoroverview_set_size */
+int hexeditoroverview_set_size(HexEditorOverview * overview, off_t size)
+{
+	if(size == overview->size)
+		return 0;
+	return _hexeditoroverview_resize(overview, size);
+}
+
+
+/* useful */
+/* hexeditoroverview_hole */
+int hexeditoroverview_hole(HexEditorOverview * overview, off_t offset,
+		off_t size)
+{
+	size_t n;
+
+	if(offset != overview->scan_offset)
+		_hexeditoroverview_commit(overview);
+	overview->scan_offset = offset;
+	/* counted as zeros */
+	for(; size > 0; size -= n)
+	{
+		n = overview->block - (overview->scan_offset
+				% overview->block);
+		n = (size < (off_t)n) ? (size_t)size : n;
+		_hexeditoroverview_feed(overview, NULL, n);
+	}
+	return 0;
+}
+
+
+/* hexeditoroverview_scan */
+int hexeditoroverview_scan(HexEditorOverview * overview, off_t offset,
+		void const * buf, size_t size)
+{
+	unsigned char const * p = buf;
+	size_t n;
+
+	/* the blocks are summarized as soon as they are complete */
+	if(buf == NULL || offset != overview->scan_offset)
+		_hexeditoroverview_commit(overview);
+	if(buf == NULL)
+		return 0;
+	overview->scan_offset = offset;
+	for(; size > 0; p += n, size -= n)
+	{
+		n = overview->block - (overview->scan_offset
+				% overview->block);
+		n = (size < n) ? size : n;
+		_hexeditoroverview_feed(overview, p, n);
+	}
+	return 0;
+}
+
+
+/* private */
+/* functions */
+/* hexeditoroverview_commit */
+static void _hexeditoroverview_commit(HexEditorOverview * overview)
+{
+	const uint64_t * h = overview->scan_histogram;
+	const uint64_t n = overview->scan_cnt;
+	HexEditorOverviewNode * node;
+	size_t index;
+	size_t level;
+	uint64_t ascii;
+	double entropy = 0.0;
+	size_t i;
+
+	if(n == 0)
+		return;
+	index = (overview->scan_offset - 1) / overview->block;
+	if(index < overview->levels_cnt[0])
+	{
+		node = &overview->levels[0][index];
+		memset(node->share, 0, sizeof(node->share));
+		for(i = 0; i < 256; i++)
+			if(h[i] != 0)
+				entropy += h[i] * log2(h[i]);
+		entropy = log2(n) - entropy / n;
+		for(i = 0x20, ascii = h['\t'] + h['\n'] + h['\r']; i < 0x7f;
+				i++)
+			ascii += h[i];
+		if(n >= 1024 && entropy > HEXEDITOROVERVIEW_ENTROPY)
+			node->share[HEOC_ENTROPY] = 255;
+		else
+		{
+			node->share[HEOC_ZERO] = h[0x00] * 255 / n;
+			node->share[HEOC_FF] = h[0xff] * 255 / n;
+			node->share[HEOC_ASCII] = ascii * 255 / n;
+			node->share[HEOC_OTHER] = (n - h[0x00] - h[0xff]
+					- ascii) * 255 / n;
+		}
+		/* the coarser levels are summarized again when needed */
+		for(level = 1; level <= overview->levels_levels; level++)
+		{
+			index /= 2;
+			node = &overview->levels[level][index];
+			if(node->dirty)
+				break;
+			node->dirty = 1;
+		}
+	}
+	memset(overview->scan_histogram, 0, sizeof(overview->scan_histogram));
+	overview->scan_cnt = 0;
+}
+
+
+/* hexeditoroverview_feed */
+static void _hexeditoroverview_feed(HexEditorOverview * overview,
+		unsigned char const * buf, size_t size)
+{
+	uint32_t h[4][256];
+	size_t i;
+
+	if(buf == NULL)
+		overview->scan_histogram[0] += size;
+	else
+	{
+		/* interleaved to avoid stalling on repeated bytes */
+		memset(h, 0, sizeof(h));
+		for(i = 0; i + 4 <= size; i += 4)
+		{
+			h[0][buf[i]]++;
+			h[1][buf[i + 1]]++;
+			h[2][buf[i + 2]]++;
+			h[3][buf[i + 3]]++;
+		}
+		for(; i < size; i++)
+			h[0][buf[i]]++;
+		for(i = 0; i < 256; i++)
+			overview->scan_histogram[i] += h[0][i] + h[1][i]
+				+ h[2][i] + h[3][i];
+	}
+	overview->scan_cnt += size;
+	overview->scan_offset += size;
+	if(overview->scan_offset % overview->block == 0)
+		_hexeditoroverview_commit(overview);
+}
+
+
+/* hexeditoroverview_node */
+static HexEditorOverviewNode * _hexeditoroverview_node(
+		HexEditorOverview * overview, size_t level, size_t index)
+{
+	HexEditorOverviewNode * node;
+	HexEditorOverviewNode * a;
+	HexEditorOverviewNode * b;
+	size_t i;
+
+	node = &overview->levels[level][index];
+	if(level == 0)
+		return node;
+	if(!node->dirty)
+		return node;
+	a = _hexeditoroverview_node(overview, level - 1, index * 2);
+	b = (index * 2 + 1 < overview->levels_cnt[level - 1])
+		? _hexeditoroverview_node(overview, level - 1, index * 2 + 1)
+		: a;
+	for(i = 0; i < HEOC_COUNT; i++)
+		node->share[i] = (a->share[i] + b->share[i] + 1) / 2;
+	node->dirty = 0;
+	return node;
+}
+
+
+/* hexeditoroverview_resize */
+static void _resize_coarsen(HexEditorOverview * overview);
+static int _resize_level(HexEditorOverview * overview, size_t level,
+		size_t cnt);
+
+static int _hexeditoroverview_resize(HexEditorOverview * overview,
+		off_t size)
+{
+	size_t tail;
+	size_t level;
+	size_t index;
+
+	/* the blocks get larger with the file, so that there are never too
+	 * many of them */
+	while((size + overview->block - 1) / overview->block
+			> HEXEDITOROVERVIEW_BLOCKS)
+		_resize_coarsen(overview);
+	tail = overview->levels_cnt[0];
+	if(_resize_level(overview, 0, (size + overview->block - 1)
+				/ overview->block) != 0)
+		return -1;
+	if(overview->levels_cnt[0] < tail)
+		tail = overview->levels_cnt[0];
+	for(level = 0; overview->levels_cnt[level] > 1; level++)
+		if(_resize_level(overview, level + 1,
+					(overview->levels_cnt[level] + 1) / 2)
+				!= 0)
+			return -1;
+	for(index = level + 1; index <= overview->levels_levels; index++)
+		overview->levels_cnt[index] = 0;
+	overview->levels_levels = level;
+	overview->size = size;
+	/* besides the new nodes, only the path from the former last block
+	 * to the root has to be summarized again */
+	for(level = 1, index = tail - 1; tail > 0
+			&& level <= overview->levels_levels; level++)
+	{
+		index /= 2;
+		overview->levels[level][index].dirty = 1;
+	}
+	return 0;
+}
+
+static void _resize_coarsen(HexEditorOverview * overview)
+{
+	HexEditorOverviewNode * blocks = overview->levels[0];
+	HexEditorOverviewNode unknown;
+	HexEditorOverviewNode * a;
+	HexEditorOverviewNode * b;
+	size_t cnt = overview->levels_cnt[0];
+	size_t level;
+	size_t i;
+	size_t j;
+
+	/* the pairs of blocks are merged in place */
+	memset(&unknown, 0, sizeof(unknown));
+	unknown.share[HEOC_UNKNOWN] = 255;
+	for(i = 0; i < (cnt + 1) / 2; i++)
+	{
+		a = &blocks[i * 2];
+		b = (i * 2 + 1 < cnt) ? &blocks[i * 2 + 1] : &unknown;
+		for(j = 0; j < HEOC_COUNT; j++)
+			blocks[i].share[j] = (a->share[j] + b->share[j] + 1)
+				/ 2;
+	}
+	overview->levels_cnt[0] = (cnt + 1) / 2;
+	overview->block <<= 1;
+	/* the block being scanned is then only summarized partially */
+	for(level = 1; level <= overview->levels_levels; level++)
+		for(i = 0; i < overview->levels_cnt[level]; i++)
+			overview->levels[level][i].dirty = 1;
+}
+
+static int _resize_level(HexEditorOverview * overview, size_t level,
+		size_t cnt)
+{
+	HexEditorOverviewNode * p;
+	size_t alloc;
+	size_t i;
+
+	/* grown geometrically, but never shrunk */
+	if(cnt > overview->levels_alloc[level])
+	{
+		for(alloc = (overview->levels_alloc[level] > 0)
+				? overview->levels_alloc[level] : 16;
+				alloc < cnt; alloc <<= 1);
+		if((p = realloc(overview->levels[level], sizeof(*p) * alloc))
+				== NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+		overview->levels[level] = p;
+		overview->levels_alloc[level] = alloc;
+	}
+	/* not scanned, or not summarized yet */
+	for(i = overview->levels_cnt[level]; i < cnt; i++)
+	{
+		p = &overview->levels[level][i];
+		memset(p, 0, sizeof(*p));
+		if(level == 0)
+			p->share[HEOC_UNKNOWN] = 255;
+		else
+			p->dirty = 1;
+	}
+	overview->levels_cnt[level] = cnt;
+	return 0;
+}
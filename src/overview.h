@@ -0,0 +1,70 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_OVERVIEW_H
+# define HEXEDITOR_OVERVIEW_H
+
+# include <sys/types.h>
+
+
+/* HexEditorOverview */
+/* public */
+/* types */
+typedef struct _HexEditorOverview HexEditorOverview;
+
+typedef enum _HexEditorOverviewClass
+{
+	HEOC_UNKNOWN = 0,
+	HEOC_ZERO,
+	HEOC_FF,
+	HEOC_ASCII,
+	HEOC_ENTROPY,
+	HEOC_OTHER
+} HexEditorOverviewClass;
+# define HEOC_LAST	HEOC_OTHER
+# define HEOC_COUNT	(HEOC_LAST + 1)
+
+
+/* constants */
+/* the smallest block summarized */
+# define HEXEDITOROVERVIEW_BLOCK_SIZE	4096
+/* the blocks grow with the files beyond this count */
+# define HEXEDITOROVERVIEW_BLOCKS	65536
+
+
+/* functions */
+HexEditorOverview * hexeditoroverview_new(off_t size);
+HexEditorOverview * hexeditoroverview_new_from_buffer(void const * buf,
+		size_t size);
+void hexeditoroverview_delete(HexEditorOverview * overview);
+
+/* accessors */
+int hexeditoroverview_get_buffer(HexEditorOverview * overview, void ** buf,
+		size_t * size);
+HexEditorOverviewClass hexeditoroverview_get_class(
+		HexEditorOverview * overview, off_t offset, off_t size);
+off_t hexeditoroverview_get_size(HexEditorOverview * overview);
+
+int hexeditoroverview_set_size(HexEditorOverview * overview, off_t size);
+
+/* useful */
+int hexeditoroverview_hole(HexEditorOverview * overview, off_t offset,
+		off_t size);
+int hexeditoroverview_scan(HexEditorOverview * overview, off_t offset,
+		void const * buf, size_t size);
+
+#endif /* !HEXEDITOR_OVERVIEW_H */
@@ -15,20 +15,263 @@
 
 
 
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <libintl.h>
 #include "HexEditor/plugin.h"
 #include <System.h>
+#define _(string) gettext(string)
 
 
 /* Template */
+/* private */
 /* types */
+typedef enum _TemplateType
+{
+	TT_U8 = 0,
+	TT_S8,
+	TT_U16,
+	TT_S16,
+	TT_U32,
+	TT_S32,
+	TT_U64,
+	TT_S64,
+	TT_CHAR,
+	TT_BYTES,
+	TT_STRUCT
+} TemplateType;
+
+/* the bytecode */
+typedef enum _TemplateOpcode
+{
+	TO_END = 0,
+	TO_PUSH,	/* low, high */
+	TO_LOAD,	/* slot */
+	TO_JZ,		/* target */
+	TO_JMP,		/* target */
+	TO_FIELD,	/* descriptor, name, slot */
+	TO_ARRAY,	/* descriptor, name */
+	TO_NEG,
+	TO_NOT,
+	TO_BNOT,
+	TO_MUL,
+	TO_DIV,
+	TO_MOD,
+	TO_ADD,
+	TO_SUB,
+	TO_SHL,
+	TO_SHR,
+	TO_LT,
+	TO_LE,
+	TO_GT,
+	TO_GE,
+	TO_EQ,
+	TO_NE,
+	TO_AND,
+	TO_XOR,
+	TO_OR,
+	TO_LAND,
+	TO_LOR
+} TemplateOpcode;
+
+typedef struct _TemplateStruct
+{
+	uint32_t name;
+	uint32_t code;
+	/* -1 unless constant */
+	off_t size;
+} TemplateStruct;
+
+typedef struct _Template
+{
+	char * name;
+	uint32_t * code;
+	size_t code_cnt;
+	TemplateStruct * structs;
+	size_t structs_cnt;
+	/* names of the structures and members */
+	char * strings;
+	size_t strings_size;
+	/* shared by the instances, until the file is modified */
+	gint refcnt;
+	time_t mtime;
+} Template;
+
+/* a member, as decoded */
+typedef struct _TemplateMember
+{
+	uint32_t desc;
+	uint32_t name;
+	off_t offset;
+	/* -1 if not known (yet) */
+	off_t size;
+	gboolean array;
+	uint64_t count;
+	uint64_t value;
+} TemplateMember;
+
+/* an array of variable elements, walked as needed */
+typedef struct _TemplateArray
+{
+	uint32_t desc;
+	off_t offset;
+	uint64_t count;
+	off_t stride;
+	/* offset of every TEMPLATE_GROUP-th element found so far */
+	off_t * marks;
+	size_t marks_cnt;
+} TemplateArray;
+
+/* what an expandable row stands for */
+typedef struct _TemplateNode
+{
+	/* a structure */
+	uint32_t desc;
+	off_t offset;
+	/* or a range of an array */
+	TemplateArray * array;
+	uint64_t first;
+	uint64_t count;
+	gboolean expanded;
+} TemplateNode;
+
 typedef struct _HexEditorPlugin
 {
 	HexEditorPluginHelper * helper;
-	/* FIXME really implement */
+
+	/* the template selected */
+	Template * template;
+	gboolean open;
+	gboolean eof;
+	/* the size of the file when decoded */
+	off_t size;
+
+	/* decoded on demand */
+	GPtrArray * nodes;
+	GPtrArray * arrays;
+
+	/* widgets */
 	GtkWidget * widget;
+	GtkListStore * templates;
+	GtkWidget * combo;
+	GtkTreeStore * store;
 	GtkWidget * view;
 } TemplatePlugin;
 
+typedef enum _TemplatePluginTemplateColumn
+{
+	TPTC_NAME = 0,
+	TPTC_SOURCE,
+	TPTC_FILENAME,
+	TPTC_TEMPLATE
+} TemplatePluginTemplateColumn;
+#define TPTC_LAST	TPTC_TEMPLATE
+#define TPTC_COUNT	(TPTC_LAST + 1)
+
+typedef enum _TemplatePluginColumn
+{
+	TPC_NAME = 0,
+	TPC_OFFSET,
+	TPC_VALUE,
+	TPC_NODE
+} TemplatePluginColumn;
+#define TPC_LAST	TPC_NODE
+#define TPC_COUNT	(TPC_LAST + 1)
+
+
+/* constants */
+#define TEMPLATE_BIG_ENDIAN	0x1
+#define TEMPLATE_SIGNED		0x2
+#define TEMPLATE_AT		0x4
+#define TEMPLATE_UNBOUNDED	0x8
+
+/* descriptors: type, flags, then the structure if any */
+#define TEMPLATE_DESC(type, flags, s)	((type) | ((flags) << 4) | ((s) << 8))
+#define TEMPLATE_DESC_TYPE(desc)	((desc) & 0xf)
+#define TEMPLATE_DESC_FLAGS(desc)	(((desc) >> 4) & 0xf)
+#define TEMPLATE_DESC_STRUCT(desc)	((desc) >> 8)
+
+/* rows listed at once, and elements between two marks */
+#define TEMPLATE_GROUP		1000
+#define TEMPLATE_PREVIEW	16
+#define TEMPLATE_SLOTS		256
+#define TEMPLATE_STACK		64
+#define TEMPLATE_DIRECTORY	".hexeditor.templates"
+
+static const struct
+{
+	char const * name;
+	TemplateType type;
+	unsigned int size;
+} _template_types[] =
+{
+	{ "u8",		TT_U8,		1 },
+	{ "s8",		TT_S8,		1 },
+	{ "u16",	TT_U16,		2 },
+	{ "s16",	TT_S16,		2 },
+	{ "u32",	TT_U32,		4 },
+	{ "s32",	TT_S32,		4 },
+	{ "u64",	TT_U64,		8 },
+	{ "s64",	TT_S64,		8 },
+	{ "char",	TT_CHAR,	1 },
+	{ "bytes",	TT_BYTES,	1 }
+};
+
+/* built-in templates */
+static const struct
+{
+	char const * name;
+	char const * source;
+} _template_builtin[] =
+{
+	{ "BMP",
+		"endian little;\n"
+		"struct info { u32 size; s32 width; s32 height; u16 planes;"
+		" u16 bpp; u32 compression; u32 image_size; s32 xppm;"
+		" s32 yppm; u32 colors; u32 important; }\n"
+		"struct bmp { char magic[2]; u32 size; u16 reserved1;"
+		" u16 reserved2; u32 offset; info info;"
+		" bytes pixels[size - offset] @ offset; }\n" },
+	{ "ELF (64-bit)",
+		"endian little;\n"
+		"struct segment { u32 type; u32 flags; u64 offset; u64 vaddr;"
+		" u64 paddr; u64 filesz; u64 memsz; u64 align; }\n"
+		"struct section { u32 name; u32 type; u64 flags; u64 addr;"
+		" u64 offset; u64 size; u32 link; u32 info; u64 addralign;"
+		" u64 entsize; }\n"
+		"struct elf { bytes magic[4]; u8 class; u8 data; u8 version;"
+		" u8 osabi; u8 abiversion; bytes padding[7]; u16 type;"
+		" u16 machine; u32 version2; u64 entry; u64 phoff; u64 shoff;"
+		" u32 flags; u16 ehsize; u16 phentsize; u16 phnum;"
+		" u16 shentsize; u16 shnum; u16 shstrndx;"
+		" segment segments[phnum] @ phoff;"
+		" section sections[shnum] @ shoff; }\n" },
+	{ "PNG",
+		"endian big;\n"
+		"struct chunk { u32 length; char type[4]; bytes data[length];"
+		" u32 crc; }\n"
+		"struct png { bytes signature[8]; chunk chunks[]; }\n" },
+	{ "WAV",
+		"endian little;\n"
+		"struct chunk { char id[4]; u32 size;"
+		" bytes data[size + (size & 1)]; }\n"
+		"struct riff { char id[4]; u32 size; char format[4];"
+		" chunk chunks[]; }\n" }
+};
+
+
+/* variables */
+/* compiled once, then only read by every instance */
+static GMutex _template_mutex;
+static GHashTable * _template_cache = NULL;
+
 
 /* prototypes */
 /* plug-in */
@@ -38,23 +281,89 @@ static void _templateplugin_destroy(TemplatePlugin * template);
 static GtkWidget * _templateplugin_get_widget(TemplatePlugin * template);
 static void _templateplugin_read(TemplatePlugin * template, off_t offset,
 		char const * buffer, size_t size);
+static int _templateplugin_save(TemplatePlugin * template, void ** buffer,
+		size_t * size);
+static int _templateplugin_restore(TemplatePlugin * template,
+		void const * buffer, size_t size);
+static int _templateplugin_format(TemplatePlugin * template,
+		char const * name);
+static void _templateplugin_hole(TemplatePlugin * template, off_t offset,
+		off_t size);
+
+/* useful */
+static void _templateplugin_append(TemplatePlugin * template,
+		GtkTreeIter * parent, char const * name, off_t offset,
+		TemplateNode * node);
+static int _templateplugin_array_offset(TemplatePlugin * template,
+		TemplateArray * array, uint64_t index, off_t * offset);
+static void _templateplugin_expand(TemplatePlugin * template,
+		GtkTreeIter * iter, TemplateNode * node);
+static ssize_t _templateplugin_fetch(TemplatePlugin * template, off_t offset,
+		void * buf, size_t size);
+static off_t _templateplugin_get_size(TemplatePlugin * template);
+static void _templateplugin_refresh(TemplatePlugin * template);
+static void _templateplugin_reset(TemplatePlugin * template);
+static int _templateplugin_run(TemplatePlugin * template, uint32_t sidx,
+		off_t offset, GArray * members, off_t * size);
+static void _templateplugin_select(TemplatePlugin * template,
+		GtkTreeIter * iter);
+static int _templateplugin_sizeof(TemplatePlugin * template, uint32_t desc,
+		off_t offset, off_t * size);
+
+/* templates */
+typedef struct _TemplateCompiler
+{
+	Template * template;
+	char const * filename;
+	char const * p;
+	unsigned int line;
+	unsigned int endian;
+	/* the scalar fields of the current structure */
+	uint32_t fields[TEMPLATE_SLOTS];
+	uint32_t fields_cnt;
+	/* -1 unless constant */
+	off_t size;
+} TemplateCompiler;
+
+static Template * _template_compile(char const * name, char const * source);
+static void _template_delete(Template * template);
+static Template * _template_get(char const * name, char const * source,
+		char const * filename);
+static void _template_unref(Template * template);
+static uint64_t _template_apply(TemplateOpcode op, uint64_t a, uint64_t b);
 
+/* callbacks */
+static void _templateplugin_on_changed(gpointer data);
+static gboolean _templateplugin_on_test_expand_row(GtkWidget * widget,
+		GtkTreeIter * iter, GtkTreePath * path, gpointer data);
 
+
+/* public */
+/* variables */
 /* plug-in */
 HexEditorPluginDefinition plugin =
 {
+	HEXEDITOR_PLUGIN_VERSION,
 	"Template",
 	NULL,
 	NULL,
 	_templateplugin_init,
 	_templateplugin_destroy,
 	_templateplugin_get_widget,
-	_templateplugin_read
+	_templateplugin_read,
+	_templateplugin_save,
+	_templateplugin_restore,
+	_templateplugin_format,
+	_templateplugin_hole
 };
 
 
+/* private */
 /* functions */
+/* plug-in */
 /* templateplugin_init */
+static void _init_templates(TemplatePlugin * template);
+
 static TemplatePlugin * _templateplugin_init(HexEditorPluginHelper * helper)
 {
 	TemplatePlugin * template;
@@ -62,34 +371,1576 @@ static TemplatePlugin * _templateplugin_init(HexEditorPluginHelper * helper)
 	if((template = object_new(sizeof(*template))) == NULL)
 		return NULL;
 	template->helper = helper;
-	/* FIXME really implement */
-	template->widget = gtk_scrolled_window_new(NULL, NULL);
-	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(template->widget),
-			GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-	template->view = gtk_tree_view_new();
-	gtk_container_add(GTK_CONTAINER(template->widget), template->view);
-	gtk_widget_show_all(template->widget);
+	template->template = NULL;
+	template->open = FALSE;
+	template->eof = FALSE;
+	template->size = -1;
+	template->nodes = g_ptr_array_new_with_free_func(g_free);
+	template->arrays = g_ptr_array_new();
+	/* the widgets are only created once displayed */
+	template->widget = NULL;
+	template->templates = gtk_list_store_new(TPTC_COUNT, G_TYPE_STRING,
+			G_TYPE_POINTER, G_TYPE_STRING, G_TYPE_POINTER);
+	_init_templates(template);
+	template->combo = NULL;
+	template->store = gtk_tree_store_new(TPC_COUNT, G_TYPE_STRING,
+			G_TYPE_STRING, G_TYPE_STRING, G_TYPE_POINTER);
+	template->view = NULL;
 	return template;
 }
 
+static void _init_templates(TemplatePlugin * template)
+{
+	GtkTreeIter iter;
+	size_t i;
+	char const * homedir;
+	String * dirname;
+	String * filename;
+	DIR * dir;
+	struct dirent * de;
+
+	for(i = 0; i < sizeof(_template_builtin) / sizeof(*_template_builtin);
+			i++)
+	{
+		gtk_list_store_append(template->templates, &iter);
+		gtk_list_store_set(template->templates, &iter,
+				TPTC_NAME, _template_builtin[i].name,
+				TPTC_SOURCE, _template_builtin[i].source,
+				TPTC_FILENAME, NULL, TPTC_TEMPLATE, NULL, -1);
+	}
+	/* the templates of the user, compiled once selected */
+	if((homedir = getenv("HOME")) == NULL)
+		homedir = g_get_home_dir();
+	if((dirname = string_new_append(homedir, "/", TEMPLATE_DIRECTORY,
+					NULL)) == NULL)
+		return;
+	if((dir = opendir(dirname)) != NULL)
+	{
+		while((de = readdir(dir)) != NULL)
+		{
+			if(de->d_name[0] == '.')
+				continue;
+			if((filename = string_new_append(dirname, "/",
+							de->d_name, NULL))
+					== NULL)
+				continue;
+			gtk_list_store_append(template->templates, &iter);
+			gtk_list_store_set(template->templates, &iter,
+					TPTC_NAME, de->d_name,
+					TPTC_SOURCE, NULL,
+					TPTC_FILENAME, filename,
+					TPTC_TEMPLATE, NULL, -1);
+			string_delete(filename);
+		}
+		closedir(dir);
+	}
+	string_delete(dirname);
+}
+
+
 
 /* templateplugin_destroy */
 static void _templateplugin_destroy(TemplatePlugin * template)
 {
+	GtkTreeModel * model = GTK_TREE_MODEL(template->templates);
+	GtkTreeIter iter;
+	gboolean valid;
+	Template * t;
+
+	_templateplugin_reset(template);
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
+			valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gtk_tree_model_get(model, &iter, TPTC_TEMPLATE, &t, -1);
+		if(t != NULL)
+			_template_unref(t);
+	}
+	g_ptr_array_free(template->arrays, TRUE);
+	g_ptr_array_free(template->nodes, TRUE);
+	g_object_unref(template->templates);
+	g_object_unref(template->store);
 	object_delete(template);
 }
 
 
 /* templateplugin_get_widget */
+static GtkWidget * _get_widget_view(TemplatePlugin * template);
+
 static GtkWidget * _templateplugin_get_widget(TemplatePlugin * template)
 {
+	GtkCellRenderer * renderer;
+	GtkWidget * widget;
+
+	if(template->widget != NULL)
+		return template->widget;
+#if GTK_CHECK_VERSION(3, 0, 0)
+	template->widget = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
+#else
+	template->widget = gtk_vbox_new(FALSE, 4);
+#endif
+	/* templates */
+	template->combo = gtk_combo_box_new_with_model(GTK_TREE_MODEL(
+				template->templates));
+	renderer = gtk_cell_renderer_text_new();
+	gtk_cell_layout_pack_start(GTK_CELL_LAYOUT(template->combo), renderer,
+			TRUE);
+	gtk_cell_layout_set_attributes(GTK_CELL_LAYOUT(template->combo),
+			renderer, "text", TPTC_NAME, NULL);
+	g_signal_connect_swapped(template->combo, "changed", G_CALLBACK(
+				_templateplugin_on_changed), template);
+	gtk_box_pack_start(GTK_BOX(template->widget), template->combo, FALSE,
+			TRUE, 0);
+	/* view */
+	widget = _get_widget_view(template);
+	gtk_box_pack_start(GTK_BOX(template->widget), widget, TRUE, TRUE, 0);
+	gtk_widget_show_all(template->widget);
 	return template->widget;
 }
 
+static GtkWidget * _get_widget_view(TemplatePlugin * template)
+{
+	GtkWidget * widget;
+	GtkCellRenderer * renderer;
+	GtkTreeViewColumn * column;
+
+	widget = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(widget),
+			GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	template->view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(
+				template->store));
+	/* the rows are only decoded once expanded */
+	g_signal_connect(template->view, "test-expand-row", G_CALLBACK(
+				_templateplugin_on_test_expand_row), template);
+	renderer = gtk_cell_renderer_text_new();
+	column = gtk_tree_view_column_new_with_attributes(_("Name"), renderer,
+			"text", TPC_NAME, NULL);
+	gtk_tree_view_column_set_resizable(column, TRUE);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(template->view), column);
+	renderer = gtk_cell_renderer_text_new();
+	g_object_set(renderer, "family", "Monospace", NULL);
+	column = gtk_tree_view_column_new_with_attributes(_("Offset"),
+			renderer, "text", TPC_OFFSET, NULL);
+	gtk_tree_view_column_set_resizable(column, TRUE);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(template->view), column);
+	renderer = gtk_cell_renderer_text_new();
+	column = gtk_tree_view_column_new_with_attributes(_("Value"), renderer,
+			"text", TPC_VALUE, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(template->view), column);
+	gtk_container_add(GTK_CONTAINER(widget), template->view);
+	return widget;
+}
+
 
 /* templateplugin_read */
 static void _templateplugin_read(TemplatePlugin * template, off_t offset,
 		char const * buffer, size_t size)
 {
-	/* FIXME implement */
+	(void) size;
+
+	/* nothing is decoded until needed: only start over when the file is
+	 * read again from the beginning, or modified afterwards */
+	if(buffer == NULL)
+	{
+		template->eof = TRUE;
+		/* the file was decoded before it was read whole, as when
+		 * decompressed or from a pipe */
+		if(template->open && _templateplugin_get_size(template)
+				!= template->size)
+			_templateplugin_refresh(template);
+	}
+	else if(offset == 0)
+	{
+		template->open = TRUE;
+		template->eof = FALSE;
+		_templateplugin_refresh(template);
+	}
+	else if(template->eof)
+		_templateplugin_refresh(template);
+}
+
+
+/* templateplugin_save */
+static int _templateplugin_save(TemplatePlugin * template, void ** buffer,
+		size_t * size)
+{
+	(void) template;
+
+	/* there is nothing to keep */
+	*buffer = NULL;
+	*size = 0;
+	return 0;
+}
+
+
+/* templateplugin_restore */
+static int _templateplugin_restore(TemplatePlugin * template,
+		void const * buffer, size_t size)
+{
+	(void) buffer;
+	(void) size;
+
+	template->open = TRUE;
+	template->eof = TRUE;
+	_templateplugin_refresh(template);
+	return 0;
+}
+
+
+/* templateplugin_format */
+static int _templateplugin_format(TemplatePlugin * template,
+		char const * name)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(template->templates);
+	GtkTreeIter iter;
+	gboolean valid;
+	gchar * p;
+	int res;
+
+	/* the templates are named after the formats they describe */
+	for(valid = gtk_tree_model_get_iter_first(model, &iter); valid == TRUE;
+			valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gtk_tree_model_get(model, &iter, TPTC_NAME, &p, -1);
+		res = strcmp(p, name);
+		g_free(p);
+		if(res != 0)
+			continue;
+		if(template->combo != NULL)
+			gtk_combo_box_set_active_iter(GTK_COMBO_BOX(
+						template->combo), &iter);
+		else
+			/* without a widget, as in batch mode */
+			_templateplugin_select(template, &iter);
+		return 0;
+	}
+	return -1;
+}
+
+
+/* templateplugin_hole */
+static void _templateplugin_hole(TemplatePlugin * template, off_t offset,
+		off_t size)
+{
+	(void) size;
+
+	/* the zeros are read through the helper as well */
+	if(offset == 0)
+	{
+		template->open = TRUE;
+		template->eof = FALSE;
+		_templateplugin_refresh(template);
+	}
+	else if(template->eof)
+		_templateplugin_refresh(template);
+}
+
+
+/* useful */
+/* templateplugin_append */
+static void _templateplugin_append(TemplatePlugin * template,
+		GtkTreeIter * parent, char const * name, off_t offset,
+		TemplateNode * node)
+{
+	GtkTreeIter iter;
+	GtkTreeIter child;
+	char buf[32] = "";
+
+	if(offset >= 0)
+		snprintf(buf, sizeof(buf), "0x%08llx",
+				(unsigned long long)offset);
+	gtk_tree_store_append(template->store, &iter, parent);
+	gtk_tree_store_set(template->store, &iter, TPC_NAME, name,
+			TPC_OFFSET, buf, TPC_NODE, node, -1);
+	/* a placeholder, for the row to be expandable */
+	if(node != NULL)
+	{
+		g_ptr_array_add(template->nodes, node);
+		gtk_tree_store_append(template->store, &child, &iter);
+	}
+}
+
+
+/* templateplugin_array_offset */
+static int _templateplugin_array_offset(TemplatePlugin * template,
+		TemplateArray * array, uint64_t index, off_t * offset)
+{
+	off_t * p;
+	off_t pos;
+	off_t size;
+	uint64_t i;
+
+	if(array->stride > 0)
+	{
+		*offset = array->offset + index * array->stride;
+		return 0;
+	}
+	/* walk from the closest element known */
+	while(array->marks_cnt <= index / TEMPLATE_GROUP)
+	{
+		pos = array->marks[array->marks_cnt - 1];
+		for(i = 0; i < TEMPLATE_GROUP; i++, pos += size)
+			if(pos >= _templateplugin_get_size(template)
+					|| _templateplugin_sizeof(template,
+						array->desc, pos, &size) != 0)
+				return -1;
+		if((p = realloc(array->marks, sizeof(*p)
+						* (array->marks_cnt + 1)))
+				== NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+		array->marks = p;
+		array->marks[array->marks_cnt++] = pos;
+	}
+	pos = array->marks[index / TEMPLATE_GROUP];
+	for(i = index - (index % TEMPLATE_GROUP); i < index; i++, pos += size)
+		if(pos >= _templateplugin_get_size(template)
+				|| _templateplugin_sizeof(template,
+					array->desc, pos, &size) != 0)
+			return -1;
+	if(pos >= _templateplugin_get_size(template))
+		return -1;
+	*offset = pos;
+	return 0;
+}
+
+
+/* templateplugin_expand */
+static void _expand_array(TemplatePlugin * template, GtkTreeIter * iter,
+		TemplateNode * node);
+static TemplateArray * _expand_array_new(TemplatePlugin * template,
+		TemplateMember * member);
+static void _expand_element(TemplatePlugin * template, GtkTreeIter * iter,
+		TemplateArray * array, uint64_t index, off_t offset);
+static void _expand_member(TemplatePlugin * template, GtkTreeIter * iter,
+		TemplateMember * member);
+static void _expand_value(TemplatePlugin * template, GtkTreeIter * iter,
+		uint32_t desc, off_t offset, off_t size, uint64_t value);
+
+static void _templateplugin_expand(TemplatePlugin * template,
+		GtkTreeIter * iter, TemplateNode * node)
+{
+	GArray * members;
+	size_t i;
+	GtkTreeIter child;
+
+	if(node->array != NULL)
+	{
+		_expand_array(template, iter, node);
+		return;
+	}
+	/* decode this very structure, and nothing below */
+	members = g_array_new(FALSE, FALSE, sizeof(TemplateMember));
+	if(_templateplugin_run(template, TEMPLATE_DESC_STRUCT(node->desc),
+				node->offset, members, NULL) != 0)
+	{
+		gtk_tree_store_append(template->store, &child, iter);
+		gtk_tree_store_set(template->store, &child, TPC_VALUE,
+				error_get(NULL), -1);
+	}
+	for(i = 0; i < members->len; i++)
+		_expand_member(template, iter, &g_array_index(members,
+					TemplateMember, i));
+	g_array_free(members, TRUE);
+}
+
+static void _expand_array(TemplatePlugin * template, GtkTreeIter * iter,
+		TemplateNode * node)
+{
+	TemplateArray * array = node->array;
+	TemplateNode * n;
+	uint64_t group;
+	uint64_t i;
+	off_t offset;
+	char buf[64];
+
+	if(node->count != UINT64_MAX && node->count > TEMPLATE_GROUP)
+	{
+		/* nested ranges, at most TEMPLATE_GROUP at a time */
+		for(group = TEMPLATE_GROUP; node->count / group
+				> TEMPLATE_GROUP; group *= TEMPLATE_GROUP);
+		for(i = 0; i < node->count; i += group)
+		{
+			if((n = g_malloc0(sizeof(*n))) == NULL)
+				return;
+			n->array = array;
+			n->first = node->first + i;
+			n->count = MIN(group, node->count - i);
+			snprintf(buf, sizeof(buf), "[%llu..%llu]",
+					(unsigned long long)n->first,
+					(unsigned long long)(n->first
+						+ n->count - 1));
+			_templateplugin_append(template, iter, buf,
+					(array->stride > 0) ? array->offset
+					+ (off_t)n->first * array->stride : -1,
+					n);
+		}
+		return;
+	}
+	for(i = 0; i < MIN(node->count, TEMPLATE_GROUP); i++)
+	{
+		if(_templateplugin_array_offset(template, array, node->first
+					+ i, &offset) != 0)
+			return;
+		_expand_element(template, iter, array, node->first + i,
+				offset);
+	}
+	/* up to the end of the file: carry on below */
+	if(node->count == UINT64_MAX && _templateplugin_array_offset(template,
+				array, node->first + i, &offset) == 0)
+	{
+		if((n = g_malloc0(sizeof(*n))) == NULL)
+			return;
+		n->array = array;
+		n->first = node->first + i;
+		n->count = UINT64_MAX;
+		snprintf(buf, sizeof(buf), "[%llu...]",
+				(unsigned long long)n->first);
+		_templateplugin_append(template, iter, buf, offset, n);
+	}
+}
+
+static TemplateArray * _expand_array_new(TemplatePlugin * template,
+		TemplateMember * member)
+{
+	TemplateArray * array;
+	off_t stride = 0;
+
+	if(TEMPLATE_DESC_TYPE(member->desc) != TT_STRUCT)
+		stride = _template_types[TEMPLATE_DESC_TYPE(member->desc)].size;
+	else if(template->template->structs[TEMPLATE_DESC_STRUCT(
+				member->desc)].size > 0)
+		stride = template->template->structs[TEMPLATE_DESC_STRUCT(
+				member->desc)].size;
+	if((array = g_malloc0(sizeof(*array))) == NULL)
+		return NULL;
+	if((array->marks = malloc(sizeof(*array->marks))) == NULL)
+	{
+		g_free(array);
+		return NULL;
+	}
+	array->desc = member->desc;
+	array->offset = member->offset;
+	array->count = member->count;
+	array->stride = stride;
+	array->marks[0] = member->offset;
+	array->marks_cnt = 1;
+	/* elements of constant size are counted right away */
+	if(stride > 0 && array->count == UINT64_MAX)
+		array->count = (_templateplugin_get_size(template)
+				> array->offset) ? (_templateplugin_get_size(
+						template) - array->offset)
+			/ stride : 0;
+	g_ptr_array_add(template->arrays, array);
+	return array;
+}
+
+static void _expand_element(TemplatePlugin * template, GtkTreeIter * iter,
+		TemplateArray * array, uint64_t index, off_t offset)
+{
+	char buf[32];
+	TemplateNode * node = NULL;
+	GtkTreeIter child;
+	GtkTreeModel * model = GTK_TREE_MODEL(template->store);
+	off_t size;
+
+	snprintf(buf, sizeof(buf), "[%llu]", (unsigned long long)index);
+	if(TEMPLATE_DESC_TYPE(array->desc) == TT_STRUCT)
+	{
+		if((node = g_malloc0(sizeof(*node))) == NULL)
+			return;
+		node->desc = array->desc;
+		node->offset = offset;
+	}
+	_templateplugin_append(template, iter, buf, offset, node);
+	if(node != NULL)
+		return;
+	size = _template_types[TEMPLATE_DESC_TYPE(array->desc)].size;
+	gtk_tree_model_iter_nth_child(model, &child, iter,
+			gtk_tree_model_iter_n_children(model, iter) - 1);
+	_expand_value(template, &child, array->desc, offset, size, 0);
+}
+
+static void _expand_member(TemplatePlugin * template, GtkTreeIter * iter,
+		TemplateMember * member)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(template->store);
+	char const * name = &template->template->strings[member->name];
+	TemplateType type = TEMPLATE_DESC_TYPE(member->desc);
+	TemplateNode * node = NULL;
+	GtkTreeIter child;
+	char buf[80];
+
+	if(member->array && type != TT_CHAR && type != TT_BYTES)
+	{
+		if((node = g_malloc0(sizeof(*node))) == NULL)
+			return;
+		if((node->array = _expand_array_new(template, member)) == NULL)
+		{
+			g_free(node);
+			return;
+		}
+		node->count = node->array->count;
+		if(node->count == UINT64_MAX)
+			snprintf(buf, sizeof(buf), "%s[]", name);
+		else
+			snprintf(buf, sizeof(buf), "%s[%llu]", name,
+					(unsigned long long)node->count);
+		_templateplugin_append(template, iter, buf, member->offset,
+				node);
+		return;
+	}
+	if(type == TT_STRUCT)
+	{
+		if((node = g_malloc0(sizeof(*node))) == NULL)
+			return;
+		node->desc = member->desc;
+		node->offset = member->offset;
+	}
+	_templateplugin_append(template, iter, name, member->offset, node);
+	if(node != NULL)
+		return;
+	/* highlighted in the view as well */
+	if(member->size > 0 && template->helper->annotate != NULL)
+		template->helper->annotate(template->helper->hexeditor,
+				HEPA_FIELD, member->offset, member->size, name);
+	gtk_tree_model_iter_nth_child(model, &child, iter,
+			gtk_tree_model_iter_n_children(model, iter) - 1);
+	_expand_value(template, &child, member->desc, member->offset,
+			(type == TT_CHAR || type == TT_BYTES) ? member->size
+			: -1, member->value);
+}
+
+static void _expand_value(TemplatePlugin * template, GtkTreeIter * iter,
+		uint32_t desc, off_t offset, off_t size, uint64_t value)
+{
+	TemplateType type = TEMPLATE_DESC_TYPE(desc);
+	unsigned char data[TEMPLATE_PREVIEW * 4];
+	char buf[TEMPLATE_PREVIEW * 4 * 4 + 8];
+	size_t pos = 0;
+	ssize_t res;
+	ssize_t i;
+	off_t count;
+	int64_t s;
+
+	if(type == TT_CHAR || type == TT_BYTES)
+	{
+		/* a preview of the contents */
+		count = (size < 0) ? (off_t)sizeof(data) : MIN(size,
+				(off_t)((type == TT_CHAR) ? sizeof(data)
+					: TEMPLATE_PREVIEW));
+		if((res = _templateplugin_fetch(template, offset, data, count))
+				< 0)
+			res = 0;
+		if(type == TT_CHAR)
+			buf[pos++] = '"';
+		for(i = 0; i < res && pos + 5 < sizeof(buf) - 4; i++)
+			if(type == TT_BYTES)
+				pos += snprintf(&buf[pos], sizeof(buf) - pos,
+						"%s%02x", (i > 0) ? " " : "",
+						data[i]);
+			else if(data[i] == '\0')
+				break;
+			else if(isprint(data[i]) && data[i] != '"'
+					&& data[i] != '\\')
+				buf[pos++] = data[i];
+			else
+				pos += snprintf(&buf[pos], sizeof(buf) - pos,
+						"\\x%02x", data[i]);
+		if(type == TT_CHAR)
+			buf[pos++] = '"';
+		buf[pos] = '\0';
+		if(size < 0 || res < size)
+			snprintf(&buf[pos], sizeof(buf) - pos, "%s", "...");
+		gtk_tree_store_set(template->store, iter, TPC_VALUE, buf, -1);
+		return;
+	}
+	if(size > 0)
+	{
+		/* an element: not decoded yet */
+		if((res = _templateplugin_fetch(template, offset, data, size))
+				!= size)
+		{
+			gtk_tree_store_set(template->store, iter, TPC_VALUE,
+					error_get(NULL), -1);
+			return;
+		}
+		for(value = 0, i = 0; i < res; i++)
+			value |= (uint64_t)data[(TEMPLATE_DESC_FLAGS(desc)
+						& TEMPLATE_BIG_ENDIAN)
+					? res - i - 1 : i] << (i * 8);
+		if((TEMPLATE_DESC_FLAGS(desc) & TEMPLATE_SIGNED) && size < 8
+				&& (value >> (size * 8 - 1)) & 1)
+			value |= ~(uint64_t)0 << (size * 8);
+	}
+	if(TEMPLATE_DESC_FLAGS(desc) & TEMPLATE_SIGNED)
+	{
+		s = (int64_t)value;
+		snprintf(buf, sizeof(buf), "%lld", (long long)s);
+	}
+	else
+		snprintf(buf, sizeof(buf), "%llu (0x%llx)",
+				(unsigned long long)value,
+				(unsigned long long)value);
+	gtk_tree_store_set(template->store, iter, TPC_VALUE, buf, -1);
+}
+
+
+/* templateplugin_fetch */
+static ssize_t _templateplugin_fetch(TemplatePlugin * template, off_t offset,
+		void * buf, size_t size)
+{
+	ssize_t res;
+
+	if(template->helper->read == NULL)
+		return -error_set_code(1, "%s", strerror(ENOTSUP));
+	if((res = template->helper->read(template->helper->hexeditor, offset,
+					buf, size)) >= 0 && (size_t)res < size)
+		error_set_code(1, "%s", _("End of file"));
+	return res;
+}
+
+
+/* templateplugin_get_size */
+static off_t _templateplugin_get_size(TemplatePlugin * template)
+{
+	if(template->helper->get_size == NULL)
+		return -error_set_code(1, "%s", strerror(ENOTSUP));
+	return template->helper->get_size(template->helper->hexeditor);
+}
+
+
+/* templateplugin_refresh */
+static void _templateplugin_refresh(TemplatePlugin * template)
+{
+	TemplateNode * node;
+	GtkTreeIter iter;
+	GtkTreePath * path;
+
+	_templateplugin_reset(template);
+	if(template->template == NULL || template->open == FALSE
+			|| template->template->structs_cnt == 0)
+		return;
+	template->size = _templateplugin_get_size(template);
+	/* the last structure declared describes the whole file */
+	if((node = g_malloc0(sizeof(*node))) == NULL)
+		return;
+	node->desc = TEMPLATE_DESC(TT_STRUCT, 0,
+			template->template->structs_cnt - 1);
+	node->offset = 0;
+	_templateplugin_append(template, NULL, template->template->name, 0,
+			node);
+	if(gtk_tree_model_get_iter_first(GTK_TREE_MODEL(template->store),
+				&iter) != TRUE)
+		return;
+	/* the members of the file are annotated even when not displayed */
+	if(template->view == NULL)
+	{
+		_templateplugin_on_test_expand_row(NULL, &iter, NULL,
+				template);
+		return;
+	}
+	path = gtk_tree_model_get_path(GTK_TREE_MODEL(template->store), &iter);
+	gtk_tree_view_expand_row(GTK_TREE_VIEW(template->view), path, FALSE);
+	gtk_tree_path_free(path);
+}
+
+
+/* templateplugin_reset */
+static void _templateplugin_reset(TemplatePlugin * template)
+{
+	TemplateArray * array;
+	size_t i;
+
+	gtk_tree_store_clear(template->store);
+	g_ptr_array_set_size(template->nodes, 0);
+	for(i = 0; i < template->arrays->len; i++)
+	{
+		array = g_ptr_array_index(template->arrays, i);
+		free(array->marks);
+		g_free(array);
+	}
+	g_ptr_array_set_size(template->arrays, 0);
+	template->size = -1;
+	if(template->helper->annotate_clear != NULL)
+		template->helper->annotate_clear(template->helper->hexeditor,
+				HEPA_FIELD);
+}
+
+
+/* templateplugin_run */
+static int _run_field(TemplatePlugin * template, uint32_t desc, off_t offset,
+		uint64_t * value);
+static int _run_resolve(TemplatePlugin * template, TemplateMember * member);
+
+static int _templateplugin_run(TemplatePlugin * template, uint32_t sidx,
+		off_t offset, GArray * members, off_t * size)
+{
+	Template * t = template->template;
+	uint32_t const * code = t->code;
+	uint32_t pc = t->structs[sidx].code;
+	uint64_t stack[TEMPLATE_STACK];
+	size_t sp = 0;
+	uint64_t slots[TEMPLATE_SLOTS];
+	TemplateMember member;
+	/* the end of a member of variable size is only known on demand */
+	TemplateMember pending;
+	gboolean unresolved = FALSE;
+	off_t cursor = offset;
+	uint32_t op;
+	off_t s;
+
+	/* the fields of the branches not taken read as zero */
+	memset(slots, 0, sizeof(slots));
+	for(;;)
+	{
+		op = code[pc++];
+		if((op == TO_FIELD || op == TO_ARRAY
+					|| (op == TO_END && members == NULL))
+				&& unresolved)
+		{
+			if(_run_resolve(template, &pending) != 0)
+				return -1;
+			cursor = pending.offset + pending.size;
+			unresolved = FALSE;
+		}
+		switch(op)
+		{
+			case TO_END:
+				if(size != NULL)
+					*size = unresolved ? -1
+						: cursor - offset;
+				return 0;
+			case TO_PUSH:
+				if(sp == TEMPLATE_STACK)
+					return -error_set_code(1, "%s",
+							_("Stack overflow"));
+				stack[sp++] = code[pc] | ((uint64_t)code[pc + 1]
+						<< 32);
+				pc += 2;
+				break;
+			case TO_LOAD:
+				if(sp == TEMPLATE_STACK)
+					return -error_set_code(1, "%s",
+							_("Stack overflow"));
+				stack[sp++] = slots[code[pc++]];
+				break;
+			case TO_JZ:
+				pc = (stack[--sp] == 0) ? code[pc] : pc + 1;
+				break;
+			case TO_JMP:
+				pc = code[pc];
+				break;
+			case TO_FIELD:
+			case TO_ARRAY:
+				memset(&member, 0, sizeof(member));
+				member.desc = code[pc++];
+				member.name = code[pc++];
+				member.array = (op == TO_ARRAY) ? TRUE : FALSE;
+				if(TEMPLATE_DESC_FLAGS(member.desc)
+						& TEMPLATE_AT)
+					member.offset = stack[--sp];
+				else
+					member.offset = cursor;
+				if(!member.array)
+					member.count = 1;
+				else if(TEMPLATE_DESC_FLAGS(member.desc)
+						& TEMPLATE_UNBOUNDED)
+					member.count = UINT64_MAX;
+				else
+					member.count = stack[--sp];
+				if(op == TO_FIELD && TEMPLATE_DESC_TYPE(
+							member.desc)
+						!= TT_STRUCT)
+				{
+					if(_run_field(template, member.desc,
+								member.offset,
+								&member.value)
+							!= 0)
+						return -1;
+					slots[code[pc]] = member.value;
+				}
+				if(op == TO_FIELD)
+					pc++;
+				/* the size, if known without decoding */
+				member.size = -1;
+				if(TEMPLATE_DESC_TYPE(member.desc) != TT_STRUCT)
+					s = _template_types[TEMPLATE_DESC_TYPE(
+							member.desc)].size;
+				else
+					s = t->structs[TEMPLATE_DESC_STRUCT(
+							member.desc)].size;
+				if(s > 0 && member.count != UINT64_MAX
+						&& member.count <= (uint64_t)
+						INT64_MAX / s)
+					member.size = s * member.count;
+				else if(s == 1 && member.count == UINT64_MAX)
+					member.size = (_templateplugin_get_size(
+								template)
+							> member.offset)
+						? _templateplugin_get_size(
+								template)
+						- member.offset : 0;
+				if(members != NULL)
+					g_array_append_val(members, member);
+				if(TEMPLATE_DESC_FLAGS(member.desc)
+						& TEMPLATE_AT)
+					break;
+				if(member.size >= 0)
+					cursor = member.offset + member.size;
+				else
+				{
+					pending = member;
+					unresolved = TRUE;
+				}
+				break;
+			case TO_NEG:
+			case TO_NOT:
+			case TO_BNOT:
+				stack[sp - 1] = _template_apply(op,
+						stack[sp - 1], 0);
+				break;
+			default:
+				sp--;
+				stack[sp - 1] = _template_apply(op,
+						stack[sp - 1], stack[sp]);
+				break;
+		}
+	}
+}
+
+static int _run_field(TemplatePlugin * template, uint32_t desc, off_t offset,
+		uint64_t * value)
+{
+	unsigned char buf[8];
+	size_t size = _template_types[TEMPLATE_DESC_TYPE(desc)].size;
+	uint64_t v = 0;
+	size_t i;
+
+	if(_templateplugin_fetch(template, offset, buf, size) != (ssize_t)size)
+		return -1;
+	for(i = 0; i < size; i++)
+		v |= (uint64_t)buf[(TEMPLATE_DESC_FLAGS(desc)
+					& TEMPLATE_BIG_ENDIAN) ? size - i - 1
+				: i] << (i * 8);
+	if((TEMPLATE_DESC_FLAGS(desc) & TEMPLATE_SIGNED) && size < 8
+			&& (v >> (size * 8 - 1)) & 1)
+		v |= ~(uint64_t)0 << (size * 8);
+	*value = v;
+	return 0;
+}
+
+static int _run_resolve(TemplatePlugin * template, TemplateMember * member)
+{
+	off_t pos = member->offset;
+	off_t size;
+	uint64_t i;
+
+	/* walk over every element */
+	for(i = 0; i < member->count; i++, pos += size)
+	{
+		if(member->count == UINT64_MAX
+				&& pos >= _templateplugin_get_size(template))
+			break;
+		if(_templateplugin_sizeof(template, member->desc, pos, &size)
+				!= 0)
+			return -1;
+	}
+	member->size = pos - member->offset;
+	return 0;
+}
+
+
+/* templateplugin_select */
+static void _templateplugin_select(TemplatePlugin * template,
+		GtkTreeIter * iter)
+{
+	GtkTreeModel * model = GTK_TREE_MODEL(template->templates);
+	gchar * name;
+	char const * source;
+	gchar * filename;
+	Template * t;
+
+	gtk_tree_model_get(model, iter, TPTC_NAME, &name,
+			TPTC_SOURCE, &source, TPTC_FILENAME, &filename,
+			TPTC_TEMPLATE, &t, -1);
+	/* kept by the instance once obtained */
+	if(t == NULL && (t = _template_get(name, source, filename)) != NULL)
+		gtk_list_store_set(template->templates, iter, TPTC_TEMPLATE,
+				t, -1);
+	else if(t == NULL)
+		template->helper->error(template->helper->hexeditor,
+				error_get(NULL), 1);
+	g_free(filename);
+	g_free(name);
+	_templateplugin_reset(template);
+	template->template = t;
+	_templateplugin_refresh(template);
+}
+
+
+/* templateplugin_sizeof */
+static int _templateplugin_sizeof(TemplatePlugin * template, uint32_t desc,
+		off_t offset, off_t * size)
+{
+	TemplateStruct * s;
+
+	if(TEMPLATE_DESC_TYPE(desc) != TT_STRUCT)
+	{
+		*size = _template_types[TEMPLATE_DESC_TYPE(desc)].size;
+		return 0;
+	}
+	s = &template->template->structs[TEMPLATE_DESC_STRUCT(desc)];
+	if(s->size >= 0)
+	{
+		*size = s->size;
+		return 0;
+	}
+	if(_templateplugin_run(template, TEMPLATE_DESC_STRUCT(desc), offset,
+				NULL, size) != 0)
+		return -1;
+	/* empty elements would never end */
+	if(*size <= 0)
+		return -error_set_code(1, "%s", _("Empty element"));
+	return 0;
+}
+
+
+/* templates */
+/* template_compile */
+static int _compile_accept(TemplateCompiler * c, char const * token);
+static int _compile_emit(TemplateCompiler * c, uint32_t code);
+static int _compile_error(TemplateCompiler * c, char const * message);
+static int _compile_expect(TemplateCompiler * c, char const * token);
+static int _compile_expr(TemplateCompiler * c, int precedence,
+		gboolean * constant);
+static int _compile_ident(TemplateCompiler * c, char * buf, size_t size);
+static int _compile_member(TemplateCompiler * c);
+static int _compile_push(TemplateCompiler * c, uint64_t value);
+static void _compile_skip(TemplateCompiler * c);
+static int _compile_string(TemplateCompiler * c, char const * string,
+		uint32_t * offset);
+static int _compile_struct(TemplateCompiler * c);
+static int _compile_type(TemplateCompiler * c, char const * name,
+		uint32_t * desc, off_t * size);
+
+static Template * _template_compile(char const * name, char const * source)
+{
+	TemplateCompiler c;
+	char buf[32];
+	int res = 0;
+
+	memset(&c, 0, sizeof(c));
+	c.filename = name;
+	c.p = source;
+	c.line = 1;
+	if((c.template = object_new(sizeof(*c.template))) == NULL)
+		return NULL;
+	memset(c.template, 0, sizeof(*c.template));
+	c.template->refcnt = 1;
+	if((c.template->name = string_new(name)) == NULL)
+	{
+		_template_delete(c.template);
+		return NULL;
+	}
+	for(_compile_skip(&c); *c.p != '\0' && res == 0; _compile_skip(&c))
+	{
+		if((res = _compile_ident(&c, buf, sizeof(buf))) != 0)
+			break;
+		if(strcmp(buf, "endian") == 0)
+		{
+			if((res = _compile_ident(&c, buf, sizeof(buf))) != 0)
+				break;
+			if(strcmp(buf, "little") == 0)
+				c.endian = 0;
+			else if(strcmp(buf, "big") == 0)
+				c.endian = TEMPLATE_BIG_ENDIAN;
+			else
+				res = _compile_error(&c,
+						_("Unknown endianness"));
+			if(res == 0)
+				res = _compile_expect(&c, ";");
+		}
+		else if(strcmp(buf, "struct") == 0)
+			res = _compile_struct(&c);
+		else
+			res = _compile_error(&c, _("Expected a structure"));
+	}
+	if(res != 0)
+	{
+		_template_delete(c.template);
+		return NULL;
+	}
+	if(c.template->structs_cnt == 0)
+	{
+		_compile_error(&c, _("No structure defined"));
+		_template_delete(c.template);
+		return NULL;
+	}
+	return c.template;
+}
+
+static int _compile_accept(TemplateCompiler * c, char const * token)
+{
+	size_t len = strlen(token);
+
+	_compile_skip(c);
+	if(strncmp(c->p, token, len) != 0)
+		return 0;
+	/* keywords are whole words */
+	if((isalpha((unsigned char)token[0]))
+			&& (isalnum((unsigned char)c->p[len])
+				|| c->p[len] == '_'))
+		return 0;
+	c->p += len;
+	return 1;
+}
+
+static int _compile_emit(TemplateCompiler * c, uint32_t code)
+{
+	Template * t = c->template;
+	uint32_t * p;
+
+	if((t->code_cnt & 0xff) == 0)
+	{
+		if((p = realloc(t->code, sizeof(*p) * (t->code_cnt + 0x100)))
+				== NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+		t->code = p;
+	}
+	t->code[t->code_cnt++] = code;
+	return 0;
+}
+
+static int _compile_error(TemplateCompiler * c, char const * message)
+{
+	return -error_set_code(1, "%s:%u: %s", c->filename, c->line, message);
+}
+
+static int _compile_expect(TemplateCompiler * c, char const * token)
+{
+	char buf[32];
+
+	if(_compile_accept(c, token))
+		return 0;
+	snprintf(buf, sizeof(buf), _("Expected \"%s\""), token);
+	return _compile_error(c, buf);
+}
+
+static int _compile_expr(TemplateCompiler * c, int precedence,
+		gboolean * constant)
+{
+	static const struct
+	{
+		char const * token;
+		TemplateOpcode op;
+		int precedence;
+	} binary[] =
+	{
+		/* the longest tokens first */
+		{ "||",	TO_LOR,		1 },
+		{ "&&",	TO_LAND,	2 },
+		{ "==",	TO_EQ,		6 },
+		{ "!=",	TO_NE,		6 },
+		{ "<=",	TO_LE,		7 },
+		{ ">=",	TO_GE,		7 },
+		{ "<<",	TO_SHL,		8 },
+		{ ">>",	TO_SHR,		8 },
+		{ "|",	TO_OR,		3 },
+		{ "^",	TO_XOR,		4 },
+		{ "&",	TO_AND,		5 },
+		{ "<",	TO_LT,		7 },
+		{ ">",	TO_GT,		7 },
+		{ "+",	TO_ADD,		9 },
+		{ "-",	TO_SUB,		9 },
+		{ "*",	TO_MUL,		10 },
+		{ "/",	TO_DIV,		10 },
+		{ "%",	TO_MOD,		10 }
+	};
+	Template * t = c->template;
+	size_t start = t->code_cnt;
+	size_t middle;
+	gboolean right;
+	TemplateOpcode op;
+	uint64_t a;
+	uint64_t b;
+	char buf[32];
+	char * q;
+	size_t i;
+	uint32_t j;
+
+	/* the operand */
+	_compile_skip(c);
+	op = TO_END;
+	if(_compile_accept(c, "-"))
+		op = TO_NEG;
+	else if(_compile_accept(c, "!"))
+		op = TO_NOT;
+	else if(_compile_accept(c, "~"))
+		op = TO_BNOT;
+	if(op != TO_END)
+	{
+		if(_compile_expr(c, 11, constant) != 0
+				|| _compile_emit(c, op) != 0)
+			return -1;
+		if(*constant)
+		{
+			a = t->code[start + 1] | ((uint64_t)t->code[start + 2]
+					<< 32);
+			t->code_cnt = start;
+			if(_compile_push(c, _template_apply(op, a, 0)) != 0)
+				return -1;
+		}
+	}
+	else if(_compile_accept(c, "("))
+	{
+		if(_compile_expr(c, 0, constant) != 0
+				|| _compile_expect(c, ")") != 0)
+			return -1;
+	}
+	else if(isdigit((unsigned char)*c->p))
+	{
+		errno = 0;
+		a = strtoull(c->p, &q, 0);
+		if(errno != 0 || isalnum((unsigned char)*q))
+			return _compile_error(c, _("Invalid number"));
+		c->p = q;
+		if(_compile_push(c, a) != 0)
+			return -1;
+		*constant = TRUE;
+	}
+	else
+	{
+		/* a field of the current structure */
+		if(_compile_ident(c, buf, sizeof(buf)) != 0)
+			return -1;
+		for(j = c->fields_cnt; j > 0; j--)
+			if(strcmp(&t->strings[c->fields[j - 1]], buf) == 0)
+				break;
+		if(j == 0)
+			return _compile_error(c, _("Unknown field"));
+		if(_compile_emit(c, TO_LOAD) != 0
+				|| _compile_emit(c, j - 1) != 0)
+			return -1;
+		*constant = FALSE;
+	}
+	/* the operators, by precedence */
+	for(;;)
+	{
+		_compile_skip(c);
+		for(i = 0; i < sizeof(binary) / sizeof(*binary); i++)
+			if(strncmp(c->p, binary[i].token,
+						strlen(binary[i].token)) == 0)
+				break;
+		if(i == sizeof(binary) / sizeof(*binary)
+				|| binary[i].precedence <= precedence)
+			return 0;
+		c->p += strlen(binary[i].token);
+		middle = t->code_cnt;
+		if(_compile_expr(c, binary[i].precedence, &right) != 0
+				|| _compile_emit(c, binary[i].op) != 0)
+			return -1;
+		if(*constant && right)
+		{
+			/* folded right away */
+			a = t->code[start + 1] | ((uint64_t)t->code[start + 2]
+					<< 32);
+			b = t->code[middle + 1] | ((uint64_t)t->code[middle
+					+ 2] << 32);
+			t->code_cnt = start;
+			if(_compile_push(c, _template_apply(binary[i].op, a,
+							b)) != 0)
+				return -1;
+		}
+		else
+			*constant = FALSE;
+	}
+}
+
+static int _compile_ident(TemplateCompiler * c, char * buf, size_t size)
+{
+	size_t i;
+
+	_compile_skip(c);
+	if(!isalpha((unsigned char)*c->p) && *c->p != '_')
+		return _compile_error(c, _("Expected an identifier"));
+	for(i = 0; isalnum((unsigned char)c->p[i]) || c->p[i] == '_'; i++)
+		if(i + 1 == size)
+			return _compile_error(c, _("Identifier too long"));
+		else
+			buf[i] = c->p[i];
+	buf[i] = '\0';
+	c->p += i;
+	return 0;
+}
+
+static int _compile_member(TemplateCompiler * c)
+{
+	Template * t = c->template;
+	char type[32];
+	char buf[32];
+	uint32_t desc;
+	uint32_t name;
+	off_t size;
+	size_t start;
+	size_t jump;
+	gboolean constant = FALSE;
+	gboolean at;
+	gboolean array = FALSE;
+	uint64_t count = 1;
+
+	if(_compile_accept(c, "{"))
+	{
+		while(!_compile_accept(c, "}"))
+			if(_compile_member(c) != 0)
+				return -1;
+		return 0;
+	}
+	if(_compile_accept(c, "if"))
+	{
+		/* the layout is no longer constant */
+		c->size = -1;
+		if(_compile_expect(c, "(") != 0
+				|| _compile_expr(c, 0, &constant) != 0
+				|| _compile_expect(c, ")") != 0
+				|| _compile_emit(c, TO_JZ) != 0
+				|| _compile_emit(c, 0) != 0)
+			return -1;
+		jump = t->code_cnt - 1;
+		if(_compile_member(c) != 0)
+			return -1;
+		if(_compile_accept(c, "else"))
+		{
+			if(_compile_emit(c, TO_JMP) != 0
+					|| _compile_emit(c, 0) != 0)
+				return -1;
+			t->code[jump] = t->code_cnt;
+			jump = t->code_cnt - 1;
+			if(_compile_member(c) != 0)
+				return -1;
+		}
+		t->code[jump] = t->code_cnt;
+		return 0;
+	}
+	if(_compile_accept(c, "endian"))
+	{
+		if(_compile_ident(c, buf, sizeof(buf)) != 0)
+			return -1;
+		if(strcmp(buf, "little") == 0)
+			c->endian = 0;
+		else if(strcmp(buf, "big") == 0)
+			c->endian = TEMPLATE_BIG_ENDIAN;
+		else
+			return _compile_error(c, _("Unknown endianness"));
+		return _compile_expect(c, ";");
+	}
+	/* a field */
+	if(_compile_ident(c, type, sizeof(type)) != 0
+			|| _compile_type(c, type, &desc, &size) != 0
+			|| _compile_ident(c, buf, sizeof(buf)) != 0
+			|| _compile_string(c, buf, &name) != 0)
+		return -1;
+	if(_compile_accept(c, "["))
+	{
+		array = TRUE;
+		if(_compile_accept(c, "]"))
+			desc |= TEMPLATE_DESC(0, TEMPLATE_UNBOUNDED, 0);
+		else
+		{
+			start = t->code_cnt;
+			if(_compile_expr(c, 0, &constant) != 0
+					|| _compile_expect(c, "]") != 0)
+				return -1;
+			if(constant)
+				count = t->code[start + 1]
+					| ((uint64_t)t->code[start + 2] << 32);
+		}
+	}
+	else
+		constant = TRUE;
+	if(_compile_accept(c, "@"))
+		desc |= TEMPLATE_DESC(0, TEMPLATE_AT, 0);
+	if((TEMPLATE_DESC_FLAGS(desc) & TEMPLATE_AT)
+			&& _compile_expr(c, 0, &at) != 0)
+		return -1;
+	if(_compile_expect(c, ";") != 0)
+		return -1;
+	/* the size of the structure, if still known */
+	if(TEMPLATE_DESC_FLAGS(desc) & TEMPLATE_AT)
+		;
+	else if(!constant || size < 0
+			|| (TEMPLATE_DESC_FLAGS(desc) & TEMPLATE_UNBOUNDED)
+			|| count > (uint64_t)INT64_MAX / (size > 0 ? size : 1))
+		c->size = -1;
+	else if(c->size >= 0)
+		c->size += size * count;
+	if(array)
+		return (_compile_emit(c, TO_ARRAY) != 0
+				|| _compile_emit(c, desc) != 0
+				|| _compile_emit(c, name) != 0) ? -1 : 0;
+	if(TEMPLATE_DESC_TYPE(desc) != TT_STRUCT)
+	{
+		if(c->fields_cnt == TEMPLATE_SLOTS)
+			return _compile_error(c, _("Too many fields"));
+		c->fields[c->fields_cnt] = name;
+	}
+	if(_compile_emit(c, TO_FIELD) != 0 || _compile_emit(c, desc) != 0
+			|| _compile_emit(c, name) != 0
+			|| _compile_emit(c, c->fields_cnt) != 0)
+		return -1;
+	if(TEMPLATE_DESC_TYPE(desc) != TT_STRUCT)
+		c->fields_cnt++;
+	return 0;
+}
+
+static int _compile_push(TemplateCompiler * c, uint64_t value)
+{
+	if(_compile_emit(c, TO_PUSH) != 0
+			|| _compile_emit(c, value & 0xffffffff) != 0
+			|| _compile_emit(c, value >> 32) != 0)
+		return -1;
+	return 0;
+}
+
+static void _compile_skip(TemplateCompiler * c)
+{
+	for(;;)
+		if(*c->p == '\n')
+		{
+			c->line++;
+			c->p++;
+		}
+		else if(isspace((unsigned char)*c->p))
+			c->p++;
+		else if(*c->p == '#' || (c->p[0] == '/' && c->p[1] == '/'))
+			for(; *c->p != '\0' && *c->p != '\n'; c->p++);
+		else if(c->p[0] == '/' && c->p[1] == '*')
+		{
+			for(c->p += 2; *c->p != '\0' && (c->p[0] != '*'
+						|| c->p[1] != '/'); c->p++)
+				if(*c->p == '\n')
+					c->line++;
+			if(*c->p != '\0')
+				c->p += 2;
+		}
+		else
+			break;
+}
+
+static int _compile_string(TemplateCompiler * c, char const * string,
+		uint32_t * offset)
+{
+	Template * t = c->template;
+	size_t len = strlen(string) + 1;
+	char * p;
+
+	if((p = realloc(t->strings, t->strings_size + len)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	t->strings = p;
+	memcpy(&t->strings[t->strings_size], string, len);
+	*offset = t->strings_size;
+	t->strings_size += len;
+	return 0;
+}
+
+static int _compile_struct(TemplateCompiler * c)
+{
+	Template * t = c->template;
+	TemplateStruct * p;
+	TemplateStruct s;
+	char buf[32];
+	unsigned int endian = c->endian;
+
+	if(_compile_ident(c, buf, sizeof(buf)) != 0
+			|| _compile_string(c, buf, &s.name) != 0
+			|| _compile_expect(c, "{") != 0)
+		return -1;
+	s.code = t->code_cnt;
+	c->fields_cnt = 0;
+	c->size = 0;
+	while(!_compile_accept(c, "}"))
+		if(*c->p == '\0')
+			return _compile_expect(c, "}");
+		else if(_compile_member(c) != 0)
+			return -1;
+	_compile_accept(c, ";");
+	/* the endianness only changes within the structure */
+	c->endian = endian;
+	if(_compile_emit(c, TO_END) != 0)
+		return -1;
+	s.size = c->size;
+	/* only declared once complete: no recursion */
+	if((p = realloc(t->structs, sizeof(*p) * (t->structs_cnt + 1)))
+			== NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	t->structs = p;
+	t->structs[t->structs_cnt++] = s;
+	return 0;
+}
+
+static int _compile_type(TemplateCompiler * c, char const * name,
+		uint32_t * desc, off_t * size)
+{
+	Template * t = c->template;
+	size_t i;
+	size_t len;
+	unsigned int flags;
+
+	for(i = 0; i < sizeof(_template_types) / sizeof(*_template_types);
+			i++)
+	{
+		len = strlen(_template_types[i].name);
+		if(strncmp(name, _template_types[i].name, len) != 0)
+			continue;
+		flags = c->endian;
+		if(strcmp(&name[len], "le") == 0)
+			flags = 0;
+		else if(strcmp(&name[len], "be") == 0)
+			flags = TEMPLATE_BIG_ENDIAN;
+		else if(name[len] != '\0')
+			continue;
+		if(name[0] == 's')
+			flags |= TEMPLATE_SIGNED;
+		*desc = TEMPLATE_DESC(_template_types[i].type, flags, 0);
+		*size = _template_types[i].size;
+		return 0;
+	}
+	for(i = 0; i < t->structs_cnt; i++)
+		if(strcmp(&t->strings[t->structs[i].name], name) == 0)
+		{
+			*desc = TEMPLATE_DESC(TT_STRUCT, 0, i);
+			*size = t->structs[i].size;
+			return 0;
+		}
+	return _compile_error(c, _("Unknown type"));
+}
+
+
+/* template_delete */
+static void _template_delete(Template * template)
+{
+	free(template->strings);
+	free(template->structs);
+	free(template->code);
+	string_delete(template->name);
+	object_delete(template);
+}
+
+
+/* template_get */
+static Template * _template_get(char const * name, char const * source,
+		char const * filename)
+{
+	Template * t;
+	char const * key = (source != NULL) ? name : filename;
+	struct stat st;
+	gchar * contents = NULL;
+	GError * error = NULL;
+
+	/* the templates of the user are compiled again once modified */
+	if(source == NULL && stat(filename, &st) != 0)
+	{
+		error_set_code(1, "%s: %s", filename, strerror(errno));
+		return NULL;
+	}
+	g_mutex_lock(&_template_mutex);
+	if(_template_cache == NULL)
+		_template_cache = g_hash_table_new_full(g_str_hash,
+				g_str_equal, g_free,
+				(GDestroyNotify)_template_unref);
+	if((t = g_hash_table_lookup(_template_cache, key)) != NULL
+			&& (source != NULL || t->mtime == st.st_mtime))
+		g_atomic_int_inc(&t->refcnt);
+	else if(source == NULL && g_file_get_contents(filename, &contents,
+				NULL, &error) != TRUE)
+	{
+		error_set_code(1, "%s", error->message);
+		g_error_free(error);
+		t = NULL;
+	}
+	else if((t = _template_compile(name, (source != NULL) ? source
+					: contents)) != NULL)
+	{
+		t->mtime = (source != NULL) ? 0 : st.st_mtime;
+		/* one reference for the cache, one for the caller */
+		g_atomic_int_inc(&t->refcnt);
+		g_hash_table_replace(_template_cache, g_strdup(key), t);
+	}
+	g_mutex_unlock(&_template_mutex);
+	g_free(contents);
+	return t;
+}
+
+
+/* template_unref */
+static void _template_unref(Template * template)
+{
+	if(g_atomic_int_dec_and_test(&template->refcnt))
+		_template_delete(template);
+}
+
+
+/* template_apply */
+static uint64_t _template_apply(TemplateOpcode op, uint64_t a, uint64_t b)
+{
+	switch(op)
+	{
+		case TO_NEG:	return -a;
+		case TO_NOT:	return !a;
+		case TO_BNOT:	return ~a;
+		case TO_MUL:	return a * b;
+		/* dividing by zero gives zero */
+		case TO_DIV:	return (b != 0) ? a / b : 0;
+		case TO_MOD:	return (b != 0) ? a % b : 0;
+		case TO_ADD:	return a + b;
+		case TO_SUB:	return a - b;
+		case TO_SHL:	return (b < 64) ? a << b : 0;
+		case TO_SHR:	return (b < 64) ? a >> b : 0;
+		case TO_LT:	return a < b;
+		case TO_LE:	return a <= b;
+		case TO_GT:	return a > b;
+		case TO_GE:	return a >= b;
+		case TO_EQ:	return a == b;
+		case TO_NE:	return a != b;
+		case TO_AND:	return a & b;
+		case TO_XOR:	return a ^ b;
+		case TO_OR:	return a | b;
+		case TO_LAND:	return a && b;
+		case TO_LOR:	return a || b;
+		default:	return 0;
+	}
+}
+
+
+/* callbacks */
+/* templateplugin_on_changed */
+static void _templateplugin_on_changed(gpointer data)
+{
+	TemplatePlugin * template = data;
+	GtkTreeIter iter;
+
+	if(gtk_combo_box_get_active_iter(GTK_COMBO_BOX(template->combo),
+				&iter) == TRUE)
+		_templateplugin_select(template, &iter);
+}
+
+
+/* templateplugin_on_test_expand_row */
+static gboolean _templateplugin_on_test_expand_row(GtkWidget * widget,
+		GtkTreeIter * iter, GtkTreePath * path, gpointer data)
+{
+	TemplatePlugin * template = data;
+	GtkTreeModel * model = GTK_TREE_MODEL(template->store);
+	TemplateNode * node;
+	GtkTreeIter child;
+	(void) widget;
+	(void) path;
+
+	gtk_tree_model_get(model, iter, TPC_NODE, &node, -1);
+	if(node == NULL || node->expanded)
+		return FALSE;
+	node->expanded = TRUE;
+	/* replace the placeholder with the contents */
+	if(gtk_tree_model_iter_children(model, &child, iter))
+		gtk_tree_store_remove(template->store, &child);
+	_templateplugin_expand(template, iter, node);
+	return FALSE;
 }
@@ -0,0 +1,406 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <sys/types.h>
+#include <sys/uio.h>
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <System.h>
+#include "process.h"
+
+#if defined(__linux__) && defined(__NR_process_vm_readv)
+# define HEXEDITORPROCESS_VM
+#endif
+
+
+/* HexEditorProcess */
+/* private */
+/* types */
+typedef struct _HexEditorProcessMapping
+{
+	off_t start;
+	off_t end;
+	int readable;
+	char * name;
+} HexEditorProcessMapping;
+
+struct _HexEditorProcess
+{
+	pid_t pid;
+	char * name;
+	HexEditorProcessMapping * mappings;
+	size_t mappings_cnt;
+	/* without process_vm_readv() */
+	int fd;
+};
+
+
+/* constants */
+/* the ranges transferred at once */
+#define HEXEDITORPROCESS_IOV	64
+
+
+/* prototypes */
+static HexEditorProcessMapping * _hexeditorprocess_find(
+		HexEditorProcess * process, off_t offset);
+static void _hexeditorprocess_free(HexEditorProcessMapping * mappings,
+		size_t count);
+static int _hexeditorprocess_transfer(HexEditorProcess * process,
+		struct iovec * local, struct iovec * remote, size_t count);
+
+
+/* public */
+/* functions */
+/* hexeditorprocess_new */
+static int _new_maps(HexEditorProcess * process);
+static void _new_name(HexEditorProcess * process);
+
+HexEditorProcess * hexeditorprocess_new(pid_t pid)
+{
+	HexEditorProcess * process;
+	char buf[32];
+
+	if((process = object_new(sizeof(*process))) == NULL)
+		return NULL;
+	process->pid = pid;
+	process->name = NULL;
+	process->mappings = NULL;
+	process->mappings_cnt = 0;
+	process->fd = -1;
+	if(_new_maps(process) != 0)
+	{
+		hexeditorprocess_delete(process);
+		return NULL;
+	}
+	_new_name(process);
+#ifndef HEXEDITORPROCESS_VM
+	/* the memory is read as a file instead */
+	snprintf(buf, sizeof(buf), "/proc/%ld/mem", (long)pid);
+	if((process->fd = open(buf, O_RDONLY)) < 0)
+	{
+		error_set_code(1, "%s: %s", buf, strerror(errno));
+		hexeditorprocess_delete(process);
+		return NULL;
+	}
+#else
+	(void) buf;
+#endif
+	return process;
+}
+
+static int _new_maps(HexEditorProcess * process)
+{
+	char path[32];
+	char line[PATH_MAX + 128];
+	FILE * fp;
+	unsigned long long start;
+	unsigned long long end;
+	char perms[5];
+	int pos;
+	char * p;
+	size_t alloc = 0;
+	HexEditorProcessMapping * m;
+
+	snprintf(path, sizeof(path), "/proc/%ld/maps", (long)process->pid);
+	if((fp = fopen(path, "r")) == NULL)
+		return -error_set_code(1, "%s: %s", path, strerror(errno));
+	while(fgets(line, sizeof(line), fp) != NULL)
+	{
+		pos = 0;
+		if(sscanf(line, "%llx-%llx %4s %*s %*s %*s %n", &start, &end,
+					perms, &pos) != 3 || pos == 0
+				|| start >= end)
+			continue;
+		/* beyond what can be addressed, like vsyscall */
+		if((off_t)end <= 0 || (unsigned long long)(off_t)end != end)
+			continue;
+		if(process->mappings_cnt == alloc)
+		{
+			alloc = (alloc > 0) ? alloc * 2 : 64;
+			if((m = realloc(process->mappings, sizeof(*m) * alloc))
+					== NULL)
+			{
+				fclose(fp);
+				return -error_set_code(1, "%s",
+						strerror(errno));
+			}
+			process->mappings = m;
+		}
+		if((p = strchr(&line[pos], '\n')) != NULL)
+			*p = '\0';
+		m = &process->mappings[process->mappings_cnt];
+		if((m->name = strdup(&line[pos])) == NULL)
+		{
+			fclose(fp);
+			return -error_set_code(1, "%s", strerror(errno));
+		}
+		m->start = start;
+		m->end = end;
+		m->readable = (perms[0] == 'r') ? 1 : 0;
+		process->mappings_cnt++;
+	}
+	if(fclose(fp) != 0)
+		return -error_set_code(1, "%s: %s", path, strerror(errno));
+	/* kernel threads have no memory of their own */
+	if(process->mappings_cnt == 0)
+		return -error_set_code(1, "%s: %s", path, strerror(ESRCH));
+	return 0;
+}
+
+static void _new_name(HexEditorProcess * process)
+{
+	char path[32];
+	char buf[256];
+	FILE * fp;
+	char * p;
+
+	snprintf(path, sizeof(path), "/proc/%ld/comm", (long)process->pid);
+	if((fp = fopen(path, "r")) == NULL)
+		return;
+	if(fgets(buf, sizeof(buf), fp) != NULL)
+	{
+		if((p = strchr(buf, '\n')) != NULL)
+			*p = '\0';
+		process->name = strdup(buf);
+	}
+	fclose(fp);
+}
+
+
+/* hexeditorprocess_delete */
+void hexeditorprocess_delete(HexEditorProcess * process)
+{
+	if(process->fd >= 0)
+		close(process->fd);
+	_hexeditorprocess_free(process->mappings, process->mappings_cnt);
+	free(process->name);
+	object_delete(process);
+}
+
+
+/* accessors */
+/* hexeditorprocess_get_mapping */
+int hexeditorprocess_get_mapping(HexEditorProcess * process, size_t index,
+		off_t * start, off_t * end, char const ** name)
+{
+	if(index >= process->mappings_cnt)
+		return -error_set_code(1, "%s", strerror(ERANGE));
+	*start = process->mappings[index].start;
+	*end = process->mappings[index].end;
+	if(name != NULL)
+		*name = process->mappings[index].name;
+	return 0;
+}
+
+
+/* hexeditorprocess_get_mappings */
+size_t hexeditorprocess_get_mappings(HexEditorProcess * process)
+{
+	return process->mappings_cnt;
+}
+
+
+/* hexeditorprocess_get_name */
+char const * hexeditorprocess_get_name(HexEditorProcess * process)
+{
+	return process->name;
+}
+
+
+/* hexeditorprocess_get_pid */
+pid_t hexeditorprocess_get_pid(HexEditorProcess * process)
+{
+	return process->pid;
+}
+
+
+/* hexeditorprocess_get_size */
+off_t hexeditorprocess_get_size(HexEditorProcess * process)
+{
+	/* up to the end of the last mapping */
+	return process->mappings[process->mappings_cnt - 1].end;
+}
+
+
+/* useful */
+/* hexeditorprocess_read */
+ssize_t hexeditorprocess_read(HexEditorProcess * process, void * buf,
+		size_t size, off_t offset)
+{
+	off_t end = hexeditorprocess_get_size(process);
+
+	if(offset < 0)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	if(offset >= end)
+		return 0;
+	if((off_t)size > end - offset)
+		size = end - offset;
+	if(hexeditorprocess_readv(process, &offset, 1, size, buf) != 0)
+		return -1;
+	return size;
+}
+
+
+/* hexeditorprocess_readv */
+int hexeditorprocess_readv(HexEditorProcess * process, off_t const * offsets,
+		size_t count, size_t size, char * buf)
+{
+	struct iovec local[HEXEDITORPROCESS_IOV];
+	struct iovec remote[HEXEDITORPROCESS_IOV];
+	size_t cnt = 0;
+	size_t i;
+	HexEditorProcessMapping * m;
+	off_t end;
+	off_t from;
+	off_t to;
+
+	/* what is neither mapped nor readable reads as zeros */
+	memset(buf, 0, count * size);
+	for(i = 0; i < count; i++)
+		for(m = _hexeditorprocess_find(process, offsets[i]),
+				end = offsets[i] + size;
+				m != NULL && m < &process->mappings[
+				process->mappings_cnt] && m->start < end; m++)
+		{
+			if(!m->readable)
+				continue;
+			from = (m->start > offsets[i]) ? m->start : offsets[i];
+			to = (m->end < end) ? m->end : end;
+			local[cnt].iov_base = &buf[i * size
+				+ (from - offsets[i])];
+			local[cnt].iov_len = to - from;
+			remote[cnt].iov_base = (void *)(uintptr_t)from;
+			remote[cnt].iov_len = to - from;
+			/* as many ranges as possible in a single call */
+			if(++cnt < HEXEDITORPROCESS_IOV)
+				continue;
+			if(_hexeditorprocess_transfer(process, local, remote,
+						cnt) != 0)
+				return -1;
+			cnt = 0;
+		}
+	if(cnt > 0 && _hexeditorprocess_transfer(process, local, remote, cnt)
+			!= 0)
+		return -1;
+	return 0;
+}
+
+
+/* hexeditorprocess_refresh */
+int hexeditorprocess_refresh(HexEditorProcess * process)
+{
+	HexEditorProcessMapping * mappings = process->mappings;
+	const size_t cnt = process->mappings_cnt;
+
+	process->mappings = NULL;
+	process->mappings_cnt = 0;
+	if(_new_maps(process) != 0)
+	{
+		_hexeditorprocess_free(process->mappings,
+				process->mappings_cnt);
+		process->mappings = mappings;
+		process->mappings_cnt = cnt;
+		return -1;
+	}
+	_hexeditorprocess_free(mappings, cnt);
+	return 0;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorprocess_find */
+static HexEditorProcessMapping * _hexeditorprocess_find(
+		HexEditorProcess * process, off_t offset)
+{
+	size_t low = 0;
+	size_t high = process->mappings_cnt;
+	size_t mid;
+
+	/* the first mapping ending after this offset */
+	while(low < high)
+	{
+		mid = low + (high - low) / 2;
+		if(process->mappings[mid].end <= offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return (low < process->mappings_cnt) ? &process->mappings[low] : NULL;
+}
+
+
+/* hexeditorprocess_free */
+static void _hexeditorprocess_free(HexEditorProcessMapping * mappings,
+		size_t count)
+{
+	size_t i;
+
+	for(i = 0; i < count; i++)
+		free(mappings[i].name);
+	free(mappings);
+}
+
+
+/* hexeditorprocess_transfer */
+static int _hexeditorprocess_transfer(HexEditorProcess * process,
+		struct iovec * local, struct iovec * remote, size_t count)
+{
+	size_t i = 0;
+	size_t last;
+	ssize_t res;
+	size_t done;
+
+	while(i < count)
+	{
+#ifdef HEXEDITORPROCESS_VM
+		last = count;
+		res = syscall(__NR_process_vm_readv, process->pid, &local[i],
+				count - i, &remote[i], count - i, 0);
+#else
+		last = i + 1;
+		if((res = pread(process->fd, local[i].iov_base,
+						local[i].iov_len,
+						(off_t)(uintptr_t)
+						remote[i].iov_base)) < 0
+				&& errno == EIO)
+			errno = EFAULT;
+#endif
+		if(res < 0 && errno == EINTR)
+			continue;
+		else if(res < 0 && errno == EFAULT)
+			/* the range is not readable after all */
+			res = 0;
+		else if(res < 0)
+			return -error_set_code(1, "%s", strerror(errno));
+		/* the transfer stops at the first range failing */
+		for(done = res; i < last && done >= local[i].iov_len; i++)
+			done -= local[i].iov_len;
+		if(i < last)
+			i++;
+	}
+	return 0;
+}
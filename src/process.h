@@ -0,0 +1,50 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_PROCESS_H
+# define HEXEDITOR_PROCESS_H
+
+# include <sys/types.h>
+
+
+/* HexEditorProcess */
+/* public */
+/* types */
+typedef struct _HexEditorProcess HexEditorProcess;
+
+
+/* functions */
+HexEditorProcess * hexeditorprocess_new(pid_t pid);
+void hexeditorprocess_delete(HexEditorProcess * process);
+
+/* accessors */
+char const * hexeditorprocess_get_name(HexEditorProcess * process);
+size_t hexeditorprocess_get_mappings(HexEditorProcess * process);
+int hexeditorprocess_get_mapping(HexEditorProcess * process, size_t index,
+		off_t * start, off_t * end, char const ** name);
+pid_t hexeditorprocess_get_pid(HexEditorProcess * process);
+off_t hexeditorprocess_get_size(HexEditorProcess * process);
+
+/* useful */
+ssize_t hexeditorprocess_read(HexEditorProcess * process, void * buf,
+		size_t size, off_t offset);
+int hexeditorprocess_readv(HexEditorProcess * process, off_t const * offsets,
+		size_t count, size_t size, char * buf);
+/* reads the mappings again, kept as they were on errors */
+int hexeditorprocess_refresh(HexEditorProcess * process);
+
+#endif /* !HEXEDITOR_PROCESS_H */
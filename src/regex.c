@@ -0,0 +1,1132 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE /* for memmem() */
+#endif
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <libintl.h>
+#include <System.h>
+#include "regex.h"
+#define _(string) gettext(string)
+
+
+/* HexEditorRegex */
+/* private */
+/* types */
+/* the bytes matched, as a bitmap */
+typedef struct _HexEditorRegexSet
+{
+	uint32_t bits[8];
+} HexEditorRegexSet;
+
+/* the expression parsed */
+typedef enum _HexEditorRegexNodeType
+{
+	HERN_EMPTY = 0,
+	HERN_SET,
+	HERN_CAT,
+	HERN_ALT,
+	HERN_REPEAT
+} HexEditorRegexNodeType;
+
+typedef struct _HexEditorRegexNode
+{
+	HexEditorRegexNodeType type;
+	/* the set, or the nodes repeated or combined */
+	size_t left;
+	size_t right;
+	unsigned int min;
+	unsigned int max;
+} HexEditorRegexNode;
+
+/* the NFA, where the sets are followed by one state */
+typedef enum _HexEditorRegexStateType
+{
+	HERS_SET = 0,
+	HERS_SPLIT,
+	HERS_MATCH
+} HexEditorRegexStateType;
+
+typedef struct _HexEditorRegexState
+{
+	HexEditorRegexStateType type;
+	size_t set;
+	size_t next;
+	size_t next2;
+} HexEditorRegexState;
+
+/* a DFA, over the classes of bytes; the first state matches nothing */
+typedef struct _HexEditorRegexDFA
+{
+	uint32_t * table;
+	unsigned char * accept;
+	size_t states_cnt;
+	uint32_t start;
+} HexEditorRegexDFA;
+
+typedef struct _HexEditorRegexCompiler
+{
+	char const * expression;
+	size_t position;
+	char const * error;
+
+	HexEditorRegexNode * nodes;
+	size_t nodes_cnt;
+	HexEditorRegexSet * sets;
+	size_t sets_cnt;
+	HexEditorRegexState * states;
+	size_t states_cnt;
+	size_t start;
+	size_t reverse;
+
+	/* the subsets of states, while building the DFA */
+	uint32_t * subsets;
+	size_t subsets_cnt;
+	size_t subsets_alloc;
+	size_t * subset;
+	uint32_t * stamps;
+	uint32_t stamp;
+	size_t * stack;
+	uint32_t * list;
+	uint32_t * buckets;
+} HexEditorRegexCompiler;
+
+struct _HexEditorRegex
+{
+	unsigned char classes[256];
+	size_t classes_cnt;
+	HexEditorRegexDFA anchored;
+	/* reversed, to find where the matches start */
+	HexEditorRegexDFA reverse;
+
+	/* the bytes a match may start with, or its first bytes */
+	unsigned char first[256];
+	unsigned char prefix[16];
+	size_t prefix_size;
+	int zero;
+};
+
+
+/* constants */
+#define HEXEDITORREGEX_INFINITE		((unsigned int)-1)
+#define HEXEDITORREGEX_REPEAT_MAX	1000
+#define HEXEDITORREGEX_NODES		16384
+#define HEXEDITORREGEX_NFA_STATES	65536
+#define HEXEDITORREGEX_DFA_STATES	4096
+/* a power of two, twice as many as the states */
+#define HEXEDITORREGEX_BUCKETS		8192
+
+
+/* prototypes */
+/* parsing */
+static int _hexeditorregex_parse_alt(HexEditorRegexCompiler * c,
+		size_t * node);
+static int _hexeditorregex_parse_atom(HexEditorRegexCompiler * c,
+		size_t * node);
+static int _hexeditorregex_parse_cat(HexEditorRegexCompiler * c,
+		size_t * node);
+static int _hexeditorregex_parse_class(HexEditorRegexCompiler * c,
+		HexEditorRegexSet * set);
+static int _hexeditorregex_parse_count(HexEditorRegexCompiler * c,
+		unsigned int * min, unsigned int * max);
+static int _hexeditorregex_parse_escape(HexEditorRegexCompiler * c,
+		HexEditorRegexSet * set, int * byte);
+static int _hexeditorregex_parse_repeat(HexEditorRegexCompiler * c,
+		size_t * node);
+
+/* compiling */
+static int _hexeditorregex_classes(HexEditorRegex * regex,
+		HexEditorRegexCompiler * c);
+static void _hexeditorregex_closure(HexEditorRegexCompiler * c,
+		size_t state, size_t * count);
+static int _hexeditorregex_dfa(HexEditorRegex * regex,
+		HexEditorRegexCompiler * c, size_t start, int unanchored,
+		HexEditorRegexDFA * dfa);
+static int _hexeditorregex_emit(HexEditorRegexCompiler * c, size_t node,
+		int reverse, size_t next, size_t * start);
+static int _hexeditorregex_error(HexEditorRegexCompiler * c,
+		char const * error);
+static int _hexeditorregex_node(HexEditorRegexCompiler * c,
+		HexEditorRegexNodeType type, size_t left, size_t right,
+		size_t * node);
+static int _hexeditorregex_set(HexEditorRegexCompiler * c,
+		HexEditorRegexSet const * set, size_t * node);
+static int _hexeditorregex_state(HexEditorRegexCompiler * c,
+		HexEditorRegexStateType type, size_t set, size_t next,
+		size_t next2, size_t * state);
+
+/* matching */
+static size_t _hexeditorregex_longest(HexEditorRegex * regex,
+		unsigned char const * buf, size_t size);
+
+/* sets */
+static void _set_add(HexEditorRegexSet * set, unsigned int byte);
+static void _set_add_range(HexEditorRegexSet * set, unsigned int from,
+		unsigned int to);
+static void _set_add_set(HexEditorRegexSet * set,
+		HexEditorRegexSet const * from);
+static int _set_has(HexEditorRegexSet const * set, unsigned int byte);
+static void _set_invert(HexEditorRegexSet * set);
+
+
+/* public */
+/* functions */
+/* hexeditorregex_new */
+static void _new_compiler_delete(HexEditorRegexCompiler * c);
+static void _new_prefix(HexEditorRegex * regex);
+
+HexEditorRegex * hexeditorregex_new(char const * expression)
+{
+	HexEditorRegex * regex;
+	HexEditorRegexCompiler c;
+	size_t root;
+	size_t match;
+	size_t i;
+	int ret;
+
+	if((regex = object_new(sizeof(*regex))) == NULL)
+		return NULL;
+	memset(regex, 0, sizeof(*regex));
+	memset(&c, 0, sizeof(c));
+	c.expression = expression;
+	/* parse, then build the NFA and the DFAs */
+	if((ret = _hexeditorregex_parse_alt(&c, &root)) == 0
+			&& expression[c.position] != '\0')
+		ret = _hexeditorregex_error(&c, _("Unmatched parenthesis"));
+	if(ret == 0)
+		ret = _hexeditorregex_state(&c, HERS_MATCH, 0, 0, 0, &match);
+	if(ret == 0)
+		ret = _hexeditorregex_emit(&c, root, 0, match, &c.start);
+	if(ret == 0)
+		ret = _hexeditorregex_emit(&c, root, 1, match, &c.reverse);
+	if(ret == 0)
+		ret = _hexeditorregex_classes(regex, &c);
+	if(ret == 0 && ((c.stamps = calloc(c.states_cnt, sizeof(*c.stamps)))
+				== NULL
+				|| (c.stack = malloc((c.states_cnt * 2 + 1)
+						* sizeof(*c.stack))) == NULL
+				|| (c.list = malloc(c.states_cnt
+						* sizeof(*c.list))) == NULL
+				|| (c.buckets = malloc(HEXEDITORREGEX_BUCKETS
+						* sizeof(*c.buckets)))
+				== NULL))
+		ret = _hexeditorregex_error(&c, strerror(errno));
+	if(ret == 0)
+		ret = _hexeditorregex_dfa(regex, &c, c.start, 0,
+				&regex->anchored);
+	if(ret == 0)
+		ret = _hexeditorregex_dfa(regex, &c, c.reverse, 1,
+				&regex->reverse);
+	if(ret == 0 && regex->anchored.accept[regex->anchored.start])
+		ret = _hexeditorregex_error(&c,
+				_("The expression matches empty strings"));
+	if(ret != 0)
+	{
+		error_set_code(1, "%s", c.error);
+		_new_compiler_delete(&c);
+		hexeditorregex_delete(regex);
+		return NULL;
+	}
+	/* what the matches start with, and whether zeros may match */
+	for(i = 0; i < c.states_cnt; i++)
+		if(c.states[i].type == HERS_SET && _set_has(
+					&c.sets[c.states[i].set], 0))
+			regex->zero = 1;
+	c.stamp++;
+	root = 0;
+	_hexeditorregex_closure(&c, c.start, &root);
+	for(i = 0; i < root; i++)
+		if(c.states[c.list[i]].type == HERS_SET)
+			for(match = 0; match < 256; match++)
+				if(_set_has(&c.sets[c.states[c.list[i]].set],
+							match))
+					regex->first[match] = 1;
+	_new_prefix(regex);
+	_new_compiler_delete(&c);
+	return regex;
+}
+
+static void _new_compiler_delete(HexEditorRegexCompiler * c)
+{
+	free(c->nodes);
+	free(c->sets);
+	free(c->states);
+	free(c->subsets);
+	free(c->subset);
+	free(c->stamps);
+	free(c->stack);
+	free(c->list);
+	free(c->buckets);
+}
+
+static void _new_prefix(HexEditorRegex * regex)
+{
+	HexEditorRegexDFA * dfa = &regex->anchored;
+	uint32_t state = dfa->start;
+	uint32_t next;
+	size_t i;
+	size_t k;
+	size_t cnt;
+	unsigned int byte;
+
+	/* the bytes every match starts with */
+	while(regex->prefix_size < sizeof(regex->prefix) && !dfa->accept[state])
+	{
+		for(i = 0, next = 0, k = 0, cnt = 0; i < regex->classes_cnt;
+				i++)
+			if(dfa->table[state * regex->classes_cnt + i] != 0)
+			{
+				next = dfa->table[state * regex->classes_cnt
+					+ i];
+				k = i;
+				cnt++;
+			}
+		if(cnt != 1)
+			break;
+		for(byte = 0, cnt = 0, i = 0; i < 256; i++)
+			if(regex->classes[i] == k)
+			{
+				byte = i;
+				cnt++;
+			}
+		if(cnt != 1)
+			break;
+		regex->prefix[regex->prefix_size++] = byte;
+		state = next;
+	}
+}
+
+
+/* hexeditorregex_delete */
+void hexeditorregex_delete(HexEditorRegex * regex)
+{
+	free(regex->anchored.table);
+	free(regex->anchored.accept);
+	free(regex->reverse.table);
+	free(regex->reverse.accept);
+	object_delete(regex);
+}
+
+
+/* accessors */
+/* hexeditorregex_get_zero */
+int hexeditorregex_get_zero(HexEditorRegex * regex)
+{
+	return regex->zero;
+}
+
+
+/* useful */
+/* hexeditorregex_match */
+int hexeditorregex_match(HexEditorRegex * regex, unsigned char const * buf,
+		size_t size, size_t end, HexEditorRegexCallback callback,
+		void * data)
+{
+	HexEditorRegexDFA * dfa = &regex->reverse;
+	unsigned char const * p;
+	unsigned char * starts;
+	size_t pos;
+	size_t i;
+	size_t len;
+	uint32_t state;
+	int ret = 0;
+
+	if(end > size)
+		end = size;
+	/* skip to where the first match may start */
+	if(regex->prefix_size > 1)
+		p = memmem(buf, (size < end + regex->prefix_size - 1) ? size
+				: end + regex->prefix_size - 1,
+				regex->prefix, regex->prefix_size);
+	else if(regex->prefix_size == 1)
+		p = memchr(buf, regex->prefix[0], end);
+	else
+		for(p = buf; p < &buf[end] && !regex->first[*p]; p++);
+	if(p == NULL || (pos = p - buf) >= end)
+		return 0;
+	if((starts = calloc((size + 7) / 8, 1)) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	/* from the end, where the matches start */
+	for(state = dfa->start, i = size; i > pos; i--)
+	{
+		state = dfa->table[state * regex->classes_cnt
+			+ regex->classes[buf[i - 1]]];
+		if(dfa->accept[state])
+			starts[(i - 1) / 8] |= 1 << ((i - 1) % 8);
+	}
+	while(ret == 0)
+	{
+		for(; pos < end && starts[pos / 8] == 0; pos = (pos | 7) + 1);
+		for(; pos < end && (starts[pos / 8] & (1 << (pos % 8))) == 0;
+				pos++);
+		if(pos >= end)
+			break;
+		/* the longest one from there, or cut */
+		len = (size - pos < HEXEDITORREGEX_MATCH_MAX) ? size - pos
+			: HEXEDITORREGEX_MATCH_MAX;
+		if((len = _hexeditorregex_longest(regex, &buf[pos], len)) == 0)
+			len = HEXEDITORREGEX_MATCH_MAX;
+		ret = callback(data, pos, len);
+		pos += len;
+	}
+	free(starts);
+	return ret;
+}
+
+
+/* private */
+/* functions */
+/* parsing */
+/* hexeditorregex_parse_alt */
+static int _hexeditorregex_parse_alt(HexEditorRegexCompiler * c,
+		size_t * node)
+{
+	size_t left;
+	size_t right;
+
+	if(_hexeditorregex_parse_cat(c, &left) != 0)
+		return -1;
+	while(c->expression[c->position] == '|')
+	{
+		c->position++;
+		if(_hexeditorregex_parse_cat(c, &right) != 0
+				|| _hexeditorregex_node(c, HERN_ALT, left,
+					right, &left) != 0)
+			return -1;
+	}
+	*node = left;
+	return 0;
+}
+
+
+/* hexeditorregex_parse_atom */
+static int _hexeditorregex_parse_atom(HexEditorRegexCompiler * c,
+		size_t * node)
+{
+	HexEditorRegexSet set;
+	int byte;
+
+	memset(&set, 0, sizeof(set));
+	switch(c->expression[c->position])
+	{
+		case '*':
+		case '+':
+		case '?':
+			return _hexeditorregex_error(c, _("Nothing to repeat"));
+		case '^':
+		case '$':
+			return _hexeditorregex_error(c,
+					_("Anchors are not supported"));
+		case '(':
+			/* the groups do not capture anyway */
+			c->position++;
+			if(strncmp(&c->expression[c->position], "?:", 2) == 0)
+				c->position += 2;
+			if(_hexeditorregex_parse_alt(c, node) != 0)
+				return -1;
+			if(c->expression[c->position] != ')')
+				return _hexeditorregex_error(c,
+						_("Missing parenthesis"));
+			c->position++;
+			return 0;
+		case '[':
+			c->position++;
+			if(_hexeditorregex_parse_class(c, &set) != 0)
+				return -1;
+			break;
+		case '.':
+			/* any byte, new lines included */
+			c->position++;
+			_set_add_range(&set, 0x00, 0xff);
+			break;
+		case '\\':
+			c->position++;
+			if(_hexeditorregex_parse_escape(c, &set, &byte) != 0)
+				return -1;
+			if(byte >= 0)
+				_set_add(&set, byte);
+			break;
+		default:
+			_set_add(&set, (unsigned char)c->expression[
+					c->position++]);
+			break;
+	}
+	return _hexeditorregex_set(c, &set, node);
+}
+
+
+/* hexeditorregex_parse_cat */
+static int _hexeditorregex_parse_cat(HexEditorRegexCompiler * c,
+		size_t * node)
+{
+	size_t left = 0;
+	size_t right;
+	int empty = 1;
+	char e;
+
+	while((e = c->expression[c->position]) != '\0' && e != '|' && e != ')')
+	{
+		if(_hexeditorregex_parse_repeat(c, &right) != 0)
+			return -1;
+		if(empty)
+			left = right;
+		else if(_hexeditorregex_node(c, HERN_CAT, left, right, &left)
+				!= 0)
+			return -1;
+		empty = 0;
+	}
+	if(empty)
+		return _hexeditorregex_node(c, HERN_EMPTY, 0, 0, node);
+	*node = left;
+	return 0;
+}
+
+
+/* hexeditorregex_parse_class */
+static int _hexeditorregex_parse_class(HexEditorRegexCompiler * c,
+		HexEditorRegexSet * set)
+{
+	int invert = 0;
+	int from;
+	int to;
+	char const * e = c->expression;
+
+	if(e[c->position] == '^')
+	{
+		invert = 1;
+		c->position++;
+	}
+	/* a bracket right at the start is part of the class */
+	do
+	{
+		if(e[c->position] == '\0')
+			return _hexeditorregex_error(c, _("Missing bracket"));
+		if(e[c->position] == '\\')
+		{
+			c->position++;
+			if(_hexeditorregex_parse_escape(c, set, &from) != 0)
+				return -1;
+			if(from < 0)
+				continue;
+		}
+		else
+			from = (unsigned char)e[c->position++];
+		if(e[c->position] != '-' || e[c->position + 1] == ']'
+				|| e[c->position + 1] == '\0')
+		{
+			_set_add(set, from);
+			continue;
+		}
+		c->position++;
+		if(e[c->position] == '\\')
+		{
+			c->position++;
+			if(_hexeditorregex_parse_escape(c, set, &to) != 0)
+				return -1;
+		}
+		else
+			to = (unsigned char)e[c->position++];
+		if(to < from)
+			return _hexeditorregex_error(c, _("Invalid range"));
+		_set_add_range(set, from, to);
+	}
+	while(e[c->position] != ']');
+	c->position++;
+	if(invert)
+		_set_invert(set);
+	return 0;
+}
+
+
+/* hexeditorregex_parse_count */
+static int _hexeditorregex_parse_count(HexEditorRegexCompiler * c,
+		unsigned int * min, unsigned int * max)
+{
+	char const * p = &c->expression[c->position + 1];
+	char * q;
+	unsigned long from;
+	unsigned long to;
+
+	/* otherwise the brace is a literal */
+	if(*p < '0' || *p > '9')
+		return 0;
+	from = strtoul(p, &q, 10);
+	to = from;
+	if(*q == ',' && q[1] == '}')
+	{
+		to = HEXEDITORREGEX_INFINITE;
+		q++;
+	}
+	else if(*q == ',' && q[1] >= '0' && q[1] <= '9')
+		to = strtoul(&q[1], &q, 10);
+	if(*q != '}')
+		return 0;
+	if(from > HEXEDITORREGEX_REPEAT_MAX || to < from
+			|| (to > HEXEDITORREGEX_REPEAT_MAX
+				&& to != HEXEDITORREGEX_INFINITE))
+		return _hexeditorregex_error(c, _("Invalid repetition"));
+	c->position = q + 1 - c->expression;
+	*min = from;
+	*max = to;
+	return 1;
+}
+
+
+/* hexeditorregex_parse_escape */
+static int _hexeditorregex_parse_escape(HexEditorRegexCompiler * c,
+		HexEditorRegexSet * set, int * byte)
+{
+	char const hex[] = "0123456789abcdef0123456789ABCDEF";
+	char e = c->expression[c->position++];
+	char const * p;
+	char const * q;
+	HexEditorRegexSet s;
+
+	*byte = -1;
+	memset(&s, 0, sizeof(s));
+	switch(e)
+	{
+		case 'd':
+		case 'D':
+			_set_add_range(&s, '0', '9');
+			break;
+		case 's':
+		case 'S':
+			_set_add_range(&s, '\t', '\r');
+			_set_add(&s, ' ');
+			break;
+		case 'w':
+		case 'W':
+			_set_add_range(&s, '0', '9');
+			_set_add_range(&s, 'A', 'Z');
+			_set_add_range(&s, 'a', 'z');
+			_set_add(&s, '_');
+			break;
+		case 'x':
+			/* exactly two digits */
+			if(c->expression[c->position] == '\0'
+					|| (p = strchr(hex, c->expression[
+							c->position])) == NULL
+					|| c->expression[c->position + 1]
+					== '\0'
+					|| (q = strchr(hex, c->expression[
+							c->position + 1]))
+					== NULL)
+				return _hexeditorregex_error(c,
+						_("Invalid escape"));
+			*byte = (((p - hex) % 16) << 4) | ((q - hex) % 16);
+			c->position += 2;
+			return 0;
+		case '0':
+			*byte = '\0';
+			return 0;
+		case 'a':
+			*byte = '\a';
+			return 0;
+		case 'e':
+			*byte = 0x1b;
+			return 0;
+		case 'f':
+			*byte = '\f';
+			return 0;
+		case 'n':
+			*byte = '\n';
+			return 0;
+		case 'r':
+			*byte = '\r';
+			return 0;
+		case 't':
+			*byte = '\t';
+			return 0;
+		case 'v':
+			*byte = '\v';
+			return 0;
+		default:
+			/* the other characters are literals */
+			if(e == '\0' || (e >= '0' && e <= '9')
+					|| (e >= 'A' && e <= 'Z')
+					|| (e >= 'a' && e <= 'z'))
+				return _hexeditorregex_error(c,
+						_("Invalid escape"));
+			*byte = (unsigned char)e;
+			return 0;
+	}
+	/* the uppercase classes are inverted */
+	if(e >= 'A' && e <= 'Z')
+		_set_invert(&s);
+	_set_add_set(set, &s);
+	return 0;
+}
+
+
+/* hexeditorregex_parse_repeat */
+static int _hexeditorregex_parse_repeat(HexEditorRegexCompiler * c,
+		size_t * node)
+{
+	unsigned int min;
+	unsigned int max;
+	int res;
+
+	if(_hexeditorregex_parse_atom(c, node) != 0)
+		return -1;
+	for(;;)
+	{
+		switch(c->expression[c->position])
+		{
+			case '*':
+				min = 0;
+				max = HEXEDITORREGEX_INFINITE;
+				break;
+			case '+':
+				min = 1;
+				max = HEXEDITORREGEX_INFINITE;
+				break;
+			case '?':
+				min = 0;
+				max = 1;
+				break;
+			case '{':
+				if((res = _hexeditorregex_parse_count(c, &min,
+								&max)) < 0)
+					return -1;
+				if(res == 0)
+					return 0;
+				c->position--;
+				break;
+			default:
+				return 0;
+		}
+		c->position++;
+		if(_hexeditorregex_node(c, HERN_REPEAT, *node, 0, node) != 0)
+			return -1;
+		c->nodes[*node].min = min;
+		c->nodes[*node].max = max;
+	}
+}
+
+
+/* compiling */
+/* hexeditorregex_classes */
+static int _hexeditorregex_classes(HexEditorRegex * regex,
+		HexEditorRegexCompiler * c)
+{
+	unsigned char classes[256];
+	int map[512];
+	size_t cnt;
+	size_t i;
+	unsigned int b;
+	unsigned int k;
+
+	/* the bytes always matched together share a class */
+	memset(regex->classes, 0, sizeof(regex->classes));
+	regex->classes_cnt = 1;
+	for(i = 0; i < c->sets_cnt; i++)
+	{
+		for(k = 0; k < regex->classes_cnt * 2; k++)
+			map[k] = -1;
+		for(b = 0, cnt = 0; b < 256; b++)
+		{
+			k = regex->classes[b] * 2 + _set_has(&c->sets[i], b);
+			if(map[k] < 0)
+				map[k] = cnt++;
+			classes[b] = map[k];
+		}
+		memcpy(regex->classes, classes, sizeof(classes));
+		regex->classes_cnt = cnt;
+	}
+	return 0;
+}
+
+
+/* hexeditorregex_closure */
+static void _hexeditorregex_closure(HexEditorRegexCompiler * c,
+		size_t state, size_t * count)
+{
+	size_t top = 0;
+
+	/* the states reached without reading; the splits push two at most */
+	c->stack[top++] = state;
+	while(top > 0)
+	{
+		state = c->stack[--top];
+		if(c->stamps[state] == c->stamp)
+			continue;
+		c->stamps[state] = c->stamp;
+		if(c->states[state].type == HERS_SPLIT)
+		{
+			c->stack[top++] = c->states[state].next2;
+			c->stack[top++] = c->states[state].next;
+		}
+		else
+			c->list[(*count)++] = state;
+	}
+}
+
+
+/* hexeditorregex_dfa */
+static int _dfa_compare(void const * a, void const * b);
+static int _dfa_state(HexEditorRegexCompiler * c, HexEditorRegexDFA * dfa,
+		size_t classes, size_t count, uint32_t * state);
+
+static int _hexeditorregex_dfa(HexEditorRegex * regex,
+		HexEditorRegexCompiler * c, size_t start, int unanchored,
+		HexEditorRegexDFA * dfa)
+{
+	unsigned char bytes[256];
+	size_t i;
+	size_t j;
+	size_t k;
+	size_t count;
+	uint32_t * subset;
+	uint32_t state;
+
+	for(i = 0; i < 256; i++)
+		bytes[regex->classes[255 - i]] = 255 - i;
+	for(i = 0; i < HEXEDITORREGEX_BUCKETS; i++)
+		c->buckets[i] = 0;
+	c->subsets_cnt = 0;
+	/* the first state matches nothing */
+	count = 0;
+	if(_dfa_state(c, dfa, regex->classes_cnt, count, &state) != 0)
+		return -1;
+	c->stamp++;
+	_hexeditorregex_closure(c, start, &count);
+	if(_dfa_state(c, dfa, regex->classes_cnt, count, &dfa->start) != 0)
+		return -1;
+	/* the states are added as they are found */
+	for(i = 0; i < dfa->states_cnt; i++)
+		for(k = 0; k < regex->classes_cnt; k++)
+		{
+			c->stamp++;
+			count = 0;
+			subset = &c->subsets[c->subset[i]];
+			for(j = 0; subset[j] != (uint32_t)-1; j++)
+				if(c->states[subset[j]].type == HERS_SET
+						&& _set_has(&c->sets[c->states[
+							subset[j]].set],
+							bytes[k]))
+					_hexeditorregex_closure(c,
+							c->states[subset[j]]
+							.next, &count);
+			/* a match may start anywhere */
+			if(unanchored)
+				_hexeditorregex_closure(c, start, &count);
+			if(_dfa_state(c, dfa, regex->classes_cnt, count,
+						&state) != 0)
+				return -1;
+			dfa->table[i * regex->classes_cnt + k] = state;
+		}
+	return 0;
+}
+
+static int _dfa_compare(void const * a, void const * b)
+{
+	uint32_t const * ua = a;
+	uint32_t const * ub = b;
+
+	return (*ua < *ub) ? -1 : ((*ua > *ub) ? 1 : 0);
+}
+
+static int _dfa_state(HexEditorRegexCompiler * c, HexEditorRegexDFA * dfa,
+		size_t classes, size_t count, uint32_t * state)
+{
+	uint32_t hash = 2166136261U;
+	size_t i;
+	size_t b;
+	size_t alloc;
+	uint32_t * subset;
+	void * p;
+
+	/* looked up by its states, sorted */
+	qsort(c->list, count, sizeof(*c->list), _dfa_compare);
+	for(i = 0; i < count; i++)
+		hash = (hash ^ c->list[i]) * 16777619U;
+	for(b = hash % HEXEDITORREGEX_BUCKETS; c->buckets[b] != 0;
+			b = (b + 1) % HEXEDITORREGEX_BUCKETS)
+	{
+		subset = &c->subsets[c->subset[c->buckets[b] - 1]];
+		for(i = 0; i < count && subset[i] == c->list[i]; i++);
+		if(i == count && subset[i] == (uint32_t)-1)
+		{
+			*state = c->buckets[b] - 1;
+			return 0;
+		}
+	}
+	if(dfa->states_cnt == HEXEDITORREGEX_DFA_STATES)
+		return _hexeditorregex_error(c,
+				_("The expression is too complex"));
+	/* a new state, and its transitions */
+	if(c->subsets_cnt + count + 1 > c->subsets_alloc)
+	{
+		for(alloc = (c->subsets_alloc > 0) ? c->subsets_alloc : 4096;
+				c->subsets_cnt + count + 1 > alloc;
+				alloc *= 2);
+		if((p = realloc(c->subsets, alloc * sizeof(*c->subsets)))
+				== NULL)
+			return _hexeditorregex_error(c, strerror(errno));
+		c->subsets = p;
+		c->subsets_alloc = alloc;
+	}
+	if(c->subset == NULL && (c->subset = malloc(HEXEDITORREGEX_DFA_STATES
+					* sizeof(*c->subset))) == NULL)
+		return _hexeditorregex_error(c, strerror(errno));
+	if((p = realloc(dfa->table, (dfa->states_cnt + 1) * classes
+					* sizeof(*dfa->table))) == NULL)
+		return _hexeditorregex_error(c, strerror(errno));
+	dfa->table = p;
+	if((p = realloc(dfa->accept, dfa->states_cnt + 1)) == NULL)
+		return _hexeditorregex_error(c, strerror(errno));
+	dfa->accept = p;
+	*state = dfa->states_cnt++;
+	c->subset[*state] = c->subsets_cnt;
+	memcpy(&c->subsets[c->subsets_cnt], c->list, count * sizeof(*c->list));
+	c->subsets_cnt += count;
+	c->subsets[c->subsets_cnt++] = (uint32_t)-1;
+	c->buckets[b] = *state + 1;
+	memset(&dfa->table[*state * classes], 0, classes * sizeof(*dfa->table));
+	for(i = 0, dfa->accept[*state] = 0; i < count; i++)
+		if(c->states[c->list[i]].type == HERS_MATCH)
+			dfa->accept[*state] = 1;
+	return 0;
+}
+
+
+/* hexeditorregex_emit */
+static int _hexeditorregex_emit(HexEditorRegexCompiler * c, size_t node,
+		int reverse, size_t next, size_t * start)
+{
+	HexEditorRegexNode n = c->nodes[node];
+	size_t left;
+	size_t right;
+	size_t loop;
+	unsigned int i;
+
+	/* from the end, every state knows where to go next; the reverse
+	 * matches the bytes backwards */
+	switch(n.type)
+	{
+		case HERN_EMPTY:
+			*start = next;
+			return 0;
+		case HERN_SET:
+			return _hexeditorregex_state(c, HERS_SET, n.left, next,
+					0, start);
+		case HERN_CAT:
+			if(reverse)
+			{
+				left = n.right;
+				n.right = n.left;
+				n.left = left;
+			}
+			if(_hexeditorregex_emit(c, n.right, reverse, next,
+						&right) != 0)
+				return -1;
+			return _hexeditorregex_emit(c, n.left, reverse, right,
+					start);
+		case HERN_ALT:
+			if(_hexeditorregex_emit(c, n.left, reverse, next, &left)
+					!= 0 || _hexeditorregex_emit(c, n.right,
+						reverse, next, &right) != 0)
+				return -1;
+			return _hexeditorregex_state(c, HERS_SPLIT, 0, left,
+					right, start);
+		case HERN_REPEAT:
+			break;
+	}
+	if(n.max == HEXEDITORREGEX_INFINITE)
+	{
+		/* loops back until leaving */
+		if(_hexeditorregex_state(c, HERS_SPLIT, 0, 0, next, &loop) != 0
+				|| _hexeditorregex_emit(c, n.left, reverse,
+					loop, &left) != 0)
+			return -1;
+		c->states[loop].next = left;
+		next = loop;
+	}
+	else
+		/* the optional ones are nested */
+		for(i = n.min, loop = next; i < n.max; i++)
+			if(_hexeditorregex_emit(c, n.left, reverse, next,
+						&left) != 0
+					|| _hexeditorregex_state(c, HERS_SPLIT,
+						0, left, loop, &next) != 0)
+				return -1;
+	for(i = 0; i < n.min; i++)
+		if(_hexeditorregex_emit(c, n.left, reverse, next, &next)
+				!= 0)
+			return -1;
+	*start = next;
+	return 0;
+}
+
+
+/* hexeditorregex_error */
+static int _hexeditorregex_error(HexEditorRegexCompiler * c,
+		char const * error)
+{
+	if(c->error == NULL)
+		c->error = error;
+	return -1;
+}
+
+
+/* hexeditorregex_node */
+static int _hexeditorregex_node(HexEditorRegexCompiler * c,
+		HexEditorRegexNodeType type, size_t left, size_t right,
+		size_t * node)
+{
+	HexEditorRegexNode * n;
+
+	if(c->nodes_cnt == HEXEDITORREGEX_NODES)
+		return _hexeditorregex_error(c,
+				_("The expression is too long"));
+	if(c->nodes == NULL && (c->nodes = malloc(HEXEDITORREGEX_NODES
+					* sizeof(*c->nodes))) == NULL)
+		return _hexeditorregex_error(c, strerror(errno));
+	*node = c->nodes_cnt++;
+	n = &c->nodes[*node];
+	n->type = type;
+	n->left = left;
+	n->right = right;
+	n->min = 0;
+	n->max = 0;
+	return 0;
+}
+
+
+/* hexeditorregex_set */
+static int _hexeditorregex_set(HexEditorRegexCompiler * c,
+		HexEditorRegexSet const * set, size_t * node)
+{
+	size_t i;
+	void * p;
+
+	/* the sets are shared */
+	for(i = 0; i < c->sets_cnt; i++)
+		if(memcmp(&c->sets[i], set, sizeof(*set)) == 0)
+			return _hexeditorregex_node(c, HERN_SET, i, 0, node);
+	if((c->sets_cnt & (c->sets_cnt - 1)) == 0)
+	{
+		if((p = realloc(c->sets, (c->sets_cnt > 0 ? c->sets_cnt * 2
+							: 1)
+						* sizeof(*c->sets))) == NULL)
+			return _hexeditorregex_error(c, strerror(errno));
+		c->sets = p;
+	}
+	c->sets[c->sets_cnt] = *set;
+	return _hexeditorregex_node(c, HERN_SET, c->sets_cnt++, 0, node);
+}
+
+
+/* hexeditorregex_state */
+static int _hexeditorregex_state(HexEditorRegexCompiler * c,
+		HexEditorRegexStateType type, size_t set, size_t next,
+		size_t next2, size_t * state)
+{
+	HexEditorRegexState * s;
+	void * p;
+
+	if(c->states_cnt == HEXEDITORREGEX_NFA_STATES)
+		return _hexeditorregex_error(c,
+				_("The expression is too complex"));
+	if((c->states_cnt & (c->states_cnt - 1)) == 0)
+	{
+		if((p = realloc(c->states, (c->states_cnt > 0
+							? c->states_cnt * 2 : 1)
+						* sizeof(*c->states))) == NULL)
+			return _hexeditorregex_error(c, strerror(errno));
+		c->states = p;
+	}
+	*state = c->states_cnt++;
+	s = &c->states[*state];
+	s->type = type;
+	s->set = set;
+	s->next = next;
+	s->next2 = next2;
+	return 0;
+}
+
+
+/* matching */
+/* hexeditorregex_longest */
+static size_t _hexeditorregex_longest(HexEditorRegex * regex,
+		unsigned char const * buf, size_t size)
+{
+	HexEditorRegexDFA * dfa = &regex->anchored;
+	uint32_t state = dfa->start;
+	size_t ret = 0;
+	size_t i;
+
+	for(i = 0; i < size; i++)
+	{
+		if((state = dfa->table[state * regex->classes_cnt
+					+ regex->classes[buf[i]]]) == 0)
+			break;
+		if(dfa->accept[state])
+			ret = i + 1;
+	}
+	return ret;
+}
+
+
+/* sets */
+/* set_add */
+static void _set_add(HexEditorRegexSet * set, unsigned int byte)
+{
+	set->bits[byte / 32] |= 1U << (byte % 32);
+}
+
+
+/* set_add_range */
+static void _set_add_range(HexEditorRegexSet * set, unsigned int from,
+		unsigned int to)
+{
+	for(; from <= to; from++)
+		_set_add(set, from);
+}
+
+
+/* set_add_set */
+static void _set_add_set(HexEditorRegexSet * set,
+		HexEditorRegexSet const * from)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(set->bits) / sizeof(*set->bits); i++)
+		set->bits[i] |= from->bits[i];
+}
+
+
+/* set_has */
+static int _set_has(HexEditorRegexSet const * set, unsigned int byte)
+{
+	return (set->bits[byte / 32] >> (byte % 32)) & 1;
+}
+
+
+/* set_invert */
+static void _set_invert(HexEditorRegexSet * set)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(set->bits) / sizeof(*set->bits); i++)
+		set->bits[i] = ~set->bits[i];
+}
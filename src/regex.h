@@ -0,0 +1,57 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_REGEX_H
+# define HEXEDITOR_REGEX_H
+
+# include <sys/types.h>
+
+
+/* HexEditorRegex */
+/* public */
+/* types */
+typedef struct _HexEditorRegex HexEditorRegex;
+
+/* a match found, returns 0 to go on */
+typedef int (*HexEditorRegexCallback)(void * data, size_t position,
+		size_t length);
+
+
+/* constants */
+/* the longest match: longer ones are cut, if found within the bytes looked at
+ * at all */
+# define HEXEDITORREGEX_MATCH_MAX	65536
+
+
+/* functions */
+/* the expression applies to bytes: "\xHH" escapes, classes, "." matches any
+ * byte, groups, alternatives and the usual quantifiers */
+HexEditorRegex * hexeditorregex_new(char const * expression);
+void hexeditorregex_delete(HexEditorRegex * regex);
+
+/* accessors */
+/* whether a match may hold zero bytes */
+int hexeditorregex_get_zero(HexEditorRegex * regex);
+
+/* useful */
+/* the leftmost-longest matches starting before end, without overlapping and
+ * looking at up to size bytes */
+int hexeditorregex_match(HexEditorRegex * regex, unsigned char const * buf,
+		size_t size, size_t end, HexEditorRegexCallback callback,
+		void * data);
+
+#endif /* !HEXEDITOR_REGEX_H */
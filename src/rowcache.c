@@ -0,0 +1,265 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <System.h>
+#include "rowcache.h"
+
+
+/* HexEditorRowCache */
+/* private */
+/* types */
+typedef struct _HexEditorRowCacheEntry
+{
+	HexEditorRowCacheKey key;
+	HexEditorRowBlock * block;
+	size_t size;
+	/* most recently used first */
+	GList link;
+} HexEditorRowCacheEntry;
+
+struct _HexEditorRowCache
+{
+	size_t budget;
+	size_t size;
+	GHashTable * entries;
+	GQueue lru;
+};
+
+
+/* prototypes */
+static void _hexeditorrowcache_evict(HexEditorRowCache * cache,
+		HexEditorRowCacheEntry * entry);
+static void _hexeditorrowcache_trim(HexEditorRowCache * cache);
+
+static guint _hexeditorrowcache_key_hash(gconstpointer key);
+static gboolean _hexeditorrowcache_key_equal(gconstpointer a,
+		gconstpointer b);
+
+
+/* public */
+/* functions */
+/* hexeditorrowcache_new */
+HexEditorRowCache * hexeditorrowcache_new(size_t budget)
+{
+	HexEditorRowCache * cache;
+
+	if((cache = object_new(sizeof(*cache))) == NULL)
+		return NULL;
+	cache->budget = budget;
+	cache->size = 0;
+	cache->entries = g_hash_table_new(_hexeditorrowcache_key_hash,
+			_hexeditorrowcache_key_equal);
+	g_queue_init(&cache->lru);
+	return cache;
+}
+
+
+/* hexeditorrowcache_delete */
+void hexeditorrowcache_delete(HexEditorRowCache * cache)
+{
+	hexeditorrowcache_flush(cache);
+	g_hash_table_destroy(cache->entries);
+	object_delete(cache);
+}
+
+
+/* accessors */
+/* hexeditorrowcache_set_budget */
+void hexeditorrowcache_set_budget(HexEditorRowCache * cache, size_t budget)
+{
+	cache->budget = budget;
+	_hexeditorrowcache_trim(cache);
+}
+
+
+/* useful */
+/* hexeditorrowcache_lookup */
+HexEditorRowBlock * hexeditorrowcache_lookup(HexEditorRowCache * cache,
+		HexEditorRowCacheKey const * key)
+{
+	HexEditorRowCacheEntry * entry;
+
+	if((entry = g_hash_table_lookup(cache->entries, key)) == NULL)
+		return NULL;
+	g_queue_unlink(&cache->lru, &entry->link);
+	g_queue_push_head_link(&cache->lru, &entry->link);
+	return entry->block;
+}
+
+
+/* hexeditorrowcache_insert */
+int hexeditorrowcache_insert(HexEditorRowCache * cache,
+		HexEditorRowCacheKey const * key, HexEditorRowBlock * block)
+{
+	HexEditorRowCacheEntry * entry;
+
+	if((entry = g_hash_table_lookup(cache->entries, key)) != NULL)
+		_hexeditorrowcache_evict(cache, entry);
+	if((entry = object_new(sizeof(*entry))) == NULL)
+		return -1;
+	entry->key = *key;
+	entry->block = block;
+	entry->size = sizeof(*entry) + sizeof(*block) + block->rows
+		* (block->addr_stride + block->hex_stride
+				+ block->data_stride + block->classes_stride);
+	entry->link.data = entry;
+	entry->link.prev = NULL;
+	entry->link.next = NULL;
+	g_hash_table_insert(cache->entries, &entry->key, entry);
+	g_queue_push_head_link(&cache->lru, &entry->link);
+	cache->size += entry->size;
+	_hexeditorrowcache_trim(cache);
+	return 0;
+}
+
+
+/* hexeditorrowcache_expire */
+void hexeditorrowcache_expire(HexEditorRowCache * cache,
+		unsigned int columns, unsigned int flags)
+{
+	GList * l;
+	GList * p;
+	HexEditorRowCacheEntry * entry;
+
+	/* release the blocks formatted with other settings */
+	for(l = cache->lru.head; l != NULL; l = p)
+	{
+		p = l->next;
+		entry = l->data;
+		if(entry->key.columns != columns || entry->key.flags != flags)
+			_hexeditorrowcache_evict(cache, entry);
+	}
+}
+
+
+/* hexeditorrowcache_flush */
+void hexeditorrowcache_flush(HexEditorRowCache * cache)
+{
+	while(cache->lru.tail != NULL)
+		_hexeditorrowcache_evict(cache, cache->lru.tail->data);
+}
+
+
+/* hexeditorrowcache_invalidate */
+void hexeditorrowcache_invalidate(HexEditorRowCache * cache, off_t offset,
+		off_t size)
+{
+	GList * l;
+	GList * p;
+	HexEditorRowCacheEntry * entry;
+	off_t end;
+
+	for(l = cache->lru.head; l != NULL; l = p)
+	{
+		p = l->next;
+		entry = l->data;
+		end = entry->key.offset + entry->block->rows
+			* entry->key.columns;
+		if(entry->key.offset < offset + size && end > offset)
+			_hexeditorrowcache_evict(cache, entry);
+	}
+}
+
+
+/* blocks */
+/* hexeditorrowblock_new */
+HexEditorRowBlock * hexeditorrowblock_new(size_t rows, size_t addr_stride,
+		size_t hex_stride, size_t data_stride, size_t classes_stride)
+{
+	HexEditorRowBlock * block;
+
+	if((block = object_new(sizeof(*block))) == NULL)
+		return NULL;
+	/* a single allocation holds the three columns and the classes */
+	if((block->addr = malloc(rows * (addr_stride + hex_stride
+						+ data_stride
+						+ classes_stride))) == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		object_delete(block);
+		return NULL;
+	}
+	block->rows = rows;
+	block->addr_stride = addr_stride;
+	block->hex = &block->addr[rows * addr_stride];
+	block->hex_stride = hex_stride;
+	block->data = &block->hex[rows * hex_stride];
+	block->data_stride = data_stride;
+	block->classes = (classes_stride > 0)
+		? (unsigned char *)&block->data[rows * data_stride] : NULL;
+	block->classes_stride = classes_stride;
+	return block;
+}
+
+
+/* hexeditorrowblock_delete */
+void hexeditorrowblock_delete(HexEditorRowBlock * block)
+{
+	free(block->addr);
+	object_delete(block);
+}
+
+
+/* private */
+/* functions */
+/* hexeditorrowcache_evict */
+static void _hexeditorrowcache_evict(HexEditorRowCache * cache,
+		HexEditorRowCacheEntry * entry)
+{
+	g_hash_table_remove(cache->entries, &entry->key);
+	g_queue_unlink(&cache->lru, &entry->link);
+	cache->size -= entry->size;
+	hexeditorrowblock_delete(entry->block);
+	object_delete(entry);
+}
+
+
+/* hexeditorrowcache_trim */
+static void _hexeditorrowcache_trim(HexEditorRowCache * cache)
+{
+	/* always keep the most recent block */
+	while(cache->size > cache->budget && cache->lru.tail != NULL
+			&& cache->lru.tail != cache->lru.head)
+		_hexeditorrowcache_evict(cache, cache->lru.tail->data);
+}
+
+
+/* hexeditorrowcache_key_hash */
+static guint _hexeditorrowcache_key_hash(gconstpointer key)
+{
+	HexEditorRowCacheKey const * k = key;
+	guint64 h;
+
+	h = (guint64)k->offset * 0x9e3779b97f4a7c15ULL;
+	h ^= ((guint64)k->columns << 32) | k->flags;
+	return (guint)(h ^ (h >> 32));
+}
+
+
+/* hexeditorrowcache_key_equal */
+static gboolean _hexeditorrowcache_key_equal(gconstpointer a, gconstpointer b)
+{
+	HexEditorRowCacheKey const * ka = a;
+	HexEditorRowCacheKey const * kb = b;
+
+	return (ka->offset == kb->offset && ka->columns == kb->columns
+			&& ka->flags == kb->flags) ? TRUE : FALSE;
+}
@@ -0,0 +1,80 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_ROWCACHE_H
+# define HEXEDITOR_ROWCACHE_H
+
+# include <sys/types.h>
+
+
+/* HexEditorRowCache */
+/* public */
+/* types */
+typedef struct _HexEditorRowCache HexEditorRowCache;
+
+typedef struct _HexEditorRowCacheKey
+{
+	off_t offset;
+	unsigned int columns;
+	unsigned int flags;
+} HexEditorRowCacheKey;
+
+/* every row of a block is padded to the same stride, newline included */
+typedef struct _HexEditorRowBlock
+{
+	size_t rows;
+	char * addr;
+	size_t addr_stride;
+	char * hex;
+	size_t hex_stride;
+	char * data;
+	size_t data_stride;
+	/* of every byte, if colored (NULL otherwise) */
+	unsigned char * classes;
+	size_t classes_stride;
+} HexEditorRowBlock;
+
+
+/* constants */
+# define HEXEDITORROWCACHE_BUDGET	(4 * 1024 * 1024)
+
+
+/* functions */
+HexEditorRowCache * hexeditorrowcache_new(size_t budget);
+void hexeditorrowcache_delete(HexEditorRowCache * cache);
+
+/* accessors */
+void hexeditorrowcache_set_budget(HexEditorRowCache * cache, size_t budget);
+
+/* useful */
+HexEditorRowBlock * hexeditorrowcache_lookup(HexEditorRowCache * cache,
+		HexEditorRowCacheKey const * key);
+int hexeditorrowcache_insert(HexEditorRowCache * cache,
+		HexEditorRowCacheKey const * key, HexEditorRowBlock * block);
+
+void hexeditorrowcache_expire(HexEditorRowCache * cache,
+		unsigned int columns, unsigned int flags);
+void hexeditorrowcache_flush(HexEditorRowCache * cache);
+void hexeditorrowcache_invalidate(HexEditorRowCache * cache, off_t offset,
+		off_t size);
+
+/* blocks */
+HexEditorRowBlock * hexeditorrowblock_new(size_t rows, size_t addr_stride,
+		size_t hex_stride, size_t data_stride, size_t classes_stride);
+void hexeditorrowblock_delete(HexEditorRowBlock * block);
+
+#endif /* !HEXEDITOR_ROWCACHE_H */
@@ -0,0 +1,738 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE /* for memmem() */
+#endif
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <System.h>
+#include "regex.h"
+#include "search.h"
+
+
+/* HexEditorSearch */
+/* private */
+/* types */
+typedef struct _HexEditorSearchRange
+{
+	off_t offset;
+	off_t size;
+} HexEditorSearchRange;
+
+/* the hits of a chunk, delta-encoded from its offset */
+typedef struct _HexEditorSearchChunk
+{
+	int done;
+	off_t offset;
+	off_t end;
+	off_t limit;
+	off_t last;
+	unsigned char * hits;
+	size_t hits_size;
+	size_t hits_alloc;
+} HexEditorSearchChunk;
+
+/* where to decode the hits from */
+typedef struct _HexEditorSearchIndex
+{
+	size_t position;
+	off_t offset;
+	size_t size;
+} HexEditorSearchIndex;
+
+struct _HexEditorSearch
+{
+	unsigned char * pattern;
+	size_t pattern_size;
+	HexEditorRegex * regex;
+	HexEditorSearchRange * ranges;
+	size_t ranges_cnt;
+	off_t size;
+
+	/* the file */
+	int fd;
+	HexEditorBufferReader reader;
+	void * reader_data;
+
+	/* the hits merged, delta-encoded and followed by their size with
+	 * regular expressions */
+	unsigned char * hits;
+	size_t hits_size;
+	size_t hits_alloc;
+	size_t hits_cnt;
+	off_t hits_last;
+	off_t hits_end;
+	HexEditorSearchIndex * index;
+	size_t index_cnt;
+	size_t index_alloc;
+
+	/* the workers, claiming the chunks in order */
+	GThreadPool * pool;
+	GMutex mutex;
+	GCond cond;
+	size_t range;
+	off_t next;
+	size_t claimed;
+	size_t merged;
+	HexEditorSearchChunk * chunks;
+	/* the chunk searched again, plus one */
+	size_t redo;
+	off_t done;
+	unsigned int workers;
+	int cancel;
+	int error;
+};
+
+
+/* constants */
+/* the hits between two entries of the index */
+#define HEXEDITORSEARCH_INDEX		64
+/* the chunks searched ahead of the hits merged */
+#define HEXEDITORSEARCH_PENDING		32
+#define HEXEDITORSEARCH_THREADS		16
+
+
+/* prototypes */
+static int _hexeditorsearch_add(HexEditorSearch * search, off_t offset,
+		size_t size);
+static int _hexeditorsearch_chunk_add(HexEditorSearchChunk * chunk,
+		off_t offset, size_t size);
+static int _hexeditorsearch_merge(HexEditorSearch * search,
+		HexEditorSearchChunk * chunk);
+static size_t _hexeditorsearch_varint_get(unsigned char const * buf,
+		size_t size, uint64_t * value);
+static size_t _hexeditorsearch_varint_set(unsigned char * buf,
+		uint64_t value);
+
+/* callbacks */
+static int _hexeditorsearch_on_match(void * data, size_t position,
+		size_t length);
+static void _hexeditorsearch_on_worker(gpointer data, gpointer user_data);
+
+
+/* public */
+/* functions */
+/* hexeditorsearch_new */
+static HexEditorSearch * _new_search(size_t size);
+
+HexEditorSearch * hexeditorsearch_new(unsigned char const * pattern,
+		size_t size)
+{
+	HexEditorSearch * search;
+
+	if(size == 0)
+	{
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	if((search = _new_search(size)) == NULL)
+		return NULL;
+	memcpy(search->pattern, pattern, size);
+	return search;
+}
+
+static HexEditorSearch * _new_search(size_t size)
+{
+	HexEditorSearch * search;
+	size_t i;
+
+	if((search = object_new(sizeof(*search))) == NULL)
+		return NULL;
+	search->pattern_size = size;
+	search->regex = NULL;
+	search->ranges = NULL;
+	search->ranges_cnt = 0;
+	search->size = 0;
+	search->fd = -1;
+	search->reader = NULL;
+	search->reader_data = NULL;
+	search->hits = NULL;
+	search->hits_size = 0;
+	search->hits_alloc = 0;
+	search->hits_cnt = 0;
+	search->hits_last = 0;
+	search->hits_end = 0;
+	search->index = NULL;
+	search->index_cnt = 0;
+	search->index_alloc = 0;
+	search->pool = NULL;
+	g_mutex_init(&search->mutex);
+	g_cond_init(&search->cond);
+	search->range = 0;
+	search->next = 0;
+	search->claimed = 0;
+	search->merged = 0;
+	search->redo = 0;
+	search->done = 0;
+	search->workers = 0;
+	search->cancel = 0;
+	search->error = 0;
+	search->pattern = (size > 0) ? malloc(size) : NULL;
+	if((search->chunks = malloc(sizeof(*search->chunks)
+					* HEXEDITORSEARCH_PENDING)) != NULL)
+		for(i = 0; i < HEXEDITORSEARCH_PENDING; i++)
+		{
+			search->chunks[i].done = 0;
+			search->chunks[i].hits = NULL;
+		}
+	if((size > 0 && search->pattern == NULL) || search->chunks == NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		hexeditorsearch_delete(search);
+		return NULL;
+	}
+	return search;
+}
+
+
+/* hexeditorsearch_new_regex */
+HexEditorSearch * hexeditorsearch_new_regex(char const * expression)
+{
+	HexEditorSearch * search;
+
+	if((search = _new_search(0)) == NULL)
+		return NULL;
+	if((search->regex = hexeditorregex_new(expression)) == NULL)
+	{
+		hexeditorsearch_delete(search);
+		return NULL;
+	}
+	return search;
+}
+
+
+/* hexeditorsearch_delete */
+void hexeditorsearch_delete(HexEditorSearch * search)
+{
+	size_t i;
+
+	hexeditorsearch_cancel(search);
+	for(i = 0; search->chunks != NULL && i < HEXEDITORSEARCH_PENDING; i++)
+		free(search->chunks[i].hits);
+	free(search->chunks);
+	g_cond_clear(&search->cond);
+	g_mutex_clear(&search->mutex);
+	free(search->index);
+	free(search->hits);
+	free(search->ranges);
+	free(search->pattern);
+	if(search->regex != NULL)
+		hexeditorregex_delete(search->regex);
+	object_delete(search);
+}
+
+
+/* accessors */
+/* hexeditorsearch_get_count */
+size_t hexeditorsearch_get_count(HexEditorSearch * search)
+{
+	return search->hits_cnt;
+}
+
+
+/* hexeditorsearch_get_hit */
+off_t hexeditorsearch_get_hit(HexEditorSearch * search, size_t index,
+		size_t * size)
+{
+	HexEditorSearchIndex * i;
+	size_t position;
+	off_t offset;
+	uint64_t delta;
+	uint64_t length;
+	size_t j;
+
+	if(index >= search->hits_cnt)
+		return -1;
+	/* at most HEXEDITORSEARCH_INDEX hits are decoded */
+	i = &search->index[index / HEXEDITORSEARCH_INDEX];
+	position = i->position;
+	offset = i->offset;
+	length = i->size;
+	for(j = index % HEXEDITORSEARCH_INDEX; j > 0; j--)
+	{
+		position += _hexeditorsearch_varint_get(
+				&search->hits[position],
+				search->hits_size - position, &delta);
+		offset += delta;
+		if(search->regex != NULL)
+			position += _hexeditorsearch_varint_get(
+					&search->hits[position],
+					search->hits_size - position, &length);
+	}
+	if(size != NULL)
+		*size = length;
+	return offset;
+}
+
+
+/* hexeditorsearch_get_hole_margin */
+off_t hexeditorsearch_get_hole_margin(HexEditorSearch * search)
+{
+	size_t i;
+
+	/* the holes read as zeros */
+	if(search->regex != NULL)
+		return hexeditorregex_get_zero(search->regex) ? -1 : 0;
+	for(i = 0; i < search->pattern_size; i++)
+		if(search->pattern[i] != 0)
+			return search->pattern_size - 1;
+	return -1;
+}
+
+
+/* hexeditorsearch_get_position */
+off_t hexeditorsearch_get_position(HexEditorSearch * search)
+{
+	off_t ret;
+
+	g_mutex_lock(&search->mutex);
+	ret = search->done;
+	g_mutex_unlock(&search->mutex);
+	return ret;
+}
+
+
+/* hexeditorsearch_get_size */
+off_t hexeditorsearch_get_size(HexEditorSearch * search)
+{
+	return search->size;
+}
+
+
+/* useful */
+/* hexeditorsearch_add_range */
+int hexeditorsearch_add_range(HexEditorSearch * search, off_t offset,
+		off_t size)
+{
+	HexEditorSearchRange * p;
+
+	if(search->pool != NULL || search->cancel || offset < 0 || size < 0)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	if(size == 0)
+		return 0;
+	/* the ranges overlapping or next to the last one extend it */
+	p = (search->ranges_cnt > 0) ? &search->ranges[search->ranges_cnt - 1]
+		: NULL;
+	if(p != NULL && offset <= p->offset + p->size)
+	{
+		if(offset < p->offset)
+			return -error_set_code(1, "%s", strerror(EINVAL));
+		if(offset + size > p->offset + p->size)
+		{
+			search->size += offset + size - (p->offset + p->size);
+			p->size = offset + size - p->offset;
+		}
+		return 0;
+	}
+	if((p = realloc(search->ranges, sizeof(*p) * (search->ranges_cnt
+						+ 1))) == NULL)
+		return -error_set_code(1, "%s", strerror(errno));
+	search->ranges = p;
+	p = &search->ranges[search->ranges_cnt++];
+	p->offset = offset;
+	p->size = size;
+	search->size += size;
+	return 0;
+}
+
+
+/* hexeditorsearch_cancel */
+void hexeditorsearch_cancel(HexEditorSearch * search)
+{
+	g_mutex_lock(&search->mutex);
+	search->cancel = 1;
+	g_cond_broadcast(&search->cond);
+	g_mutex_unlock(&search->mutex);
+	/* wait for the workers, once they notice */
+	if(search->pool != NULL)
+		g_thread_pool_free(search->pool, FALSE, TRUE);
+	search->pool = NULL;
+}
+
+
+/* hexeditorsearch_poll */
+int hexeditorsearch_poll(HexEditorSearch * search)
+{
+	int ret;
+	HexEditorSearchChunk chunk;
+	HexEditorSearchChunk * c;
+
+	g_mutex_lock(&search->mutex);
+	/* in order, the chunks found ahead wait for the ones before */
+	for(c = &search->chunks[search->merged % HEXEDITORSEARCH_PENDING];
+			search->merged < search->claimed && c->done;
+			c = &search->chunks[search->merged
+			% HEXEDITORSEARCH_PENDING])
+	{
+		chunk = *c;
+		c->done = 0;
+		c->hits = NULL;
+		g_mutex_unlock(&search->mutex);
+		ret = _hexeditorsearch_merge(search, &chunk);
+		free(chunk.hits);
+		g_mutex_lock(&search->mutex);
+		if(ret < 0 && search->error == 0)
+			search->error = errno;
+		else if(ret > 0)
+		{
+			/* searched again from the end of the last hit */
+			c->offset = search->hits_end;
+			search->redo = search->merged % HEXEDITORSEARCH_PENDING
+				+ 1;
+			break;
+		}
+		search->merged++;
+	}
+	g_cond_broadcast(&search->cond);
+	if(search->error != 0)
+		ret = -error_set_code(1, "%s", strerror(search->error));
+	else
+		ret = (search->workers > 0) ? 1 : 0;
+	g_mutex_unlock(&search->mutex);
+	return ret;
+}
+
+
+/* hexeditorsearch_start */
+int hexeditorsearch_start(HexEditorSearch * search, int fd,
+		HexEditorBufferReader reader, void * data)
+{
+	unsigned int threads;
+	unsigned int i;
+	GError * error = NULL;
+
+	if(search->pool != NULL || search->cancel)
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	search->fd = fd;
+	search->reader = reader;
+	search->reader_data = data;
+	/* there may be nothing to search */
+	if(search->ranges_cnt == 0)
+		return 0;
+	/* the readers are not expected to be reentrant */
+	if(reader != NULL)
+		threads = 1;
+	else if((threads = g_get_num_processors())
+			> HEXEDITORSEARCH_THREADS)
+		threads = HEXEDITORSEARCH_THREADS;
+	if((search->pool = g_thread_pool_new(_hexeditorsearch_on_worker,
+					search, threads, FALSE, &error))
+			== NULL)
+	{
+		error_set_code(1, "%s", error->message);
+		g_error_free(error);
+		return -1;
+	}
+	search->workers = threads;
+	for(i = 0; i < threads; i++)
+		g_thread_pool_push(search->pool, GUINT_TO_POINTER(i + 1),
+				NULL);
+	return 0;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorsearch_add */
+static int _hexeditorsearch_add(HexEditorSearch * search, off_t offset,
+		size_t size)
+{
+	size_t alloc;
+	void * p;
+
+	if(search->hits_size + 20 > search->hits_alloc)
+	{
+		alloc = (search->hits_alloc > 0) ? search->hits_alloc * 2
+			: 4096;
+		if((p = realloc(search->hits, alloc)) == NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+		search->hits = p;
+		search->hits_alloc = alloc;
+	}
+	if(search->hits_cnt % HEXEDITORSEARCH_INDEX == 0
+			&& search->index_cnt == search->index_alloc)
+	{
+		alloc = (search->index_alloc > 0) ? search->index_alloc * 2
+			: 64;
+		if((p = realloc(search->index, sizeof(*search->index)
+						* alloc)) == NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+		search->index = p;
+		search->index_alloc = alloc;
+	}
+	search->hits_size += _hexeditorsearch_varint_set(
+			&search->hits[search->hits_size],
+			offset - search->hits_last);
+	if(search->regex != NULL)
+		search->hits_size += _hexeditorsearch_varint_set(
+				&search->hits[search->hits_size], size);
+	search->hits_last = offset;
+	search->hits_end = offset + size;
+	/* the hits indexed are decoded from the following one */
+	if(search->hits_cnt++ % HEXEDITORSEARCH_INDEX == 0)
+	{
+		search->index[search->index_cnt].position = search->hits_size;
+		search->index[search->index_cnt].offset = offset;
+		search->index[search->index_cnt++].size = size;
+	}
+	return 0;
+}
+
+
+/* hexeditorsearch_chunk_add */
+static int _hexeditorsearch_chunk_add(HexEditorSearchChunk * chunk,
+		off_t offset, size_t size)
+{
+	size_t alloc;
+	void * p;
+
+	if(chunk->hits_size + 20 > chunk->hits_alloc)
+	{
+		alloc = (chunk->hits_alloc > 0) ? chunk->hits_alloc * 2 : 256;
+		if((p = realloc(chunk->hits, alloc)) == NULL)
+			return -1;
+		chunk->hits = p;
+		chunk->hits_alloc = alloc;
+	}
+	chunk->hits_size += _hexeditorsearch_varint_set(
+			&chunk->hits[chunk->hits_size], offset - chunk->last);
+	/* the size of the patterns is known */
+	if(size > 0)
+		chunk->hits_size += _hexeditorsearch_varint_set(
+				&chunk->hits[chunk->hits_size], size);
+	chunk->last = offset;
+	return 0;
+}
+
+
+/* hexeditorsearch_merge */
+static int _hexeditorsearch_merge(HexEditorSearch * search,
+		HexEditorSearchChunk * chunk)
+{
+	size_t i;
+	off_t offset = chunk->offset;
+	off_t end = chunk->offset;
+	uint64_t delta;
+	uint64_t size = search->pattern_size;
+
+	/* the hits of regular expressions do not overlap: those of a chunk
+	 * count from the end of the last one merged, if they meet it */
+	if(search->hits_end < chunk->offset)
+		search->hits_end = chunk->offset;
+	for(i = 0; i < chunk->hits_size;)
+	{
+		i += _hexeditorsearch_varint_get(&chunk->hits[i],
+				chunk->hits_size - i, &delta);
+		offset += delta;
+		if(search->regex != NULL)
+			i += _hexeditorsearch_varint_get(&chunk->hits[i],
+					chunk->hits_size - i, &size);
+		if(search->regex != NULL && offset < search->hits_end)
+		{
+			end = offset + size;
+			continue;
+		}
+		/* otherwise the chunk has to be searched again */
+		if(search->regex != NULL && end > search->hits_end)
+			return 1;
+		if(_hexeditorsearch_add(search, offset, size) != 0)
+			return -1;
+		end = search->hits_end;
+	}
+	return (end > search->hits_end && search->hits_end < chunk->end)
+		? 1 : 0;
+}
+
+
+/* hexeditorsearch_varint_get */
+static size_t _hexeditorsearch_varint_get(unsigned char const * buf,
+		size_t size, uint64_t * value)
+{
+	size_t i;
+
+	*value = 0;
+	for(i = 0; i < size && i < 10; i++)
+	{
+		*value |= (uint64_t)(buf[i] & 0x7f) << (i * 7);
+		if((buf[i] & 0x80) == 0)
+			return i + 1;
+	}
+	return 0;
+}
+
+
+/* hexeditorsearch_varint_set */
+static size_t _hexeditorsearch_varint_set(unsigned char * buf,
+		uint64_t value)
+{
+	size_t i;
+
+	for(i = 0; value >= 0x80; i++, value >>= 7)
+		buf[i] = (value & 0x7f) | 0x80;
+	buf[i++] = value;
+	return i;
+}
+
+
+/* callbacks */
+/* hexeditorsearch_on_match */
+static int _hexeditorsearch_on_match(void * data, size_t position,
+		size_t length)
+{
+	HexEditorSearchChunk * chunk = data;
+
+	return _hexeditorsearch_chunk_add(chunk, chunk->offset + position,
+			length);
+}
+
+
+/* hexeditorsearch_on_worker */
+static int _worker_chunk(HexEditorSearch * search, unsigned char * buf,
+		HexEditorSearchChunk * chunk);
+
+static void _hexeditorsearch_on_worker(gpointer data, gpointer user_data)
+{
+	HexEditorSearch * search = user_data;
+	HexEditorSearchRange * range;
+	HexEditorSearchChunk chunk;
+	unsigned char * buf;
+	size_t overlap;
+	off_t size;
+	size_t i;
+	int error = 0;
+
+	(void) data;
+	/* the chunks overlap by the size of the pattern, or of the longest
+	 * match */
+	overlap = (search->regex != NULL) ? HEXEDITORREGEX_MATCH_MAX
+		: search->pattern_size - 1;
+	if((buf = malloc(HEXEDITORSEARCH_CHUNK_SIZE + overlap)) == NULL)
+		error = errno;
+	g_mutex_lock(&search->mutex);
+	for(;;)
+	{
+		if(error != 0 && search->error == 0)
+			search->error = error;
+		/* the hits found are bounded until merged, and the chunks may
+		 * have to be searched again until then */
+		while(search->error == 0 && !search->cancel
+				&& search->redo == 0
+				&& ((search->range < search->ranges_cnt
+						&& search->claimed
+						- search->merged
+						>= HEXEDITORSEARCH_PENDING)
+					|| (search->range
+						>= search->ranges_cnt
+						&& search->merged
+						< search->claimed)))
+			g_cond_wait(&search->cond, &search->mutex);
+		if(search->error != 0 || search->cancel)
+			break;
+		if(search->redo != 0)
+		{
+			i = search->redo - 1;
+			search->redo = 0;
+			chunk = search->chunks[i];
+			size = 0;
+		}
+		else if(search->range < search->ranges_cnt)
+		{
+			/* the chunks do not cross the limits of the ranges */
+			range = &search->ranges[search->range];
+			chunk.offset = range->offset + search->next;
+			chunk.end = (range->size - search->next
+					< HEXEDITORSEARCH_CHUNK_SIZE)
+				? range->offset + range->size
+				: chunk.offset + HEXEDITORSEARCH_CHUNK_SIZE;
+			chunk.limit = (range->offset + range->size - chunk.end
+					< (off_t)overlap)
+				? range->offset + range->size
+				: chunk.end + (off_t)overlap;
+			if((search->next = chunk.end - range->offset)
+					== range->size)
+			{
+				search->range++;
+				search->next = 0;
+			}
+			i = search->claimed++ % HEXEDITORSEARCH_PENDING;
+			size = chunk.end - chunk.offset;
+		}
+		else
+			break;
+		chunk.done = 1;
+		chunk.last = chunk.offset;
+		chunk.hits = NULL;
+		chunk.hits_size = 0;
+		chunk.hits_alloc = 0;
+		g_mutex_unlock(&search->mutex);
+		error = _worker_chunk(search, buf, &chunk);
+		g_mutex_lock(&search->mutex);
+		search->chunks[i] = chunk;
+		search->done += size;
+	}
+	search->workers--;
+	g_mutex_unlock(&search->mutex);
+	free(buf);
+}
+
+static int _worker_chunk(HexEditorSearch * search, unsigned char * buf,
+		HexEditorSearchChunk * chunk)
+{
+	off_t offset = chunk->offset;
+	size_t size = chunk->limit - offset;
+	size_t end = chunk->end - offset;
+	size_t i;
+	ssize_t len;
+	unsigned char const * p;
+
+	for(i = 0; i < size; i += len)
+	{
+		if(search->reader != NULL)
+			len = search->reader(search->reader_data, &buf[i],
+					size - i, offset + i);
+		else
+			len = pread(search->fd, &buf[i], size - i, offset + i);
+		if(len < 0 && errno == EINTR)
+			len = 0;
+		else if(len < 0)
+			return errno;
+		else if(len == 0)
+		{
+			/* the file was truncated meanwhile */
+			size = i;
+			break;
+		}
+	}
+	/* the hits may end in the next chunk */
+	if(search->regex != NULL)
+		return (hexeditorregex_match(search->regex, buf, size, end,
+					_hexeditorsearch_on_match, chunk) != 0)
+			? errno : 0;
+	/* the hits may overlap */
+	for(p = buf; (p = memmem(p, size - (p - buf), search->pattern,
+					search->pattern_size)) != NULL
+			&& (size_t)(p - buf) < end; p++)
+		if(_hexeditorsearch_chunk_add(chunk, offset + (p - buf), 0)
+				!= 0)
+			return errno;
+	return 0;
+}
@@ -0,0 +1,67 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_SEARCH_H
+# define HEXEDITOR_SEARCH_H
+
+# include <sys/types.h>
+# include "buffer.h"
+
+
+/* HexEditorSearch */
+/* public */
+/* types */
+typedef struct _HexEditorSearch HexEditorSearch;
+
+
+/* constants */
+# define HEXEDITORSEARCH_CHUNK_SIZE	(1024 * 1024)
+
+
+/* functions */
+HexEditorSearch * hexeditorsearch_new(unsigned char const * pattern,
+		size_t size);
+/* the hits do not overlap, see regex.h */
+HexEditorSearch * hexeditorsearch_new_regex(char const * expression);
+void hexeditorsearch_delete(HexEditorSearch * search);
+
+/* accessors */
+/* the hits merged so far, in order */
+size_t hexeditorsearch_get_count(HexEditorSearch * search);
+/* returns -1 past the hits merged */
+off_t hexeditorsearch_get_hit(HexEditorSearch * search, size_t index,
+		size_t * size);
+/* how far around the holes to search, or -1 if within them as well */
+off_t hexeditorsearch_get_hole_margin(HexEditorSearch * search);
+off_t hexeditorsearch_get_position(HexEditorSearch * search);
+off_t hexeditorsearch_get_size(HexEditorSearch * search);
+
+/* useful */
+/* the ranges searched, in order and before starting; the ranges overlapping
+ * are merged */
+int hexeditorsearch_add_range(HexEditorSearch * search, off_t offset,
+		off_t size);
+
+/* from fd, or the reader if not NULL */
+int hexeditorsearch_start(HexEditorSearch * search, int fd,
+		HexEditorBufferReader reader, void * data);
+/* stops the workers, the hits found remain to be merged */
+void hexeditorsearch_cancel(HexEditorSearch * search);
+/* merges the hits found, returns 1 while searching */
+int hexeditorsearch_poll(HexEditorSearch * search);
+
+#endif /* !HEXEDITOR_SEARCH_H */
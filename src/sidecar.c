@@ -0,0 +1,515 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <libintl.h>
+#include <System.h>
+#include "sidecar.h"
+#define _(string) gettext(string)
+
+
+/* HexEditorSidecar */
+/* private */
+/* types */
+/* the files are mapped as they are: every field is naturally aligned, and
+ * the version does not match with the other byte order */
+typedef struct _HexEditorSidecarHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t count;
+	/* identity of the file analyzed */
+	uint64_t device;
+	uint64_t inode;
+	uint64_t size;
+	int64_t mtime;
+	uint64_t hash;
+} HexEditorSidecarHeader;
+
+typedef struct _HexEditorSidecarSection
+{
+	char name[HEXEDITORSIDECAR_NAME_SIZE];
+	uint64_t offset;
+	uint64_t size;
+} HexEditorSidecarSection;
+
+typedef struct _HexEditorSidecarEntry
+{
+	char name[HEXEDITORSIDECAR_NAME_SIZE];
+	void * data;
+	size_t size;
+} HexEditorSidecarEntry;
+
+struct _HexEditorSidecar
+{
+	String * directory;
+	String * filename;
+	/* the file analyzed, kept open by the caller */
+	int fd;
+	HexEditorSidecarHeader key;
+
+	/* saved previously, mapped read-only */
+	void * map;
+	size_t map_size;
+	HexEditorSidecarSection const * sections;
+	size_t sections_cnt;
+
+	/* to be saved */
+	HexEditorSidecarEntry * entries;
+	size_t entries_cnt;
+};
+
+
+/* constants */
+#define HEXEDITORSIDECAR_MAGIC		"HEXEDSC"
+#define HEXEDITORSIDECAR_ALIGN		16
+#define HEXEDITORSIDECAR_SAMPLE		4096
+#define HEXEDITORSIDECAR_SAMPLES	4
+
+
+/* prototypes */
+static int _hexeditorsidecar_hash(int fd, off_t size, uint64_t * hash);
+static int _hexeditorsidecar_key(int fd, HexEditorSidecarHeader * key);
+static int _hexeditorsidecar_map(HexEditorSidecar * sidecar);
+static int64_t _hexeditorsidecar_mtime(struct stat const * st);
+
+
+/* public */
+/* functions */
+/* hexeditorsidecar_new */
+HexEditorSidecar * hexeditorsidecar_new(int fd, char const * directory)
+{
+	HexEditorSidecar * sidecar;
+	HexEditorSidecarHeader key;
+
+	if(_hexeditorsidecar_key(fd, &key) != 0)
+		return NULL;
+	if((sidecar = object_new(sizeof(*sidecar))) == NULL)
+		return NULL;
+	sidecar->fd = fd;
+	sidecar->key = key;
+	sidecar->directory = string_new(directory);
+	sidecar->filename = string_new_format("%s/%016llx-%016llx",
+			directory, (unsigned long long)key.device,
+			(unsigned long long)key.inode);
+	sidecar->map = NULL;
+	sidecar->map_size = 0;
+	sidecar->sections = NULL;
+	sidecar->sections_cnt = 0;
+	sidecar->entries = NULL;
+	sidecar->entries_cnt = 0;
+	if(sidecar->directory == NULL || sidecar->filename == NULL)
+	{
+		hexeditorsidecar_delete(sidecar);
+		return NULL;
+	}
+	/* previous results are optional */
+	_hexeditorsidecar_map(sidecar);
+	return sidecar;
+}
+
+
+/* hexeditorsidecar_delete */
+void hexeditorsidecar_delete(HexEditorSidecar * sidecar)
+{
+	size_t i;
+
+	for(i = 0; i < sidecar->entries_cnt; i++)
+		free(sidecar->entries[i].data);
+	free(sidecar->entries);
+	if(sidecar->map != NULL)
+		munmap(sidecar->map, sidecar->map_size);
+	if(sidecar->filename != NULL)
+		string_delete(sidecar->filename);
+	if(sidecar->directory != NULL)
+		string_delete(sidecar->directory);
+	object_delete(sidecar);
+}
+
+
+/* accessors */
+/* hexeditorsidecar_get */
+void const * hexeditorsidecar_get(HexEditorSidecar * sidecar,
+		char const * name, size_t * size)
+{
+	size_t i;
+	char const * p = sidecar->map;
+
+	for(i = 0; i < sidecar->entries_cnt; i++)
+		if(strcmp(sidecar->entries[i].name, name) == 0)
+		{
+			*size = sidecar->entries[i].size;
+			return (sidecar->entries[i].data != NULL)
+				? sidecar->entries[i].data : "";
+		}
+	for(i = 0; i < sidecar->sections_cnt; i++)
+		if(strcmp(sidecar->sections[i].name, name) == 0)
+		{
+			*size = sidecar->sections[i].size;
+			return &p[sidecar->sections[i].offset];
+		}
+	return NULL;
+}
+
+
+/* hexeditorsidecar_get_filename */
+char const * hexeditorsidecar_get_filename(HexEditorSidecar * sidecar)
+{
+	return sidecar->filename;
+}
+
+
+/* hexeditorsidecar_get_key */
+uint64_t hexeditorsidecar_get_key(HexEditorSidecar * sidecar)
+{
+	unsigned char const * p = (unsigned char const *)&sidecar->key;
+	uint64_t h = 0xcbf29ce484222325ULL;
+	size_t i;
+
+	/* identifies this very version of the file, for companion files */
+	for(i = 0; i < sizeof(sidecar->key); i++)
+	{
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+
+/* hexeditorsidecar_set */
+int hexeditorsidecar_set(HexEditorSidecar * sidecar, char const * name,
+		void const * data, size_t size)
+{
+	HexEditorSidecarEntry * entry = NULL;
+	void * p = NULL;
+	size_t i;
+
+	if(strlen(name) >= HEXEDITORSIDECAR_NAME_SIZE)
+		return -error_set_code(1, "%s: %s", name,
+				strerror(ENAMETOOLONG));
+	if(size > 0)
+	{
+		if((p = malloc(size)) == NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+		memcpy(p, data, size);
+	}
+	for(i = 0; i < sidecar->entries_cnt; i++)
+		if(strcmp(sidecar->entries[i].name, name) == 0)
+		{
+			entry = &sidecar->entries[i];
+			free(entry->data);
+			break;
+		}
+	if(entry == NULL)
+	{
+		if((entry = realloc(sidecar->entries, sizeof(*entry)
+						* (sidecar->entries_cnt + 1)))
+				== NULL)
+		{
+			free(p);
+			return -error_set_code(1, "%s", strerror(errno));
+		}
+		sidecar->entries = entry;
+		entry = &sidecar->entries[sidecar->entries_cnt++];
+		memset(entry->name, 0, sizeof(entry->name));
+		strcpy(entry->name, name);
+	}
+	entry->data = p;
+	entry->size = size;
+	return 0;
+}
+
+
+/* useful */
+/* hexeditorsidecar_save */
+static int _save_write(FILE * fp, void const * data, size_t size,
+		uint64_t * offset);
+
+int hexeditorsidecar_save(HexEditorSidecar * sidecar)
+{
+	int ret = 0;
+	HexEditorSidecarHeader header;
+	HexEditorSidecarSection * sections;
+	void const ** data;
+	char const * p = sidecar->map;
+	size_t i;
+	size_t j;
+	String * filename;
+	int fd;
+	FILE * fp;
+	uint64_t offset = 0;
+
+	/* the file may have grown or changed since, as when followed */
+	if(_hexeditorsidecar_key(sidecar->fd, &header) != 0)
+		return -1;
+	if(memcmp(&header, &sidecar->key, sizeof(header)) != 0)
+	{
+		/* the results saved previously no longer apply */
+		if(sidecar->map != NULL)
+			munmap(sidecar->map, sidecar->map_size);
+		sidecar->map = NULL;
+		sidecar->map_size = 0;
+		sidecar->sections = NULL;
+		sidecar->sections_cnt = 0;
+		sidecar->key = header;
+		p = NULL;
+	}
+	if(mkdir(sidecar->directory, 0700) != 0 && errno != EEXIST)
+		return -error_set_code(1, "%s: %s", sidecar->directory,
+				strerror(errno));
+	sections = calloc(sidecar->entries_cnt + sidecar->sections_cnt + 1,
+			sizeof(*sections));
+	data = calloc(sidecar->entries_cnt + sidecar->sections_cnt + 1,
+			sizeof(*data));
+	if(sections == NULL || data == NULL)
+	{
+		free(sections);
+		free(data);
+		return -error_set_code(1, "%s", strerror(errno));
+	}
+	/* the new results replace the sections of the same name */
+	for(i = 0; i < sidecar->entries_cnt; i++, header.count++)
+	{
+		memcpy(sections[i].name, sidecar->entries[i].name,
+				sizeof(sections[i].name));
+		sections[i].size = sidecar->entries[i].size;
+		data[i] = sidecar->entries[i].data;
+	}
+	for(i = 0; i < sidecar->sections_cnt; i++)
+	{
+		for(j = 0; j < sidecar->entries_cnt; j++)
+			if(strcmp(sidecar->entries[j].name,
+						sidecar->sections[i].name) == 0)
+				break;
+		if(j < sidecar->entries_cnt)
+			continue;
+		sections[header.count] = sidecar->sections[i];
+		data[header.count++] = &p[sidecar->sections[i].offset];
+	}
+	offset = sizeof(header) + sizeof(*sections) * header.count;
+	for(i = 0; i < header.count; i++)
+	{
+		offset = (offset + HEXEDITORSIDECAR_ALIGN - 1)
+			& ~(uint64_t)(HEXEDITORSIDECAR_ALIGN - 1);
+		sections[i].offset = offset;
+		offset += sections[i].size;
+	}
+	/* write to a temporary file, then replace the previous one */
+	if((filename = string_new_append(sidecar->filename, ".XXXXXX", NULL))
+			== NULL)
+		ret = -1;
+	else if((fd = mkstemp(filename)) < 0)
+		ret = -error_set_code(1, "%s: %s", filename, strerror(errno));
+	else if((fp = fdopen(fd, "w")) == NULL)
+	{
+		ret = -error_set_code(1, "%s: %s", filename, strerror(errno));
+		close(fd);
+	}
+	else
+	{
+		offset = 0;
+		if(_save_write(fp, &header, sizeof(header), &offset) != 0
+				|| _save_write(fp, sections, sizeof(*sections)
+					* header.count, &offset) != 0)
+			ret = -1;
+		for(i = 0; ret == 0 && i < header.count; i++)
+			if(_save_write(fp, NULL, sections[i].offset - offset,
+						&offset) != 0
+					|| _save_write(fp, data[i],
+						sections[i].size, &offset)
+					!= 0)
+				ret = -1;
+		if(fclose(fp) != 0 && ret == 0)
+			ret = -1;
+		if(ret != 0)
+			error_set_code(1, "%s: %s", filename, strerror(errno));
+		else if(rename(filename, sidecar->filename) != 0)
+			ret = -error_set_code(1, "%s: %s", sidecar->filename,
+					strerror(errno));
+		if(ret != 0)
+			unlink(filename);
+	}
+	if(filename != NULL)
+		string_delete(filename);
+	free(data);
+	free(sections);
+	return ret;
+}
+
+static int _save_write(FILE * fp, void const * data, size_t size,
+		uint64_t * offset)
+{
+	static const char zero[HEXEDITORSIDECAR_ALIGN];
+
+	/* padding */
+	if(data == NULL && size > sizeof(zero))
+		return -1;
+	if(size > 0 && fwrite((data != NULL) ? data : zero, size, 1, fp) != 1)
+		return -1;
+	*offset += size;
+	return 0;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorsidecar_hash */
+static int _hexeditorsidecar_hash(int fd, off_t size, uint64_t * hash)
+{
+	char buf[HEXEDITORSIDECAR_SAMPLE];
+	uint64_t h = 0xcbf29ce484222325ULL;
+	off_t offset;
+	ssize_t res;
+	size_t i;
+	ssize_t j;
+
+	/* FNV-1a over a few samples spread over the file */
+	for(i = 0; i < HEXEDITORSIDECAR_SAMPLES; i++)
+	{
+		offset = (size / (HEXEDITORSIDECAR_SAMPLES - 1)) * i;
+		if(offset + (off_t)sizeof(buf) > size)
+			offset = (size > (off_t)sizeof(buf))
+				? size - (off_t)sizeof(buf) : 0;
+		while((res = pread(fd, buf, sizeof(buf), offset)) < 0
+				&& errno == EINTR);
+		if(res < 0)
+			return -error_set_code(1, "%s", strerror(errno));
+		for(j = 0; j < res; j++)
+		{
+			h ^= (unsigned char)buf[j];
+			h *= 0x100000001b3ULL;
+		}
+	}
+	*hash = h;
+	return 0;
+}
+
+
+/* hexeditorsidecar_key */
+static int _hexeditorsidecar_key(int fd, HexEditorSidecarHeader * key)
+{
+	struct stat st;
+
+	if(fstat(fd, &st) != 0)
+		return -error_set_code(1, "%s", strerror(errno));
+	/* devices and pipes have no stable identity */
+	if(!S_ISREG(st.st_mode))
+		return -error_set_code(1, "%s", strerror(ENOTSUP));
+	memset(key, 0, sizeof(*key));
+	memcpy(key->magic, HEXEDITORSIDECAR_MAGIC, sizeof(key->magic));
+	key->version = HEXEDITORSIDECAR_VERSION;
+	key->device = st.st_dev;
+	key->inode = st.st_ino;
+	key->size = st.st_size;
+	key->mtime = _hexeditorsidecar_mtime(&st);
+	return _hexeditorsidecar_hash(fd, st.st_size, &key->hash);
+}
+
+
+/* hexeditorsidecar_map */
+static int _hexeditorsidecar_map(HexEditorSidecar * sidecar)
+{
+	int fd;
+	struct stat st;
+	HexEditorSidecarHeader const * header;
+	HexEditorSidecarHeader const * key = &sidecar->key;
+	HexEditorSidecarSection const * sections;
+	size_t i;
+
+	if((fd = open(sidecar->filename, O_RDONLY)) < 0)
+		return -error_set_code(1, "%s: %s", sidecar->filename,
+				strerror(errno));
+	if(fstat(fd, &st) != 0)
+	{
+		close(fd);
+		return -error_set_code(1, "%s: %s", sidecar->filename,
+				strerror(errno));
+	}
+	if(st.st_size < (off_t)sizeof(*header))
+	{
+		close(fd);
+		return -error_set_code(1, "%s: %s", sidecar->filename,
+				strerror(EINVAL));
+	}
+	sidecar->map_size = st.st_size;
+	sidecar->map = mmap(NULL, sidecar->map_size, PROT_READ, MAP_SHARED,
+			fd, 0);
+	close(fd);
+	if(sidecar->map == MAP_FAILED)
+	{
+		sidecar->map = NULL;
+		return -error_set_code(1, "%s: %s", sidecar->filename,
+				strerror(errno));
+	}
+	header = sidecar->map;
+	sections = (HexEditorSidecarSection const *)&header[1];
+	/* only trust results for this very version of the file */
+	if(memcmp(header->magic, key->magic, sizeof(key->magic)) != 0
+			|| header->version != key->version
+			|| header->device != key->device
+			|| header->inode != key->inode
+			|| header->size != key->size
+			|| header->mtime != key->mtime
+			|| header->hash != key->hash
+			|| header->count > (sidecar->map_size - sizeof(*header))
+			/ sizeof(*sections))
+		i = SIZE_MAX;
+	else
+		for(i = 0; i < header->count; i++)
+			if(memchr(sections[i].name, '\0',
+						sizeof(sections[i].name)) == NULL
+					|| sections[i].offset
+					% HEXEDITORSIDECAR_ALIGN != 0
+					|| sections[i].offset
+					> sidecar->map_size
+					|| sections[i].size > sidecar->map_size
+					- sections[i].offset)
+				break;
+	if(i != header->count)
+	{
+		munmap(sidecar->map, sidecar->map_size);
+		sidecar->map = NULL;
+		sidecar->map_size = 0;
+		return -error_set_code(1, "%s: %s", sidecar->filename,
+				_("Obsolete or invalid cache"));
+	}
+	sidecar->sections = sections;
+	sidecar->sections_cnt = header->count;
+	return 0;
+}
+
+
+/* hexeditorsidecar_mtime */
+static int64_t _hexeditorsidecar_mtime(struct stat const * st)
+{
+	int64_t ret = (int64_t)st->st_mtime * 1000000000;
+
+#if defined(__APPLE__) || defined(__NetBSD__)
+	ret += st->st_mtimespec.tv_nsec;
+#elif defined(__linux__) || defined(__FreeBSD__) || defined(__OpenBSD__)
+	ret += st->st_mtim.tv_nsec;
+#endif
+	return ret;
+}
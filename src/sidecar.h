@@ -0,0 +1,52 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_SIDECAR_H
+# define HEXEDITOR_SIDECAR_H
+
+# include <sys/types.h>
+# include <stdint.h>
+
+
+/* HexEditorSidecar */
+/* public */
+/* types */
+typedef struct _HexEditorSidecar HexEditorSidecar;
+
+
+/* constants */
+# define HEXEDITORSIDECAR_VERSION	1
+# define HEXEDITORSIDECAR_NAME_SIZE	48
+
+
+/* functions */
+HexEditorSidecar * hexeditorsidecar_new(int fd, char const * directory);
+void hexeditorsidecar_delete(HexEditorSidecar * sidecar);
+
+/* accessors */
+void const * hexeditorsidecar_get(HexEditorSidecar * sidecar,
+		char const * name, size_t * size);
+char const * hexeditorsidecar_get_filename(HexEditorSidecar * sidecar);
+uint64_t hexeditorsidecar_get_key(HexEditorSidecar * sidecar);
+
+int hexeditorsidecar_set(HexEditorSidecar * sidecar, char const * name,
+		void const * data, size_t size);
+
+/* useful */
+int hexeditorsidecar_save(HexEditorSidecar * sidecar);
+
+#endif /* !HEXEDITOR_SIDECAR_H */
@@ -0,0 +1,241 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE /* for O_TMPFILE */
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <System.h>
+#include "spool.h"
+
+
+/* HexEditorSpool */
+/* private */
+/* types */
+struct _HexEditorSpool
+{
+	int fd;
+	size_t memory;
+	int complete;
+
+	/* the readers may be other threads */
+	GMutex mutex;
+	off_t size;
+	/* in memory, until spilled to the file */
+	unsigned char * buf;
+	size_t buf_alloc;
+	int file;
+};
+
+
+/* prototypes */
+static int _hexeditorspool_append(HexEditorSpool * spool, void const * buf,
+		size_t size);
+static int _hexeditorspool_spill(HexEditorSpool * spool);
+
+
+/* public */
+/* functions */
+/* hexeditorspool_new */
+HexEditorSpool * hexeditorspool_new(int fd, size_t memory)
+{
+	HexEditorSpool * spool;
+
+	if((spool = object_new(sizeof(*spool))) == NULL)
+		return NULL;
+	spool->fd = fd;
+	spool->memory = memory;
+	spool->complete = 0;
+	g_mutex_init(&spool->mutex);
+	spool->size = 0;
+	spool->buf = NULL;
+	spool->buf_alloc = 0;
+	spool->file = -1;
+	return spool;
+}
+
+
+/* hexeditorspool_delete */
+void hexeditorspool_delete(HexEditorSpool * spool)
+{
+	if(spool->file >= 0)
+		close(spool->file);
+	free(spool->buf);
+	g_mutex_clear(&spool->mutex);
+	object_delete(spool);
+}
+
+
+/* accessors */
+/* hexeditorspool_is_complete */
+int hexeditorspool_is_complete(HexEditorSpool * spool)
+{
+	return spool->complete;
+}
+
+
+/* hexeditorspool_get_size */
+off_t hexeditorspool_get_size(HexEditorSpool * spool)
+{
+	off_t ret;
+
+	g_mutex_lock(&spool->mutex);
+	ret = spool->size;
+	g_mutex_unlock(&spool->mutex);
+	return ret;
+}
+
+
+/* useful */
+/* hexeditorspool_fill */
+ssize_t hexeditorspool_fill(HexEditorSpool * spool, void * buf, size_t size)
+{
+	ssize_t res;
+
+	if(spool->complete)
+		return 0;
+	while((res = read(spool->fd, buf, size)) < 0 && errno == EINTR);
+	if(res < 0)
+		return -error_set_code(1, "%s", strerror(errno));
+	if(res == 0)
+	{
+		spool->complete = 1;
+		return 0;
+	}
+	g_mutex_lock(&spool->mutex);
+	if(_hexeditorspool_append(spool, buf, res) != 0)
+		res = -1;
+	g_mutex_unlock(&spool->mutex);
+	return res;
+}
+
+
+/* hexeditorspool_read */
+ssize_t hexeditorspool_read(HexEditorSpool * spool, void * buf, size_t size,
+		off_t offset)
+{
+	ssize_t ret;
+
+	g_mutex_lock(&spool->mutex);
+	if(offset >= spool->size)
+		ret = 0;
+	else
+	{
+		if((off_t)size > spool->size - offset)
+			size = spool->size - offset;
+		if(spool->file < 0)
+		{
+			memcpy(buf, &spool->buf[offset], size);
+			ret = size;
+		}
+		else if((ret = pread(spool->file, buf, size, offset)) < 0)
+			error_set_code(1, "%s", strerror(errno));
+	}
+	g_mutex_unlock(&spool->mutex);
+	return ret;
+}
+
+
+/* private */
+/* functions */
+/* hexeditorspool_append */
+static int _hexeditorspool_append(HexEditorSpool * spool, void const * buf,
+		size_t size)
+{
+	size_t alloc;
+	ssize_t res;
+	void * p;
+
+	if(spool->file < 0 && (size_t)spool->size + size > spool->memory
+			&& _hexeditorspool_spill(spool) != 0)
+		return -1;
+	if(spool->file >= 0)
+	{
+		for(; size > 0; size -= res, buf = (char const *)buf + res)
+			if((res = pwrite(spool->file, buf, size, spool->size))
+					< 0 && errno == EINTR)
+				res = 0;
+			else if(res < 0)
+				return -error_set_code(1, "%s",
+						strerror(errno));
+			else
+				spool->size += res;
+		return 0;
+	}
+	if((size_t)spool->size + size > spool->buf_alloc)
+	{
+		for(alloc = (spool->buf_alloc > 0) ? spool->buf_alloc : 65536;
+				alloc < (size_t)spool->size + size; alloc *= 2);
+		if((p = realloc(spool->buf, alloc)) == NULL)
+			return -error_set_code(1, "%s", strerror(errno));
+		spool->buf = p;
+		spool->buf_alloc = alloc;
+	}
+	memcpy(&spool->buf[spool->size], buf, size);
+	spool->size += size;
+	return 0;
+}
+
+
+/* hexeditorspool_spill */
+static int _hexeditorspool_spill(HexEditorSpool * spool)
+{
+	char const * tmpdir;
+	String * filename;
+	off_t size = spool->size;
+	int fd = -1;
+
+	if((tmpdir = getenv("TMPDIR")) == NULL)
+		tmpdir = P_tmpdir;
+	/* the file disappears with the descriptor */
+#ifdef O_TMPFILE
+	fd = open(tmpdir, O_TMPFILE | O_RDWR | O_EXCL, 0600);
+#endif
+	if(fd < 0)
+	{
+		if((filename = string_new_append(tmpdir, "/hexeditor.XXXXXX",
+						NULL)) == NULL)
+			return -1;
+		if((fd = mkstemp(filename)) < 0)
+		{
+			error_set_code(1, "%s: %s", filename, strerror(errno));
+			string_delete(filename);
+			return -1;
+		}
+		unlink(filename);
+		string_delete(filename);
+	}
+	spool->file = fd;
+	spool->size = 0;
+	if(_hexeditorspool_append(spool, spool->buf, size) != 0)
+	{
+		close(fd);
+		spool->file = -1;
+		spool->size = size;
+		return -1;
+	}
+	free(spool->buf);
+	spool->buf = NULL;
+	spool->buf_alloc = 0;
+	return 0;
+}
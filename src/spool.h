@@ -0,0 +1,51 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_SPOOL_H
+# define HEXEDITOR_SPOOL_H
+
+# include <sys/types.h>
+
+
+/* HexEditorSpool */
+/* public */
+/* types */
+typedef struct _HexEditorSpool HexEditorSpool;
+
+
+/* constants */
+/* kept in memory, then in a temporary file */
+# define HEXEDITORSPOOL_MEMORY		(64 * 1024 * 1024)
+
+
+/* functions */
+/* keeps what is read from fd, which cannot seek */
+HexEditorSpool * hexeditorspool_new(int fd, size_t memory);
+void hexeditorspool_delete(HexEditorSpool * spool);
+
+/* accessors */
+int hexeditorspool_is_complete(HexEditorSpool * spool);
+off_t hexeditorspool_get_size(HexEditorSpool * spool);
+
+/* useful */
+/* reads once from fd into buf, and keeps it; returns 0 once complete */
+ssize_t hexeditorspool_fill(HexEditorSpool * spool, void * buf, size_t size);
+/* what was kept so far */
+ssize_t hexeditorspool_read(HexEditorSpool * spool, void * buf, size_t size,
+		off_t offset);
+
+#endif /* !HEXEDITOR_SPOOL_H */
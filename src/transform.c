@@ -0,0 +1,468 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <glib.h>
+#include <System.h>
+#include "transform.h"
+
+
+/* HexEditorTransform */
+/* private */
+/* types */
+struct _HexEditorTransform
+{
+	HexEditorTransformOperation operation;
+	/* the key, then enough of it again to be read from any position */
+	unsigned char * key;
+	size_t key_size;
+	unsigned int bits;
+
+	/* the file */
+	int fd;
+	HexEditorBufferReader reader;
+	void * reader_data;
+	int out;
+	/* the range transformed, then what is written */
+	off_t offset;
+	off_t end;
+	off_t first;
+	off_t last;
+
+	/* the workers, claiming the chunks in turn */
+	GThreadPool * pool;
+	GMutex mutex;
+	off_t next;
+	off_t done;
+	unsigned int workers;
+	int cancel;
+	int error;
+};
+
+
+/* constants */
+/* the key is applied a block at a time */
+#define HEXEDITORTRANSFORM_BLOCK_SIZE	256
+#define HEXEDITORTRANSFORM_THREADS	16
+
+#define HEXEDITORTRANSFORM_HIGH		0x8080808080808080ULL
+#define HEXEDITORTRANSFORM_BYTES	0x0101010101010101ULL
+
+
+/* prototypes */
+static void _hexeditortransform_add(unsigned char * buf,
+		unsigned char const * key, size_t size);
+static void _hexeditortransform_rotate(unsigned char * buf, size_t size,
+		unsigned int bits);
+static void _hexeditortransform_swap(unsigned char * buf, size_t size,
+		size_t width);
+static void _hexeditortransform_xor(unsigned char * buf,
+		unsigned char const * key, size_t size);
+
+/* callbacks */
+static void _hexeditortransform_on_worker(gpointer data, gpointer user_data);
+
+
+/* public */
+/* functions */
+/* hexeditortransform_new */
+HexEditorTransform * hexeditortransform_new(
+		HexEditorTransformOperation operation,
+		unsigned char const * key, size_t key_size)
+{
+	HexEditorTransform * transform;
+	size_t i;
+
+	if(operation > HETO_LAST || ((operation <= HETO_ROTATE
+					|| operation == HETO_FILL)
+				&& key_size == 0)
+			|| (operation == HETO_ROTATE && key_size != 1))
+	{
+		error_set_code(1, "%s", strerror(EINVAL));
+		return NULL;
+	}
+	if((transform = object_new(sizeof(*transform))) == NULL)
+		return NULL;
+	transform->operation = operation;
+	transform->key = NULL;
+	transform->key_size = key_size;
+	transform->bits = (operation == HETO_ROTATE) ? key[0] % 8 : 0;
+	transform->fd = -1;
+	transform->reader = NULL;
+	transform->reader_data = NULL;
+	transform->out = -1;
+	transform->offset = 0;
+	transform->end = 0;
+	transform->first = 0;
+	transform->last = 0;
+	transform->pool = NULL;
+	g_mutex_init(&transform->mutex);
+	transform->next = 0;
+	transform->done = 0;
+	transform->workers = 0;
+	transform->cancel = 0;
+	transform->error = 0;
+	if(key_size > 0 && (transform->key = malloc(key_size
+					+ HEXEDITORTRANSFORM_BLOCK_SIZE))
+			== NULL)
+	{
+		error_set_code(1, "%s", strerror(errno));
+		hexeditortransform_delete(transform);
+		return NULL;
+	}
+	for(i = 0; i < key_size + HEXEDITORTRANSFORM_BLOCK_SIZE
+			&& key_size > 0; i++)
+		/* subtracting is adding the opposite */
+		transform->key[i] = (operation == HETO_SUB)
+			? -key[i % key_size] : key[i % key_size];
+	return transform;
+}
+
+
+/* hexeditortransform_delete */
+void hexeditortransform_delete(HexEditorTransform * transform)
+{
+	/* wait for the workers, once they notice */
+	if(transform->pool != NULL)
+	{
+		g_mutex_lock(&transform->mutex);
+		transform->cancel = 1;
+		g_mutex_unlock(&transform->mutex);
+		g_thread_pool_free(transform->pool, FALSE, TRUE);
+	}
+	g_mutex_clear(&transform->mutex);
+	free(transform->key);
+	object_delete(transform);
+}
+
+
+/* accessors */
+/* hexeditortransform_get_position */
+off_t hexeditortransform_get_position(HexEditorTransform * transform)
+{
+	off_t ret;
+
+	g_mutex_lock(&transform->mutex);
+	ret = transform->done;
+	g_mutex_unlock(&transform->mutex);
+	return ret;
+}
+
+
+/* hexeditortransform_get_size */
+off_t hexeditortransform_get_size(HexEditorTransform * transform)
+{
+	return transform->last - transform->first;
+}
+
+
+/* useful */
+/* hexeditortransform_apply */
+void hexeditortransform_apply(HexEditorTransform * transform,
+		unsigned char * buf, size_t size, off_t position)
+{
+	size_t i;
+	size_t n;
+	unsigned char const * key;
+
+	switch(transform->operation)
+	{
+		case HETO_ROTATE:
+			_hexeditortransform_rotate(buf, size, transform->bits);
+			return;
+		case HETO_SWAP16:
+			_hexeditortransform_swap(buf, size, 2);
+			return;
+		case HETO_SWAP32:
+			_hexeditortransform_swap(buf, size, 4);
+			return;
+		case HETO_SWAP64:
+			_hexeditortransform_swap(buf, size, 8);
+			return;
+		default:
+			break;
+	}
+	for(i = 0; i < size; i += n)
+	{
+		n = (size - i < HEXEDITORTRANSFORM_BLOCK_SIZE) ? size - i
+			: HEXEDITORTRANSFORM_BLOCK_SIZE;
+		key = &transform->key[(position + i) % transform->key_size];
+		if(transform->operation == HETO_XOR)
+			_hexeditortransform_xor(&buf[i], key, n);
+		else if(transform->operation == HETO_FILL)
+			memcpy(&buf[i], key, n);
+		else
+			_hexeditortransform_add(&buf[i], key, n);
+	}
+}
+
+
+/* hexeditortransform_poll */
+int hexeditortransform_poll(HexEditorTransform * transform)
+{
+	int ret;
+
+	g_mutex_lock(&transform->mutex);
+	if(transform->error != 0)
+		ret = -error_set_code(1, "%s", strerror(transform->error));
+	else
+		ret = (transform->workers > 0) ? 1 : 0;
+	g_mutex_unlock(&transform->mutex);
+	return ret;
+}
+
+
+/* hexeditortransform_start */
+int hexeditortransform_start(HexEditorTransform * transform, int fd,
+		HexEditorBufferReader reader, void * data, off_t offset,
+		off_t size, off_t total, int out)
+{
+	unsigned int threads;
+	unsigned int i;
+	GError * error = NULL;
+
+	if(transform->pool != NULL || offset < 0 || size <= 0
+			|| (total != 0 && total < offset + size))
+		return -error_set_code(1, "%s", strerror(EINVAL));
+	transform->fd = fd;
+	transform->reader = reader;
+	transform->reader_data = data;
+	transform->out = out;
+	transform->offset = offset;
+	transform->end = offset + size;
+	transform->first = (total != 0) ? 0 : offset;
+	transform->last = (total != 0) ? total : offset + size;
+	transform->next = transform->first;
+	transform->done = 0;
+	/* the readers are not expected to be reentrant */
+	if(reader != NULL)
+		threads = 1;
+	else if((threads = g_get_num_processors())
+			> HEXEDITORTRANSFORM_THREADS)
+		threads = HEXEDITORTRANSFORM_THREADS;
+	if((transform->pool = g_thread_pool_new(_hexeditortransform_on_worker,
+					transform, threads, FALSE, &error))
+			== NULL)
+	{
+		error_set_code(1, "%s", error->message);
+		g_error_free(error);
+		return -1;
+	}
+	transform->workers = threads;
+	for(i = 0; i < threads; i++)
+		g_thread_pool_push(transform->pool, GUINT_TO_POINTER(i + 1),
+				NULL);
+	return 0;
+}
+
+
+/* private */
+/* functions */
+/* hexeditortransform_add */
+static void _hexeditortransform_add(unsigned char * buf,
+		unsigned char const * key, size_t size)
+{
+	const uint64_t high = HEXEDITORTRANSFORM_HIGH;
+	uint64_t a;
+	uint64_t b;
+	size_t i;
+
+	/* eight bytes at once, without carrying from one to the next */
+	for(i = 0; i + 8 <= size; i += 8)
+	{
+		memcpy(&a, &buf[i], 8);
+		memcpy(&b, &key[i], 8);
+		a = ((a & ~high) + (b & ~high)) ^ ((a ^ b) & high);
+		memcpy(&buf[i], &a, 8);
+	}
+	for(; i < size; i++)
+		buf[i] += key[i];
+}
+
+
+/* hexeditortransform_rotate */
+static void _hexeditortransform_rotate(unsigned char * buf, size_t size,
+		unsigned int bits)
+{
+	uint64_t left;
+	uint64_t right;
+	uint64_t a;
+	size_t i;
+
+	if(bits == 0)
+		return;
+	/* the bits remaining within every byte */
+	left = HEXEDITORTRANSFORM_BYTES * ((0xff << bits) & 0xff);
+	right = HEXEDITORTRANSFORM_BYTES * (0xff >> (8 - bits));
+	for(i = 0; i + 8 <= size; i += 8)
+	{
+		memcpy(&a, &buf[i], 8);
+		a = ((a << bits) & left) | ((a >> (8 - bits)) & right);
+		memcpy(&buf[i], &a, 8);
+	}
+	for(; i < size; i++)
+		buf[i] = (buf[i] << bits) | (buf[i] >> (8 - bits));
+}
+
+
+/* hexeditortransform_swap */
+static void _hexeditortransform_swap(unsigned char * buf, size_t size,
+		size_t width)
+{
+	uint64_t a;
+	size_t i;
+	size_t j;
+	unsigned char c;
+
+	/* a partial word at the end is left alone */
+	size -= size % width;
+	/* swap the bytes, then the pairs and the halves as wide */
+	for(i = 0; i + 8 <= size; i += 8)
+	{
+		memcpy(&a, &buf[i], 8);
+		a = ((a & 0x00ff00ff00ff00ffULL) << 8)
+			| ((a >> 8) & 0x00ff00ff00ff00ffULL);
+		if(width >= 4)
+			a = ((a & 0x0000ffff0000ffffULL) << 16)
+				| ((a >> 16) & 0x0000ffff0000ffffULL);
+		if(width == 8)
+			a = (a << 32) | (a >> 32);
+		memcpy(&buf[i], &a, 8);
+	}
+	for(; i < size; i += width)
+		for(j = 0; j < width / 2; j++)
+		{
+			c = buf[i + j];
+			buf[i + j] = buf[i + width - j - 1];
+			buf[i + width - j - 1] = c;
+		}
+}
+
+
+/* hexeditortransform_xor */
+static void _hexeditortransform_xor(unsigned char * buf,
+		unsigned char const * key, size_t size)
+{
+	uint64_t a;
+	uint64_t b;
+	size_t i;
+
+	for(i = 0; i + 8 <= size; i += 8)
+	{
+		memcpy(&a, &buf[i], 8);
+		memcpy(&b, &key[i], 8);
+		a ^= b;
+		memcpy(&buf[i], &a, 8);
+	}
+	for(; i < size; i++)
+		buf[i] ^= key[i];
+}
+
+
+/* callbacks */
+/* hexeditortransform_on_worker */
+static int _worker_chunk(HexEditorTransform * transform, unsigned char * buf,
+		off_t offset, size_t size);
+
+static void _hexeditortransform_on_worker(gpointer data, gpointer user_data)
+{
+	HexEditorTransform * transform = user_data;
+	unsigned char * buf;
+	off_t offset;
+	size_t size;
+	int error = 0;
+
+	(void) data;
+	if((buf = malloc(HEXEDITORTRANSFORM_CHUNK_SIZE)) == NULL)
+		error = errno;
+	for(;;)
+	{
+		g_mutex_lock(&transform->mutex);
+		if(error != 0 && transform->error == 0)
+			transform->error = error;
+		if(transform->error != 0 || transform->cancel
+				|| transform->next >= transform->last)
+			break;
+		/* the chunks do not cross the limits of the range */
+		offset = transform->next;
+		size = (transform->last - offset
+				< HEXEDITORTRANSFORM_CHUNK_SIZE)
+			? transform->last - offset
+			: HEXEDITORTRANSFORM_CHUNK_SIZE;
+		if(offset < transform->offset
+				&& offset + (off_t)size > transform->offset)
+			size = transform->offset - offset;
+		else if(offset < transform->end
+				&& offset + (off_t)size > transform->end)
+			size = transform->end - offset;
+		transform->next += size;
+		g_mutex_unlock(&transform->mutex);
+		error = _worker_chunk(transform, buf, offset, size);
+	}
+	transform->workers--;
+	g_mutex_unlock(&transform->mutex);
+	free(buf);
+}
+
+static int _worker_chunk(HexEditorTransform * transform, unsigned char * buf,
+		off_t offset, size_t size)
+{
+	int inside = (offset >= transform->offset && offset < transform->end);
+	size_t i;
+	ssize_t len;
+
+	/* filling does not need to read the range */
+	for(i = 0; i < size && (!inside
+				|| transform->operation != HETO_FILL); i += len)
+	{
+		if(transform->reader != NULL)
+			len = transform->reader(transform->reader_data,
+					&buf[i], size - i, offset + i);
+		else
+			len = pread(transform->fd, &buf[i], size - i,
+					offset + i);
+		if(len < 0 && errno == EINTR)
+			len = 0;
+		else if(len < 0)
+			return errno;
+		else if(len == 0)
+		{
+			/* the file ends before the range */
+			size = i;
+			break;
+		}
+	}
+	if(inside)
+		hexeditortransform_apply(transform, buf, size,
+				offset - transform->offset);
+	for(i = 0; i < size; i += len)
+		if((len = pwrite(transform->out, &buf[i], size - i,
+						offset + i)) < 0)
+		{
+			if(errno != EINTR)
+				return errno;
+			len = 0;
+		}
+	g_mutex_lock(&transform->mutex);
+	transform->done += size;
+	g_mutex_unlock(&transform->mutex);
+	return 0;
+}
@@ -0,0 +1,72 @@
+/* $Id$ */
+/* Copyright (c) 2020 Pierre Pronchery <khorben@defora.org> */
+/* This file is part of DeforaOS Desktop HexEditor */
+/* This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3 of the License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>. */
+
+
+
+#ifndef HEXEDITOR_TRANSFORM_H
+# define HEXEDITOR_TRANSFORM_H
+
+# include <sys/types.h>
+# include "buffer.h"
+
+
+/* HexEditorTransform */
+/* public */
+/* types */
+typedef struct _HexEditorTransform HexEditorTransform;
+
+typedef enum _HexEditorTransformOperation
+{
+	HETO_XOR = 0,
+	HETO_ADD,
+	HETO_SUB,
+	HETO_ROTATE,
+	HETO_SWAP16,
+	HETO_SWAP32,
+	HETO_SWAP64,
+	HETO_FILL
+} HexEditorTransformOperation;
+# define HETO_LAST	HETO_FILL
+# define HETO_COUNT	(HETO_LAST + 1)
+
+
+/* constants */
+# define HEXEDITORTRANSFORM_CHUNK_SIZE	(1024 * 1024)
+
+
+/* functions */
+/* the key repeats along the range, or holds the bits to rotate left by */
+HexEditorTransform * hexeditortransform_new(
+		HexEditorTransformOperation operation,
+		unsigned char const * key, size_t key_size);
+void hexeditortransform_delete(HexEditorTransform * transform);
+
+/* accessors */
+off_t hexeditortransform_get_position(HexEditorTransform * transform);
+off_t hexeditortransform_get_size(HexEditorTransform * transform);
+
+/* useful */
+/* position is relative to the range, a multiple of the words swapped */
+void hexeditortransform_apply(HexEditorTransform * transform,
+		unsigned char * buf, size_t size, off_t position);
+
+/* from fd, or the reader if not NULL, to out at the same offsets; the rest
+ * of the file is copied up to total if not 0 */
+int hexeditortransform_start(HexEditorTransform * transform, int fd,
+		HexEditorBufferReader reader, void * data, off_t offset,
+		off_t size, off_t total, int out);
+int hexeditortransform_poll(HexEditorTransform * transform);
+
+#endif /* !HEXEDITOR_TRANSFORM_H */
@@ -47,14 +47,27 @@ struct _HexEditorWindow
 static void _hexeditorwindow_on_close(gpointer data);
 static gboolean _hexeditorwindow_on_closex(gpointer data);
 static void _hexeditorwindow_on_contents(gpointer data);
+static void _hexeditorwindow_on_goto(gpointer data);
 static void _hexeditorwindow_on_open(gpointer data);
 
 #ifndef EMBEDDED
 /* menus */
 static void _hexeditorwindow_on_file_close(gpointer data);
+static void _hexeditorwindow_on_file_export(gpointer data);
+static void _hexeditorwindow_on_file_import(gpointer data);
+static void _hexeditorwindow_on_file_load_annotations(gpointer data);
 static void _hexeditorwindow_on_file_open(gpointer data);
+static void _hexeditorwindow_on_file_open_process(gpointer data);
 static void _hexeditorwindow_on_file_properties(gpointer data);
+static void _hexeditorwindow_on_file_refresh(gpointer data);
+static void _hexeditorwindow_on_file_save_annotations(gpointer data);
+static void _hexeditorwindow_on_edit_annotate(gpointer data);
+static void _hexeditorwindow_on_edit_find_all(gpointer data);
+static void _hexeditorwindow_on_edit_goto(gpointer data);
+static void _hexeditorwindow_on_edit_goto_bookmark(gpointer data);
+static void _hexeditorwindow_on_edit_paste(gpointer data);
 static void _hexeditorwindow_on_edit_preferences(gpointer data);
+static void _hexeditorwindow_on_edit_transform(gpointer data);
 static void _hexeditorwindow_on_help_about(gpointer data);
 static void _hexeditorwindow_on_help_contents(gpointer data);
 #endif
@@ -74,6 +87,7 @@ static const DesktopAccel _hexeditorwindow_accel[] =
 {
 	{ G_CALLBACK(_hexeditorwindow_on_close), GDK_CONTROL_MASK, GDK_KEY_W },
 	{ G_CALLBACK(_hexeditorwindow_on_contents), 0, GDK_KEY_F1 },
+	{ G_CALLBACK(_hexeditorwindow_on_goto), GDK_CONTROL_MASK, GDK_KEY_G },
 	{ NULL, 0, 0 }
 };
 #endif
@@ -84,6 +98,22 @@ static const DesktopMenu _hexeditorwindow_menu_file[] =
 {
 	{ N_("_Open"), G_CALLBACK(_hexeditorwindow_on_file_open),
 		GTK_STOCK_OPEN, GDK_CONTROL_MASK, GDK_KEY_O },
+	{ N_("Open _process..."),
+		G_CALLBACK(_hexeditorwindow_on_file_open_process), NULL, 0,
+		0 },
+	{ N_("_Refresh"), G_CALLBACK(_hexeditorwindow_on_file_refresh),
+		GTK_STOCK_REFRESH, 0, GDK_KEY_F5 },
+	{ "", NULL, NULL, 0, 0 },
+	{ N_("_Load annotations..."),
+		G_CALLBACK(_hexeditorwindow_on_file_load_annotations), NULL, 0,
+		0 },
+	{ N_("_Save annotations..."),
+		G_CALLBACK(_hexeditorwindow_on_file_save_annotations),
+		GTK_STOCK_SAVE_AS, 0, 0 },
+	{ N_("_Import..."), G_CALLBACK(_hexeditorwindow_on_file_import), NULL,
+		GDK_CONTROL_MASK, GDK_KEY_I },
+	{ N_("_Export..."), G_CALLBACK(_hexeditorwindow_on_file_export), NULL,
+		GDK_CONTROL_MASK, GDK_KEY_E },
 	{ "", NULL, NULL, 0, 0 },
 	{ N_("_Properties"), G_CALLBACK(_hexeditorwindow_on_file_properties),
 		GTK_STOCK_PROPERTIES, GDK_MOD1_MASK, GDK_KEY_Return },
@@ -95,6 +125,22 @@ static const DesktopMenu _hexeditorwindow_menu_file[] =
 
 static const DesktopMenu _hexeditorwindow_menu_edit[] =
 {
+	{ N_("_Paste as a new file..."),
+		G_CALLBACK(_hexeditorwindow_on_edit_paste), GTK_STOCK_PASTE,
+		GDK_CONTROL_MASK | GDK_SHIFT_MASK, GDK_KEY_V },
+	{ "", NULL, NULL, 0, 0 },
+	{ N_("_Find all..."), G_CALLBACK(_hexeditorwindow_on_edit_find_all),
+		GTK_STOCK_FIND, GDK_CONTROL_MASK, GDK_KEY_F },
+	{ N_("_Go to offset..."), G_CALLBACK(_hexeditorwindow_on_edit_goto),
+		GTK_STOCK_JUMP_TO, GDK_CONTROL_MASK, GDK_KEY_G },
+	{ N_("Go to next _bookmark"),
+		G_CALLBACK(_hexeditorwindow_on_edit_goto_bookmark), NULL, 0,
+		GDK_KEY_F2 },
+	{ N_("_Annotate..."), G_CALLBACK(_hexeditorwindow_on_edit_annotate),
+		NULL, GDK_CONTROL_MASK, GDK_KEY_B },
+	{ N_("_Transform..."), G_CALLBACK(_hexeditorwindow_on_edit_transform),
+		NULL, GDK_CONTROL_MASK, GDK_KEY_T },
+	{ "", NULL, NULL, 0, 0 },
 	{ N_("_Preferences"), G_CALLBACK(_hexeditorwindow_on_edit_preferences),
 		GTK_STOCK_PREFERENCES, GDK_CONTROL_MASK, GDK_KEY_P },
 	{ NULL, NULL, NULL, 0, 0 }
@@ -189,6 +235,13 @@ void hexeditorwindow_delete(HexEditorWindow * hexeditor)
 
 
 /* useful */
+/* hexeditorwindow_open_process */
+int hexeditorwindow_open_process(HexEditorWindow * hexeditor, pid_t pid)
+{
+	return hexeditor_open_process(hexeditor->hexeditor, pid);
+}
+
+
 /* callbacks */
 /* hexeditorwindow_on_close */
 static void _hexeditorwindow_on_close(gpointer data)
@@ -230,6 +283,33 @@ static void _hexeditorwindow_on_file_close(gpointer data)
 }
 
 
+/* hexeditorwindow_on_file_export */
+static void _hexeditorwindow_on_file_export(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_export_dialog(hexeditor->hexeditor);
+}
+
+
+/* hexeditorwindow_on_file_import */
+static void _hexeditorwindow_on_file_import(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_import(hexeditor->hexeditor, NULL, NULL);
+}
+
+
+/* hexeditorwindow_on_file_load_annotations */
+static void _hexeditorwindow_on_file_load_annotations(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_annotations_load(hexeditor->hexeditor, NULL);
+}
+
+
 /* hexeditorwindow_on_file_open */
 static void _hexeditorwindow_on_file_open(gpointer data)
 {
@@ -239,6 +319,15 @@ static void _hexeditorwindow_on_file_open(gpointer data)
 }
 
 
+/* hexeditorwindow_on_file_open_process */
+static void _hexeditorwindow_on_file_open_process(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_open_process_dialog(hexeditor->hexeditor);
+}
+
+
 /* hexeditorwindow_on_file_properties */
 static void _hexeditorwindow_on_file_properties(gpointer data)
 {
@@ -248,6 +337,69 @@ static void _hexeditorwindow_on_file_properties(gpointer data)
 }
 
 
+/* hexeditorwindow_on_file_refresh */
+static void _hexeditorwindow_on_file_refresh(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_refresh(hexeditor->hexeditor);
+}
+
+
+/* hexeditorwindow_on_file_save_annotations */
+static void _hexeditorwindow_on_file_save_annotations(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_annotations_save(hexeditor->hexeditor, NULL);
+}
+
+
+/* hexeditorwindow_on_edit_annotate */
+static void _hexeditorwindow_on_edit_annotate(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_annotate_dialog(hexeditor->hexeditor);
+}
+
+
+/* hexeditorwindow_on_edit_find_all */
+static void _hexeditorwindow_on_edit_find_all(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_search_dialog(hexeditor->hexeditor);
+}
+
+
+/* hexeditorwindow_on_edit_goto */
+static void _hexeditorwindow_on_edit_goto(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	_hexeditorwindow_on_goto(hexeditor);
+}
+
+
+/* hexeditorwindow_on_edit_goto_bookmark */
+static void _hexeditorwindow_on_edit_goto_bookmark(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_goto_bookmark(hexeditor->hexeditor);
+}
+
+
+/* hexeditorwindow_on_edit_paste */
+static void _hexeditorwindow_on_edit_paste(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_paste(hexeditor->hexeditor, NULL);
+}
+
+
 /* hexeditorwindow_on_edit_preferences */
 static void _hexeditorwindow_on_edit_preferences(gpointer data)
 {
@@ -257,6 +409,15 @@ static void _hexeditorwindow_on_edit_preferences(gpointer data)
 }
 
 
+/* hexeditorwindow_on_edit_transform */
+static void _hexeditorwindow_on_edit_transform(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_transform_dialog(hexeditor->hexeditor);
+}
+
+
 /* hexeditorwindow_on_help_about */
 static void _hexeditorwindow_on_help_about(gpointer data)
 {
@@ -291,6 +452,15 @@ static void _hexeditorwindow_on_help_contents(gpointer data)
 #endif
 
 
+/* hexeditorwindow_on_goto */
+static void _hexeditorwindow_on_goto(gpointer data)
+{
+	HexEditorWindow * hexeditor = data;
+
+	hexeditor_goto_dialog(hexeditor->hexeditor);
+}
+
+
 /* hexeditorwindow_on_open */
 static void _hexeditorwindow_on_open(gpointer data)
 {
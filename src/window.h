@@ -18,6 +18,8 @@
 #ifndef HEXEDITOR_WINDOW_H
 # define HEXEDITOR_WINDOW_H
 
+# include <sys/types.h>
+
 
 /* public */
 /* types */
@@ -28,4 +30,7 @@ typedef struct _HexEditorWindow HexEditorWindow;
 HexEditorWindow * hexeditorwindow_new(char const * filename);
 void hexeditorwindow_delete(HexEditorWindow * hexeditor);
 
+/* useful */
+int hexeditorwindow_open_process(HexEditorWindow * hexeditor, pid_t pid);
+
 #endif /* !HEXEDITOR_WINDOW_H */